@@ -20,22 +20,33 @@
 
 #include "ankiclient.h"
 
+#include <functional>
+#include <vector>
+
+#include <QCryptographicHash>
 #include <QDebug>
 #include <QFile>
+#include <QFileInfo>
 #include <QJsonArray>
 #include <QMetaType>
+#include <QMutexLocker>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
 #include <QTemporaryFile>
-#include <QThreadPool>
+#include <QTimer>
+#include <QUrl>
 
+#include "ankimediaindex.h"
+#include "ankirequestbody.h"
 #include "glossarybuilder.h"
 
 #include "gui/widgets/subtitlelistwidget.h"
 #include "player/playeradapter.h"
 #include "util/constants.h"
+#include "util/executor.h"
 #include "util/globalmediator.h"
+#include "util/trace.h"
 #include "util/utils.h"
 
 /* Anki request fields */
@@ -57,6 +68,8 @@
 
 #define ANKI_ACTION_GUI_BROWSE          "guiBrowse"
 #define ANKI_ACTION_STORE_MEDIA_FILE    "storeMediaFile"
+#define ANKI_ACTION_MEDIA_FILE_NAMES    "getMediaFilesNames"
+#define ANKI_ACTION_ACTIVE_PROFILE      "getActiveProfile"
 #define ANKI_ACTION_MULTI               "multi"
 
 /* Anki param fields */
@@ -64,6 +77,7 @@
 #define ANKI_PARAM_QUERY                "query"
 #define ANKI_PARAM_ADD_NOTE             "note"
 #define ANKI_PARAM_ACTIONS              "actions"
+#define ANKI_PARAM_PATTERN              "pattern"
 
 /* Anki note fields */
 #define ANKI_CAN_ADD_NOTES_PARAM        "notes"
@@ -88,9 +102,32 @@
 #define MIN_ANKICONNECT_VERSION         6
 #define TIMEOUT                         5000
 #define CONFIG_FILE                     "anki_connect.json"
+#define MEDIA_INDEX_FILE                "anki_media.json"
+#define SPOOL_FILE                      "anki_spool.jsonl"
 #define FURIGANA_FORMAT_STRING          (QString("<ruby>%1<rt>%2</rt></ruby>"))
 #define AUDIO_FILENAME_FORMAT_STRING    (QString("memento_%1_%2_%3.mp3"))
 
+/* The maximum number of cached canAddNotes results */
+#define ADDABLE_CACHE_SIZE              4096
+
+/* Budgets for batching queued writes into a single multi request */
+#define WRITE_BATCH_DELAY               100
+#define WRITE_BATCH_ACTIONS             64
+#define WRITE_BATCH_BYTES               (32 * 1024 * 1024)
+
+/* Media placeholders are only matched as the data of a media object, which
+ * can't occur inside escaped user text */
+#define STREAM_PREFIX                   "memento-stream:"
+#define STREAM_PATTERN \
+    "\"" ANKI_NOTE_DATA "\":\"" STREAM_PREFIX
+
+/* The number of bytes copied from a request body at once when spooling */
+#define SPOOL_CHUNK_SIZE                (64 * 1024)
+
+#define WRITE_SPOOLED_ERROR \
+    "Could not reach AnkiConnect. The note was saved and will be added once " \
+    "Anki is running and the connection is tested in the settings."
+
 /* Config file fields */
 #define CONFIG_ENABLED          "enabled"
 #define CONFIG_PROFILES         "profiles"
@@ -101,6 +138,7 @@
 #define CONFIG_DUPLICATE        "duplicate"
 #define CONFIG_NEWLINE_REPLACER "newline-replace"
 #define CONFIG_SCREENSHOT       "screenshot"
+#define CONFIG_SCREENSHOT_HEIGHT "screenshot-height"
 #define CONFIG_AUDIO_PAD_START  "audio-pad-start"
 #define CONFIG_AUDIO_PAD_END    "audio-pad-end"
 #define CONFIG_AUDIO_NORMALIZE  "audio-normalize"
@@ -119,6 +157,12 @@ AnkiClient::AnkiClient(QObject *parent) : QObject(parent)
 {
     m_manager = new QNetworkAccessManager(this);
     m_manager->setTransferTimeout(TIMEOUT);
+    m_mediaIndex =
+        new AnkiMediaIndex(DirectoryUtils::getConfigDir() + MEDIA_INDEX_FILE);
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(WRITE_BATCH_DELAY);
+    connect(m_flushTimer, &QTimer::timeout, this, &AnkiClient::flushWrites);
 
     if (!readConfigFromFile(CONFIG_FILE) || m_currentConfig == nullptr)
     {
@@ -140,12 +184,22 @@ AnkiClient::AnkiClient(QObject *parent) : QObject(parent)
         this, &AnkiClient::receiveBoolListRequest
     );
 
+    updateFirstFields();
+
     GlobalMediator::getGlobalMediator()->setAnkiClient(this);
 }
 
 AnkiClient::~AnkiClient()
 {
+    /* Writes that haven't been sent yet are kept for next time */
+    if (!m_pendingWrites.isEmpty())
+    {
+        spoolWrites(m_pendingWrites);
+    }
+    QStringList streams = m_streams.keys();
+    releaseStreams(streams);
     delete m_manager;
+    delete m_mediaIndex;
 }
 
 void AnkiClient::clearProfiles()
@@ -232,6 +286,11 @@ bool AnkiClient::readConfigFromFile(const QString &filename)
             modified = true;
             profile[CONFIG_SCREENSHOT] = DEFAULT_SCREENSHOT;
         }
+        if (profile[CONFIG_SCREENSHOT_HEIGHT].isNull())
+        {
+            modified = true;
+            profile[CONFIG_SCREENSHOT_HEIGHT] = DEFAULT_SCREENSHOT_HEIGHT;
+        }
         if (profile[CONFIG_TERM].isNull())
         {
             modified = true;
@@ -304,6 +363,11 @@ bool AnkiClient::readConfigFromFile(const QString &filename)
             qDebug() << CONFIG_SCREENSHOT << "is not a double";
             return false;
         }
+        else if (!profile[CONFIG_SCREENSHOT_HEIGHT].isDouble())
+        {
+            qDebug() << CONFIG_SCREENSHOT_HEIGHT << "is not a double";
+            return false;
+        }
         else if (!profile[CONFIG_AUDIO_PAD_START].isDouble())
         {
             qDebug() << CONFIG_AUDIO_PAD_START << "is not a double";
@@ -359,6 +423,8 @@ bool AnkiClient::readConfigFromFile(const QString &filename)
 
         config->screenshotType  = (AnkiConfig::FileType)
             profile[CONFIG_SCREENSHOT].toInt(DEFAULT_SCREENSHOT);
+        config->screenshotHeight = profile[CONFIG_SCREENSHOT_HEIGHT]
+            .toInt(DEFAULT_SCREENSHOT_HEIGHT);
         config->audioPadStart   = profile[CONFIG_AUDIO_PAD_START].toDouble();
         config->audioPadEnd     = profile[CONFIG_AUDIO_PAD_END].toDouble();
         config->audioNormalize  = profile[CONFIG_AUDIO_NORMALIZE].toBool();
@@ -393,6 +459,7 @@ bool AnkiClient::readConfigFromFile(const QString &filename)
     if (m_currentConfig)
     {
         setServer(m_currentConfig->address, m_currentConfig->port);
+        compileTemplates();
     }
 
     m_configExists = true;
@@ -426,6 +493,7 @@ bool AnkiClient::writeConfigToFile(const QString &filename)
         configObj[CONFIG_DUPLICATE]        = config->duplicatePolicy;
         configObj[CONFIG_NEWLINE_REPLACER] = config->newlineReplacer;
         configObj[CONFIG_SCREENSHOT]       = config->screenshotType;
+        configObj[CONFIG_SCREENSHOT_HEIGHT] = config->screenshotHeight;
         configObj[CONFIG_AUDIO_PAD_START]  = config->audioPadStart;
         configObj[CONFIG_AUDIO_PAD_END]    = config->audioPadEnd;
         configObj[CONFIG_AUDIO_NORMALIZE]  = config->audioNormalize;
@@ -465,6 +533,7 @@ bool AnkiClient::writeConfigToFile(const QString &filename)
 void AnkiClient::writeChanges()
 {
     writeConfigToFile(CONFIG_FILE);
+    updateFirstFields();
     Q_EMIT GlobalMediator::getGlobalMediator()->ankiSettingsChanged();
 }
 
@@ -494,6 +563,8 @@ bool AnkiClient::setProfile(const QString &profile)
         m_currentConfig = config;
         m_currentProfile = profile;
         setServer(m_currentConfig->address, m_currentConfig->port);
+        compileTemplates();
+        updateFirstFields();
         return true;
     }
     return false;
@@ -538,6 +609,7 @@ void AnkiClient::setDefaultConfig()
     config->port            = DEFAULT_PORT;
     config->duplicatePolicy = DEFAULT_DUPLICATE_POLICY;
     config->screenshotType  = DEFAULT_SCREENSHOT;
+    config->screenshotHeight = DEFAULT_SCREENSHOT_HEIGHT;
     config->audioPadStart   = DEFAULT_AUDIO_PAD_START;
     config->audioPadEnd     = DEFAULT_AUDIO_PAD_END;
     config->audioNormalize  = DEFAULT_AUDIO_NORMALIZE;
@@ -550,6 +622,34 @@ void AnkiClient::setDefaultConfig()
     m_currentProfile = DEFAULT_PROFILE;
 
     setServer(config->address, config->port);
+    compileTemplates();
+}
+
+void AnkiClient::compileTemplates()
+{
+    CardTemplate termTemplate(
+        m_currentConfig->termFields, CardTemplate::Type::Term
+    );
+    CardTemplate kanjiTemplate(
+        m_currentConfig->kanjiFields, CardTemplate::Type::Kanji
+    );
+
+    QMutexLocker locker(&m_templateLock);
+    m_termTemplate = termTemplate;
+    m_kanjiTemplate = kanjiTemplate;
+}
+
+CardTemplate AnkiClient::getTemplate(const CardTemplate::Type type) const
+{
+    QMutexLocker locker(&m_templateLock);
+    switch (type)
+    {
+    case CardTemplate::Type::Term:
+        return m_termTemplate;
+    case CardTemplate::Type::Kanji:
+        return m_kanjiTemplate;
+    }
+    return CardTemplate();
 }
 
 /* End Config/Profile Methods */
@@ -567,13 +667,29 @@ bool AnkiClient::isEnabled() const
 
 void AnkiClient::setEnabled(const bool value)
 {
+    const bool changed = m_enabled != value;
     m_enabled = value;
+    if (changed && m_enabled)
+    {
+        seedMediaIndex();
+        updateFirstFields();
+    }
 }
 
 void AnkiClient::setServer(const QString &address, const QString &port)
 {
+    const bool changed = m_address != address || m_port != port;
     m_address = address;
     m_port = port;
+    if (changed && m_enabled)
+    {
+        seedMediaIndex();
+    }
+}
+
+QString AnkiClient::getServer() const
+{
+    return m_address + ':' + m_port;
 }
 
 /* End Getter/Setters */
@@ -609,6 +725,8 @@ AnkiReply *AnkiClient::testConnection()
             else
             {
                 Q_EMIT ankiReply->finishedBool(true, error);
+                seedMediaIndex();
+                replaySpool();
             }
             ankiReply->deleteLater();
             reply->deleteLater();
@@ -638,54 +756,38 @@ AnkiReply *AnkiClient::notesAddable(QList<QSharedPointer<const Term>> terms)
 {
     AnkiReply *ankiReply = new AnkiReply;
 
-    QThreadPool::globalInstance()->start(
-    [this, terms, ankiReply]
-    {
-        QJsonArray notes;
-        for (QSharedPointer<const Term> term : terms)
-        {
-            /* Make sure to check for both reading as expression and not */
-            Term termCopy(*term);
-            termCopy.readingAsExpression = false;
-            notes.append(createAnkiNoteObject(termCopy, false));
-            if (!term->reading.isEmpty())
-            {
-                termCopy.readingAsExpression = true;
-                notes.append(createAnkiNoteObject(termCopy, false));
-            }
-        }
-        QJsonObject params;
-        params[ANKI_CAN_ADD_NOTES_PARAM] = notes;
+    Executor::run(
+        Executor::Queue::Anki,
+        [this, terms, ankiReply] {
+            /* Only the first field matters for duplicate checking */
+            const QString firstField =
+                getFirstField(m_currentConfig->termModel);
+            const CardTemplate tmpl =
+                getTemplate(CardTemplate::Type::Term).onlyField(firstField);
 
-        AnkiReply *proxyReply = new AnkiReply;
-        connect(proxyReply, &AnkiReply::finishedBoolList, this,
-        [ankiReply, terms] (const QList<bool> &value, const QString &error)
-        {
-            QList<bool> result;
-            for (int termsIdx = 0, valueIdx = 0;
-                 termsIdx < terms.size() && valueIdx < value.size();
-                 ++termsIdx)
+            /* Make sure to check for both reading as expression and not */
+            QList<QJsonObject> notes;
+            QList<QPair<QString, QString>> filemap;
+            for (QSharedPointer<const Term> term : terms)
             {
-                if (terms[termsIdx]->reading.isEmpty())
+                Term termCopy(*term);
+                termCopy.readingAsExpression = false;
+                notes << createAnkiNoteObject(termCopy, false, filemap, tmpl);
+                if (term->reading.isEmpty())
                 {
-                    result << value[valueIdx] << false;
-                    ++valueIdx;
+                    notes << QJsonObject();
                 }
                 else
                 {
-                    result << value[valueIdx] << value[valueIdx + 1];
-                    valueIdx += 2;
+                    termCopy.readingAsExpression = true;
+                    notes << createAnkiNoteObject(
+                        termCopy, false, filemap, tmpl
+                    );
                 }
             }
-            Q_EMIT ankiReply->finishedBoolList(result, error);
-            ankiReply->deleteLater();
-        }
-        );
-
-        Q_EMIT sendBoolListRequest(
-            ANKI_ACTION_CAN_ADD_NOTES, params, proxyReply
-        );
-    }
+            checkNotesAddable(notes, firstField, ankiReply);
+        },
+        Executor::Priority::Normal
     );
 
     return ankiReply;
@@ -695,19 +797,22 @@ AnkiReply *AnkiClient::notesAddable(QList<QSharedPointer<const Kanji>> kanji)
 {
     AnkiReply *ankiReply = new AnkiReply;
 
-    QThreadPool::globalInstance()->start(
+    Executor::run(
+        Executor::Queue::Anki,
         [this, kanji, ankiReply] {
-            QJsonArray notes;
+            const QString firstField =
+                getFirstField(m_currentConfig->kanjiModel);
+            const CardTemplate tmpl =
+                getTemplate(CardTemplate::Type::Kanji).onlyField(firstField);
+
+            QList<QJsonObject> notes;
             for (QSharedPointer<const Kanji> kanji : kanji)
             {
-                notes.append(createAnkiNoteObject(*kanji, false));
+                notes << createAnkiNoteObject(*kanji, false, tmpl);
             }
-            QJsonObject params;
-            params[ANKI_CAN_ADD_NOTES_PARAM] = notes;
-            Q_EMIT sendBoolListRequest(
-                ANKI_ACTION_CAN_ADD_NOTES, params, ankiReply
-            );
-        }
+            checkNotesAddable(notes, firstField, ankiReply);
+        },
+        Executor::Priority::Normal
     );
 
     return ankiReply;
@@ -717,7 +822,8 @@ AnkiReply *AnkiClient::addNote(const Term *term)
 {
     AnkiReply *ankiReply = new AnkiReply;
 
-    QThreadPool::globalInstance()->start(
+    Executor::run(
+        Executor::Queue::Anki,
         [=] {
             QJsonObject params;
             QList<QPair<QString, QString>> filemap;
@@ -729,7 +835,14 @@ AnkiReply *AnkiClient::addNote(const Term *term)
             delete term;
             params[ANKI_PARAM_ADD_NOTE] = note;
             Q_EMIT sendIntRequest(ANKI_ACTION_ADD_NOTE, params, ankiReply);
-        }
+        },
+        Executor::Priority::Interactive
+    );
+
+    invalidateAddableCache();
+    connect(
+        ankiReply, &AnkiReply::finishedInt,
+        this, &AnkiClient::invalidateAddableCache
     );
 
     return ankiReply;
@@ -739,14 +852,22 @@ AnkiReply *AnkiClient::addNote(const Kanji *kanji)
 {
     AnkiReply *ankiReply = new AnkiReply;
 
-    QThreadPool::globalInstance()->start(
+    Executor::run(
+        Executor::Queue::Anki,
         [=] {
             QJsonObject params;
             QJsonObject note = createAnkiNoteObject(*kanji, true);
             delete kanji;
             params[ANKI_PARAM_ADD_NOTE] = note;
             Q_EMIT sendIntRequest(ANKI_ACTION_ADD_NOTE, params, ankiReply);
-        }
+        },
+        Executor::Priority::Interactive
+    );
+
+    invalidateAddableCache();
+    connect(
+        ankiReply, &AnkiReply::finishedInt,
+        this, &AnkiClient::invalidateAddableCache
     );
 
     return ankiReply;
@@ -813,184 +934,863 @@ AnkiReply *AnkiClient::openBrowse(const QString &deck, const QString &query)
 
 AnkiReply *AnkiClient::addMedia(const QList<QPair<QString, QString>> &fileMap)
 {
-    QJsonObject params;
-    QJsonArray actions;
+    AnkiReply *ankiReply = new AnkiReply;
+
+    /* The profile open in Anki can change at any time, so check it before
+     * trusting the media index. */
+    const QString server = getServer();
+    QNetworkReply *reply = makeRequest(ANKI_ACTION_ACTIVE_PROFILE);
+    connect(reply, &QNetworkReply::finished, this,
+        [=] {
+            QString error;
+            const QString collection = processCollection(reply, server, error);
+            reply->deleteLater();
+            if (collection.isEmpty())
+            {
+                qDebug() << "Could not get the Anki profile:" << error;
+            }
+            else if (collection != m_mediaCollection && !m_mediaSeeding)
+            {
+                seedMediaIndex();
+            }
+            storeMedia(
+                fileMap, collection, collection == m_mediaCollection, ankiReply
+            );
+        }
+    );
+    return ankiReply;
+}
+
+void AnkiClient::storeMedia(
+    const QList<QPair<QString, QString>> &fileMap,
+    const QString &collection,
+    const bool skipStored,
+    AnkiReply *ankiReply)
+{
+    /* Filenames are content addressed, so files the collection already has
+     * can be skipped without reading them. */
+    QList<QJsonObject> actions;
+    QStringList skipped;
+    QSet<QString> queued;
     for (const QPair<QString, QString> &p : fileMap)
     {
+        if (skipStored && m_mediaIndex->contains(collection, p.second))
+        {
+            skipped << p.second;
+            continue;
+        }
+        else if (queued.contains(p.second))
+        {
+            continue;
+        }
+        queued.insert(p.second);
+
         QJsonObject command;
         command[ANKI_ACTION] = ANKI_ACTION_STORE_MEDIA_FILE;
+        command[ANKI_VERSION] = MIN_ANKICONNECT_VERSION;
         QJsonObject fileParams;
-        fileParams[ANKI_NOTE_DATA] = fileToBase64(p.first);
+        fileParams[ANKI_NOTE_DATA] = streamFile(p.first, false);
         fileParams[ANKI_NOTE_FILENAME] = p.second;
         command[ANKI_PARAMS] = fileParams;
 
         actions << command;
     }
-    params[ANKI_PARAM_ACTIONS] = actions;
 
-    QNetworkReply *reply = makeRequest(ANKI_ACTION_MULTI, params);
-    AnkiReply *ankiReply = new AnkiReply;
+    if (actions.isEmpty())
+    {
+        QTimer::singleShot(0, ankiReply,
+            [=] {
+                Q_EMIT ankiReply->finishedStringList(skipped, QString());
+                ankiReply->deleteLater();
+            }
+        );
+        return;
+    }
+
+    enqueueWrite(actions,
+        [=] (const QJsonArray &results, const QString &error) {
+            if (!error.isEmpty())
+            {
+                Q_EMIT ankiReply->finishedStringList(QStringList(), error);
+                ankiReply->deleteLater();
+                return;
+            }
+
+            QStringList filenames;
+            for (const QJsonValue &result : results)
+            {
+                QJsonObject obj;
+                if (!result.isObject())
+                {
+                    Q_EMIT ankiReply->finishedStringList(
+                        QStringList(), "Result is not an array of objects"
+                    );
+                    goto exit;
+                }
+
+                obj = result.toObject();
+                if (!obj[ANKI_ERROR].isNull())
+                {
+                    Q_EMIT ankiReply->finishedStringList(
+                        QStringList(), obj[ANKI_ERROR].toString()
+                    );
+                    goto exit;
+                }
+
+                if (!obj[ANKI_RESULT].isString())
+                {
+                    Q_EMIT ankiReply->finishedStringList(
+                        QStringList(), "A result is not a string"
+                    );
+                    goto exit;
+                }
+
+                filenames << obj[ANKI_RESULT].toString();
+            }
+            if (!collection.isEmpty())
+            {
+                m_mediaIndex->insert(collection, filenames);
+            }
+            Q_EMIT ankiReply->finishedStringList(skipped + filenames, error);
+        exit:
+            ankiReply->deleteLater();
+        }
+    );
+}
+
+void AnkiClient::seedMediaIndex()
+{
+    /* Don't trust the index until the new collection is known */
+    m_mediaCollection.clear();
+    m_mediaSeeding = true;
+    const int seed = ++m_mediaSeed;
+    const QString server = getServer();
+
+    QNetworkReply *reply = makeRequest(ANKI_ACTION_ACTIVE_PROFILE);
     connect(reply, &QNetworkReply::finished, this,
         [=] {
             QString error;
-            QJsonObject replyObj = processReply(reply, error);
-            if (replyObj.isEmpty())
+            const QString collection = processCollection(reply, server, error);
+            reply->deleteLater();
+            if (seed != m_mediaSeed)
             {
-                Q_EMIT ankiReply->finishedStringList(QStringList(), error);
+                return;
             }
-            else if (!replyObj[ANKI_RESULT].isArray())
+            else if (collection.isEmpty())
             {
-                Q_EMIT ankiReply->finishedStringList(
-                    QStringList(), "Result is not an array"
-                );
+                qDebug() << "Could not get the Anki profile:" << error;
+                m_mediaSeeding = false;
+                return;
             }
-            else
-            {
-                QStringList filenames;
-                QJsonArray resultObjects = replyObj[ANKI_RESULT].toArray();
-                for (const QJsonValueRef &result : resultObjects)
-                {
-                    QJsonObject obj;
-                    if (!result.isObject())
-                    {
-                        Q_EMIT ankiReply->finishedStringList(
-                            QStringList(), "Result is not an array of objects"
-                        );
-                        goto exit;
-                    }
 
-                    obj = result.toObject();
-                    if (!obj[ANKI_ERROR].isNull())
+            QJsonObject params;
+            params[ANKI_PARAM_PATTERN] = "*";
+            AnkiReply *ankiReply =
+                requestStringList(ANKI_ACTION_MEDIA_FILE_NAMES, params);
+            connect(ankiReply, &AnkiReply::finishedStringList, this,
+                [=] (const QStringList &filenames, const QString &error) {
+                    if (seed != m_mediaSeed)
                     {
-                        Q_EMIT ankiReply->finishedStringList(
-                            QStringList(), obj[ANKI_ERROR].toString()
-                        );
-                        goto exit;
+                        return;
                     }
-
-                    if (!obj[ANKI_RESULT].isString())
+                    m_mediaSeeding = false;
+                    if (!error.isEmpty())
                     {
-                        Q_EMIT ankiReply->finishedStringList(
-                            QStringList(), "A result is not a string"
-                        );
-                        goto exit;
+                        qDebug() << "Could not get Anki media files:" << error;
+                        return;
                     }
-
-                    filenames << obj[ANKI_RESULT].toString();
+                    m_mediaIndex->reset(collection, filenames);
+                    m_mediaCollection = collection;
                 }
-                Q_EMIT ankiReply->finishedStringList(filenames, error);
-            }
-        exit:
-            ankiReply->deleteLater();
-            reply->deleteLater();
+            );
         }
     );
-    return ankiReply;
 }
 
 /* End Commands */
-/* Begin Network Helpers */
+/* Begin Duplicate Checking */
 
-QNetworkReply *AnkiClient::makeRequest(const QString     &action,
-                                       const QJsonObject &params)
+void AnkiClient::invalidateAddableCache()
 {
-    QNetworkRequest request;
-    request.setUrl(QUrl("http://" + m_address + ":" + m_port));
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    QMutexLocker locker(&m_addableLock);
+    m_addableCache.clear();
+    ++m_addableGeneration;
+}
 
-    QJsonObject jsonMsg;
-    jsonMsg[ANKI_ACTION] = action;
-    jsonMsg[ANKI_VERSION] = MIN_ANKICONNECT_VERSION;
-    if (!params.isEmpty())
+void AnkiClient::updateFirstFields()
+{
+    invalidateAddableCache();
     {
-        jsonMsg[ANKI_PARAMS] = params;
+        QMutexLocker locker(&m_addableLock);
+        m_firstFields.clear();
+    }
+    if (!m_enabled)
+    {
+        return;
     }
-    QJsonDocument jsonDoc(jsonMsg);
-
-    return m_manager->post(request, jsonDoc.toJson());
-}
 
-QJsonObject AnkiClient::processReply(QNetworkReply *reply, QString &error)
-{
-    switch (reply->error())
+    QStringList models{m_currentConfig->termModel};
+    if (m_currentConfig->kanjiModel != m_currentConfig->termModel)
     {
-    case QNetworkReply::NoError:
+        models << m_currentConfig->kanjiModel;
+    }
+    for (const QString &model : models)
     {
-        QJsonDocument replyDoc = QJsonDocument::fromJson(reply->readAll());
-        if (replyDoc.isNull())
-        {
-            error = "Reply was not JSON";
-            qDebug() << reply->readAll();
-            return QJsonObject();
-        }
-        else if (!replyDoc.isObject())
+        if (model.isEmpty())
         {
-            error = "Reply was not an object";
-            return QJsonObject();
+            continue;
         }
+        AnkiReply *reply = getFieldNames(model);
+        connect(reply, &AnkiReply::finishedStringList, this,
+            [=] (const QStringList &fields, const QString &error) {
+                if (!error.isEmpty() || fields.isEmpty())
+                {
+                    return;
+                }
+                QMutexLocker locker(&m_addableLock);
+                m_firstFields[model] = fields.first();
+            }
+        );
+    }
+}
 
-        QJsonObject replyObj = replyDoc.object();
-        if (replyObj.length() != 2)
-        {
-            error = "Anki response has unexpected number of fields";
-        }
-        else if (!replyObj.contains(ANKI_ERROR))
-        {
-            error = "Anki response is missing error field";
-        }
-        else if (!replyObj.contains(ANKI_RESULT))
-        {
-            error = "Anki response is missing result field";
-        }
-        else if (!replyObj[ANKI_ERROR].isNull())
-        {
-            error = replyObj[ANKI_ERROR].toString();
-        }
-        else
+QString AnkiClient::getFirstField(const QString &model) const
+{
+    QMutexLocker locker(&m_addableLock);
+    return m_firstFields.value(model);
+}
+
+void AnkiClient::checkNotesAddable(
+    const QList<QJsonObject> &notes,
+    const QString &firstField,
+    AnkiReply *ankiReply)
+{
+    QList<bool> result(notes.size(), false);
+    QStringList keys(notes.size());
+    QJsonArray uncached;
+    QList<int> uncachedIndices;
+    quint64 generation = 0;
+    {
+        QMutexLocker locker(&m_addableLock);
+        generation = m_addableGeneration;
+        for (int i = 0; i < notes.size(); ++i)
         {
-            return replyObj;
+            const QJsonObject &note = notes[i];
+            if (note.isEmpty())
+            {
+                continue;
+            }
+
+            if (!firstField.isEmpty())
+            {
+                keys[i] = note[ANKI_NOTE_DECK].toString() + '\x1f' +
+                    note[ANKI_NOTE_MODEL].toString() + '\x1f' +
+                    note[ANKI_NOTE_FIELDS][firstField].toString();
+                auto it = m_addableCache.constFind(keys[i]);
+                if (it != m_addableCache.constEnd())
+                {
+                    result[i] = it.value();
+                    continue;
+                }
+            }
+            uncached.append(note);
+            uncachedIndices.append(i);
         }
-        break;
     }
-    default:
-        error = reply->errorString();
+
+    /* Queue the result on the reply's thread since the caller may not have
+     * connected to it yet */
+    if (uncached.isEmpty())
+    {
+        QMetaObject::invokeMethod(
+            ankiReply,
+            [=] {
+                Q_EMIT ankiReply->finishedBoolList(result, QString());
+                ankiReply->deleteLater();
+            },
+            Qt::QueuedConnection
+        );
+        return;
     }
 
-    return QJsonObject();
-}
+    QJsonObject params;
+    params[ANKI_CAN_ADD_NOTES_PARAM] = uncached;
 
-void AnkiClient::receiveIntRequest(const QString     &action,
-                                   const QJsonObject &params,
-                                   AnkiReply         *ankiReply)
-{
-    QNetworkReply *reply = makeRequest(action, params);
-    connect(reply, &QNetworkReply::finished, this,
-        [=] {
-            QString error;
-            QJsonObject replyObj = processReply(reply, error);
-            if (replyObj.isEmpty())
+    AnkiReply *proxyReply = new AnkiReply;
+    connect(proxyReply, &AnkiReply::finishedBoolList, this,
+        [=] (const QList<bool> &value, const QString &error) mutable {
+            if (value.size() != uncachedIndices.size())
             {
-                Q_EMIT ankiReply->finishedInt(0, error);
+                Q_EMIT ankiReply->finishedBoolList(QList<bool>(), error);
+                ankiReply->deleteLater();
+                return;
             }
-            else if (!replyObj[ANKI_RESULT].isDouble())
+
+            QMutexLocker locker(&m_addableLock);
+            const bool current = generation == m_addableGeneration;
+            if (current && m_addableCache.size() > ADDABLE_CACHE_SIZE)
             {
-                Q_EMIT ankiReply->finishedInt(
-                    0, "AnkiConnect result is not a double"
-                );
+                m_addableCache.clear();
             }
-            else
+            for (int i = 0; i < value.size(); ++i)
             {
-                Q_EMIT ankiReply->finishedInt(
-                    replyObj[ANKI_RESULT].toInt(), error
-                );
+                const int index = uncachedIndices[i];
+                result[index] = value[i];
+                if (current && !keys[index].isEmpty())
+                {
+                    m_addableCache.insert(keys[index], value[i]);
+                }
             }
+            locker.unlock();
+
+            Q_EMIT ankiReply->finishedBoolList(result, error);
             ankiReply->deleteLater();
-            reply->deleteLater();
         }
     );
+
+    Q_EMIT sendBoolListRequest(
+        ANKI_ACTION_CAN_ADD_NOTES, params, proxyReply
+    );
 }
 
-void AnkiClient::receiveBoolListRequest(const QString     &,
+/* End Duplicate Checking */
+/* Begin Write Queue */
+
+void AnkiClient::enqueueWrite(
+    const QList<QJsonObject> &actions,
+    WriteCallback callback)
+{
+    PendingWrite write;
+    for (const QJsonObject &action : actions)
+    {
+        write.actions << QJsonDocument(action).toJson(QJsonDocument::Compact);
+        write.size += write.actions.last().size();
+        write.streams << findStreams(write.actions.last());
+    }
+    write.callback = std::move(callback);
+
+    /* Budget for the encoded media rather than the placeholders */
+    {
+        QMutexLocker locker(&m_streamLock);
+        for (const QString &key : write.streams)
+        {
+            const MediaStream stream = m_streams.value(key);
+            const qint64 size = stream.path.isEmpty()
+                ? stream.data.size() : QFileInfo(stream.path).size();
+            write.size += AnkiRequestBody::encodedSize(size) - key.size();
+        }
+    }
+
+    m_pendingBytes += write.size;
+    m_pendingActions += write.actions.size();
+    m_pendingWrites.append(write);
+
+    if (m_pendingBytes >= WRITE_BATCH_BYTES ||
+        m_pendingActions >= WRITE_BATCH_ACTIONS)
+    {
+        flushWrites();
+    }
+    else if (!m_flushTimer->isActive())
+    {
+        m_flushTimer->start();
+    }
+}
+
+/**
+ * Checks if a network error means the server couldn't be reached at all.
+ * Errors after the connection was made aren't included since AnkiConnect may
+ * have already run the actions, and replaying them would add notes twice.
+ * @param error The error of the reply.
+ * @return true if the request never reached AnkiConnect, false otherwise.
+ */
+static bool isUnreachable(const QNetworkReply::NetworkError error)
+{
+    switch (error)
+    {
+    case QNetworkReply::ConnectionRefusedError:
+    case QNetworkReply::HostNotFoundError:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void AnkiClient::flushWrites()
+{
+    if (m_writeInFlight || m_pendingWrites.isEmpty())
+    {
+        return;
+    }
+    m_flushTimer->stop();
+
+    /* Take writes in order until the batch is full. A single write larger
+     * than the budget is sent on its own. */
+    QList<PendingWrite> batch;
+    qsizetype bytes = 0;
+    int count = 0;
+    while (!m_pendingWrites.isEmpty())
+    {
+        const PendingWrite &next = m_pendingWrites.first();
+        if (!batch.isEmpty() &&
+            (bytes + next.size > WRITE_BATCH_BYTES ||
+             count + next.actions.size() > WRITE_BATCH_ACTIONS))
+        {
+            break;
+        }
+        bytes += next.size;
+        count += next.actions.size();
+        batch.append(m_pendingWrites.takeFirst());
+    }
+    m_pendingBytes -= bytes;
+    m_pendingActions -= count;
+
+    QList<QByteArray> actions;
+    for (const PendingWrite &write : batch)
+    {
+        actions << write.actions;
+    }
+    QByteArray prefix;
+    prefix += "{\"" ANKI_ACTION "\":\"" ANKI_ACTION_MULTI "\",";
+    prefix += "\"" ANKI_VERSION "\":";
+    prefix += QByteArray::number(MIN_ANKICONNECT_VERSION);
+    prefix += ",\"" ANKI_PARAMS "\":{\"" ANKI_PARAM_ACTIONS "\":[";
+
+    AnkiRequestBody *body = new AnkiRequestBody;
+    buildRequestBody(*body, actions, prefix, "]}}");
+    body->open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+
+    Trace::addInstant("AnkiClient::flushWrites");
+
+    m_writeInFlight = true;
+    QNetworkReply *reply = postRequest(
+        QString(ANKI_ACTION_MULTI " (%1 actions)").arg(count), body
+    );
+    body->setParent(reply);
+    connect(reply, &QNetworkReply::finished, this,
+        [=] {
+            m_writeInFlight = false;
+            body->close();
+
+            QString error;
+            QJsonArray results;
+            if (isUnreachable(reply->error()))
+            {
+                qDebug() << "AnkiConnect is unreachable, spooling"
+                         << count << "actions:" << reply->errorString();
+                error = spoolWrites(batch)
+                    ? WRITE_SPOOLED_ERROR : reply->errorString();
+            }
+            else
+            {
+                QJsonObject replyObj = processReply(reply, error);
+                results = replyObj[ANKI_RESULT].toArray();
+                if (!replyObj.isEmpty() && results.size() != count)
+                {
+                    error = "AnkiConnect returned the wrong number of results";
+                }
+            }
+
+            qsizetype offset = 0;
+            for (const PendingWrite &write : batch)
+            {
+                QJsonArray writeResults;
+                for (qsizetype i = 0;
+                     error.isEmpty() && i < write.actions.size();
+                     ++i)
+                {
+                    writeResults.append(results.at(offset + i));
+                }
+                offset += write.actions.size();
+
+                if (write.callback)
+                {
+                    write.callback(writeResults, error);
+                }
+                releaseStreams(write.streams);
+            }
+            reply->deleteLater();
+
+            flushWrites();
+        }
+    );
+}
+
+bool AnkiClient::spoolWrites(const QList<PendingWrite> &writes) const
+{
+    QFile spool(DirectoryUtils::getConfigDir() + SPOOL_FILE);
+    if (!spool.open(QIODevice::WriteOnly | QIODevice::Append))
+    {
+        qDebug() << "Could not open the Anki spool" << spool.fileName();
+        return false;
+    }
+
+    /* Each line is a JSON array of actions that must be sent together */
+    const qint64 start = spool.size();
+    for (const PendingWrite &write : writes)
+    {
+        AnkiRequestBody line;
+        buildRequestBody(line, write.actions, "[", "]\n");
+        line.open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+        while (!line.atEnd())
+        {
+            const QByteArray chunk = line.read(SPOOL_CHUNK_SIZE);
+            if (chunk.isEmpty() || spool.write(chunk) != chunk.size())
+            {
+                qDebug() << "Could not write to the Anki spool"
+                         << spool.fileName();
+                goto error;
+            }
+        }
+    }
+    if (!spool.flush())
+    {
+        qDebug() << "Could not write to the Anki spool" << spool.fileName();
+        goto error;
+    }
+    return true;
+
+error:
+    /* None of the writes are reported as spooled, so don't leave any of
+     * them or a partial line behind */
+    spool.resize(start);
+    return false;
+}
+
+void AnkiClient::replaySpool()
+{
+    QFile spool(DirectoryUtils::getConfigDir() + SPOOL_FILE);
+    if (!spool.exists())
+    {
+        return;
+    }
+    if (!spool.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "Could not open the Anki spool" << spool.fileName();
+        return;
+    }
+    const QList<QByteArray> lines = spool.readAll().split('\n');
+    spool.close();
+    spool.remove();
+
+    int replayed = 0;
+    for (const QByteArray &line : lines)
+    {
+        const QJsonArray array = QJsonDocument::fromJson(line).array();
+        if (array.isEmpty())
+        {
+            continue;
+        }
+
+        QList<QJsonObject> actions;
+        for (const QJsonValue &action : array)
+        {
+            actions << action.toObject();
+        }
+        enqueueWrite(actions,
+            [] (const QJsonArray &results, const QString &error) {
+                if (!error.isEmpty())
+                {
+                    qDebug() << "Could not replay spooled Anki write:"
+                             << error;
+                    return;
+                }
+                for (const QJsonValue &result : results)
+                {
+                    const QJsonValue resultError =
+                        result.toObject().value(ANKI_ERROR);
+                    if (!resultError.isNull())
+                    {
+                        qDebug() << "Spooled Anki write failed:"
+                                 << resultError.toString();
+                    }
+                }
+            }
+        );
+        ++replayed;
+    }
+    qDebug() << "Replaying" << replayed << "spooled Anki writes";
+}
+
+/* End Write Queue */
+/* Begin Media Streams */
+
+QString AnkiClient::streamFile(const QString &path, const bool temporary)
+{
+    QMutexLocker locker(&m_streamLock);
+    const QString key = STREAM_PREFIX + QString::number(m_nextStream++);
+    m_streams.insert(key, {path, QByteArray(), temporary});
+    return key;
+}
+
+QString AnkiClient::streamData(const QByteArray &data)
+{
+    QMutexLocker locker(&m_streamLock);
+    const QString key = STREAM_PREFIX + QString::number(m_nextStream++);
+    m_streams.insert(key, {QString(), data, false});
+    return key;
+}
+
+QStringList AnkiClient::findStreams(const QByteArray &action)
+{
+    constexpr qsizetype PATTERN_SIZE = sizeof(STREAM_PATTERN) - 1;
+    constexpr qsizetype PREFIX_SIZE = sizeof(STREAM_PREFIX) - 1;
+
+    QStringList streams;
+    qsizetype start = action.indexOf(STREAM_PATTERN);
+    while (start != -1)
+    {
+        const qsizetype key = start + PATTERN_SIZE - PREFIX_SIZE;
+        const qsizetype end = action.indexOf('"', key);
+        if (end == -1)
+        {
+            break;
+        }
+        streams << QString::fromUtf8(action.mid(key, end - key));
+        start = action.indexOf(STREAM_PATTERN, end);
+    }
+    return streams;
+}
+
+void AnkiClient::releaseStreams(const QStringList &streams)
+{
+    QMutexLocker locker(&m_streamLock);
+    for (const QString &key : streams)
+    {
+        const MediaStream stream = m_streams.take(key);
+        if (stream.temporary)
+        {
+            QFile::remove(stream.path);
+        }
+    }
+}
+
+void AnkiClient::buildRequestBody(
+    AnkiRequestBody &body,
+    const QList<QByteArray> &actions,
+    const QByteArray &prefix,
+    const QByteArray &suffix) const
+{
+    constexpr qsizetype PATTERN_SIZE = sizeof(STREAM_PATTERN) - 1;
+    constexpr qsizetype PREFIX_SIZE = sizeof(STREAM_PREFIX) - 1;
+
+    QMutexLocker locker(&m_streamLock);
+    body.appendLiteral(prefix);
+    for (qsizetype i = 0; i < actions.size(); ++i)
+    {
+        const QByteArray &action = actions[i];
+        if (i > 0)
+        {
+            body.appendLiteral(",");
+        }
+
+        /* Copy everything up to and including the opening quote of each
+         * placeholder, then the media in place of the placeholder */
+        qsizetype literal = 0;
+        qsizetype start = action.indexOf(STREAM_PATTERN);
+        while (start != -1)
+        {
+            const qsizetype key = start + PATTERN_SIZE - PREFIX_SIZE;
+            const qsizetype end = action.indexOf('"', key);
+            if (end == -1)
+            {
+                break;
+            }
+            body.appendLiteral(action.mid(literal, key - literal));
+
+            const MediaStream stream =
+                m_streams.value(QString::fromUtf8(action.mid(key, end - key)));
+            if (stream.path.isEmpty())
+            {
+                body.appendData(stream.data);
+            }
+            else
+            {
+                body.appendFile(stream.path);
+            }
+
+            literal = end;
+            start = action.indexOf(STREAM_PATTERN, end);
+        }
+        body.appendLiteral(action.mid(literal));
+    }
+    body.appendLiteral(suffix);
+}
+
+/* End Media Streams */
+/* Begin Network Helpers */
+
+QNetworkReply *AnkiClient::postRequest(
+    const QString &action,
+    const QByteArray &body)
+{
+    QNetworkRequest request;
+    request.setUrl(QUrl("http://" + m_address + ":" + m_port));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    QNetworkReply *reply = m_manager->post(request, body);
+    traceRequest(reply, action, body.size());
+    return reply;
+}
+
+QNetworkReply *AnkiClient::postRequest(const QString &action, QIODevice *body)
+{
+    QNetworkRequest request;
+    request.setUrl(QUrl("http://" + m_address + ":" + m_port));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    request.setHeader(QNetworkRequest::ContentLengthHeader, body->size());
+    QNetworkReply *reply = m_manager->post(request, body);
+    traceRequest(reply, action, body->size());
+    return reply;
+}
+
+void AnkiClient::traceRequest(
+    QNetworkReply *reply,
+    const QString &action,
+    const qint64 size)
+{
+    if (!Trace::isEnabled())
+    {
+        return;
+    }
+    const qint64 start = Trace::now();
+    connect(reply, &QNetworkReply::finished, this,
+        [=] {
+            Trace::addSpan(
+                "AnkiConnect",
+                start,
+                Trace::now(),
+                QString("%1, %2 bytes sent, %3")
+                    .arg(action)
+                    .arg(size)
+                    .arg(reply->error() == QNetworkReply::NoError
+                        ? QString("ok") : reply->errorString())
+            );
+        }
+    );
+}
+
+QNetworkReply *AnkiClient::makeRequest(const QString     &action,
+                                       const QJsonObject &params)
+{
+    QJsonObject jsonMsg;
+    jsonMsg[ANKI_ACTION] = action;
+    jsonMsg[ANKI_VERSION] = MIN_ANKICONNECT_VERSION;
+    if (!params.isEmpty())
+    {
+        jsonMsg[ANKI_PARAMS] = params;
+    }
+    QJsonDocument jsonDoc(jsonMsg);
+
+    return postRequest(action, jsonDoc.toJson(QJsonDocument::Compact));
+}
+
+QJsonObject AnkiClient::processReply(QNetworkReply *reply, QString &error)
+{
+    switch (reply->error())
+    {
+    case QNetworkReply::NoError:
+    {
+        QJsonDocument replyDoc = QJsonDocument::fromJson(reply->readAll());
+        if (replyDoc.isNull())
+        {
+            error = "Reply was not JSON";
+            qDebug() << reply->readAll();
+            return QJsonObject();
+        }
+        else if (!replyDoc.isObject())
+        {
+            error = "Reply was not an object";
+            return QJsonObject();
+        }
+
+        QJsonObject replyObj = replyDoc.object();
+        if (replyObj.length() != 2)
+        {
+            error = "Anki response has unexpected number of fields";
+        }
+        else if (!replyObj.contains(ANKI_ERROR))
+        {
+            error = "Anki response is missing error field";
+        }
+        else if (!replyObj.contains(ANKI_RESULT))
+        {
+            error = "Anki response is missing result field";
+        }
+        else if (!replyObj[ANKI_ERROR].isNull())
+        {
+            error = replyObj[ANKI_ERROR].toString();
+        }
+        else
+        {
+            return replyObj;
+        }
+        break;
+    }
+    default:
+        error = reply->errorString();
+    }
+
+    return QJsonObject();
+}
+
+QString AnkiClient::processCollection(
+    QNetworkReply *reply,
+    const QString &server,
+    QString &error)
+{
+    QJsonObject replyObj = processReply(reply, error);
+    if (replyObj.isEmpty())
+    {
+        return QString();
+    }
+    else if (!replyObj[ANKI_RESULT].isString() ||
+             replyObj[ANKI_RESULT].toString().isEmpty())
+    {
+        error = "Anki profile is not a string";
+        return QString();
+    }
+    return server + '/' + replyObj[ANKI_RESULT].toString();
+}
+
+void AnkiClient::receiveIntRequest(const QString     &action,
+                                   const QJsonObject &params,
+                                   AnkiReply         *ankiReply)
+{
+    QJsonObject command;
+    command[ANKI_ACTION] = action;
+    command[ANKI_VERSION] = MIN_ANKICONNECT_VERSION;
+    command[ANKI_PARAMS] = params;
+    enqueueWrite({command},
+        [=] (const QJsonArray &results, const QString &error) {
+            const QJsonObject replyObj =
+                results.isEmpty() ? QJsonObject() : results.first().toObject();
+            if (!error.isEmpty())
+            {
+                Q_EMIT ankiReply->finishedInt(0, error);
+            }
+            else if (!replyObj[ANKI_ERROR].isNull())
+            {
+                Q_EMIT ankiReply->finishedInt(
+                    0, replyObj[ANKI_ERROR].toString()
+                );
+            }
+            else if (!replyObj[ANKI_RESULT].isDouble())
+            {
+                Q_EMIT ankiReply->finishedInt(
+                    0, "AnkiConnect result is not a double"
+                );
+            }
+            else
+            {
+                Q_EMIT ankiReply->finishedInt(
+                    replyObj[ANKI_RESULT].toInt(), error
+                );
+            }
+            ankiReply->deleteLater();
+        }
+    );
+}
+
+void AnkiClient::receiveBoolListRequest(const QString     &,
                                         const QJsonObject &params,
                                         AnkiReply         *ankiReply)
 {
@@ -1082,99 +1882,121 @@ QJsonObject AnkiClient::createAnkiNoteObject(
     bool media,
     QList<QPair<QString, QString>> &filemap)
 {
+    return createAnkiNoteObject(
+        term, media, filemap, getTemplate(CardTemplate::Type::Term)
+    );
+}
+
+QJsonObject AnkiClient::createAnkiNoteObject(
+    const Term &term,
+    bool media,
+    QList<QPair<QString, QString>> &filemap,
+    const CardTemplate &tmpl)
+{
+    using Marker = CardTemplate::Marker;
+
     /* Build common parts of a note */
     QJsonObject note;
-    QJsonObject fieldsObj;
-    buildCommonNote(
-        m_currentConfig->termFields, term, media, note, fieldsObj
-    );
+    CardTemplate::Values values;
+    buildCommonNote(tmpl, term, media, note, values);
 
     /* Set Term and Model */
     note[ANKI_NOTE_DECK] = m_currentConfig->termDeck;
     note[ANKI_NOTE_MODEL] = m_currentConfig->termModel;
 
     /* Process Fields */
-    QString audioFile = AUDIO_FILENAME_FORMAT_STRING
-        .arg(term.audioSrcName)
-        .arg(term.reading)
-        .arg(term.expression)
-        .replace(' ', '_');
-
     QString expression = term.readingAsExpression
         ? term.reading : term.expression;
     QString reading;
-    QString furigana;
-    QString furiganaPlain;
     if (term.reading.isEmpty() || term.readingAsExpression)
     {
-        reading       = expression;
-        furigana      = expression;
-        furiganaPlain = expression;
+        reading                         = expression;
+        values[Marker::Furigana]        = expression;
+        values[Marker::FuriganaPlain]   = expression;
     }
     else
     {
         reading = term.reading;
-        furigana = FURIGANA_FORMAT_STRING.arg(expression).arg(reading);
-        furiganaPlain = expression + "[" + reading + "]";
+        if (tmpl.uses(Marker::Furigana))
+        {
+            values[Marker::Furigana] =
+                FURIGANA_FORMAT_STRING.arg(expression).arg(reading);
+        }
+        if (tmpl.uses(Marker::FuriganaPlain))
+        {
+            values[Marker::FuriganaPlain] =
+                expression + "[" + reading + "]";
+        }
     }
+    values[Marker::Expression] = expression;
+    values[Marker::Reading] = reading;
 
-    QString glossary, glossaryBrief, glossaryCompact;
-    filemap = buildGlossary(
-        term.definitions, glossary, glossaryBrief, glossaryCompact
-    );
-
-    QString pitch;
-    QString pitchGraph;
-    QString pitchPosition;
-    buildPitchInfo(term.pitches, pitch, pitchGraph, pitchPosition);
-
-    QString tags = "<ul>";
-    accumulateTags(term.tags, tags);
-    tags += "</ul>";
-    if (tags == "<ul></ul>")
-        tags.clear();
+    /* Only build the expensive markers that are used */
+    if (tmpl.uses(Marker::Glossary) ||
+        tmpl.uses(Marker::GlossaryBrief) ||
+        tmpl.uses(Marker::GlossaryCompact))
+    {
+        filemap = buildGlossary(
+            term.definitions,
+            values[Marker::Glossary],
+            values[Marker::GlossaryBrief],
+            values[Marker::GlossaryCompact]
+        );
+    }
 
-    /* Find and replace markers with data */
-    QStringList fields = m_currentConfig->termFields.keys();
-    QJsonArray fieldsWithAudio;
-    for (const QString &field : fields)
+    if (tmpl.uses(Marker::Pitch) ||
+        tmpl.uses(Marker::PitchGraphs) ||
+        tmpl.uses(Marker::PitchPositions))
     {
-        QString value = fieldsObj[field].toString();
+        buildPitchInfo(
+            term.pitches,
+            values[Marker::Pitch],
+            values[Marker::PitchGraphs],
+            values[Marker::PitchPositions]
+        );
+    }
 
-        if (value.contains(REPLACE_AUDIO))
+    if (tmpl.uses(Marker::Tags))
+    {
+        QString tags = "<ul>";
+        accumulateTags(term.tags, tags);
+        tags += "</ul>";
+        if (tags != "<ul></ul>")
         {
-            fieldsWithAudio.append(field);
+            values[Marker::Tags] = tags;
         }
-        value.replace(REPLACE_AUDIO, "");
-
-        value.replace(REPLACE_EXPRESSION,       expression);
-        value.replace(REPLACE_FURIGANA,         furigana);
-        value.replace(REPLACE_FURIGANA_PLAIN,   furiganaPlain);
-        value.replace(REPLACE_GLOSSARY,         glossary);
-        value.replace(REPLACE_GLOSSARY_BRIEF,   glossaryBrief);
-        value.replace(REPLACE_GLOSSARY_COMPACT, glossaryCompact);
-        value.replace(REPLACE_PITCH,            pitch);
-        value.replace(REPLACE_PITCH_GRAPHS,     pitchGraph);
-        value.replace(REPLACE_PITCH_POSITIONS,  pitchPosition);
-        value.replace(REPLACE_READING,          reading);
-        value.replace(REPLACE_TAGS,             tags);
-
-        fieldsObj[field] = value;
     }
-    note[ANKI_NOTE_FIELDS] = fieldsObj;
+
+    /* Replace markers with data */
+    note[ANKI_NOTE_FIELDS] = tmpl.render(values);
 
     /* Add {audio} marker to the note */
     if (media)
     {
         QJsonArray audio = note[ANKI_NOTE_AUDIO].toArray();
+        QJsonArray fieldsWithAudio = tmpl.fieldsUsing(Marker::Audio);
         if (!fieldsWithAudio.isEmpty())
         {
             QJsonObject audObj;
 
-            audObj[ANKI_NOTE_URL]      = QString(term.audioURL)
-                .replace(REPLACE_EXPRESSION, term.expression)
-                .replace(REPLACE_READING, reading);
-            audObj[ANKI_NOTE_FILENAME] = audioFile;
+            const QUrl url(
+                QString(term.audioURL)
+                    .replace(REPLACE_EXPRESSION, term.expression)
+                    .replace(REPLACE_READING, reading)
+            );
+            if (url.isLocalFile())
+            {
+                audObj[ANKI_NOTE_DATA] = streamFile(url.toLocalFile(), false);
+            }
+            else
+            {
+                audObj[ANKI_NOTE_URL] = url.toString();
+            }
+            audObj[ANKI_NOTE_FILENAME] = AUDIO_FILENAME_FORMAT_STRING
+                .arg(term.audioSrcName)
+                .arg(term.reading)
+                .arg(term.expression)
+                .replace(' ', '_');
             audObj[ANKI_NOTE_FIELDS]   = fieldsWithAudio;
             audObj[ANKI_NOTE_SKIPHASH] = term.audioSkipHash;
             audio.append(audObj);
@@ -1191,12 +2013,22 @@ QJsonObject AnkiClient::createAnkiNoteObject(
 
 QJsonObject AnkiClient::createAnkiNoteObject(const Kanji &kanji, bool media)
 {
+    return createAnkiNoteObject(
+        kanji, media, getTemplate(CardTemplate::Type::Kanji)
+    );
+}
+
+QJsonObject AnkiClient::createAnkiNoteObject(
+    const Kanji &kanji,
+    bool media,
+    const CardTemplate &tmpl)
+{
+    using Marker = CardTemplate::Marker;
+
     /* Build common parts of a note */
     QJsonObject note;
-    QJsonObject fieldsObj;
-    buildCommonNote(
-        m_currentConfig->kanjiFields, kanji, media, note, fieldsObj
-    );
+    CardTemplate::Values values;
+    buildCommonNote(tmpl, kanji, media, note, values);
 
     /* Set Term and Model */
     note[ANKI_NOTE_DECK] = m_currentConfig->kanjiDeck;
@@ -1278,35 +2110,28 @@ QJsonObject AnkiClient::createAnkiNoteObject(const Kanji &kanji, bool media)
     }
 
     /* Replace Markers */
-    QJsonArray fieldsWithAudio;
-    QStringList fields = fieldsObj.keys();
-    for (const QString &field : fields)
-    {
-        QString value = fieldsObj[field].toString();
-
-        value.replace(REPLACE_CHARACTER,    kanji.character);
-        value.replace(REPLACE_KUNYOMI,      kunyomi);
-        value.replace(REPLACE_ONYOMI,       onyomi);
-        value.replace(REPLACE_STROKE_COUNT, strokeCount);
-        value.replace(REPLACE_GLOSSARY,     glossary);
-        value.replace(REPLACE_TAGS,         tags);
-
-        fieldsObj[field] = value;
-    }
+    values[Marker::Character]   = kanji.character;
+    values[Marker::Kunyomi]     = kunyomi;
+    values[Marker::Onyomi]      = onyomi;
+    values[Marker::StrokeCount] = strokeCount;
+    values[Marker::Glossary]    = glossary;
+    values[Marker::Tags]        = tags;
 
     /* Add Fields */
-    note[ANKI_NOTE_FIELDS] = fieldsObj;
+    note[ANKI_NOTE_FIELDS] = tmpl.render(values);
 
     return note;
 }
 
 void AnkiClient::buildCommonNote(
-    const QJsonObject &configFields,
+    const CardTemplate &tmpl,
     const CommonExpFields &exp,
     const bool media,
     QJsonObject &note,
-    QJsonObject &fieldObj)
+    CardTemplate::Values &values)
 {
+    using Marker = CardTemplate::Marker;
+
     /* Set Duplicate Policy */
     switch (m_currentConfig->duplicatePolicy)
     {
@@ -1330,143 +2155,32 @@ void AnkiClient::buildCommonNote(
     /* Add Card Tags */
     note[ANKI_NOTE_TAGS] = m_currentConfig->tags;
 
-    /* Find and replace markers with processed data */
-    QString clipboard =
-        QString(exp.clipboard).replace('\n', m_currentConfig->newlineReplacer);
-    QString clozeBody =
-        QString(exp.clozeBody).replace('\n', m_currentConfig->newlineReplacer);
-    QString clozePrefix =
-        QString(exp.clozePrefix).replace('\n', m_currentConfig->newlineReplacer);
-    QString clozeSuffix =
-        QString(exp.clozeSuffix).replace('\n', m_currentConfig->newlineReplacer);
-    QString sentence =
-        QString(exp.sentence).replace('\n', m_currentConfig->newlineReplacer);
-    QString sentence2 =
-        QString(exp.sentence2).replace('\n', m_currentConfig->newlineReplacer);
-    QString context =
-        QString(exp.context).replace('\n', m_currentConfig->newlineReplacer);
-    QString context2 =
-        QString(exp.context2).replace('\n', m_currentConfig->newlineReplacer);
-
-    QString frequencies = buildFrequencies(exp.frequencies);
-
-    QJsonArray fieldsWithAudioMedia;
-    QJsonArray fieldsWithAudioContext;
-    QJsonArray fieldsWithScreenshot;
-    QJsonArray fieldWithScreenshotVideo;
-    QStringList fields = configFields.keys();
-    for (const QString &field : fields)
-    {
-        QString value = configFields[field].toString();
-
-        if (value.contains(REPLACE_AUDIO_MEDIA))
-        {
-            fieldsWithAudioMedia.append(field);
-        }
-        value.replace(REPLACE_AUDIO_MEDIA, "");
-
-        if (value.contains(REPLACE_AUDIO_CONTEXT))
-        {
-            fieldsWithAudioContext.append(field);
-        }
-        value.replace(REPLACE_AUDIO_CONTEXT, "");
-
-        if (value.contains(REPLACE_SCREENSHOT))
-        {
-            fieldsWithScreenshot.append(field);
-        }
-        value.replace(REPLACE_SCREENSHOT, "");
-
-        if (value.contains(REPLACE_SCREENSHOT_VIDEO))
+    /* Process the markers the template uses */
+    const QString &newline = m_currentConfig->newlineReplacer;
+    auto setText = [&] (const Marker marker, const QString &text) {
+        if (tmpl.uses(marker))
         {
-            fieldWithScreenshotVideo.append(field);
-        }
-        value.replace(REPLACE_SCREENSHOT_VIDEO, "");
-
-        value.replace(REPLACE_TITLE,        exp.title);
-        value.replace(REPLACE_CLIPBOARD,    clipboard);
-        value.replace(REPLACE_CLOZE_BODY,   clozeBody);
-        value.replace(REPLACE_CLOZE_PREFIX, clozePrefix);
-        value.replace(REPLACE_CLOZE_SUFFIX, clozeSuffix);
-        value.replace(REPLACE_FREQUENCIES,  frequencies);
-        value.replace(REPLACE_SENTENCE,     sentence);
-        value.replace(REPLACE_SENTENCE_SEC, sentence2);
-        value.replace(REPLACE_CONTEXT,      context);
-        value.replace(REPLACE_CONTEXT_SEC,  context2);
-
-        fieldObj[field] = value;
+            values[marker] = QString(text).replace('\n', newline);
+        }
+    };
+    setText(Marker::Clipboard,         exp.clipboard);
+    setText(Marker::ClozeBody,         exp.clozeBody);
+    setText(Marker::ClozePrefix,       exp.clozePrefix);
+    setText(Marker::ClozeSuffix,       exp.clozeSuffix);
+    setText(Marker::Sentence,          exp.sentence);
+    setText(Marker::SentenceSecondary, exp.sentence2);
+    setText(Marker::Context,           exp.context);
+    setText(Marker::ContextSecondary,  exp.context2);
+    values[Marker::Title] = exp.title;
+
+    if (tmpl.uses(Marker::Frequencies))
+    {
+        values[Marker::Frequencies] = buildFrequencies(exp.frequencies);
     }
 
     /* Add the requested Media Sections */
     if (media)
     {
-        QJsonArray audio;
-        if (!fieldsWithAudioMedia.isEmpty())
-        {
-            QJsonObject audObj;
-            PlayerAdapter *player =
-                GlobalMediator::getGlobalMediator()->getPlayerAdapter();
-
-            double startTime = exp.startTime - m_currentConfig->audioPadStart;
-            double endTime = exp.endTime + m_currentConfig->audioPadEnd;
-
-            QString path;
-            if (startTime >= 0 && endTime >= 0 && startTime < endTime)
-            {
-                path = player->tempAudioClip(
-                    startTime,
-                    endTime,
-                    m_currentConfig->audioNormalize,
-                    m_currentConfig->audioDb
-                );
-            }
-            if (!path.isEmpty()) {
-                audObj[ANKI_NOTE_DATA] = fileToBase64(path);
-                QString filename = FileUtils::calculateMd5(path) + ".aac";
-                audObj[ANKI_NOTE_FILENAME] = filename;
-                audObj[ANKI_NOTE_FIELDS] = fieldsWithAudioMedia;
-                audio.append(audObj);
-
-                QFile(path).remove();
-            }
-        }
-
-        if (!fieldsWithAudioContext.isEmpty())
-        {
-            QJsonObject audObj;
-            PlayerAdapter *player =
-                GlobalMediator::getGlobalMediator()->getPlayerAdapter();
-
-            double startTime =
-                exp.startTimeContext - m_currentConfig->audioPadStart;
-            double endTime = exp.endTimeContext + m_currentConfig->audioPadEnd;
-
-            QString path;
-            if (startTime >= 0 && endTime >= 0 && startTime < endTime)
-            {
-                path = player->tempAudioClip(
-                    startTime,
-                    endTime,
-                    m_currentConfig->audioNormalize,
-                    m_currentConfig->audioDb
-                );
-            }
-            if (!path.isEmpty()) {
-                audObj[ANKI_NOTE_DATA] = fileToBase64(path);
-                QString filename = FileUtils::calculateMd5(path) + ".aac";
-                audObj[ANKI_NOTE_FILENAME] = filename;
-                audObj[ANKI_NOTE_FIELDS] = fieldsWithAudioContext;
-                audio.append(audObj);
-
-                QFile(path).remove();
-            }
-        }
-
-        if (!audio.isEmpty())
-        {
-            note[ANKI_NOTE_AUDIO] = audio;
-        }
-
         QString imageExt;
         switch (m_currentConfig->screenshotType)
         {
@@ -1483,50 +2197,110 @@ void AnkiClient::buildCommonNote(
             imageExt = ".jpg";
         }
 
-        QJsonArray images;
-        if (!fieldsWithScreenshot.isEmpty())
+        /* Every piece of media is independent of the others, so they are all
+         * generated at the same time. Each stage only writes to itself. */
+        struct MediaStage
         {
-            QJsonObject image;
+            /* The name of the stage. Used for its trace span. */
+            const char *name;
 
-            PlayerAdapter *player =
-                GlobalMediator::getGlobalMediator()->getPlayerAdapter();
-            const bool visibility = player->getSubVisibility();
-            player->setSubVisiblity(true);
-            QString path = player->tempScreenshot(true, imageExt);
-            image[ANKI_NOTE_DATA] = fileToBase64(path);
-            player->setSubVisiblity(visibility);
+            /* The key of the note array the media belongs in. */
+            const char *key;
 
-            QString filename = FileUtils::calculateMd5(path) + imageExt;
-            image[ANKI_NOTE_FILENAME] = filename;
+            /* Generates the media object. */
+            std::function<QJsonObject()> generate;
 
-            image[ANKI_NOTE_FIELDS] = fieldsWithScreenshot;
+            /* The generated media object. Empty on failure. */
+            QJsonObject result;
+        };
+        std::vector<MediaStage> stages;
 
-            if (filename != imageExt)
-            {
-                images.append(image);
-            }
-            QFile(path).remove();
-        }
+        const QJsonArray fieldsWithAudioMedia =
+            tmpl.fieldsUsing(Marker::AudioMedia);
+        const QJsonArray fieldsWithAudioContext =
+            tmpl.fieldsUsing(Marker::AudioContext);
+        const QJsonArray fieldsWithScreenshot =
+            tmpl.fieldsUsing(Marker::Screenshot);
+        const QJsonArray fieldWithScreenshotVideo =
+            tmpl.fieldsUsing(Marker::ScreenshotVideo);
 
+        if (!fieldsWithAudioMedia.isEmpty())
+        {
+            stages.push_back({
+                REPLACE_AUDIO_MEDIA, ANKI_NOTE_AUDIO,
+                [this, start = exp.startTime, end = exp.endTime,
+                 fields = fieldsWithAudioMedia] {
+                    return buildAudioMedia(start, end, fields);
+                }
+            });
+        }
+        if (!fieldsWithAudioContext.isEmpty())
+        {
+            stages.push_back({
+                REPLACE_AUDIO_CONTEXT, ANKI_NOTE_AUDIO,
+                [this, start = exp.startTimeContext, end = exp.endTimeContext,
+                 fields = fieldsWithAudioContext] {
+                    return buildAudioMedia(start, end, fields);
+                }
+            });
+        }
+        if (!fieldsWithScreenshot.isEmpty())
+        {
+            stages.push_back({
+                REPLACE_SCREENSHOT, ANKI_NOTE_PICTURE,
+                [this, imageExt, fields = fieldsWithScreenshot] {
+                    return buildScreenshotMedia(true, imageExt, fields);
+                }
+            });
+        }
         if (!fieldWithScreenshotVideo.isEmpty())
         {
-            QJsonObject image;
-            QString path = GlobalMediator::getGlobalMediator()
-                ->getPlayerAdapter()->tempScreenshot(false, imageExt);
-            image[ANKI_NOTE_DATA] = fileToBase64(path);
-
-            QString filename = FileUtils::calculateMd5(path) + imageExt;
-            image[ANKI_NOTE_FILENAME] = filename;
+            stages.push_back({
+                REPLACE_SCREENSHOT_VIDEO, ANKI_NOTE_PICTURE,
+                [this, imageExt, fields = fieldWithScreenshotVideo] {
+                    return buildScreenshotMedia(false, imageExt, fields);
+                }
+            });
+        }
 
-            image[ANKI_NOTE_FIELDS] = fieldWithScreenshotVideo;
+        /* Media is embedded in the addNote request, so nothing can be sent
+         * before every stage has finished */
+        QList<std::function<void()>> tasks;
+        for (MediaStage &stage : stages)
+        {
+            tasks.append(
+                [&stage] {
+                    TraceSpan span(stage.name);
+                    stage.result = stage.generate();
+                }
+            );
+        }
+        Executor::runAll(
+            Executor::Queue::Media, tasks, Executor::Priority::Interactive
+        );
 
-            if (filename != imageExt)
+        QJsonArray audio;
+        QJsonArray images;
+        for (const MediaStage &stage : stages)
+        {
+            if (stage.result.isEmpty())
+            {
+                continue;
+            }
+            else if (qstrcmp(stage.key, ANKI_NOTE_AUDIO) == 0)
+            {
+                audio.append(stage.result);
+            }
+            else
             {
-                images.append(image);
+                images.append(stage.result);
             }
-            QFile(path).remove();
         }
 
+        if (!audio.isEmpty())
+        {
+            note[ANKI_NOTE_AUDIO] = audio;
+        }
         if (!images.isEmpty())
         {
             note[ANKI_NOTE_PICTURE] = images;
@@ -1534,6 +2308,77 @@ void AnkiClient::buildCommonNote(
     }
 }
 
+QJsonObject AnkiClient::buildAudioMedia(
+    const double start,
+    const double end,
+    const QJsonArray &fields)
+{
+    QJsonObject audObj;
+    PlayerAdapter *player =
+        GlobalMediator::getGlobalMediator()->getPlayerAdapter();
+
+    double startTime = start - m_currentConfig->audioPadStart;
+    double endTime = end + m_currentConfig->audioPadEnd;
+
+    QString path;
+    if (startTime >= 0 && endTime >= 0 && startTime < endTime)
+    {
+        path = player->tempAudioClip(
+            startTime,
+            endTime,
+            m_currentConfig->audioNormalize,
+            m_currentConfig->audioDb
+        );
+    }
+    if (!path.isEmpty()) {
+        QString filename = FileUtils::calculateMd5(path) + "." +
+            QFileInfo(path).suffix();
+        audObj[ANKI_NOTE_DATA] = streamFile(path, true);
+        audObj[ANKI_NOTE_FILENAME] = filename;
+        audObj[ANKI_NOTE_FIELDS] = fields;
+    }
+
+    return audObj;
+}
+
+QJsonObject AnkiClient::buildScreenshotMedia(
+    const bool subtitles,
+    const QString &ext,
+    const QJsonArray &fields)
+{
+    QJsonObject image;
+    PlayerAdapter *player =
+        GlobalMediator::getGlobalMediator()->getPlayerAdapter();
+
+    QByteArray data;
+    if (subtitles)
+    {
+        const bool visibility = player->getSubVisibility();
+        player->setSubVisiblity(true);
+        data = player->screenshot(
+            true, ext, m_currentConfig->screenshotHeight
+        );
+        player->setSubVisiblity(visibility);
+    }
+    else
+    {
+        data = player->screenshot(
+            false, ext, m_currentConfig->screenshotHeight
+        );
+    }
+    if (data.isEmpty())
+    {
+        return image;
+    }
+
+    image[ANKI_NOTE_DATA] = streamData(data);
+    image[ANKI_NOTE_FILENAME] =
+        QCryptographicHash::hash(data, QCryptographicHash::Md5).toHex() + ext;
+    image[ANKI_NOTE_FIELDS] = fields;
+
+    return image;
+}
+
 #define HL_STYLE        (QString("border-top: solid; border-right: solid;"))
 #define H_STYLE         (QString("border-top: solid;"))
 
@@ -1596,53 +2441,24 @@ void AnkiClient::buildPitchInfo(const QList<Pitch> &pitches,
             }
 
             /* Build {pitch} marker */
-            switch (pos)
-            {
-            case 0:
-                pitch += p.mora.first();
-                if (p.mora.size() > 1)
-                {
-                    pitch += PITCH_FORMAT.arg(H_STYLE)
-                                         .arg(p.mora.join("")
-                                         .remove(0, p.mora.first().size()));
-                }
-                break;
-            case 1:
-                pitch += PITCH_FORMAT.arg(HL_STYLE).arg(p.mora.first());
-                if (p.mora.size() > 1)
-                {
-                    pitch += p.mora.join("").remove(0, p.mora.first().size());
-                }
-                break;
-            default:
+            const QList<GraphicUtils::PitchSegment> segments =
+                GraphicUtils::splitPitch(p.mora, pos);
+            for (const GraphicUtils::PitchSegment &segment : segments)
             {
-                QString text = p.mora.first();
-                pitch += text;
-
-                text.clear();
-                for (size_t i = 1; i < pos; ++i)
-                {
-                    text += p.mora[i];
-                }
-                if (!text.isEmpty())
-                {
-                    pitch += PITCH_FORMAT.arg(HL_STYLE).arg(text);
-                }
-
-                text.clear();
-                for (int i = pos; i < p.mora.size(); ++i)
+                if (segment.high)
                 {
-                    text += p.mora[i];
+                    pitch += PITCH_FORMAT
+                        .arg(segment.change ? HL_STYLE : H_STYLE)
+                        .arg(segment.text);
                 }
-                if (!text.isEmpty())
+                else
                 {
-                    pitch += text;
+                    pitch += segment.text;
                 }
             }
-            }
 
             /* Build {pitch-graph}s */
-            pitchGraph = GraphicUtils::generatePitchGraph(
+            pitchGraph += GraphicUtils::generatePitchGraph(
                 p.mora.size(), pos, "rgba(0,0,0,0)", "currentColor"
             );
 
@@ -1799,14 +2615,4 @@ QString &AnkiClient::accumulateTags(const QList<Tag> &tags, QString &tagStr)
     return tagStr;
 }
 
-QString AnkiClient::fileToBase64(const QString &path)
-{
-    QFile file(path);
-    if (!file.open(QIODevice::ReadOnly))
-    {
-        return {};
-    }
-    return file.readAll().toBase64();
-}
-
 /* End Note Helpers */
@@ -23,12 +23,18 @@
 
 #include <QObject>
 
+#include <functional>
+
+#include <QHash>
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QMutex>
 #include <QString>
 #include <QStringList>
 
 #include "ankiconfig.h"
+#include "cardtemplate.h"
 
 #include "dict/expression.h"
 
@@ -73,6 +79,7 @@
 #define DEFAULT_HOST                    "localhost"
 #define DEFAULT_PORT                    "8765"
 #define DEFAULT_SCREENSHOT              AnkiConfig::FileType::jpg
+#define DEFAULT_SCREENSHOT_HEIGHT       0
 #define DEFAULT_DUPLICATE_POLICY        AnkiConfig::DuplicatePolicy::DifferentDeck
 #define DEFAULT_NEWLINE_REPLACER        "<br>"
 #define DEFAULT_TAGS                    "memento"
@@ -81,8 +88,12 @@
 #define DEFAULT_AUDIO_NORMALIZE         false
 #define DEFAULT_AUDIO_DB                (-20.0)
 
+class AnkiMediaIndex;
+class AnkiRequestBody;
+class QIODevice;
 class QNetworkAccessManager;
 class QNetworkReply;
+class QTimer;
 
 /**
  * Object used for sending replies to from one thread to another.
@@ -194,7 +205,8 @@ public:
     void setServer(const QString &address, const QString &port);
 
     /**
-     * Tests the connection to the server.
+     * Tests the connection to the server. Writes spooled while the server was
+     * unreachable are sent again if the connection is successful.
      * @return An AnkiReply that emits the finishedBool() signal. Caller does
      *         not have ownership. Emits true if connection was successful,
      *         false and an error string otherwise.
@@ -242,7 +254,8 @@ public:
     AnkiReply *notesAddable(QList<QSharedPointer<const Kanji>> kanji);
 
     /**
-     * Adds a term note to Anki.
+     * Adds a term note to Anki. The note is sent with other queued writes and
+     * is spooled to disk if AnkiConnect can't be reached.
      * @param term The term to add a note for.
      * @return An AnkiReply that emits the finishedInt() signal. The integer
      *         value is the identifer of the card. Caller does not have
@@ -251,7 +264,8 @@ public:
     AnkiReply *addNote(const Term *term);
 
     /**
-     * Adds a kanji note to Anki.
+     * Adds a kanji note to Anki. The note is sent with other queued writes
+     * and is spooled to disk if AnkiConnect can't be reached.
      * @param kanji The kanji to add a note for.
      * @return An AnkiReply that emits the finishedInt() signal. The integer
      *         value is the identifer of the card. Caller does not have
@@ -270,7 +284,8 @@ public:
 
 public Q_SLOTS:
     /**
-     * Adds media file to Anki.
+     * Adds media file to Anki. Files already known to be stored in Anki are
+     * not uploaded again. The files are sent with other queued writes.
      * @param files A mapping of file paths to file names.
      * @return An AnkiReply that emits the finishedStringList() signal. Strings
      *         are added filenames.
@@ -286,7 +301,8 @@ Q_SIGNALS:
     void requestAddMedia(const QList<QPair<QString, QString>> &fileMap) const;
 
     /**
-     * Sends a request to issue a command to Anki that returns an integer.
+     * Sends a request to queue a write command to Anki that returns an
+     * integer.
      * This is a hack to make sure that the QNetworkAccessManager is used from
      * the correct thread when multithreading.
      * @param action    The AnkiConnect 'verb'.
@@ -312,7 +328,7 @@ Q_SIGNALS:
 
 private Q_SLOTS:
     /**
-     * Issues a command to Anki that returns an integer.
+     * Queues a write command to Anki that returns an integer.
      * This is a hack to make sure that the QNetworkAccessManager is used from
      * the correct thread when multithreading.
      * @param action    The AnkiConnect 'verb'.
@@ -335,7 +351,59 @@ private Q_SLOTS:
                                 const QJsonObject &params,
                                 AnkiReply         *ankiReply);
 
+    /**
+     * Clears every cached canAddNotes result. Results of requests in flight
+     * are not cached.
+     */
+    void invalidateAddableCache();
+
+    /**
+     * Sends the oldest queued writes as a single multi request if no other
+     * write request is in flight. Writes are taken in order until the batch
+     * would exceed the size budget.
+     */
+    void flushWrites();
+
 private:
+    /**
+     * Called with the results of a group of queued write actions.
+     * @param results The AnkiConnect reply of each action in the group. Each
+     *                is an object with a result and error field. Empty on
+     *                error.
+     * @param error   The reason the request failed. Empty string if no error.
+     */
+    using WriteCallback =
+        std::function<void(const QJsonArray &results, const QString &error)>;
+
+    /* A group of actions that are always sent in the same request. */
+    struct PendingWrite
+    {
+        /* The serialized AnkiConnect actions. */
+        QList<QByteArray> actions;
+
+        /* Called when the actions finish. May be empty. */
+        WriteCallback callback;
+
+        /* The media streams the actions refer to. */
+        QStringList streams;
+
+        /* The combined size of the actions in bytes once media is encoded. */
+        qsizetype size = 0;
+    };
+
+    /* Media that is base64 encoded into a request body when it is sent. */
+    struct MediaStream
+    {
+        /* The path of the media file. Empty if the media is in memory. */
+        QString path;
+
+        /* The media if it is in memory. */
+        QByteArray data;
+
+        /* true if the file should be deleted once the media is sent. */
+        bool temporary = false;
+    };
+
     /**
      * Loads an Anki Integration configuration file.
      * @param filename The name of the configuration file in the config
@@ -358,6 +426,173 @@ private:
      */
     void setDefaultConfig();
 
+    /**
+     * Gets the key of the current server in the media index.
+     * @return The address and port of the current server.
+     */
+    QString getServer() const;
+
+    /**
+     * Finds the Anki profile open behind the current server and replaces its
+     * media index with the media files the collection reports. Media isn't
+     * skipped until this succeeds, so a switched profile or media removed by
+     * Check Media can't cause missing files.
+     */
+    void seedMediaIndex();
+
+    /**
+     * Queues storeMediaFile commands for media files and records the stored
+     * files in the media index.
+     * @param fileMap    A mapping of file paths to file names.
+     * @param collection The collection the files are stored in. Empty string
+     *                   if it isn't known.
+     * @param skipStored true if the media index of collection is up to date
+     *                   and files in it shouldn't be sent.
+     * @param ankiReply  The reply to emit finishedStringList() on.
+     */
+    void storeMedia(
+        const QList<QPair<QString, QString>> &fileMap,
+        const QString &collection,
+        const bool skipStored,
+        AnkiReply *ankiReply);
+
+    /**
+     * Invalidates the addable cache and fetches the first field of the term
+     * and kanji models. The first field is the only one Anki checks for
+     * duplicates.
+     */
+    void updateFirstFields();
+
+    /**
+     * Gets the first field of a model if it has been fetched.
+     * @param model The name of the model.
+     * @return The name of the first field, empty string if it is unknown.
+     */
+    QString getFirstField(const QString &model) const;
+
+    /**
+     * Checks if notes are addable, answering from the addable cache where
+     * possible. Only notes that aren't cached are sent to AnkiConnect.
+     * @param notes      The notes to check. Empty notes are never addable.
+     * @param firstField The first field of the notes' model. Results are only
+     *                   cached if it is not empty.
+     * @param ankiReply  The AnkiReply to emit the finishedBoolList() signal on.
+     *                   Contains a result for every note.
+     */
+    void checkNotesAddable(const QList<QJsonObject> &notes,
+                           const QString &firstField,
+                           AnkiReply *ankiReply);
+
+    /**
+     * Compiles the term and kanji fields of the current configuration.
+     */
+    void compileTemplates();
+
+    /**
+     * Gets the compiled fields of the current configuration.
+     * @param type The kind of note to get the template of.
+     * @return The compiled template of the note type.
+     */
+    CardTemplate getTemplate(CardTemplate::Type type) const;
+
+    /**
+     * Queues a group of write actions to be sent in a batch with other
+     * writes. The queue is flushed once it exceeds the size budget or after
+     * the latency budget passes.
+     * @param actions  The AnkiConnect actions to send together. Each must
+     *                 contain a version so its reply includes an error field.
+     * @param callback Called with the results of the actions. May be empty.
+     */
+    void enqueueWrite(const QList<QJsonObject> &actions,
+                      WriteCallback callback);
+
+    /**
+     * Registers a file to be streamed into the request it is sent in.
+     * @param path      The path of the file.
+     * @param temporary true if the file should be deleted once it is sent or
+     *                  spooled, false otherwise.
+     * @return A placeholder to use as the data of an AnkiConnect media object.
+     */
+    QString streamFile(const QString &path, bool temporary);
+
+    /**
+     * Registers media in memory to be streamed into the request it is sent
+     * in.
+     * @param data The media.
+     * @return A placeholder to use as the data of an AnkiConnect media object.
+     */
+    QString streamData(const QByteArray &data);
+
+    /**
+     * Finds the media streams a serialized action refers to.
+     * @param action The serialized action.
+     * @return The placeholders of every stream in the action.
+     */
+    static QStringList findStreams(const QByteArray &action);
+
+    /**
+     * Unregisters media streams, deleting temporary files.
+     * @param streams The placeholders of the streams.
+     */
+    void releaseStreams(const QStringList &streams);
+
+    /**
+     * Builds a request body from serialized actions. Media placeholders are
+     * replaced by the base64 encoded media as the body is read.
+     * @param[out] body    The body to append to.
+     * @param      actions The serialized actions. Separated by commas.
+     * @param      prefix  The bytes before the first action.
+     * @param      suffix  The bytes after the last action.
+     */
+    void buildRequestBody(AnkiRequestBody &body,
+                          const QList<QByteArray> &actions,
+                          const QByteArray &prefix,
+                          const QByteArray &suffix) const;
+
+    /**
+     * Appends writes to the spool file so they can be sent once AnkiConnect
+     * can be reached again. Media is encoded into the spool.
+     * @param writes The writes to spool.
+     * @return true on success, false if the spool couldn't be written. Nothing
+     *         is spooled on failure.
+     */
+    bool spoolWrites(const QList<PendingWrite> &writes) const;
+
+    /**
+     * Queues every spooled write again and removes the spool file. Writes
+     * that still can't be sent are spooled again.
+     */
+    void replaySpool();
+
+    /**
+     * Makes a request to AnkiConnect.
+     * @param action The name of the request. Only used for tracing.
+     * @param body   The serialized JSON request.
+     * @return A QNetworkReply where the result will be received. Caller takes
+     *         ownership.
+     */
+    QNetworkReply *postRequest(const QString &action, const QByteArray &body);
+
+    /**
+     * Makes a request to AnkiConnect with a body that is read as it is sent.
+     * @param action The name of the request. Only used for tracing.
+     * @param body   The JSON request. Must be open and outlive the reply.
+     * @return A QNetworkReply where the result will be received. Caller takes
+     *         ownership.
+     */
+    QNetworkReply *postRequest(const QString &action, QIODevice *body);
+
+    /**
+     * Records a trace span covering a request when tracing is enabled so
+     * request latency and the bytes sent can be measured.
+     * @param reply  The reply of the request.
+     * @param action The name of the request.
+     * @param size   The size of the request body in bytes.
+     */
+    void traceRequest(QNetworkReply *reply,
+                      const QString &action,
+                      qint64 size);
+
     /**
      * Makes a request to AnkiConnect.
      * @param action The AnkiConnection 'verb' to execute.
@@ -377,6 +612,20 @@ private:
      */
     QJsonObject processReply(QNetworkReply *reply, QString &error);
 
+    /**
+     * Error checks the reply to a getActiveProfile request.
+     * @param reply      The reply to error check.
+     * @param server     The server the request was sent to.
+     * @param[out] error The reason the command failed. Empty string if no
+     *                   error.
+     * @return The key of the collection in the media index, empty string on
+     *         error.
+     */
+    QString processCollection(
+        QNetworkReply *reply,
+        const QString &server,
+        QString &error);
+
     /**
      * Makes a request to AnkiConnect that returns a list of strings.
      * @param action The AnkiConnect 'verb'.
@@ -411,6 +660,22 @@ private:
         bool media,
         QList<QPair<QString, QString>> &filemap);
 
+    /**
+     * Creates an AnkiConnect compatible note JSON object from a template.
+     * Markers that don't appear in the template aren't built.
+     * @param      term    The term to make the object from.
+     * @param      media   true if screenshots and audio should be included in
+     *                     the object, false otherwise.
+     * @param[out] filemap A mapping of file paths to filenames.
+     * @param      tmpl    The compiled fields to build.
+     * @return A JSON object corresponding to the term.
+     */
+    QJsonObject createAnkiNoteObject(
+        const Term &term,
+        bool media,
+        QList<QPair<QString, QString>> &filemap,
+        const CardTemplate &tmpl);
+
     /**
      * Creates an AnkiConnect compatible note JSON object.
      * @param kanji The term to make the object from.
@@ -420,21 +685,60 @@ private:
      */
     QJsonObject createAnkiNoteObject(const Kanji &kanji, bool media);
 
+    /**
+     * Creates an AnkiConnect compatible note JSON object from a template.
+     * Markers that don't appear in the template aren't built.
+     * @param kanji The kanji to make the object from.
+     * @param media true if screenshots and audio should be included in the
+     *              object, false otherwise.
+     * @param tmpl  The compiled fields to build.
+     * @return A JSON object corresponding to the kanji.
+     */
+    QJsonObject createAnkiNoteObject(
+        const Kanji &kanji,
+        bool media,
+        const CardTemplate &tmpl);
+
     /**
      * Helper method for processing the card markers shared by both term and
-     * kanji cards.
-     * @param      configFields The raw fields object for the note type.
-     * @param      exp          The fields common between Kanji and Terms.
-     * @param      media        true if audio and screenshots should be added,
-     *                          false otherwise.
-     * @param[out] note         The note object to populate.
-     * @param[out] fieldObj     The processed fields object.
-     */
-    void buildCommonNote(const QJsonObject     &configFields,
+     * kanji cards. Only markers used by the template are computed.
+     * @param      tmpl   The compiled fields of the note type.
+     * @param      exp    The fields common between Kanji and Terms.
+     * @param      media  true if audio and screenshots should be added, false
+     *                    otherwise.
+     * @param[out] note   The note object to populate.
+     * @param[out] values The values of the shared markers.
+     */
+    void buildCommonNote(const CardTemplate    &tmpl,
                          const CommonExpFields &exp,
                          const bool             media,
                          QJsonObject           &note,
-                         QJsonObject           &fieldObj);
+                         CardTemplate::Values  &values);
+
+    /**
+     * Creates an audio clip of the current media and converts it into an
+     * AnkiConnect media object. Padding from the config is applied.
+     * @param start  The start time of the clip in seconds.
+     * @param end    The end time of the clip in seconds.
+     * @param fields The fields the clip belongs in.
+     * @return The media object, empty if the clip couldn't be created.
+     */
+    QJsonObject buildAudioMedia(double start,
+                                double end,
+                                const QJsonArray &fields);
+
+    /**
+     * Takes a screenshot of the current media and converts it into an
+     * AnkiConnect media object.
+     * @param subtitles true to include subtitles in the screenshot, false
+     *                  otherwise.
+     * @param ext       The extension of the image format to use.
+     * @param fields    The fields the screenshot belongs in.
+     * @return The media object, empty if the screenshot couldn't be taken.
+     */
+    QJsonObject buildScreenshotMedia(bool subtitles,
+                                     const QString &ext,
+                                     const QJsonArray &fields);
 
     /**
      * Generates an HTML representation of the frequencies.
@@ -488,13 +792,6 @@ private:
      */
     QString &accumulateTags(const QList<Tag> &tags, QString &tagStr);
 
-    /**
-     * Helper method to convert file to base64.
-     * @param path The path of the file to convert to base64.
-     * @return The base64 encoded file.
-     */
-    static QString fileToBase64(const QString &path);
-
     /* true if a config exists, false otherwise */
     bool m_configExists = false;
 
@@ -518,6 +815,65 @@ private:
 
     /* The Network Manager for this object. */
     QNetworkAccessManager *m_manager;
+
+    /* Media files known to be stored in each collection. */
+    AnkiMediaIndex *m_mediaIndex;
+
+    /* The server and Anki profile of the collection media is added to. Empty
+     * if the collection isn't known yet. */
+    QString m_mediaCollection;
+
+    /* Incremented every time the media index is seeded so replies from an
+     * older seed are ignored. */
+    int m_mediaSeed = 0;
+
+    /* true while the media index is being seeded. */
+    bool m_mediaSeeding = false;
+
+    /* Maps model names to the name of their first field. */
+    QHash<QString, QString> m_firstFields;
+
+    /* Maps a deck, model and first field value to if the note is addable. */
+    QHash<QString, bool> m_addableCache;
+
+    /* Incremented every time m_addableCache is invalidated. */
+    quint64 m_addableGeneration = 0;
+
+    /* Protects m_firstFields, m_addableCache and m_addableGeneration. */
+    mutable QMutex m_addableLock;
+
+    /* The compiled term fields of the current configuration. */
+    CardTemplate m_termTemplate;
+
+    /* The compiled kanji fields of the current configuration. */
+    CardTemplate m_kanjiTemplate;
+
+    /* Protects m_termTemplate and m_kanjiTemplate. */
+    mutable QMutex m_templateLock;
+
+    /* Writes waiting to be sent in order. */
+    QList<PendingWrite> m_pendingWrites;
+
+    /* The combined size of every pending write in bytes. */
+    qsizetype m_pendingBytes = 0;
+
+    /* The number of actions in every pending write. */
+    int m_pendingActions = 0;
+
+    /* true if a batch of writes is waiting for a reply, false otherwise. */
+    bool m_writeInFlight = false;
+
+    /* Flushes pending writes once the latency budget passes. */
+    QTimer *m_flushTimer;
+
+    /* Maps placeholders to the media they stand in for. */
+    QHash<QString, MediaStream> m_streams;
+
+    /* The identifier of the next media stream. */
+    quint64 m_nextStream = 0;
+
+    /* Protects m_streams and m_nextStream. */
+    mutable QMutex m_streamLock;
 };
 
 #endif // ANKICLIENT_H
@@ -80,6 +80,9 @@ struct AnkiConfig
     /* The file type to save screenshots as. */
     FileType screenshotType;
 
+    /* The maximum height of screenshots in pixels. 0 for source resolution. */
+    int screenshotHeight;
+
     /* The amount of padding to add (in seconds) to the start of an audio clip.
      * Used for the {audio-media} marker.
      */
@@ -131,6 +134,7 @@ struct AnkiConfig
         duplicatePolicy = rhs.duplicatePolicy;
         newlineReplacer = rhs.newlineReplacer;
         screenshotType  = rhs.screenshotType;
+        screenshotHeight = rhs.screenshotHeight;
         audioPadStart   = rhs.audioPadStart;
         audioPadEnd     = rhs.audioPadEnd;
         audioNormalize  = rhs.audioNormalize;
@@ -0,0 +1,168 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "ankimediaindex.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+/* The length of a hex encoded MD5 hash */
+#define MD5_HEX_LENGTH 32
+
+/* Begin Constructor */
+
+AnkiMediaIndex::AnkiMediaIndex(const QString &path) : m_path(path)
+{
+    load();
+}
+
+/* End Constructor */
+/* Begin Methods */
+
+bool AnkiMediaIndex::contains(
+    const QString &collection,
+    const QString &filename) const
+{
+    QMutexLocker locker(&m_lock);
+    auto it = m_files.constFind(collection);
+    return it != m_files.constEnd() && it->contains(filename);
+}
+
+void AnkiMediaIndex::insert(
+    const QString &collection,
+    const QStringList &filenames)
+{
+    QMutexLocker locker(&m_lock);
+    QSet<QString> &files = m_files[collection];
+    bool modified = false;
+    for (const QString &filename : filenames)
+    {
+        if (isContentAddressed(filename) && !files.contains(filename))
+        {
+            files.insert(filename);
+            modified = true;
+        }
+    }
+    if (modified)
+    {
+        save();
+    }
+}
+
+void AnkiMediaIndex::reset(
+    const QString &collection,
+    const QStringList &filenames)
+{
+    QSet<QString> files;
+    for (const QString &filename : filenames)
+    {
+        if (isContentAddressed(filename))
+        {
+            files.insert(filename);
+        }
+    }
+
+    QMutexLocker locker(&m_lock);
+    m_files[collection] = files;
+    save();
+}
+
+bool AnkiMediaIndex::isContentAddressed(const QString &filename)
+{
+    if (filename.size() <= MD5_HEX_LENGTH + 1 ||
+        filename[MD5_HEX_LENGTH] != '.')
+    {
+        return false;
+    }
+    for (int i = 0; i < MD5_HEX_LENGTH; ++i)
+    {
+        const QChar c = filename[i];
+        if (!(c >= '0' && c <= '9') && !(c >= 'a' && c <= 'f'))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+#undef MD5_HEX_LENGTH
+
+/* End Methods */
+/* Begin File Helpers */
+
+void AnkiMediaIndex::load()
+{
+    QFile file(m_path);
+    if (!file.exists())
+    {
+        return;
+    }
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "Could not open Anki media index" << m_path;
+        return;
+    }
+
+    const QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+    if (!doc.isObject())
+    {
+        qDebug() << m_path << "is not an object";
+        return;
+    }
+
+    QMutexLocker locker(&m_lock);
+    const QJsonObject obj = doc.object();
+    for (auto it = obj.constBegin(); it != obj.constEnd(); ++it)
+    {
+        QSet<QString> &files = m_files[it.key()];
+        for (const QJsonValue &filename : it.value().toArray())
+        {
+            files.insert(filename.toString());
+        }
+    }
+}
+
+void AnkiMediaIndex::save() const
+{
+    QJsonObject obj;
+    for (auto it = m_files.constBegin(); it != m_files.constEnd(); ++it)
+    {
+        obj[it.key()] = QJsonArray::fromStringList(it.value().values());
+    }
+
+    QSaveFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qDebug() << "Could not open Anki media index" << m_path;
+        return;
+    }
+    file.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+    if (!file.commit())
+    {
+        qDebug() << "Could not write Anki media index" << m_path;
+    }
+}
+
+/* End File Helpers */
@@ -0,0 +1,99 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ANKIMEDIAINDEX_H
+#define ANKIMEDIAINDEX_H
+
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+/**
+ * A persistent record of the media files already stored in each Anki
+ * collection. Collections are identified by the AnkiConnect server and the
+ * name of the Anki profile that owns them. Only content addressed filenames (an MD5
+ * hash followed by an extension) are recorded since a file with the same
+ * name is guaranteed to have the same contents.
+ * All methods are thread-safe.
+ */
+class AnkiMediaIndex
+{
+public:
+    /**
+     * Creates an index backed by a file, loading it if it exists.
+     * @param path The path of the file the index is saved to.
+     */
+    AnkiMediaIndex(const QString &path);
+
+    /**
+     * Checks if a file is known to be stored in a collection.
+     * @param collection The server and profile of the collection.
+     * @param filename   The name of the media file.
+     * @return true if the file is known to exist, false otherwise.
+     */
+    bool contains(const QString &collection, const QString &filename) const;
+
+    /**
+     * Records that files were stored in a collection and saves the index.
+     * @param collection The server and profile of the collection.
+     * @param filenames  The names of the stored files. Names that aren't
+     *                   content addressed are ignored.
+     */
+    void insert(const QString &collection, const QStringList &filenames);
+
+    /**
+     * Replaces every record for a collection and saves the index.
+     * @param collection The server and profile of the collection.
+     * @param filenames  The names of every file stored in the collection.
+     *                   Names that aren't content addressed are ignored.
+     */
+    void reset(const QString &collection, const QStringList &filenames);
+
+private:
+    /**
+     * Loads the index from its file.
+     */
+    void load();
+
+    /**
+     * Saves the index to its file. Assumes m_lock is held.
+     */
+    void save() const;
+
+    /**
+     * Checks if a filename is a content addressed name.
+     * @param filename The filename to check.
+     * @return true if filename is an MD5 hash followed by an extension.
+     */
+    static bool isContentAddressed(const QString &filename);
+
+    /* The path of the file the index is saved to. */
+    const QString m_path;
+
+    /* Maps collections to the names of the files stored in them. */
+    QHash<QString, QSet<QString>> m_files;
+
+    /* Protects m_files. */
+    mutable QMutex m_lock;
+};
+
+#endif // ANKIMEDIAINDEX_H
@@ -0,0 +1,209 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "ankirequestbody.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <QDebug>
+#include <QFileInfo>
+
+/* The maximum number of bytes encoded at once. Must be a multiple of 3. */
+#define CHUNK_SIZE (48 * 1024)
+
+/* Begin Building */
+
+void AnkiRequestBody::appendSegment(Segment segment)
+{
+    if (segment.size == 0)
+    {
+        return;
+    }
+    segment.offset = m_size;
+    m_size += segment.size;
+    m_segments.append(segment);
+}
+
+void AnkiRequestBody::appendLiteral(const QByteArray &data)
+{
+    appendSegment({Segment::Type::Literal, data, QString(), 0, data.size()});
+}
+
+void AnkiRequestBody::appendFile(const QString &path)
+{
+    appendSegment({
+        Segment::Type::File,
+        QByteArray(),
+        path,
+        0,
+        encodedSize(QFileInfo(path).size())
+    });
+}
+
+void AnkiRequestBody::appendData(const QByteArray &data)
+{
+    appendSegment({
+        Segment::Type::Data, data, QString(), 0, encodedSize(data.size())
+    });
+}
+
+qint64 AnkiRequestBody::encodedSize(const qint64 size)
+{
+    return (size + 2) / 3 * 4;
+}
+
+/* End Building */
+/* Begin QIODevice */
+
+bool AnkiRequestBody::isSequential() const
+{
+    return false;
+}
+
+qint64 AnkiRequestBody::size() const
+{
+    return m_size;
+}
+
+bool AnkiRequestBody::seek(const qint64 pos)
+{
+    if (pos < 0 || pos > m_size)
+    {
+        return false;
+    }
+    m_pos = pos;
+    auto it = std::upper_bound(
+        m_segments.constBegin(), m_segments.constEnd(), pos,
+        [] (const qint64 pos, const Segment &segment) {
+            return pos < segment.offset;
+        }
+    );
+    m_segment = std::max<qsizetype>(it - m_segments.constBegin() - 1, 0);
+    return QIODevice::seek(pos);
+}
+
+void AnkiRequestBody::close()
+{
+    m_file.close();
+    QIODevice::close();
+}
+
+qint64 AnkiRequestBody::readData(char *data, const qint64 maxSize)
+{
+    qint64 read = 0;
+    while (read < maxSize && m_pos < m_size)
+    {
+        while (m_pos >= m_segments[m_segment].offset +
+                        m_segments[m_segment].size)
+        {
+            ++m_segment;
+        }
+        const Segment &segment = m_segments[m_segment];
+        const qint64 offset = m_pos - segment.offset;
+
+        qint64 count = 0;
+        switch (segment.type)
+        {
+        case Segment::Type::Literal:
+            count = std::min(maxSize - read, segment.size - offset);
+            std::memcpy(data + read, segment.data.constData() + offset, count);
+            break;
+        case Segment::Type::File:
+        case Segment::Type::Data:
+            count = readEncoded(segment, offset, data + read, maxSize - read);
+            break;
+        }
+        if (count <= 0)
+        {
+            return read == 0 ? -1 : read;
+        }
+
+        read += count;
+        m_pos += count;
+    }
+    return read;
+}
+
+qint64 AnkiRequestBody::writeData(const char *, const qint64)
+{
+    return -1;
+}
+
+/* End QIODevice */
+/* Begin Encoding */
+
+qint64 AnkiRequestBody::readEncoded(
+    const Segment &segment,
+    const qint64 offset,
+    char *data,
+    const qint64 maxSize)
+{
+    /* Every 3 input bytes encode to 4 output bytes, so start at the group
+     * containing offset and skip the characters already read. */
+    const qint64 skip = offset % 4;
+    const qint64 want = std::min(maxSize, segment.size - offset);
+    const qint64 start = offset / 4 * 3;
+    const qint64 length = std::min<qint64>(
+        CHUNK_SIZE, (skip + want + 3) / 4 * 3
+    );
+
+    QByteArray raw;
+    if (segment.type == Segment::Type::Data)
+    {
+        raw = segment.data.mid(start, length);
+    }
+    else
+    {
+        if (m_file.fileName() != segment.path || !m_file.isOpen())
+        {
+            m_file.close();
+            m_file.setFileName(segment.path);
+            if (!m_file.open(QIODevice::ReadOnly))
+            {
+                qDebug() << "Could not open media" << segment.path;
+                return -1;
+            }
+        }
+        if (!m_file.seek(start))
+        {
+            return -1;
+        }
+        raw = m_file.read(length);
+    }
+    if (raw.isEmpty())
+    {
+        qDebug() << "Media ended early" << segment.path;
+        return -1;
+    }
+
+    const QByteArray encoded = raw.toBase64();
+    const qint64 count = std::min<qint64>(want, encoded.size() - skip);
+    if (count <= 0)
+    {
+        return -1;
+    }
+    std::memcpy(data, encoded.constData() + skip, count);
+    return count;
+}
+
+#undef CHUNK_SIZE
+
+/* End Encoding */
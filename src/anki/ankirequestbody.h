@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ANKIREQUESTBODY_H
+#define ANKIREQUESTBODY_H
+
+#include <QIODevice>
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+
+/**
+ * A request body that is generated as it is read. Literal pieces of the body
+ * are copied as is, while media is base64 encoded chunk by chunk straight
+ * from its source as the socket drains. The encoded media is never held in
+ * memory as a whole, so memory use doesn't grow with the size of the media.
+ * The size of the body is known up front so it can be sent with a
+ * Content-Length.
+ */
+class AnkiRequestBody : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    using QIODevice::QIODevice;
+
+    /**
+     * Appends bytes that are copied into the body as is.
+     * @param data The bytes to append.
+     */
+    void appendLiteral(const QByteArray &data);
+
+    /**
+     * Appends the base64 encoding of a file. The file is read when the body
+     * is read and must not change until then.
+     * @param path The path of the file.
+     */
+    void appendFile(const QString &path);
+
+    /**
+     * Appends the base64 encoding of bytes in memory.
+     * @param data The bytes to encode.
+     */
+    void appendData(const QByteArray &data);
+
+    /**
+     * Gets the base64 encoded size of some bytes.
+     * @param size The number of bytes before encoding.
+     * @return The number of bytes after encoding.
+     */
+    static qint64 encodedSize(qint64 size);
+
+    bool isSequential() const override;
+    qint64 size() const override;
+    bool seek(qint64 pos) override;
+    void close() override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    /* A contiguous piece of the body. */
+    struct Segment
+    {
+        /* The kinds of segments. */
+        enum class Type
+        {
+            Literal,
+            File,
+            Data
+        };
+
+        /* The kind of segment. */
+        Type type;
+
+        /* The bytes of literal and data segments. */
+        QByteArray data;
+
+        /* The path of file segments. */
+        QString path;
+
+        /* The offset of the segment in the body. */
+        qint64 offset;
+
+        /* The size of the segment in the body. */
+        qint64 size;
+    };
+
+    /**
+     * Appends a segment to the end of the body.
+     * @param segment The segment to append. The offset is set.
+     */
+    void appendSegment(Segment segment);
+
+    /**
+     * Copies base64 encoded bytes from a media segment.
+     * @param      segment The file or data segment to encode.
+     * @param      offset  The offset into the encoded segment to start at.
+     * @param[out] data    The buffer to copy to.
+     * @param      maxSize The maximum number of bytes to copy.
+     * @return The number of bytes copied, -1 on error.
+     */
+    qint64 readEncoded(const Segment &segment,
+                       qint64 offset,
+                       char *data,
+                       qint64 maxSize);
+
+    /* The segments of the body in order. */
+    QList<Segment> m_segments;
+
+    /* The size of the body. */
+    qint64 m_size = 0;
+
+    /* The position the next read starts at. */
+    qint64 m_pos = 0;
+
+    /* The index of the segment containing m_pos. */
+    qsizetype m_segment = 0;
+
+    /* The file of the last file segment that was read. */
+    QFile m_file;
+};
+
+#endif // ANKIREQUESTBODY_H
@@ -0,0 +1,234 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "cardtemplate.h"
+
+#include <QHash>
+
+#include "ankiclient.h"
+
+static_assert(
+    static_cast<int>(CardTemplate::Marker::Count) <= 64,
+    "Marker sets must fit in 64 bits"
+);
+
+/* Begin Constructor */
+
+CardTemplate::CardTemplate(const QJsonObject &fields, const Type type)
+{
+    for (auto it = fields.constBegin(); it != fields.constEnd(); ++it)
+    {
+        Field field = compile(it.key(), it.value().toString(), type);
+        for (const Token &token : field.tokens)
+        {
+            if (token.marker != Marker::Count)
+            {
+                m_markers |= bit(token.marker);
+            }
+        }
+        m_fields.append(field);
+    }
+}
+
+/* End Constructor */
+/* Begin Compilation */
+
+CardTemplate::Marker CardTemplate::lookup(const QString &text, const Type type)
+{
+    static const QHash<QString, Marker> markers{
+        {REPLACE_AUDIO_MEDIA,      Marker::AudioMedia},
+        {REPLACE_AUDIO_CONTEXT,    Marker::AudioContext},
+        {REPLACE_CLIPBOARD,        Marker::Clipboard},
+        {REPLACE_CLOZE_BODY,       Marker::ClozeBody},
+        {REPLACE_CLOZE_PREFIX,     Marker::ClozePrefix},
+        {REPLACE_CLOZE_SUFFIX,     Marker::ClozeSuffix},
+        {REPLACE_CONTEXT,          Marker::Context},
+        {REPLACE_CONTEXT_SEC,      Marker::ContextSecondary},
+        {REPLACE_FREQUENCIES,      Marker::Frequencies},
+        {REPLACE_GLOSSARY,         Marker::Glossary},
+        {REPLACE_SCREENSHOT,       Marker::Screenshot},
+        {REPLACE_SCREENSHOT_VIDEO, Marker::ScreenshotVideo},
+        {REPLACE_SENTENCE,         Marker::Sentence},
+        {REPLACE_SENTENCE_SEC,     Marker::SentenceSecondary},
+        {REPLACE_TAGS,             Marker::Tags},
+        {REPLACE_TITLE,            Marker::Title},
+
+        {REPLACE_AUDIO,            Marker::Audio},
+        {REPLACE_EXPRESSION,       Marker::Expression},
+        {REPLACE_FURIGANA,         Marker::Furigana},
+        {REPLACE_FURIGANA_PLAIN,   Marker::FuriganaPlain},
+        {REPLACE_GLOSSARY_BRIEF,   Marker::GlossaryBrief},
+        {REPLACE_GLOSSARY_COMPACT, Marker::GlossaryCompact},
+        {REPLACE_PITCH,            Marker::Pitch},
+        {REPLACE_PITCH_GRAPHS,     Marker::PitchGraphs},
+        {REPLACE_PITCH_POSITIONS,  Marker::PitchPositions},
+        {REPLACE_READING,          Marker::Reading},
+
+        {REPLACE_CHARACTER,        Marker::Character},
+        {REPLACE_KUNYOMI,          Marker::Kunyomi},
+        {REPLACE_ONYOMI,           Marker::Onyomi},
+        {REPLACE_STROKE_COUNT,     Marker::StrokeCount},
+    };
+
+    const Marker marker = markers.value(text, Marker::Count);
+    switch (type)
+    {
+    case Type::Term:
+        if (marker >= Marker::Character)
+        {
+            return Marker::Count;
+        }
+        break;
+    case Type::Kanji:
+        if (marker >= Marker::Audio && marker < Marker::Character)
+        {
+            return Marker::Count;
+        }
+        break;
+    }
+    return marker;
+}
+
+CardTemplate::Field CardTemplate::compile(
+    const QString &name,
+    const QString &source,
+    const Type type)
+{
+    Field field;
+    field.name = name;
+
+    auto appendLiteral = [&field] (const QString &literal) {
+        if (!literal.isEmpty())
+        {
+            field.tokens.append({Marker::Count, literal});
+            field.literalSize += literal.size();
+        }
+    };
+
+    qsizetype literalStart = 0;
+    qsizetype open = source.indexOf('{');
+    while (open != -1)
+    {
+        const qsizetype close = source.indexOf('}', open);
+        if (close == -1)
+        {
+            break;
+        }
+
+        const Marker marker =
+            lookup(source.mid(open, close - open + 1), type);
+        if (marker == Marker::Count)
+        {
+            open = source.indexOf('{', open + 1);
+            continue;
+        }
+
+        appendLiteral(source.mid(literalStart, open - literalStart));
+        field.tokens.append({marker, QString()});
+        literalStart = close + 1;
+        open = source.indexOf('{', literalStart);
+    }
+    appendLiteral(source.mid(literalStart));
+
+    return field;
+}
+
+/* End Compilation */
+/* Begin Queries */
+
+bool CardTemplate::uses(const Marker marker) const
+{
+    return m_markers & bit(marker);
+}
+
+QJsonArray CardTemplate::fieldsUsing(const Marker marker) const
+{
+    QJsonArray fields;
+    if (!uses(marker))
+    {
+        return fields;
+    }
+    for (const Field &field : m_fields)
+    {
+        for (const Token &token : field.tokens)
+        {
+            if (token.marker == marker)
+            {
+                fields.append(field.name);
+                break;
+            }
+        }
+    }
+    return fields;
+}
+
+CardTemplate CardTemplate::onlyField(const QString &name) const
+{
+    for (const Field &field : m_fields)
+    {
+        if (field.name != name)
+        {
+            continue;
+        }
+
+        CardTemplate result;
+        result.m_fields.append(field);
+        for (const Token &token : field.tokens)
+        {
+            if (token.marker != Marker::Count)
+            {
+                result.m_markers |= bit(token.marker);
+            }
+        }
+        return result;
+    }
+    return *this;
+}
+
+/* End Queries */
+/* Begin Rendering */
+
+QJsonObject CardTemplate::render(const Values &values) const
+{
+    QJsonObject result;
+    for (const Field &field : m_fields)
+    {
+        qsizetype size = field.literalSize;
+        for (const Token &token : field.tokens)
+        {
+            if (token.marker != Marker::Count)
+            {
+                size += values[token.marker].size();
+            }
+        }
+
+        QString value;
+        value.reserve(size);
+        for (const Token &token : field.tokens)
+        {
+            value += token.marker == Marker::Count
+                ? token.literal : values[token.marker];
+        }
+        result[field.name] = value;
+    }
+    return result;
+}
+
+/* End Rendering */
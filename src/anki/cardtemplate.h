@@ -0,0 +1,213 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CARDTEMPLATE_H
+#define CARDTEMPLATE_H
+
+#include <array>
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+
+/**
+ * The fields of a note type compiled into lists of literals and markers.
+ * Fields are parsed once when the configuration changes so that rendering a
+ * note is a single pass over each field and markers that aren't used by any
+ * field don't need to be computed.
+ */
+class CardTemplate
+{
+public:
+    /* The kinds of note a template can belong to. */
+    enum class Type
+    {
+        Term,
+        Kanji
+    };
+
+    /* Every marker a template can contain. */
+    enum class Marker
+    {
+        /* Shared Markers */
+        AudioMedia,
+        AudioContext,
+        Clipboard,
+        ClozeBody,
+        ClozePrefix,
+        ClozeSuffix,
+        Context,
+        ContextSecondary,
+        Frequencies,
+        Glossary,
+        Screenshot,
+        ScreenshotVideo,
+        Sentence,
+        SentenceSecondary,
+        Tags,
+        Title,
+
+        /* Term Markers */
+        Audio,
+        Expression,
+        Furigana,
+        FuriganaPlain,
+        GlossaryBrief,
+        GlossaryCompact,
+        Pitch,
+        PitchGraphs,
+        PitchPositions,
+        Reading,
+
+        /* Kanji Markers */
+        Character,
+        Kunyomi,
+        Onyomi,
+        StrokeCount,
+
+        /* The number of markers. Not a marker. */
+        Count
+    };
+
+    /**
+     * The values markers are replaced with. Markers without a value are
+     * replaced with the empty string.
+     */
+    class Values
+    {
+    public:
+        QString &operator[](Marker marker)
+        {
+            return m_values[static_cast<size_t>(marker)];
+        }
+
+        const QString &operator[](Marker marker) const
+        {
+            return m_values[static_cast<size_t>(marker)];
+        }
+
+    private:
+        std::array<QString, static_cast<size_t>(Marker::Count)> m_values;
+    };
+
+    /**
+     * Creates an empty template.
+     */
+    CardTemplate() = default;
+
+    /**
+     * Compiles the fields of a note type. Markers that don't belong to the
+     * note type are left as literal text.
+     * @param fields The raw fields object mapping field names to templates.
+     * @param type   The kind of note the fields belong to.
+     */
+    CardTemplate(const QJsonObject &fields, Type type);
+
+    /**
+     * Checks if any field uses a marker.
+     * @param marker The marker to check for.
+     * @return true if at least one field contains marker, false otherwise.
+     */
+    bool uses(Marker marker) const;
+
+    /**
+     * Gets the names of every field that uses a marker.
+     * @param marker The marker to check for.
+     * @return The names of the fields containing marker in sorted order.
+     */
+    QJsonArray fieldsUsing(Marker marker) const;
+
+    /**
+     * Gets a template containing only a single field.
+     * @param name The name of the field.
+     * @return The template of the field, a copy of this template if the field
+     *         doesn't exist.
+     */
+    CardTemplate onlyField(const QString &name) const;
+
+    /**
+     * Replaces the markers in every field with their values.
+     * @param values The values of the markers.
+     * @return The fields object mapping field names to their rendered values.
+     */
+    QJsonObject render(const Values &values) const;
+
+private:
+    /* A piece of a compiled field. */
+    struct Token
+    {
+        /* The marker this token is replaced with. Count for literals. */
+        Marker marker;
+
+        /* The text of a literal token. Empty for markers. */
+        QString literal;
+    };
+
+    /* A compiled field. */
+    struct Field
+    {
+        /* The name of the field. */
+        QString name;
+
+        /* The tokens of the field in order. */
+        QList<Token> tokens;
+
+        /* The combined length of every literal token. */
+        qsizetype literalSize = 0;
+    };
+
+    /**
+     * Splits a raw field into literal and marker tokens.
+     * @param name   The name of the field.
+     * @param source The raw template of the field.
+     * @param type   The kind of note the field belongs to.
+     * @return The compiled field.
+     */
+    static Field compile(const QString &name,
+                         const QString &source,
+                         Type type);
+
+    /**
+     * Gets the marker matching some text.
+     * @param text The text of the marker including the braces.
+     * @param type The kind of note the marker would belong to.
+     * @return The matching marker, Count if the text isn't a marker of type.
+     */
+    static Marker lookup(const QString &text, Type type);
+
+    /**
+     * Gets the bit representing a marker in a marker set.
+     * @param marker The marker.
+     * @return The bit of marker.
+     */
+    static constexpr quint64 bit(Marker marker)
+    {
+        return quint64(1) << static_cast<int>(marker);
+    }
+
+    /* The compiled fields sorted by name. */
+    QList<Field> m_fields;
+
+    /* The set of markers used by any field. */
+    quint64 m_markers = 0;
+};
+
+#endif // CARDTEMPLATE_H
@@ -21,9 +21,17 @@
 #include "glossarybuilder.h"
 
 #include <QAbstractTextDocumentLayout>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonDocument>
 #include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QTextBlock>
 
+#include "dict/yomidbbuilder.h"
 #include "util/utils.h"
 
 /* Begin Public Methods */
@@ -509,17 +517,72 @@ void GlossaryBuilder::addText(const QJsonObject &obj, QString &out)
 /* End Other Object Parsers */
 /* Begin Helpers */
 
+/**
+ * The resource hashes of a dictionary written when it was imported.
+ */
+struct ResourceHashes
+{
+    /* The modification time of the hashes file when it was read. */
+    QDateTime modified;
+
+    /* Maps relative resource paths to their MD5 hashes. */
+    QHash<QString, QString> hashes;
+};
+
+/**
+ * Gets the hash of a resource computed when its dictionary was imported.
+ * Hashes are cached until the dictionary is imported again.
+ * @param basepath The resource directory of the dictionary.
+ * @param path     The path of the resource relative to basepath.
+ * @return The MD5 hash of the resource, empty string if it is not known.
+ */
+static QString importedHash(const QString &basepath, const QString &path)
+{
+    static QMutex lock;
+    static QHash<QString, ResourceHashes> cache;
+
+    const QFileInfo info(basepath + YOMI_RESOURCE_HASHES_FILE);
+    const QDateTime modified =
+        info.exists() ? info.lastModified() : QDateTime();
+
+    QMutexLocker locker(&lock);
+    ResourceHashes &entry = cache[basepath];
+    if (entry.modified != modified)
+    {
+        entry.modified = modified;
+        entry.hashes.clear();
+
+        QFile file(info.filePath());
+        if (file.open(QIODevice::ReadOnly))
+        {
+            const QJsonObject obj =
+                QJsonDocument::fromJson(file.readAll()).object();
+            for (auto it = obj.constBegin(); it != obj.constEnd(); ++it)
+            {
+                entry.hashes.insert(it.key(), it.value().toString());
+            }
+        }
+    }
+    return entry.hashes.value(path);
+}
+
 QString GlossaryBuilder::addFile(
     QString basepath,
     const QString &path,
     QList<QPair<QString, QString>> &fileMap)
 {
+    const QString resourceDir = basepath;
 #if defined(Q_OS_WIN)
     basepath += QString(path).replace('/', SLASH);
 #else
     basepath += path;
 #endif
-    QString hash = FileUtils::calculateMd5(basepath);
+    /* Dictionaries imported before hashes were saved need to be hashed */
+    QString hash = importedHash(resourceDir, path);
+    if (hash.isEmpty() || !QFileInfo::exists(basepath))
+    {
+        hash = FileUtils::calculateMd5(basepath);
+    }
     if (hash.isEmpty())
     {
         return QString("File not found at: %1").arg(basepath);
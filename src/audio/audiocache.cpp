@@ -0,0 +1,334 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "audiocache.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSet>
+
+#include "util/utils.h"
+
+#define INDEX_FILE      "index.json"
+
+/* The minimum time between index saves in milliseconds */
+#define SAVE_INTERVAL   2000
+
+#define KEY_FILES       "files"
+#define KEY_MD5         "md5"
+#define KEY_SIZE        "size"
+#define KEY_URLS        "urls"
+
+/* Begin Constructor/Destructor */
+
+AudioCache::AudioCache(const QString &dir, const qint64 maxSize) :
+    m_dir(dir.endsWith(SLASH) ? dir : dir + SLASH),
+    m_maxSize(maxSize)
+{
+    if (!QDir().mkpath(m_dir))
+    {
+        qDebug() << "Could not create audio cache directory" << m_dir;
+    }
+
+    QMutexLocker locker(&m_lock);
+    load();
+}
+
+AudioCache::~AudioCache()
+{
+    QMutexLocker locker(&m_lock);
+    if (m_dirty)
+    {
+        save();
+    }
+}
+
+/* End Constructor/Destructor */
+/* Begin Persistence */
+
+void AudioCache::load()
+{
+    QJsonArray index;
+    QFile indexFile(m_dir + INDEX_FILE);
+    if (indexFile.open(QIODevice::ReadOnly))
+    {
+        index = QJsonDocument::fromJson(indexFile.readAll())
+            .object()[KEY_FILES].toArray();
+        indexFile.close();
+    }
+
+    QSet<QString> indexed;
+    for (const QJsonValue &val : index)
+    {
+        indexed << val.toObject()[KEY_MD5].toString();
+    }
+
+    /* Adopt files that were written but never made it into the index. They
+     * have no URLs, so they go first in line to be evicted. */
+    const QFileInfoList infos =
+        QDir(m_dir).entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
+    for (const QFileInfo &info : infos)
+    {
+        const QString name = info.fileName();
+        if (name == INDEX_FILE || indexed.contains(name))
+        {
+            continue;
+        }
+        else if (!isMd5(name))
+        {
+            /* Leftovers of interrupted writes */
+            QFile::remove(info.filePath());
+            continue;
+        }
+
+        File &file = m_files[name];
+        file.size = info.size();
+        m_size += file.size;
+        touch(name, file);
+        m_dirty = true;
+    }
+
+    /* Files are stored oldest first */
+    for (const QJsonValue &val : index)
+    {
+        const QJsonObject obj = val.toObject();
+        const QString md5 = obj[KEY_MD5].toString();
+        if (md5.isEmpty() || m_files.contains(md5))
+        {
+            continue;
+        }
+
+        const QFileInfo info(filePath(md5));
+        if (!info.exists())
+        {
+            m_dirty = true;
+            continue;
+        }
+
+        File &file = m_files[md5];
+        file.size = info.size();
+        for (const QJsonValue &url : obj[KEY_URLS].toArray())
+        {
+            file.urls << url.toString();
+            m_urls.insert(url.toString(), md5);
+        }
+        m_size += file.size;
+        touch(md5, file);
+    }
+
+    evict();
+    if (m_dirty)
+    {
+        save();
+    }
+}
+
+void AudioCache::save()
+{
+    QJsonArray files;
+    for (const QString &md5 : m_lru)
+    {
+        const File &file = m_files[md5];
+        QJsonObject obj;
+        obj[KEY_MD5] = md5;
+        obj[KEY_SIZE] = file.size;
+        obj[KEY_URLS] = QJsonArray::fromStringList(file.urls);
+        files.append(obj);
+    }
+    QJsonObject root;
+    root[KEY_FILES] = files;
+
+    QSaveFile indexFile(m_dir + INDEX_FILE);
+    if (!indexFile.open(QIODevice::WriteOnly))
+    {
+        qDebug() << "Could not open audio cache index" << indexFile.fileName();
+        return;
+    }
+    indexFile.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    if (!indexFile.commit())
+    {
+        qDebug() << "Could not write audio cache index"
+                 << indexFile.fileName();
+        return;
+    }
+    m_dirty = false;
+    m_lastSave.start();
+}
+
+void AudioCache::saveIfDue()
+{
+    if (m_dirty &&
+        (!m_lastSave.isValid() || m_lastSave.hasExpired(SAVE_INTERVAL)))
+    {
+        save();
+    }
+}
+
+#undef INDEX_FILE
+#undef SAVE_INTERVAL
+
+#undef KEY_FILES
+#undef KEY_MD5
+#undef KEY_SIZE
+#undef KEY_URLS
+
+/* End Persistence */
+/* Begin Cache Operations */
+
+AudioCache::Entry AudioCache::find(const QString &url)
+{
+    Entry entry;
+
+    QMutexLocker locker(&m_lock);
+    auto urlIt = m_urls.constFind(url);
+    if (urlIt == m_urls.constEnd())
+    {
+        return entry;
+    }
+    auto fileIt = m_files.find(urlIt.value());
+    if (fileIt == m_files.end())
+    {
+        return entry;
+    }
+
+    /* Persist the new LRU order so hits survive restarts */
+    touch(fileIt.key(), fileIt.value());
+    m_dirty = true;
+    saveIfDue();
+
+    entry.path = filePath(fileIt.key());
+    entry.md5 = fileIt.key();
+    return entry;
+}
+
+AudioCache::Entry AudioCache::insert(const QString &url, const QByteArray &data)
+{
+    Entry entry;
+    const QString md5 =
+        QCryptographicHash::hash(data, QCryptographicHash::Md5).toHex();
+
+    QMutexLocker locker(&m_lock);
+
+    /* Only write the file if the same audio isn't already stored */
+    auto fileIt = m_files.find(md5);
+    if (fileIt == m_files.end())
+    {
+        QSaveFile out(filePath(md5));
+        if (!out.open(QIODevice::WriteOnly) ||
+            out.write(data) != data.size() ||
+            !out.commit())
+        {
+            qDebug() << "Could not write audio cache file" << out.fileName();
+            return entry;
+        }
+        fileIt = m_files.insert(md5, File());
+        fileIt->size = data.size();
+        m_size += data.size();
+    }
+
+    /* Point the URL at the file, detaching it from any older file */
+    const QString oldMd5 = m_urls.value(url);
+    if (oldMd5 != md5)
+    {
+        if (!oldMd5.isEmpty())
+        {
+            m_files[oldMd5].urls.removeOne(url);
+        }
+        fileIt->urls << url;
+        m_urls.insert(url, md5);
+    }
+    touch(md5, fileIt.value());
+    m_dirty = true;
+
+    evict();
+    saveIfDue();
+
+    entry.path = filePath(md5);
+    entry.md5 = md5;
+    return entry;
+}
+
+/* End Cache Operations */
+/* Begin Helpers */
+
+void AudioCache::touch(const QString &md5, File &file)
+{
+    if (file.used != 0)
+    {
+        m_lru.remove(file.used);
+    }
+    file.used = ++m_tick;
+    m_lru.insert(file.used, md5);
+}
+
+void AudioCache::evict()
+{
+    while (m_size > m_maxSize && m_lru.size() > 1)
+    {
+        auto lruIt = m_lru.begin();
+        const QString md5 = lruIt.value();
+        m_lru.erase(lruIt);
+
+        auto fileIt = m_files.find(md5);
+        if (fileIt == m_files.end())
+        {
+            continue;
+        }
+        for (const QString &url : fileIt->urls)
+        {
+            m_urls.remove(url);
+        }
+        m_size -= fileIt->size;
+        m_files.erase(fileIt);
+        QFile::remove(filePath(md5));
+        m_dirty = true;
+    }
+}
+
+QString AudioCache::filePath(const QString &md5) const
+{
+    return m_dir + md5;
+}
+
+bool AudioCache::isMd5(const QString &name)
+{
+    if (name.size() != 32)
+    {
+        return false;
+    }
+    for (const QChar c : name)
+    {
+        if (!c.isDigit() && (c < u'a' || c > u'f'))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* End Helpers */
@@ -0,0 +1,174 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef AUDIOCACHE_H
+#define AUDIOCACHE_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+/**
+ * A size bounded cache of downloaded audio files on disk that persists between
+ * sessions. Files are named after the MD5 of their contents so URLs that serve
+ * the same audio share a file, and the MD5 is kept in the index so it never has
+ * to be recalculated. The least recently used files are evicted when the cache
+ * grows past its maximum size. The index is saved at most every few seconds as
+ * the cache changes, and files that never made it into the index are adopted
+ * the next time the cache is opened.
+ * All methods are thread-safe.
+ */
+class AudioCache
+{
+public:
+    /**
+     * A file in the cache.
+     */
+    struct Entry
+    {
+        /* The path to the file. Empty if there is no such entry. */
+        QString path;
+
+        /* The MD5 of the file as a hex string. */
+        QString md5;
+    };
+
+    /**
+     * Opens the cache in the directory, creating the directory if it doesn't
+     * exist.
+     * @param dir     The directory the cache is stored in.
+     * @param maxSize The maximum total size of the files in bytes.
+     */
+    AudioCache(const QString &dir, qint64 maxSize);
+    ~AudioCache();
+
+    /**
+     * Finds the file downloaded from a URL and marks it as recently used.
+     * @param url The URL of the audio.
+     * @return The entry of the file. The path is empty if the URL isn't cached.
+     */
+    Entry find(const QString &url);
+
+    /**
+     * Adds the audio downloaded from a URL to the cache. Evicts the least
+     * recently used files if the cache is too large.
+     * @param url  The URL the audio was downloaded from.
+     * @param data The contents of the audio file.
+     * @return The entry of the file. The path is empty on error.
+     */
+    Entry insert(const QString &url, const QByteArray &data);
+
+private:
+    /* Information about a file in the cache. */
+    struct File
+    {
+        /* The size of the file in bytes. */
+        qint64 size = 0;
+
+        /* The tick the file was last used at. */
+        quint64 used = 0;
+
+        /* The URLs that resolve to the file. */
+        QStringList urls;
+    };
+
+    /**
+     * Reads the index from disk. Files named after an MD5 that aren't in the
+     * index are kept as the least recently used files since they have no URLs,
+     * other files are removed.
+     * Assumes the lock is held.
+     */
+    void load();
+
+    /**
+     * Writes the index to disk. Assumes the lock is held.
+     */
+    void save();
+
+    /**
+     * Writes the index to disk if it has changed and hasn't been saved
+     * recently. Assumes the lock is held.
+     */
+    void saveIfDue();
+
+    /**
+     * Marks a file as the most recently used file. Assumes the lock is held.
+     * @param md5  The MD5 of the file.
+     * @param file The file to mark.
+     */
+    void touch(const QString &md5, File &file);
+
+    /**
+     * Removes the least recently used files until the cache fits in its
+     * maximum size. Never removes the most recently used file.
+     * Assumes the lock is held.
+     */
+    void evict();
+
+    /**
+     * Returns the path of a file in the cache.
+     * @param md5 The MD5 of the file.
+     * @return The path to the file.
+     */
+    QString filePath(const QString &md5) const;
+
+    /**
+     * Returns whether a file name is a lowercase hex MD5.
+     * @param name The file name.
+     * @return true if the name is an MD5, false otherwise.
+     */
+    static bool isMd5(const QString &name);
+
+    /* The directory the cache is stored in. Ends in a path separator. */
+    const QString m_dir;
+
+    /* The maximum total size of the files in bytes. */
+    const qint64 m_maxSize;
+
+    /* The total size of the files in bytes. */
+    qint64 m_size = 0;
+
+    /* Incremented every time a file is used. */
+    quint64 m_tick = 0;
+
+    /* Maps URLs to the MD5 of their file. */
+    QHash<QString, QString> m_urls;
+
+    /* Maps MD5s to files. */
+    QHash<QString, File> m_files;
+
+    /* Maps the tick files were last used at to their MD5. Oldest first. */
+    QMap<quint64, QString> m_lru;
+
+    /* true if the index has changed since it was last saved. */
+    bool m_dirty = false;
+
+    /* Started when the index was last saved. Invalid if it never was. */
+    QElapsedTimer m_lastSave;
+
+    /* Protects all members. */
+    QMutex m_lock;
+};
+
+#endif // AUDIOCACHE_H
@@ -0,0 +1,603 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "audioengine.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mpv/client.h>
+#include <mpv/stream_cb.h>
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QHashFunctions>
+#include <QMutexLocker>
+#include <QTemporaryFile>
+#include <QtEndian>
+
+#include "util/trace.h"
+
+/* Every clip is decoded to and played in this format so the audio output can
+ * stay open between clips */
+#define AUDIO_FORMAT        "s16"
+#define AUDIO_SAMPLERATE    "48000"
+#define AUDIO_CHANNELS      "stereo"
+
+/* The protocol decoded audio is played from memory with */
+#define STREAM_PROTOCOL     "memento-pcm"
+
+/* Begin Streams */
+
+/* A read position in decoded audio that mpv is playing. */
+struct AudioStream
+{
+    /* The audio being played. Keeps the data alive until mpv is done. */
+    SharedDecodedAudio audio;
+
+    /* The read position in bytes. */
+    qint64 pos = 0;
+};
+
+static int64_t readStream(void *cookie, char *buf, uint64_t nbytes)
+{
+    AudioStream *stream = (AudioStream *)cookie;
+    const QByteArray &wav = stream->audio->wav;
+    const qint64 count =
+        std::min<qint64>(wav.size() - stream->pos, (qint64)nbytes);
+    std::memcpy(buf, wav.constData() + stream->pos, count);
+    stream->pos += count;
+    return count;
+}
+
+static int64_t seekStream(void *cookie, int64_t offset)
+{
+    AudioStream *stream = (AudioStream *)cookie;
+    if (offset < 0 || offset > stream->audio->wav.size())
+    {
+        return MPV_ERROR_GENERIC;
+    }
+    stream->pos = offset;
+    return offset;
+}
+
+static int64_t sizeStream(void *cookie)
+{
+    return ((AudioStream *)cookie)->audio->wav.size();
+}
+
+static void closeStream(void *cookie)
+{
+    delete (AudioStream *)cookie;
+}
+
+int AudioEngine::openStream(
+    void *engine,
+    char *uri,
+    mpv_stream_cb_info *info)
+{
+    AudioEngine *self = (AudioEngine *)engine;
+    const quint64 id = QByteArray(uri)
+        .mid(std::strlen(STREAM_PROTOCOL "://"))
+        .toULongLong();
+
+    SharedDecodedAudio audio;
+    {
+        QMutexLocker locker(&self->m_streamLock);
+        audio = self->m_streams.value(id);
+    }
+    if (!audio)
+    {
+        return MPV_ERROR_LOADING_FAILED;
+    }
+
+    info->cookie = new AudioStream{audio, 0};
+    info->read_fn = readStream;
+    info->seek_fn = seekStream;
+    info->size_fn = sizeStream;
+    info->close_fn = closeStream;
+    return 0;
+}
+
+/* End Streams */
+/* Begin Constructor/Destructor */
+
+static void wakeup(void *ctx)
+{
+    QMetaObject::invokeMethod(
+        (AudioEngine *)ctx, "processEvents", Qt::QueuedConnection
+    );
+}
+
+AudioEngine::AudioEngine(
+    const QString &audioOutput,
+    const qint64 cacheSize,
+    QObject *parent) :
+    QObject(parent),
+    m_cache(std::max<qint64>(1, cacheSize / 1024))
+{
+    m_player = mpv_create();
+    if (!m_player)
+    {
+        qDebug() << "AudioEngine: Could not create mpv context";
+        return;
+    }
+
+    mpv_set_option_string(m_player, "config",         "no");
+    mpv_set_option_string(m_player, "terminal",       "no");
+    mpv_set_option_string(m_player, "force-window",   "no");
+    mpv_set_option_string(m_player, "input-terminal", "no");
+    mpv_set_option_string(m_player, "cover-art-auto", "no");
+    mpv_set_option_string(m_player, "vid",            "no");
+    mpv_set_option_string(m_player, "ytdl",           "no");
+
+    /* Keep the last clip open and paused once it ends so the audio output
+     * isn't closed, and don't probe short clips for longer than needed. Fall
+     * back to the null output when there is no audio device so playback works
+     * headless. */
+    mpv_set_option_string(m_player, "idle",                         "yes");
+    mpv_set_option_string(m_player, "keep-open",                    "yes");
+    mpv_set_option_string(m_player, "audio-fallback-to-null",       "yes");
+    mpv_set_option_string(m_player, "demuxer-lavf-probe-info",      "nostreams");
+    mpv_set_option_string(m_player, "demuxer-lavf-analyzeduration", "0.1");
+    mpv_set_option_string(m_player, "cache",                        "no");
+    mpv_set_option_string(m_player, "audio-format",     AUDIO_FORMAT);
+    mpv_set_option_string(m_player, "audio-samplerate", AUDIO_SAMPLERATE);
+    mpv_set_option_string(m_player, "audio-channels",   AUDIO_CHANNELS);
+    if (!audioOutput.isEmpty())
+    {
+        mpv_set_option_string(m_player, "ao", audioOutput.toUtf8());
+    }
+
+    if (mpv_initialize(m_player) < 0)
+    {
+        qDebug() << "AudioEngine: Failed to initialize mpv context";
+        mpv_destroy(m_player);
+        m_player = nullptr;
+        return;
+    }
+
+    if (mpv_stream_cb_add_ro(
+            m_player, STREAM_PROTOCOL, this, AudioEngine::openStream) < 0)
+    {
+        qDebug() << "AudioEngine: Could not register the"
+                 << STREAM_PROTOCOL << "protocol";
+    }
+    mpv_set_wakeup_callback(m_player, wakeup, this);
+}
+
+AudioEngine::~AudioEngine()
+{
+    /* Decode jobs use the engine, so wait for them before tearing it down.
+     * Results they already posted are dropped along with the engine. */
+    {
+        QMutexLocker locker(&m_jobLock);
+        m_shutdown = true;
+        while (m_decodes > 0)
+        {
+            m_decodesDone.wait(&m_jobLock);
+        }
+    }
+
+    if (m_player)
+    {
+        mpv_set_wakeup_callback(m_player, nullptr, nullptr);
+        mpv_terminate_destroy(m_player);
+        m_player = nullptr;
+    }
+
+    {
+        QMutexLocker locker(&m_decodeLock);
+        if (m_decoder)
+        {
+            mpv_terminate_destroy(m_decoder);
+            m_decoder = nullptr;
+        }
+    }
+
+    /* Callers holding on to a reply still expect a result */
+    for (AudioEngineReply *reply : m_pending)
+    {
+        Q_EMIT reply->finished(nullptr);
+        reply->deleteLater();
+    }
+    m_pending.clear();
+}
+
+/* End Constructor/Destructor */
+/* Begin Decoding */
+
+/* The number of seconds to wait for an event from the decoder */
+#define EVENT_TIMEOUT 5
+
+bool AudioEngine::initDecoder()
+{
+    m_decoder = mpv_create();
+    if (!m_decoder)
+    {
+        qDebug() << "AudioEngine: Could not create decoder";
+        return false;
+    }
+
+    /* Decode as fast as possible into a WAV file. Without gapless audio the
+     * output is closed, and the file finished, before the end of each file is
+     * reported. */
+    mpv_set_option_string(m_decoder, "config",                  "no");
+    mpv_set_option_string(m_decoder, "terminal",                "no");
+    mpv_set_option_string(m_decoder, "idle",                    "yes");
+    mpv_set_option_string(m_decoder, "keep-open",               "no");
+    mpv_set_option_string(m_decoder, "cover-art-auto",          "no");
+    mpv_set_option_string(m_decoder, "vid",                     "no");
+    mpv_set_option_string(m_decoder, "sid",                     "no");
+    mpv_set_option_string(m_decoder, "ytdl",                    "no");
+    mpv_set_option_string(m_decoder, "cache",                   "no");
+    mpv_set_option_string(m_decoder, "demuxer-lavf-probe-info", "nostreams");
+    mpv_set_option_string(m_decoder, "gapless-audio",           "no");
+    mpv_set_option_string(m_decoder, "ao",                      "pcm");
+    mpv_set_option_string(m_decoder, "ao-pcm-fast",             "yes");
+    mpv_set_option_string(m_decoder, "ao-pcm-waveheader",       "yes");
+    mpv_set_option_string(m_decoder, "audio-format",     AUDIO_FORMAT);
+    mpv_set_option_string(m_decoder, "audio-samplerate", AUDIO_SAMPLERATE);
+    mpv_set_option_string(m_decoder, "audio-channels",   AUDIO_CHANNELS);
+
+    if (mpv_initialize(m_decoder) < 0)
+    {
+        qDebug() << "AudioEngine: Could not initialize decoder";
+        mpv_destroy(m_decoder);
+        m_decoder = nullptr;
+        return false;
+    }
+    return true;
+}
+
+SharedDecodedAudio AudioEngine::decode(const QString &path)
+{
+    TraceSpan span("AudioEngine::decode", path);
+
+    const QFileInfo info(path);
+    if (!info.exists())
+    {
+        return nullptr;
+    }
+
+    /* Get a temporary file name */
+    QTemporaryFile file;
+    if (!file.open())
+    {
+        return nullptr;
+    }
+    const QString pcmPath = file.fileName();
+    file.close();
+
+    QMutexLocker locker(&m_decodeLock);
+    if (m_decoder == nullptr && !initDecoder())
+    {
+        return nullptr;
+    }
+
+    const QByteArray pcmPathUtf8 = pcmPath.toUtf8();
+    const QByteArray pathUtf8 = path.toUtf8();
+    const char *args[] = {
+        "loadfile",
+        pathUtf8.constData(),
+        "replace",
+        NULL
+    };
+    if (mpv_set_property_string(m_decoder, "ao-pcm-file", pcmPathUtf8) < 0 ||
+        mpv_command(m_decoder, args) < 0)
+    {
+        qDebug() << "AudioEngine: Could not decode" << path;
+        return nullptr;
+    }
+
+    mpv_event *event = NULL;
+    do
+    {
+        event = mpv_wait_event(m_decoder, EVENT_TIMEOUT);
+        if (event->event_id == MPV_EVENT_NONE ||
+            event->event_id == MPV_EVENT_QUEUE_OVERFLOW)
+        {
+            qDebug() << "mpv returned a bad event" << event->event_id;
+            mpv_terminate_destroy(m_decoder);
+            m_decoder = nullptr;
+            return nullptr;
+        }
+    }
+    while (event->event_id != MPV_EVENT_END_FILE);
+
+    const mpv_event_end_file *endFile = (mpv_event_end_file *)event->data;
+    if (endFile->reason == MPV_END_FILE_REASON_ERROR)
+    {
+        qDebug() << "AudioEngine: Could not decode" << path;
+        return nullptr;
+    }
+    locker.unlock();
+
+    QSharedPointer<DecodedAudio> audio(new DecodedAudio);
+    QFile pcm(pcmPath);
+    if (!pcm.open(QIODevice::ReadOnly))
+    {
+        return nullptr;
+    }
+    audio->wav = pcm.readAll();
+    audio->modified = info.lastModified().toMSecsSinceEpoch();
+    if (!analyze(*audio))
+    {
+        qDebug() << "AudioEngine: Decoded invalid audio from" << path;
+        return nullptr;
+    }
+    return audio;
+}
+
+#undef EVENT_TIMEOUT
+
+/* Samples no louder than this are silence, about -54 dBFS */
+#define SILENCE_THRESHOLD 64
+
+/* The size of a RIFF chunk header */
+#define CHUNK_HEADER_SIZE 8
+
+bool AudioEngine::analyze(DecodedAudio &audio)
+{
+    const QByteArray &wav = audio.wav;
+    if (wav.size() < 12 ||
+        !wav.startsWith("RIFF") ||
+        wav.mid(8, 4) != "WAVE")
+    {
+        return false;
+    }
+
+    int blockAlign = 0;
+    const char *data = nullptr;
+    qint64 dataSize = 0;
+    for (qint64 pos = 12; pos + CHUNK_HEADER_SIZE <= wav.size(); )
+    {
+        const QByteArray id = wav.mid(pos, 4);
+        const qint64 size =
+            qFromLittleEndian<quint32>(wav.constData() + pos + 4);
+        const qint64 start = pos + CHUNK_HEADER_SIZE;
+        const qint64 available = std::min<qint64>(size, wav.size() - start);
+
+        if (id == "fmt " && available >= 16)
+        {
+            const int channels =
+                qFromLittleEndian<quint16>(wav.constData() + start + 2);
+            const int bits =
+                qFromLittleEndian<quint16>(wav.constData() + start + 14);
+            if (bits != 16 || channels <= 0)
+            {
+                return false;
+            }
+            blockAlign = channels * 2;
+        }
+        else if (id == "data")
+        {
+            data = wav.constData() + start;
+            dataSize = available;
+            break;
+        }
+
+        /* Chunks are padded to an even size */
+        pos = start + size + (size & 1);
+    }
+    if (blockAlign == 0 || data == nullptr)
+    {
+        return false;
+    }
+
+    audio.frames = dataSize / blockAlign;
+    dataSize = audio.frames * blockAlign;
+    audio.fingerprint = qHashBits(data, dataSize, audio.frames);
+    audio.silent = true;
+    for (qint64 i = 0; i + 1 < dataSize; i += 2)
+    {
+        const qint16 sample = qFromLittleEndian<qint16>(data + i);
+        if (sample > SILENCE_THRESHOLD || sample < -SILENCE_THRESHOLD)
+        {
+            audio.silent = false;
+            break;
+        }
+    }
+    return true;
+}
+
+#undef SILENCE_THRESHOLD
+#undef CHUNK_HEADER_SIZE
+
+/* End Decoding */
+/* Begin Cache */
+
+SharedDecodedAudio AudioEngine::find(const QString &path)
+{
+    const SharedDecodedAudio *audio = m_cache.object(path);
+    if (audio == nullptr)
+    {
+        return nullptr;
+    }
+    else if ((*audio)->modified !=
+             QFileInfo(path).lastModified().toMSecsSinceEpoch())
+    {
+        m_cache.remove(path);
+        return nullptr;
+    }
+    return *audio;
+}
+
+AudioEngineReply *AudioEngine::load(
+    const QString &path,
+    const Executor::Priority priority)
+{
+    AudioEngineReply *reply = m_pending.value(path);
+    if (reply)
+    {
+        return reply;
+    }
+
+    reply = new AudioEngineReply;
+
+    const SharedDecodedAudio audio = find(path);
+    if (audio)
+    {
+        QMetaObject::invokeMethod(
+            reply,
+            [=] {
+                Q_EMIT reply->finished(audio);
+                reply->deleteLater();
+            },
+            Qt::QueuedConnection
+        );
+        return reply;
+    }
+
+    m_pending.insert(path, reply);
+    {
+        QMutexLocker locker(&m_jobLock);
+        ++m_decodes;
+    }
+    Executor::run(
+        Executor::Queue::Audio,
+        [=] {
+            const SharedDecodedAudio decoded =
+                m_shutdown ? nullptr : decode(path);
+            QMetaObject::invokeMethod(
+                this,
+                [=] { finishLoad(path, decoded); },
+                Qt::QueuedConnection
+            );
+
+            /* The engine may be destroyed as soon as this is released */
+            QMutexLocker locker(&m_jobLock);
+            if (--m_decodes == 0)
+            {
+                m_decodesDone.wakeAll();
+            }
+        },
+        priority
+    );
+
+    return reply;
+}
+
+void AudioEngine::preload(const QString &path)
+{
+    if (path.isEmpty() || m_pending.contains(path) || find(path))
+    {
+        return;
+    }
+    load(path, Executor::Priority::Background);
+}
+
+void AudioEngine::finishLoad(
+    const QString &path,
+    const SharedDecodedAudio &audio)
+{
+    if (audio)
+    {
+        m_cache.insert(
+            path, new SharedDecodedAudio(audio), audio->wav.size() / 1024 + 1
+        );
+    }
+
+    AudioEngineReply *reply = m_pending.take(path);
+    if (reply)
+    {
+        Q_EMIT reply->finished(audio);
+        reply->deleteLater();
+    }
+}
+
+/* End Cache */
+/* Begin Playback */
+
+bool AudioEngine::isValid() const
+{
+    return m_player != nullptr;
+}
+
+bool AudioEngine::play(const SharedDecodedAudio &audio)
+{
+    if (!audio)
+    {
+        return false;
+    }
+
+    quint64 id = 0;
+    {
+        QMutexLocker locker(&m_streamLock);
+        id = ++m_streamId;
+
+        /* Anything older has been replaced and will never be opened */
+        m_streams.clear();
+        m_streams.insert(id, audio);
+    }
+    return playFile(STREAM_PROTOCOL "://" + QString::number(id));
+}
+
+bool AudioEngine::playFile(const QString &path)
+{
+    if (m_player == nullptr || path.isEmpty())
+    {
+        return false;
+    }
+
+    m_playTimer.start();
+    m_playTrace = Trace::now();
+
+    const QByteArray fileName = path.toUtf8();
+    const char *args[] = {
+        "loadfile",
+        fileName.constData(),
+        NULL
+    };
+    mpv_set_property_string(m_player, "pause", "no");
+    if (mpv_command(m_player, args) < 0)
+    {
+        m_playTimer.invalidate();
+        return false;
+    }
+    return true;
+}
+
+void AudioEngine::processEvents()
+{
+    while (m_player)
+    {
+        mpv_event *event = mpv_wait_event(m_player, 0);
+        if (event->event_id == MPV_EVENT_NONE)
+        {
+            break;
+        }
+        else if (event->event_id == MPV_EVENT_PLAYBACK_RESTART &&
+                 m_playTimer.isValid())
+        {
+            const qint64 latency = m_playTimer.nsecsElapsed() / 1000;
+            m_playTimer.invalidate();
+            Trace::addSpan("AudioEngine::startup", m_playTrace, Trace::now());
+            Q_EMIT started(latency);
+        }
+    }
+}
+
+/* End Playback */
+
+#undef AUDIO_FORMAT
+#undef AUDIO_SAMPLERATE
+#undef AUDIO_CHANNELS
+#undef STREAM_PROTOCOL
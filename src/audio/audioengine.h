@@ -0,0 +1,263 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef AUDIOENGINE_H
+#define AUDIOENGINE_H
+
+#include <QObject>
+
+#include <atomic>
+
+#include <QByteArray>
+#include <QCache>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QWaitCondition>
+
+#include "util/executor.h"
+
+struct mpv_handle;
+struct mpv_stream_cb_info;
+
+/**
+ * An audio clip decoded to 16-bit stereo PCM.
+ */
+struct DecodedAudio
+{
+    /* The clip as a WAV file. */
+    QByteArray wav;
+
+    /* The number of sample frames in the clip. */
+    qint64 frames = 0;
+
+    /* A hash of the samples. Clips with the same audio have the same
+     * fingerprint regardless of the format they were stored in. */
+    size_t fingerprint = 0;
+
+    /* true if no sample is louder than the silence threshold. */
+    bool silent = true;
+
+    /* The modification time of the source file in milliseconds since the
+     * epoch. Used to notice when the file changes. */
+    qint64 modified = 0;
+};
+
+typedef QSharedPointer<const DecodedAudio> SharedDecodedAudio;
+
+/**
+ * Returns asynchronous replies from the AudioEngine.
+ */
+class AudioEngineReply : public QObject
+{
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+
+Q_SIGNALS:
+    /**
+     * Emitted when a file has been decoded.
+     * @param audio The decoded audio. nullptr on error.
+     */
+    void finished(const SharedDecodedAudio &audio);
+};
+
+/**
+ * Decodes audio files to PCM and plays them with as little startup latency as
+ * possible.
+ * One long-lived mpv handle decodes files in the background with the pcm audio
+ * output, and recently played or preloaded clips are kept in a bounded cache.
+ * Another long-lived mpv handle plays clips straight from memory. Every clip is
+ * decoded to the same format so the audio output doesn't have to be reopened
+ * between clips.
+ * Must only be used from the thread it was created on.
+ */
+class AudioEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    /* The default maximum size of the decoded clips in bytes. */
+    static constexpr qint64 DEFAULT_CACHE_SIZE = 32 * 1024 * 1024;
+
+    /**
+     * Starts the engine.
+     * @param audioOutput The mpv audio output to play clips on. Empty for the
+     *                    default output.
+     * @param cacheSize   The maximum size of the decoded clips in bytes.
+     * @param parent      The parent of the engine.
+     */
+    AudioEngine(
+        const QString &audioOutput = QString(),
+        qint64 cacheSize = DEFAULT_CACHE_SIZE,
+        QObject *parent = nullptr);
+    ~AudioEngine();
+
+    /**
+     * Returns if the player could be started.
+     * @return true if audio can be played, false otherwise.
+     */
+    bool isValid() const;
+
+    /**
+     * Returns the decoded audio of a file if it is cached and the file hasn't
+     * changed since it was decoded.
+     * @param path The path of the file.
+     * @return The decoded audio. nullptr if it isn't cached.
+     */
+    SharedDecodedAudio find(const QString &path);
+
+    /**
+     * Decodes a file into the cache.
+     * @param path     The path of the file.
+     * @param priority The priority of the decode.
+     * @return A reply that emits finished() once the file is decoded. The
+     *         reply is shared with other callers of the same file and deletes
+     *         itself after finished() is emitted. finished() is never emitted
+     *         before this method returns.
+     */
+    AudioEngineReply *load(
+        const QString &path,
+        Executor::Priority priority = Executor::Priority::Interactive);
+
+    /**
+     * Decodes a file into the cache in the background. Does nothing if the
+     * file is already cached or being decoded.
+     * @param path The path of the file.
+     */
+    void preload(const QString &path);
+
+    /**
+     * Plays decoded audio from memory, replacing anything that is playing.
+     * @param audio The decoded audio.
+     * @return true if playback was started, false on error.
+     */
+    bool play(const SharedDecodedAudio &audio);
+
+    /**
+     * Plays a file without decoding it first, replacing anything that is
+     * playing.
+     * @param path The path of the file.
+     * @return true if playback was started, false on error.
+     */
+    bool playFile(const QString &path);
+
+Q_SIGNALS:
+    /**
+     * Emitted when audio starts playing.
+     * @param latency The number of microseconds between play() or playFile()
+     *                being called and the audio starting.
+     */
+    void started(qint64 latency);
+
+private Q_SLOTS:
+    /**
+     * Processes all pending events from the player.
+     */
+    void processEvents();
+
+private:
+    /**
+     * Decodes a file on the calling thread. Decodes run on the Audio queue,
+     * which only has one thread.
+     * @param path The path of the file.
+     * @return The decoded audio. nullptr on error.
+     */
+    SharedDecodedAudio decode(const QString &path);
+
+    /**
+     * Creates the decoder handle. Assumes m_decodeLock is held.
+     * @return true on success, false otherwise.
+     */
+    bool initDecoder();
+
+    /**
+     * Adds decoded audio to the cache and delivers it to the reply waiting
+     * on it.
+     * @param path  The path of the file.
+     * @param audio The decoded audio. nullptr on error.
+     */
+    void finishLoad(const QString &path, const SharedDecodedAudio &audio);
+
+    /**
+     * Fills in the frames, fingerprint and silence of decoded audio from its
+     * WAV data.
+     * @param audio The decoded audio.
+     * @return true if the WAV data could be read, false otherwise.
+     */
+    static bool analyze(DecodedAudio &audio);
+
+    /**
+     * Opens a stream of decoded audio for mpv. Called from an mpv thread.
+     * @param engine The engine the audio belongs to.
+     * @param uri    The URI of the stream.
+     * @param info   The callbacks of the stream to fill in.
+     * @return 0 on success, an mpv error code otherwise.
+     */
+    static int openStream(void *engine, char *uri, mpv_stream_cb_info *info);
+
+    /* The mpv handle clips are played on. */
+    mpv_handle *m_player = nullptr;
+
+    /* The mpv handle files are decoded on. Created on first use. */
+    mpv_handle *m_decoder = nullptr;
+
+    /* Protects m_decoder. */
+    QMutex m_decodeLock;
+
+    /* The number of decodes that have been queued and haven't finished. */
+    int m_decodes = 0;
+
+    /* true if the engine is being destroyed and queued decodes should be
+     * skipped. */
+    std::atomic<bool> m_shutdown{false};
+
+    /* Protects m_decodes. */
+    QMutex m_jobLock;
+
+    /* Signaled when m_decodes reaches zero. */
+    QWaitCondition m_decodesDone;
+
+    /* Maps file paths to their decoded audio. Costs are in KiB. */
+    QCache<QString, SharedDecodedAudio> m_cache;
+
+    /* Maps file paths being decoded to the reply shared by their callers. */
+    QHash<QString, AudioEngineReply *> m_pending;
+
+    /* Maps stream ids to the audio they play. */
+    QHash<quint64, SharedDecodedAudio> m_streams;
+
+    /* The id of the last stream. */
+    quint64 m_streamId = 0;
+
+    /* Protects m_streams. */
+    QMutex m_streamLock;
+
+    /* Started when playback was last requested. */
+    QElapsedTimer m_playTimer;
+
+    /* The trace timestamp playback was last requested at. */
+    qint64 m_playTrace = 0;
+};
+
+#endif // AUDIOENGINE_H
@@ -20,24 +20,29 @@
 
 #include "audioplayer.h"
 
-#include <mpv/client.h>
 #include <QCoreApplication>
-#include <QFileInfo>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
-#include <QThreadPool>
+#include <QUrl>
 #include <stdlib.h>
 
+#include "audiocache.h"
+
 #include "util/globalmediator.h"
 #include "util/utils.h"
 
+/* The maximum size of the audio cache in bytes */
+#define CACHE_SIZE (64 * 1024 * 1024)
+
 /* Begin Constructor/Destructor */
 
 AudioPlayer::AudioPlayer(QObject *parent) : QObject(parent)
 {
-    m_mpv = mpv_create();
-    if (!m_mpv)
+    m_engine = new AudioEngine(
+        QString(), AudioEngine::DEFAULT_CACHE_SIZE, this
+    );
+    if (!m_engine->isValid())
     {
         Q_EMIT GlobalMediator::getGlobalMediator()->showCritical(
             "Could not start mpv",
@@ -46,153 +51,200 @@ AudioPlayer::AudioPlayer(QObject *parent) : QObject(parent)
         QCoreApplication::exit(EXIT_FAILURE);
     }
 
-    mpv_set_option_string(m_mpv, "config",         "no");
-    mpv_set_option_string(m_mpv, "terminal",       "no");
-    mpv_set_option_string(m_mpv, "force-window",   "no");
-    mpv_set_option_string(m_mpv, "input-terminal", "no");
-    mpv_set_option_string(m_mpv, "cover-art-auto", "no");
-    mpv_set_option_string(m_mpv, "vid",            "no");
-
-    if (mpv_initialize(m_mpv) < 0)
-    {
-        Q_EMIT GlobalMediator::getGlobalMediator()->showCritical(
-            "Could not start mpv",
-            "AudioPlayer: Failed to initialize mpv context"
-        );
-        QCoreApplication::exit(EXIT_FAILURE);
-    }
-
     /* Initialize other values */
     m_manager = new QNetworkAccessManager;
+    m_cache = new AudioCache(DirectoryUtils::getAudioCacheDir(), CACHE_SIZE);
 }
 
 AudioPlayer::~AudioPlayer()
 {
-    mpv_terminate_destroy(m_mpv);
     delete m_manager;
-    clearFiles();
+    delete m_cache;
 }
 
-void AudioPlayer::clearFiles()
-{
-    m_fileLock.lock();
-    for (QTemporaryFile *file : m_files)
-    {
-        delete file;
-    }
-    m_files.clear();
-    m_fileLock.unlock();
-}
+#undef CACHE_SIZE
 
 /* End Constructor/Destructor */
 /* Begin Implementations */
 
-bool AudioPlayer::playFile(const QTemporaryFile *file)
+QNetworkReply *AudioPlayer::fetchAudio(const QString &url)
 {
-    if (file == nullptr)
-        return false;
-
-    QByteArray fileName = QFileInfo(*file).absoluteFilePath().toUtf8();
-    const char *args[3] = {
-        "loadfile",
-        fileName,
-        NULL
-    };
-
-    if (mpv_command(m_mpv, args) < 0)
+    QNetworkReply *reply = m_pending.value(url);
+    if (reply)
     {
-        return false;
+        return reply;
     }
 
-    return true;
-}
-
-AudioPlayerReply *AudioPlayer::playAudio(QString url, QString hash)
-{
-    /* Check if the file exists */
-    m_fileLock.lock();
-    QTemporaryFile *file = m_files[url];
-    if (file)
-    {
-        if (FileUtils::calculateMd5(file) != hash)
-        {
-            playFile(file);
-        }
-        m_fileLock.unlock();
-        return nullptr;
-    }
-    m_fileLock.unlock();
-
-    /* File does not exist so fetch it */
-    AudioPlayerReply *audioReply = new AudioPlayerReply;
     QNetworkRequest req{QUrl(url)};
     req.setAttribute(
         QNetworkRequest::RedirectPolicyAttribute,
         QNetworkRequest::UserVerifiedRedirectPolicy
     );
-    QNetworkReply *reply = m_manager->get(std::move(req));
+    reply = m_manager->get(std::move(req));
+    m_pending.insert(url, reply);
     connect(
         reply, &QNetworkReply::redirected,
         reply, &QNetworkReply::redirectAllowed
     );
-    connect(reply, &QNetworkReply::finished,  this,
-        [=] {
-            QTemporaryFile *file = nullptr;
-            bool res = false;
 
+    /* This must be the first connection to finished so the audio is cached
+     * before anyone waiting on the download is notified */
+    connect(reply, &QNetworkReply::finished, this,
+        [=] {
+            m_pending.remove(url);
             if (reply->error() != QNetworkReply::NetworkError::NoError)
             {
                 qDebug() << reply->errorString();
-                goto cleanup;
             }
-
-            if (!reply->open(QIODevice::ReadOnly))
+            else
             {
-                qDebug() << "Could not open audio reply";
-                goto cleanup;
+                m_cache->insert(url, reply->readAll());
             }
+            reply->deleteLater();
+        }
+    );
 
-            /* Put the audio in a new temp file */
-            file = new QTemporaryFile;
-            if (!file->open())
-            {
-                qDebug() << "Could not open temp file";
-                goto cleanup;
-            }
-            file->write(reply->readAll());
-            file->close();
+    return reply;
+}
 
-            /* Add the file to the cache */
-            m_fileLock.lock();
-            delete m_files[url];
-            m_files[url] = file;
+AudioPlayerReply *AudioPlayer::playAudio(QString url, QString hash)
+{
+    QString path;
+    QString md5;
+
+    /* Local files are played in place */
+    const QUrl qurl(url);
+    if (qurl.isLocalFile())
+    {
+        path = qurl.toLocalFile();
+    }
+    else
+    {
+        const AudioCache::Entry entry = m_cache->find(url);
+        path = entry.path;
+        md5 = entry.md5;
+    }
 
-            /* Check the hash */
-            if (FileUtils::calculateMd5(file) == hash)
+    /* Play audio that is already decoded right away */
+    if (!path.isEmpty())
+    {
+        const SharedDecodedAudio audio = m_engine->find(path);
+        if (audio)
+        {
+            if (!isSkipped(audio, md5, hash))
             {
-                m_fileLock.unlock();
-                goto cleanup;
+                m_engine->play(audio);
             }
+            return nullptr;
+        }
 
-            /* Play the file */
-            if (!playFile(file))
+        AudioPlayerReply *audioReply = new AudioPlayerReply;
+        playDecoded(path, md5, hash, audioReply);
+        return audioReply;
+    }
+
+    /* File does not exist so fetch it */
+    AudioPlayerReply *audioReply = new AudioPlayerReply;
+    QNetworkReply *reply = fetchAudio(url);
+    connect(reply, &QNetworkReply::finished, this,
+        [=] {
+            const AudioCache::Entry cached = m_cache->find(url);
+            if (cached.path.isEmpty())
             {
-                qDebug() << "Could not play audio file";
-                m_fileLock.unlock();
-                goto cleanup;
+                Q_EMIT audioReply->result(false);
+                audioReply->deleteLater();
+                return;
             }
+            playDecoded(cached.path, cached.md5, hash, audioReply);
+        }
+    );
 
-            m_fileLock.unlock();
+    return audioReply;
+}
 
-            res = true;
-        cleanup:
-            Q_EMIT audioReply->result(res);
+void AudioPlayer::playDecoded(
+    const QString &path,
+    const QString &md5,
+    const QString &hash,
+    AudioPlayerReply *reply)
+{
+    AudioEngineReply *engineReply = m_engine->load(path);
+    connect(engineReply, &AudioEngineReply::finished, this,
+        [=] (const SharedDecodedAudio &audio) {
+            bool res = false;
+            if (audio == nullptr)
+            {
+                /* Let mpv decode the file while playing it instead */
+                qDebug() << "Could not decode audio file" << path;
+                res = (md5.isEmpty() || md5 != hash) &&
+                    m_engine->playFile(path);
+            }
+            else if (!isSkipped(audio, md5, hash))
+            {
+                res = m_engine->play(audio);
+            }
+            Q_EMIT reply->result(res);
             reply->deleteLater();
-            audioReply->deleteLater();
         }
     );
+}
 
-    return audioReply;
+bool AudioPlayer::isSkipped(
+    const SharedDecodedAudio &audio,
+    const QString &md5,
+    const QString &hash)
+{
+    if (audio->silent)
+    {
+        return true;
+    }
+    else if (hash.isEmpty())
+    {
+        return false;
+    }
+    else if (!md5.isEmpty())
+    {
+        if (md5 != hash)
+        {
+            return false;
+        }
+
+        /* Remember the audio so copies in other formats are recognized */
+        m_skipFingerprints.insert(hash, audio->fingerprint);
+        return true;
+    }
+
+    auto it = m_skipFingerprints.constFind(hash);
+    return it != m_skipFingerprints.constEnd() && *it == audio->fingerprint;
+}
+
+void AudioPlayer::prefetchAudio(const QString &url)
+{
+    if (url.isEmpty() || m_pending.contains(url))
+    {
+        return;
+    }
+
+    const QUrl qurl(url);
+    if (qurl.isLocalFile())
+    {
+        m_engine->preload(qurl.toLocalFile());
+        return;
+    }
+
+    const AudioCache::Entry entry = m_cache->find(url);
+    if (!entry.path.isEmpty())
+    {
+        m_engine->preload(entry.path);
+        return;
+    }
+
+    QNetworkReply *reply = fetchAudio(url);
+    connect(reply, &QNetworkReply::finished, this,
+        [=] {
+            m_engine->preload(m_cache->find(url).path);
+        }
+    );
 }
 
 /* End Implementations */
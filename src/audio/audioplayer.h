@@ -24,11 +24,12 @@
 #include <QObject>
 
 #include <QHash>
-#include <QMutex>
-#include <QTemporaryFile>
 
-struct mpv_handle;
+#include "audioengine.h"
+
+class AudioCache;
 class QNetworkAccessManager;
+class QNetworkReply;
 
 /**
  * Returns an asynchronous replies from the AudioPlayer.
@@ -49,7 +50,10 @@ Q_SIGNALS:
 };
 
 /**
- * Plays audio files from over the network.
+ * Plays audio files from over the network or from local files. Downloaded
+ * files are kept in a persistent AudioCache so audio that has been played or
+ * prefetched before never has to be downloaded again, and are played through
+ * an AudioEngine that keeps them decoded in memory.
  */
 class AudioPlayer : public QObject
 {
@@ -58,41 +62,76 @@ public:
     AudioPlayer(QObject *parent = nullptr);
     ~AudioPlayer();
 
-    /**
-     * Clears all files in the cache.
-     */
-    void clearFiles();
-
     /**
      * Plays the audio at the URL.
+     * Silent clips are never played.
      * @param url  The url of the audio.
      * @param hash If the audio file matches this MD5, it is not played.
+     *             Local files are matched by their decoded audio against
+     *             downloaded files that matched the hash.
      * @return AnkiPlayerReply that emits the result() signal with true on
      *         success or false if the audio file could not be played/matches
      *         the hash. The caller does not own this object. Returns nullptr if
-     *         the file is already cached.
+     *         the file is already decoded.
      */
     AudioPlayerReply *playAudio(QString url, QString hash = QString());
 
+    /**
+     * Downloads and decodes the audio at the URL in the background without
+     * playing it. Does nothing if the audio is already decoded or downloading.
+     * @param url The url of the audio.
+     */
+    void prefetchAudio(const QString &url);
+
 private:
     /**
-     * Plays a file in mpv.
-     * @param file The file for mpv to play.
-     * @return true if it was played, false on error.
+     * Plays a file once it is decoded.
+     * @param path  The path of the file.
+     * @param md5   The MD5 of the file if it is known, empty otherwise.
+     * @param hash  If the audio file matches this MD5, it is not played.
+     * @param reply The reply to emit the result on.
      */
-    bool playFile(const QTemporaryFile *file);
+    void playDecoded(
+        const QString &path,
+        const QString &md5,
+        const QString &hash,
+        AudioPlayerReply *reply);
 
-    /* The mpv context. Used for playing audio. */
-    mpv_handle *m_mpv;
+    /**
+     * Returns if decoded audio should not be played.
+     * @param audio The decoded audio.
+     * @param md5   The MD5 of the file if it is known, empty otherwise.
+     * @param hash  The MD5 of files that should not be played.
+     * @return true if the audio should be skipped, false otherwise.
+     */
+    bool isSkipped(
+        const SharedDecodedAudio &audio,
+        const QString &md5,
+        const QString &hash);
+
+    /**
+     * Returns the download of the URL, starting one if there isn't one in
+     * progress. The audio is in the cache once the reply finishes.
+     * @param url The url of the audio.
+     * @return The reply of the download. Deleted after it finishes.
+     */
+    QNetworkReply *fetchAudio(const QString &url);
+
+    /* Decodes and plays audio. */
+    AudioEngine *m_engine;
 
     /* The network access manager used for fetching audio files. */
     QNetworkAccessManager *m_manager;
 
-    /* Maps urls to cached files. */
-    QHash<QString, QTemporaryFile *> m_files;
+    /* The cache of downloaded audio files. */
+    AudioCache *m_cache;
+
+    /* Maps urls to downloads that are in progress. */
+    QHash<QString, QNetworkReply *> m_pending;
 
-    /* Mutex that prevents the file cache from being modified concurrently. */
-    QMutex m_fileLock;
+    /* Maps skip hashes to the fingerprint of the decoded audio of a file that
+     * matched them. */
+    QHash<QString, size_t> m_skipFingerprints;
 };
 
 #endif // AUDIOPLAYER_H
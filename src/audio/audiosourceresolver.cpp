@@ -0,0 +1,238 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "audiosourceresolver.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QUrl>
+
+/* The number of milliseconds before a request is given up on */
+#define TRANSFER_TIMEOUT 5000
+
+/* The number of resolved lists kept */
+#define CACHE_SIZE 512
+
+/* The default number of milliseconds a resolved list is kept */
+#define CACHE_TTL (10 * 60 * 1000)
+
+/* Begin Constructor/Destructor */
+
+AudioSourceResolver::AudioSourceResolver(QObject *parent) :
+    QObject(parent),
+    m_cache(CACHE_SIZE),
+    m_cacheTtl(CACHE_TTL)
+{
+    m_manager = new QNetworkAccessManager(this);
+    m_manager->setTransferTimeout(TRANSFER_TIMEOUT);
+}
+
+AudioSourceResolver::~AudioSourceResolver()
+{
+    /* Callers holding on to a reply still expect a result */
+    for (AudioSourceResolverReply *reply : m_pending)
+    {
+        Q_EMIT reply->finished({});
+        reply->deleteLater();
+    }
+    m_pending.clear();
+}
+
+#undef TRANSFER_TIMEOUT
+#undef CACHE_SIZE
+#undef CACHE_TTL
+
+/* End Constructor/Destructor */
+/* Begin Resolving */
+
+void AudioSourceResolver::setCacheTtl(const qint64 msecs)
+{
+    m_cacheTtl = msecs;
+}
+
+/* The maximum number of concurrent requests to a single host */
+#define MAX_HOST_REQUESTS 4
+
+AudioSourceResolverReply *AudioSourceResolver::resolve(const QString &url)
+{
+    AudioSourceResolverReply *reply = m_pending.value(url);
+    if (reply)
+    {
+        return reply;
+    }
+
+    reply = new AudioSourceResolverReply;
+
+    const CacheEntry *entry = m_cache.object(url);
+    if (entry && entry->expires > QDateTime::currentMSecsSinceEpoch())
+    {
+        const QList<ResolvedAudioSource> sources = entry->sources;
+        QMetaObject::invokeMethod(
+            reply,
+            [=] {
+                Q_EMIT reply->finished(sources);
+                reply->deleteLater();
+            },
+            Qt::QueuedConnection
+        );
+        return reply;
+    }
+    else if (entry)
+    {
+        m_cache.remove(url);
+    }
+
+    m_pending.insert(url, reply);
+
+    Host &host = m_hosts[QUrl(url).host()];
+    if (host.active < MAX_HOST_REQUESTS)
+    {
+        ++host.active;
+        sendRequest(url);
+    }
+    else
+    {
+        host.queued << url;
+    }
+
+    return reply;
+}
+
+void AudioSourceResolver::sendRequest(const QString &url)
+{
+    QNetworkReply *reply = m_manager->get(QNetworkRequest(QUrl(url)));
+    connect(reply, &QNetworkReply::finished, this,
+        [=] {
+            QList<ResolvedAudioSource> sources;
+            if (reply->error() == QNetworkReply::NoError)
+            {
+                sources = parseJson(reply->readAll());
+                m_cache.insert(
+                    url,
+                    new CacheEntry{
+                        sources,
+                        QDateTime::currentMSecsSinceEpoch() + m_cacheTtl
+                    }
+                );
+            }
+            else
+            {
+                qDebug() << reply->errorString();
+            }
+            reply->deleteLater();
+
+            finishRequest(url, sources);
+        }
+    );
+}
+
+void AudioSourceResolver::finishRequest(
+    const QString &url,
+    const QList<ResolvedAudioSource> &sources)
+{
+    AudioSourceResolverReply *reply = m_pending.take(url);
+    if (reply)
+    {
+        Q_EMIT reply->finished(sources);
+        reply->deleteLater();
+    }
+
+    const QString hostName = QUrl(url).host();
+    auto it = m_hosts.find(hostName);
+    if (it == m_hosts.end())
+    {
+        return;
+    }
+    if (it->queued.isEmpty())
+    {
+        if (--it->active == 0)
+        {
+            m_hosts.erase(it);
+        }
+        return;
+    }
+    sendRequest(it->queued.takeFirst());
+}
+
+#undef MAX_HOST_REQUESTS
+
+/* End Resolving */
+/* Begin Helpers */
+
+#define JSON_KEY_TYPE               "type"
+#define JSON_VALUE_TYPE             "audioSourceList"
+#define JSON_KEY_AUDIO_SOURCES      "audioSources"
+#define JSON_KEY_AUDIO_SOURCES_NAME "name"
+#define JSON_KEY_AUDIO_SOURCES_URL  "url"
+
+QList<ResolvedAudioSource> AudioSourceResolver::parseJson(
+    const QByteArray &data)
+{
+    QList<ResolvedAudioSource> sources;
+
+    QJsonDocument doc = QJsonDocument::fromJson(data);
+    if (!doc.isObject())
+    {
+        return sources;
+    }
+    QJsonObject obj = doc.object();
+    if (obj[JSON_KEY_TYPE].toString() != JSON_VALUE_TYPE)
+    {
+        return sources;
+    }
+    if (!obj[JSON_KEY_AUDIO_SOURCES].isArray())
+    {
+        return sources;
+    }
+    for (const QJsonValue &val : obj[JSON_KEY_AUDIO_SOURCES].toArray())
+    {
+        if (!val.isObject())
+        {
+            continue;
+        }
+        QJsonObject srcObj = val.toObject();
+        if (!srcObj[JSON_KEY_AUDIO_SOURCES_NAME].isString() ||
+            !srcObj[JSON_KEY_AUDIO_SOURCES_URL].isString())
+        {
+            continue;
+        }
+
+        sources.append({
+            srcObj[JSON_KEY_AUDIO_SOURCES_NAME].toString(),
+            srcObj[JSON_KEY_AUDIO_SOURCES_URL].toString()
+        });
+    }
+
+    return sources;
+}
+
+#undef JSON_KEY_TYPE
+#undef JSON_VALUE_TYPE
+#undef JSON_KEY_AUDIO_SOURCES
+#undef JSON_KEY_AUDIO_SOURCES_NAME
+#undef JSON_KEY_AUDIO_SOURCES_URL
+
+/* End Helpers */
@@ -0,0 +1,158 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef AUDIOSOURCERESOLVER_H
+#define AUDIOSOURCERESOLVER_H
+
+#include <QObject>
+
+#include <QCache>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+class QNetworkAccessManager;
+
+/**
+ * An audio file listed by a JSON audio source.
+ */
+struct ResolvedAudioSource
+{
+    /* The name of the audio file. */
+    QString name;
+
+    /* The URL of the audio file. */
+    QString url;
+};
+
+/**
+ * Returns asynchronous replies from the AudioSourceResolver.
+ */
+class AudioSourceResolverReply : public QObject
+{
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+
+Q_SIGNALS:
+    /**
+     * Emitted when the JSON audio source has been resolved.
+     * @param sources The audio files listed by the source. Empty on error.
+     */
+    void finished(const QList<ResolvedAudioSource> &sources);
+};
+
+/**
+ * Resolves JSON audio sources into the audio files they list. One network
+ * manager is shared by every caller, requests for a URL that is already being
+ * resolved are merged into the existing request, and resolved lists are cached
+ * for a while so hovering over the same word again doesn't hit the network.
+ * The number of concurrent requests to a single host is limited.
+ * Must only be used from the thread it was created on.
+ */
+class AudioSourceResolver : public QObject
+{
+    Q_OBJECT
+
+public:
+    AudioSourceResolver(QObject *parent = nullptr);
+    ~AudioSourceResolver();
+
+    /**
+     * Resolves a JSON audio source.
+     * @param url The URL of the source with the expression and reading filled
+     *            in.
+     * @return A reply that emits finished() once the source is resolved. The
+     *         reply is shared with other callers of the same URL and deletes
+     *         itself after finished() is emitted. finished() is never emitted
+     *         before this method returns.
+     */
+    AudioSourceResolverReply *resolve(const QString &url);
+
+    /**
+     * Sets how long resolved lists are cached for. Only affects lists resolved
+     * after this call.
+     * @param msecs The number of milliseconds a resolved list is kept.
+     */
+    void setCacheTtl(qint64 msecs);
+
+private:
+    /* The resolved list of a source. */
+    struct CacheEntry
+    {
+        /* The audio files listed by the source. */
+        QList<ResolvedAudioSource> sources;
+
+        /* The time the entry expires in milliseconds since the epoch. */
+        qint64 expires;
+    };
+
+    /* The requests to a single host. */
+    struct Host
+    {
+        /* The number of requests currently being sent. */
+        int active = 0;
+
+        /* URLs waiting for a free request slot. */
+        QStringList queued;
+    };
+
+    /**
+     * Sends the request for a URL.
+     * @param url The URL of the source.
+     */
+    void sendRequest(const QString &url);
+
+    /**
+     * Delivers the result of a URL to its reply and starts the next request
+     * queued for the host.
+     * @param url     The URL of the source.
+     * @param sources The audio files listed by the source.
+     */
+    void finishRequest(
+        const QString &url,
+        const QList<ResolvedAudioSource> &sources);
+
+    /**
+     * Processes raw JSON into a list of audio files.
+     * @param data The raw JSON.
+     * @return The audio files listed in the JSON.
+     */
+    static QList<ResolvedAudioSource> parseJson(const QByteArray &data);
+
+    /* The network access manager shared by every request. */
+    QNetworkAccessManager *m_manager;
+
+    /* Maps URLs to their resolved lists. */
+    QCache<QString, CacheEntry> m_cache;
+
+    /* The number of milliseconds a resolved list is kept. */
+    qint64 m_cacheTtl;
+
+    /* Maps URLs being resolved to the reply shared by their callers. */
+    QHash<QString, AudioSourceResolverReply *> m_pending;
+
+    /* Maps host names to their requests. */
+    QHash<QString, Host> m_hosts;
+};
+
+#endif // AUDIOSOURCERESOLVER_H
@@ -0,0 +1,450 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "localaudiolibrary.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutexLocker>
+#include <QSettings>
+#include <QUrl>
+
+#include "util/constants.h"
+#include "util/executor.h"
+#include "util/globalmediator.h"
+#include "util/trace.h"
+
+#define QUERY_CREATE_TABLE \
+    "CREATE TABLE IF NOT EXISTS files (" \
+        "root       TEXT    NOT NULL," \
+        "path       TEXT    NOT NULL," \
+        "dir        TEXT    NOT NULL," \
+        "expression TEXT    NOT NULL," \
+        "reading    TEXT    NOT NULL," \
+        "mtime      INTEGER NOT NULL," \
+        "PRIMARY KEY (root, path)" \
+    ");"
+#define QUERY_CREATE_INDEX \
+    "CREATE INDEX IF NOT EXISTS idx_files_expression " \
+        "ON files (root, expression);"
+
+/* Files matching the reading come first, then files with no reading */
+#define QUERY_FIND \
+    "SELECT path, dir FROM files " \
+        "WHERE root = ? AND expression = ? AND (reading = ? OR reading = '') " \
+        "ORDER BY reading = '', dir, path;"
+
+/* Begin Constructor/Destructor */
+
+LocalAudioLibrary::LocalAudioLibrary(const QString &path, QObject *parent) :
+    QObject(parent)
+{
+    if (sqlite3_open_v2(
+            path.toUtf8(),
+            &m_db,
+            SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX,
+            NULL
+        ) != SQLITE_OK)
+    {
+        qDebug() << "Could not open local audio index" << path;
+        sqlite3_close(m_db);
+        m_db = nullptr;
+        return;
+    }
+
+    exec("PRAGMA synchronous = NORMAL;");
+    if (!exec(QUERY_CREATE_TABLE) || !exec(QUERY_CREATE_INDEX))
+    {
+        sqlite3_close(m_db);
+        m_db = nullptr;
+        return;
+    }
+    if (sqlite3_prepare_v2(m_db, QUERY_FIND, -1, &m_findStmt, NULL) !=
+            SQLITE_OK)
+    {
+        qDebug() << "Could not prepare local audio query"
+                 << sqlite3_errmsg(m_db);
+        m_findStmt = nullptr;
+    }
+
+    connect(
+        GlobalMediator::getGlobalMediator(),
+        &GlobalMediator::audioSourceSettingsChanged,
+        this, &LocalAudioLibrary::scanSources,
+        Qt::QueuedConnection
+    );
+    scanSources();
+}
+
+#undef QUERY_CREATE_TABLE
+#undef QUERY_CREATE_INDEX
+#undef QUERY_FIND
+
+LocalAudioLibrary::~LocalAudioLibrary()
+{
+    {
+        QMutexLocker locker(&m_scanLock);
+        m_shutdown = true;
+        while (m_scanning)
+        {
+            m_scanDone.wait(&m_scanLock);
+        }
+    }
+
+    sqlite3_finalize(m_findStmt);
+    sqlite3_close(m_db);
+}
+
+/* End Constructor/Destructor */
+/* Begin Lookups */
+
+QList<ResolvedAudioSource> LocalAudioLibrary::find(
+    const QStringList &roots,
+    const QString &expression,
+    const QString &reading)
+{
+    QList<ResolvedAudioSource> sources;
+
+    QMutexLocker locker(&m_findLock);
+    if (m_findStmt == nullptr)
+    {
+        return sources;
+    }
+
+    const QByteArray expressionUtf8 = expression.toUtf8();
+    const QByteArray readingUtf8 = reading.toUtf8();
+    for (const QString &root : roots)
+    {
+        const QByteArray rootUtf8 = root.toUtf8();
+        sqlite3_bind_text(m_findStmt, 1, rootUtf8, -1, SQLITE_STATIC);
+        sqlite3_bind_text(m_findStmt, 2, expressionUtf8, -1, SQLITE_STATIC);
+        sqlite3_bind_text(m_findStmt, 3, readingUtf8, -1, SQLITE_STATIC);
+        while (sqlite3_step(m_findStmt) == SQLITE_ROW)
+        {
+            const QString path = QString::fromUtf8(
+                (const char *)sqlite3_column_text(m_findStmt, 0)
+            );
+            QString name = QString::fromUtf8(
+                (const char *)sqlite3_column_text(m_findStmt, 1)
+            );
+            if (name.isEmpty())
+            {
+                name = QFileInfo(path).completeBaseName();
+            }
+            sources.append({name, QUrl::fromLocalFile(path).toString()});
+        }
+        sqlite3_reset(m_findStmt);
+    }
+    sqlite3_clear_bindings(m_findStmt);
+
+    return sources;
+}
+
+QStringList LocalAudioLibrary::splitRoots(const QString &url)
+{
+    QStringList roots;
+    const QStringList parts = url.split(';', Qt::SkipEmptyParts);
+    for (const QString &part : parts)
+    {
+        const QString root = part.trimmed();
+        if (!root.isEmpty())
+        {
+            roots << QDir::cleanPath(root);
+        }
+    }
+    return roots;
+}
+
+/* End Lookups */
+/* Begin Scanning */
+
+void LocalAudioLibrary::scanSources()
+{
+    if (m_db == nullptr)
+    {
+        return;
+    }
+
+    QStringList roots;
+    QSettings settings;
+    const int size =
+        settings.beginReadArray(Constants::Settings::AudioSource::GROUP);
+    for (int i = 0; i < size; ++i)
+    {
+        settings.setArrayIndex(i);
+        const Constants::AudioSourceType type =
+            static_cast<Constants::AudioSourceType>(settings.value(
+                Constants::Settings::AudioSource::TYPE,
+                static_cast<int>(
+                    Constants::Settings::AudioSource::TYPE_DEFAULT
+                )
+            ).toInt());
+        if (type != Constants::AudioSourceType::Local)
+        {
+            continue;
+        }
+        roots << splitRoots(settings.value(
+            Constants::Settings::AudioSource::URL,
+            Constants::Settings::AudioSource::URL_DEFAULT
+        ).toString());
+    }
+    settings.endArray();
+    roots.removeDuplicates();
+
+    QMutexLocker locker(&m_scanLock);
+    m_roots = roots;
+    if (m_scanning)
+    {
+        m_rescan = true;
+        return;
+    }
+    m_scanning = true;
+
+    Executor::run(
+        Executor::Queue::Library,
+        [this] {
+            QMutexLocker locker(&m_scanLock);
+            while (!m_shutdown)
+            {
+                const QStringList roots = m_roots;
+                m_rescan = false;
+
+                locker.unlock();
+                scan(roots);
+                locker.relock();
+
+                if (!m_rescan)
+                {
+                    break;
+                }
+            }
+            m_scanning = false;
+            m_scanDone.wakeAll();
+        },
+        Executor::Priority::Background
+    );
+}
+
+#define QUERY_ROOTS         "SELECT DISTINCT root FROM files;"
+#define QUERY_DELETE_ROOT   "DELETE FROM files WHERE root = ?;"
+
+void LocalAudioLibrary::scan(const QStringList &roots)
+{
+    TraceSpan span("LocalAudioLibrary::scan");
+
+    if (!exec("BEGIN TRANSACTION;"))
+    {
+        return;
+    }
+
+    /* Forget directories that are no longer part of a source */
+    QStringList removed;
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(m_db, QUERY_ROOTS, -1, &stmt, NULL) == SQLITE_OK)
+    {
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            const QString root =
+                QString::fromUtf8((const char *)sqlite3_column_text(stmt, 0));
+            if (!roots.contains(root))
+            {
+                removed << root;
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+    if (sqlite3_prepare_v2(m_db, QUERY_DELETE_ROOT, -1, &stmt, NULL) ==
+            SQLITE_OK)
+    {
+        for (const QString &root : removed)
+        {
+            const QByteArray rootUtf8 = root.toUtf8();
+            sqlite3_bind_text(stmt, 1, rootUtf8, -1, SQLITE_STATIC);
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    for (const QString &root : roots)
+    {
+        if (m_shutdown)
+        {
+            break;
+        }
+        scanRoot(root);
+    }
+
+    exec("COMMIT;");
+}
+
+#undef QUERY_ROOTS
+#undef QUERY_DELETE_ROOT
+
+#define QUERY_FILES     "SELECT path, mtime FROM files WHERE root = ?;"
+#define QUERY_INSERT \
+    "INSERT OR REPLACE INTO files " \
+        "(root, path, dir, expression, reading, mtime) " \
+        "VALUES (?, ?, ?, ?, ?, ?);"
+#define QUERY_DELETE    "DELETE FROM files WHERE root = ? AND path = ?;"
+
+/* Separates the reading from the expression in file names */
+#define NAME_SEPARATOR  " - "
+
+int LocalAudioLibrary::scanRoot(const QString &root)
+{
+    TraceSpan span("LocalAudioLibrary::scanRoot", root);
+
+    const QByteArray rootUtf8 = root.toUtf8();
+    int changed = 0;
+
+    /* Get the modification times of everything already indexed */
+    QHash<QString, qint64> indexed;
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(m_db, QUERY_FILES, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        return changed;
+    }
+    sqlite3_bind_text(stmt, 1, rootUtf8, -1, SQLITE_STATIC);
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        indexed.insert(
+            QString::fromUtf8((const char *)sqlite3_column_text(stmt, 0)),
+            sqlite3_column_int64(stmt, 1)
+        );
+    }
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+
+    /* Add new and modified files */
+    if (sqlite3_prepare_v2(m_db, QUERY_INSERT, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        return changed;
+    }
+    const QDir rootDir(root);
+    QDirIterator it(
+        root,
+        {"*.mp3", "*.opus", "*.ogg", "*.oga", "*.m4a", "*.aac", "*.wav",
+         "*.flac"},
+        QDir::Files,
+        QDirIterator::Subdirectories
+    );
+    while (it.hasNext() && !m_shutdown)
+    {
+        const QString path = it.next();
+        const QFileInfo info = it.fileInfo();
+        const qint64 mtime = info.lastModified().toMSecsSinceEpoch();
+
+        auto indexedIt = indexed.find(path);
+        if (indexedIt != indexed.end())
+        {
+            const bool unchanged = indexedIt.value() == mtime;
+            indexed.erase(indexedIt);
+            if (unchanged)
+            {
+                continue;
+            }
+        }
+
+        const QString name = info.completeBaseName();
+        QString expression = name;
+        QString reading;
+        const int sep = name.indexOf(NAME_SEPARATOR);
+        if (sep > 0)
+        {
+            reading = name.left(sep).trimmed();
+            expression = name.mid(sep + sizeof(NAME_SEPARATOR) - 1).trimmed();
+        }
+        QString dir = rootDir.relativeFilePath(info.path());
+        if (dir == ".")
+        {
+            dir.clear();
+        }
+
+        const QByteArray pathUtf8 = path.toUtf8();
+        const QByteArray dirUtf8 = dir.toUtf8();
+        const QByteArray expressionUtf8 = expression.toUtf8();
+        const QByteArray readingUtf8 = reading.toUtf8();
+        sqlite3_bind_text(stmt, 1, rootUtf8, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, pathUtf8, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, dirUtf8, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 4, expressionUtf8, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 5, readingUtf8, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 6, mtime);
+        if (sqlite3_step(stmt) == SQLITE_DONE)
+        {
+            ++changed;
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+
+    /* Remove files that no longer exist. A stopped scan hasn't seen every
+     * file, so it can't tell what was removed. */
+    if (m_shutdown ||
+        indexed.isEmpty() ||
+        sqlite3_prepare_v2(m_db, QUERY_DELETE, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        return changed;
+    }
+    for (auto it = indexed.constBegin(); it != indexed.constEnd(); ++it)
+    {
+        const QByteArray pathUtf8 = it.key().toUtf8();
+        sqlite3_bind_text(stmt, 1, rootUtf8, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, pathUtf8, -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_DONE)
+        {
+            ++changed;
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    return changed;
+}
+
+#undef QUERY_FILES
+#undef QUERY_INSERT
+#undef QUERY_DELETE
+
+#undef NAME_SEPARATOR
+
+/* End Scanning */
+/* Begin Helpers */
+
+bool LocalAudioLibrary::exec(const char *sql)
+{
+    char *error = nullptr;
+    if (sqlite3_exec(m_db, sql, NULL, NULL, &error) != SQLITE_OK)
+    {
+        qDebug() << "Local audio index error:" << error;
+        sqlite3_free(error);
+        return false;
+    }
+    return true;
+}
+
+/* End Helpers */
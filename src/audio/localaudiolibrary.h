@@ -0,0 +1,136 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LOCALAUDIOLIBRARY_H
+#define LOCALAUDIOLIBRARY_H
+
+#include <QObject>
+
+#include <atomic>
+
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QWaitCondition>
+#include <sqlite3.h>
+
+#include "audiosourceresolver.h"
+
+/**
+ * An index of audio files in local directories that can be searched by
+ * expression and reading without touching the network.
+ * Files are indexed by name. Names of the form "reading - expression" are
+ * indexed by both, all other names are indexed as the expression alone.
+ * Directories are rescanned in the background when the library is created and
+ * when the audio source settings change. Only files with a modification time
+ * that differs from the index are re-read.
+ * All methods are thread-safe.
+ */
+class LocalAudioLibrary : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Opens the index, creating it if it doesn't exist.
+     * @param path   The path to the index database.
+     * @param parent The parent of the library.
+     */
+    LocalAudioLibrary(const QString &path, QObject *parent = nullptr);
+    ~LocalAudioLibrary();
+
+    /**
+     * Finds the audio files for a term in a local audio source.
+     * @param roots      The directories of the source.
+     * @param expression The expression of the term.
+     * @param reading    The reading of the term. Can be empty.
+     * @return The audio files with file URLs. Files that match the reading come
+     *         before files that only match the expression.
+     */
+    QList<ResolvedAudioSource> find(
+        const QStringList &roots,
+        const QString &expression,
+        const QString &reading);
+
+    /**
+     * Splits the URL field of a local audio source into its directories.
+     * @param url The URL field of the source.
+     * @return The directories of the source.
+     */
+    static QStringList splitRoots(const QString &url);
+
+private Q_SLOTS:
+    /**
+     * Rescans the directories of every local audio source in the background.
+     */
+    void scanSources();
+
+private:
+    /**
+     * Brings the index up to date with the directories. Removes directories
+     * from the index that aren't in the list.
+     * @param roots Every directory that should be indexed.
+     */
+    void scan(const QStringList &roots);
+
+    /**
+     * Brings the index of a single directory up to date. Assumes a transaction
+     * is open.
+     * @param root The directory to index.
+     * @return The number of files that were added or updated.
+     */
+    int scanRoot(const QString &root);
+
+    /**
+     * Executes a statement that doesn't return rows.
+     * @param sql The statement to execute.
+     * @return true on success, false otherwise.
+     */
+    bool exec(const char *sql);
+
+    /* The index database. */
+    sqlite3 *m_db = nullptr;
+
+    /* The prepared statement used by find(). Protected by m_findLock. */
+    sqlite3_stmt *m_findStmt = nullptr;
+
+    /* Protects m_findStmt. */
+    QMutex m_findLock;
+
+    /* The directories the next scan should index. */
+    QStringList m_roots;
+
+    /* true while a scan is queued or running. */
+    bool m_scanning = false;
+
+    /* true if the directories changed while a scan was running. */
+    bool m_rescan = false;
+
+    /* true when the library is being destroyed. Stops running scans. */
+    std::atomic<bool> m_shutdown{false};
+
+    /* Protects m_roots, m_scanning and m_rescan. */
+    QMutex m_scanLock;
+
+    /* Signaled when a scan finishes. */
+    QWaitCondition m_scanDone;
+};
+
+#endif // LOCALAUDIOLIBRARY_H
@@ -29,6 +29,7 @@
 
 #include "yomidbbuilder.h"
 
+#include "util/trace.h"
 #include "util/utils.h"
 
 /* Begin Constructor/Destructor */
@@ -59,23 +60,6 @@ DatabaseManager::DatabaseManager(const QString &path)
         qDebug() << "Could not open dictionary database";
     }
 
-    m_moraSkipChar << "ぁ"
-                   << "ぃ"
-                   << "ぅ"
-                   << "ぇ"
-                   << "ぉ"
-                   << "ゃ"
-                   << "ゅ"
-                   << "ょ"
-                   << "ァ"
-                   << "ィ"
-                   << "ゥ"
-                   << "ェ"
-                   << "ォ"
-                   << "ャ"
-                   << "ュ"
-                   << "ョ";
-
     initCache();
 }
 
@@ -304,6 +288,8 @@ cleanup:
 
 QString DatabaseManager::queryTerms(const QString &query, QList<SharedTerm> &terms) const
 {
+    TraceSpan span("DatabaseManager::queryTerms", query);
+
     if (m_db == nullptr)
     {
         return "Database is invalid";
@@ -424,6 +410,161 @@ error:
 #undef COLUMN_EXPRESSION
 #undef COLUMN_READING
 
+/* The raw, full-width, and hiragana spellings of the query are bound to ?1-?3.
+ * They are the same for queries without katakana, so one statement covers
+ * every query. */
+#define QUERY_WHERE         "WHERE (expression IN (?1, ?2, ?3) OR " \
+                                   "reading IN (?1, ?2, ?3)) AND " \
+                                  "dic_id NOT IN (SELECT dic_id FROM dict_disabled)"
+#define QUERY_EXISTS        "SELECT EXISTS(SELECT 1 FROM term_bank " QUERY_WHERE ");"
+#define QUERY_FREQUENCIES   "SELECT DISTINCT expression, reading FROM term_bank " \
+                                QUERY_WHERE ";"
+
+#define QUERY_RAW_IDX       1
+#define QUERY_HALF_IDX      2
+#define QUERY_KATA_IDX      3
+
+#define COLUMN_EXISTS       0
+#define COLUMN_EXPRESSION   0
+#define COLUMN_READING      1
+
+/**
+ * Binds the spellings of a query to a statement using QUERY_WHERE.
+ * @param stmt     The statement to bind to.
+ * @param raw      The query as it was written.
+ * @param katakana The query with half-width katakana made full-width.
+ * @param hiragana The query with all katakana converted to hiragana.
+ * @return true on success, false otherwise.
+ */
+static bool bindTermSpellings(
+    sqlite3_stmt *stmt,
+    const QByteArray &raw,
+    const QByteArray &katakana,
+    const QByteArray &hiragana)
+{
+    return
+        sqlite3_bind_text(stmt, QUERY_RAW_IDX,  raw,      -1, NULL) == SQLITE_OK &&
+        sqlite3_bind_text(stmt, QUERY_HALF_IDX, katakana, -1, NULL) == SQLITE_OK &&
+        sqlite3_bind_text(stmt, QUERY_KATA_IDX, hiragana, -1, NULL) == SQLITE_OK;
+}
+
+QString DatabaseManager::termExists(const QString &query, bool &exists) const
+{
+    exists = false;
+    if (m_db == nullptr)
+    {
+        return "Database is invalid";
+    }
+
+    /* Try to acquire the database lock, early return if we can't */
+    if (!m_dbLock.tryLockForRead())
+    {
+        return "";
+    }
+
+    QString       ret;
+    QString       full     = halfToFull(query);
+    QByteArray    raw      = query.toUtf8();
+    QByteArray    katakana = full.toUtf8();
+    QByteArray    hiragana = kataToHira(full).toUtf8();
+    sqlite3_stmt *stmt     = NULL;
+    int           step     = 0;
+
+    if (sqlite3_prepare_v2(m_db, QUERY_EXISTS, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        ret = "Could not prepare database query";
+        goto cleanup;
+    }
+    if (!bindTermSpellings(stmt, raw, katakana, hiragana))
+    {
+        ret = "Could not bind values to statement";
+        goto cleanup;
+    }
+    step = sqlite3_step(stmt);
+    if (step == SQLITE_ROW)
+    {
+        exists = sqlite3_column_int(stmt, COLUMN_EXISTS) != 0;
+    }
+    else if (isStepError(step))
+    {
+        ret = "Error when executing sqlite query. Code " + QString::number(step);
+    }
+
+cleanup:
+    sqlite3_finalize(stmt);
+    m_dbLock.unlock();
+
+    return ret;
+}
+
+QString DatabaseManager::queryTermFrequencies(
+    const QString &query,
+    QList<Frequency> &frequencies) const
+{
+    if (m_db == nullptr)
+    {
+        return "Database is invalid";
+    }
+
+    /* Try to acquire the database lock, early return if we can't */
+    if (!m_dbLock.tryLockForRead())
+    {
+        return "";
+    }
+
+    QString       ret;
+    QString       full     = halfToFull(query);
+    QByteArray    raw      = query.toUtf8();
+    QByteArray    katakana = full.toUtf8();
+    QByteArray    hiragana = kataToHira(full).toUtf8();
+    sqlite3_stmt *stmt     = NULL;
+    int           step     = 0;
+
+    if (sqlite3_prepare_v2(m_db, QUERY_FREQUENCIES, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        ret = "Could not prepare database query";
+        goto cleanup;
+    }
+    if (!bindTermSpellings(stmt, raw, katakana, hiragana))
+    {
+        ret = "Could not bind values to statement";
+        goto cleanup;
+    }
+    while ((step = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        Term term;
+        term.expression = (const char *)sqlite3_column_text(stmt, COLUMN_EXPRESSION);
+        term.reading    = (const char *)sqlite3_column_text(stmt, COLUMN_READING);
+        if (addFrequencies(term))
+        {
+            qDebug() << "Could not add frequencies for" << term.expression;
+        }
+        frequencies.append(term.frequencies);
+    }
+    if (isStepError(step))
+    {
+        ret = "Error when executing sqlite query. Code " + QString::number(step);
+    }
+
+cleanup:
+    sqlite3_finalize(stmt);
+    m_dbLock.unlock();
+
+    return ret;
+}
+
+#undef QUERY_WHERE
+#undef QUERY_EXISTS
+#undef QUERY_FREQUENCIES
+
+#undef QUERY_RAW_IDX
+#undef QUERY_HALF_IDX
+#undef QUERY_KATA_IDX
+
+#undef COLUMN_EXISTS
+#undef COLUMN_EXPRESSION
+#undef COLUMN_READING
+
 #define QUERY   "SELECT dic_id, onyomi, kunyomi, tags, meanings, stats FROM kanji_bank "\
                     "WHERE dic_id NOT IN (SELECT dic_id FROM dict_disabled) AND (char = ?);"
 
@@ -441,6 +582,8 @@ error:
 
 QString DatabaseManager::queryKanji(const QString &query, Kanji &kanji) const
 {
+    TraceSpan span("DatabaseManager::queryKanji", query);
+
     if (m_db == nullptr)
     {
         return "Database is invalid";
@@ -556,7 +699,8 @@ cleanup:
 /* End Database Getters */
 /* Begin Query Helpers */
 
-#define QUERY   "SELECT dic_id, score, def_tags, glossary, rules, term_tags "\
+#define QUERY   "SELECT dic_id, score, def_tags, glossary, rules, term_tags, "\
+                        "rowid "\
                     "FROM term_bank "\
                     "WHERE dic_id NOT IN (SELECT dic_id FROM dict_disabled) AND " \
                         "(expression = ? AND reading = ?);"
@@ -570,9 +714,12 @@ cleanup:
 #define COLUMN_GLOSSARY     3
 #define COLUMN_RULES        4
 #define COLUMN_TERM_TAGS    5
+#define COLUMN_ROWID        6
 
 int DatabaseManager::populateTerms(const QList<SharedTerm> &terms) const
 {
+    TraceSpan span("DatabaseManager::populateTerms");
+
     int           ret     = 0;
     sqlite3_stmt *stmt    = NULL;
     int           step    = 0;
@@ -608,6 +755,7 @@ int DatabaseManager::populateTerms(const QList<SharedTerm> &terms) const
             );
 
             TermDefinition def;
+            def.id = sqlite3_column_int64(stmt, COLUMN_ROWID);
             def.dictionary = getDictionary(id);
             def.glossary = QJsonDocument::fromJson(
                 (const char *)sqlite3_column_text(stmt, COLUMN_GLOSSARY)
@@ -652,6 +800,7 @@ cleanup:
 #undef COLUMN_GLOSSARY
 #undef COLUMN_RULES
 #undef COLUMN_TERM_TAGS
+#undef COLUMN_ROWID
 
 QString DatabaseManager::getDictionary(const uint64_t id) const
 {
@@ -681,6 +830,7 @@ void DatabaseManager::addTags(const uint64_t  id,
 
 int DatabaseManager::addFrequencies(Term &term) const
 {
+    TraceSpan span("DatabaseManager::addFrequencies", term.expression);
     return addFrequencies(
         QUERY, term.expression, term.frequencies, term.reading
     );
@@ -799,6 +949,38 @@ cleanup:
 #undef OBJ_VALUE_KEY
 #undef OBJ_DISPLAY_KEY
 
+/**
+ * Returns if a character can't be a mora on its own, such as the small kana
+ * that form yoon.
+ * @param ch The character to check.
+ * @return true if the character belongs to the previous mora, false otherwise.
+ */
+static inline bool isMoraSkipChar(const QChar ch)
+{
+    switch (ch.unicode())
+    {
+    case u'ぁ':
+    case u'ぃ':
+    case u'ぅ':
+    case u'ぇ':
+    case u'ぉ':
+    case u'ゃ':
+    case u'ゅ':
+    case u'ょ':
+    case u'ァ':
+    case u'ィ':
+    case u'ゥ':
+    case u'ェ':
+    case u'ォ':
+    case u'ャ':
+    case u'ュ':
+    case u'ョ':
+        return true;
+    default:
+        return false;
+    }
+}
+
 #define QUERY   "SELECT dic_id, data "\
                     "FROM term_meta_bank "\
                     "WHERE dic_id NOT IN (SELECT dic_id FROM dict_disabled) AND " \
@@ -810,6 +992,8 @@ cleanup:
 
 int DatabaseManager::addPitches(Term &term) const
 {
+    TraceSpan span("DatabaseManager::addPitches", term.expression);
+
     int           ret  = 0;
     sqlite3_stmt *stmt = NULL;
     int           step = 0;
@@ -845,7 +1029,7 @@ int DatabaseManager::addPitches(Term &term) const
         QString currentMora;
         for (const QChar &ch : reading)
         {
-            if (!currentMora.isEmpty() && !m_moraSkipChar.contains(ch))
+            if (!currentMora.isEmpty() && !isMoraSkipChar(ch))
             {
                 pitch.mora.append(currentMora);
                 currentMora.clear();
@@ -95,6 +95,27 @@ public:
      */
     QString queryTerms(const QString &query, QList<SharedTerm> &terms) const;
 
+    /**
+     * Checks if any enabled dictionary has a term whose expression or reading
+     * exactly matches the query. No term information is looked up. Does
+     * automatic conversion from katakana to hiragana.
+     * @param      query  The term to query for.
+     * @param[out] exists Set to true if a term matches, false otherwise.
+     * @return Empty string on success, error string on error.
+     */
+    QString termExists(const QString &query, bool &exists) const;
+
+    /**
+     * Gets the frequencies of every term that exactly matches the query
+     * without looking up anything else about the terms.
+     * @param      query       The term to query for.
+     * @param[out] frequencies The list to add the frequencies to.
+     * @return Empty string on success, error string on error.
+     */
+    QString queryTermFrequencies(
+        const QString &query,
+        QList<Frequency> &frequencies) const;
+
     /**
      * Searches for kanji that exactly match the query.
      * @param      query The kanji to look for. Should be a single character.
@@ -208,9 +229,6 @@ private:
     /* Saved path to the database. */
     const QByteArray m_dbpath;
 
-    /* A set containing special characters that cannot be independent mora. */
-    QSet<QString> m_moraSkipChar;
-
     /* Maps dictionary IDs to dictionary names. */
     QHash<const uint64_t, QString> m_dictionaryCache;
 
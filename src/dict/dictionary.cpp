@@ -25,6 +25,7 @@
 #include <QApplication>
 #include <QDebug>
 #include <QMessageBox>
+#include <QSet>
 #include <QSettings>
 
 #include "databasemanager.h"
@@ -36,6 +37,7 @@
 
 #include "util/constants.h"
 #include "util/globalmediator.h"
+#include "util/trace.h"
 #include "util/utils.h"
 
 /* Begin Constructor/Destructor */
@@ -122,15 +124,28 @@ SharedTermList Dictionary::searchTerms(
     const int index,
     const int *currentIndex)
 {
+    return searchTerms(
+        query, subtitle, index, [=] { return index != *currentIndex; }
+    );
+}
+
+SharedTermList Dictionary::searchTerms(
+    const QString query,
+    const QString subtitle,
+    const int index,
+    const std::function<bool()> &cancelled)
+{
+    TraceSpan span("searchTerms", query);
+
     std::vector<SearchQuery> queries = generateQueries(query);
-    if (index != *currentIndex)
+    if (cancelled())
     {
         return nullptr;
     }
 
     sortQueries(queries);
     filterDuplicates(queries);
-    if (index != *currentIndex)
+    if (cancelled())
     {
         return nullptr;
     }
@@ -139,7 +154,7 @@ SharedTermList Dictionary::searchTerms(
     SharedTermList terms = SharedTermList(new QList<SharedTerm>);
     for (const SearchQuery &query : queries)
     {
-        if (index != *currentIndex)
+        if (cancelled())
         {
             return nullptr;
         }
@@ -176,7 +191,7 @@ SharedTermList Dictionary::searchTerms(
     }
 
     sortTerms(terms);
-    if (index != *currentIndex)
+    if (cancelled())
     {
         return nullptr;
     }
@@ -184,8 +199,66 @@ SharedTermList Dictionary::searchTerms(
     return terms;
 }
 
+int Dictionary::matchTerm(
+    const QString &query,
+    QList<Frequency> *frequencies)
+{
+    TraceSpan span("matchTerm", query);
+
+    std::vector<SearchQuery> queries = generateQueries(query);
+    std::stable_sort(
+        std::begin(queries), std::end(queries),
+        [] (const SearchQuery &lhs, const SearchQuery &rhs) -> bool
+        {
+            return lhs.surface.size() > rhs.surface.size();
+        }
+    );
+
+    int length = 0;
+    QSet<QString> checked;
+    for (const SearchQuery &query : queries)
+    {
+        /* Queries are sorted longest first, so stop once every query of the
+         * matched length has been checked */
+        if (query.surface.size() < length)
+        {
+            break;
+        }
+        if (checked.contains(query.deconj))
+        {
+            continue;
+        }
+        checked.insert(query.deconj);
+
+        bool exists = false;
+        QString err = m_db->termExists(query.deconj, exists);
+        if (!err.isEmpty())
+        {
+            qDebug() << err;
+            return -1;
+        }
+        if (!exists)
+        {
+            continue;
+        }
+        length = query.surface.size();
+
+        if (frequencies)
+        {
+            err = m_db->queryTermFrequencies(query.deconj, *frequencies);
+            if (!err.isEmpty())
+            {
+                qDebug() << err;
+            }
+        }
+    }
+    return length;
+}
+
 std::vector<SearchQuery> Dictionary::generateQueries(const QString &text) const
 {
+    TraceSpan span("generateQueries");
+
     std::vector<SearchQuery> queries;
     for (const std::unique_ptr<QueryGenerator> &gen : m_generators)
     {
@@ -228,6 +301,8 @@ void Dictionary::filterDuplicates(std::vector<SearchQuery> &queries)
 
 void Dictionary::sortTerms(SharedTermList &terms) const
 {
+    TraceSpan span("sortTerms");
+
     std::sort(std::begin(*terms), std::end(*terms),
         [] (const SharedTerm lhs, const SharedTerm rhs) -> bool
         {
@@ -273,6 +348,8 @@ void Dictionary::sortTerms(SharedTermList &terms) const
 
 SharedKanji Dictionary::searchKanji(const QString ch)
 {
+    TraceSpan span("searchKanji", ch);
+
     SharedKanji kanji = SharedKanji(new Kanji);
     m_db->queryKanji(ch, *kanji);
 
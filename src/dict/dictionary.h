@@ -27,6 +27,7 @@
 #include <QReadWriteLock>
 #include <QString>
 
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -64,6 +65,36 @@ public:
         const int index,
         const int *currentIndex);
 
+    /**
+     * Searches for all terms in the query.
+     * @param query     The query to look for terms in. Only matches terms that
+     *                  start from the beginning of the query.
+     * @param subtitle  The subtitle the query appears in.
+     * @param index     The index into the subtitle where the query begins.
+     * @param cancelled Polled between stages of the search. If it returns
+     *                  true, the search is aborted.
+     * @return A list of all the terms found, nullptr if the search was aborted.
+     *         Belongs to the caller.
+     */
+    SharedTermList searchTerms(
+        const QString query,
+        const QString subtitle,
+        const int index,
+        const std::function<bool()> &cancelled);
+
+    /**
+     * Finds the length of the longest term at the beginning of the query.
+     * Only checks that a term exists instead of building it, so this is much
+     * cheaper than searchTerms() when the terms themselves aren't needed.
+     * @param      query       The query to match. Only matches terms that
+     *                         start from the beginning of the query.
+     * @param[out] frequencies The frequencies of every term of the longest
+     *                         length. Can be nullptr.
+     * @return The number of characters in the longest match, 0 if nothing
+     *         matches, -1 on error.
+     */
+    int matchTerm(const QString &query, QList<Frequency> *frequencies);
+
     /**
      * Searches for a single kanji.
      * @param character The kanji to search for. Should be a single character.
@@ -94,6 +94,10 @@ struct Pitch
  */
 struct TermDefinition
 {
+    /* The row id of this entry in the database. Identifies the entry across
+     * searches. -1 if unknown. */
+    int64_t id = -1;
+
     /* The name of the dictionary this entry comes from. */
     QString dictionary;
 
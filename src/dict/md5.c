@@ -0,0 +1,213 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "md5.h"
+
+#include <string.h>
+
+/* Implementation of RFC 1321 */
+
+#define F(x, y, z) (((x) & (y)) | (~(x) & (z)))
+#define G(x, y, z) (((x) & (z)) | ((y) & ~(z)))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+#define I(x, y, z) ((y) ^ ((x) | ~(z)))
+
+#define ROTATE_LEFT(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+#define STEP(f, a, b, c, d, x, t, s) \
+    (a) += f((b), (c), (d)) + (x) + (t); \
+    (a) = ROTATE_LEFT((a), (s)); \
+    (a) += (b);
+
+/**
+ * Processes a single 64 byte block.
+ * @param state The state to update.
+ * @param block The block to process.
+ */
+static void md5_transform(uint32_t state[4], const unsigned char block[64])
+{
+    uint32_t a = state[0];
+    uint32_t b = state[1];
+    uint32_t c = state[2];
+    uint32_t d = state[3];
+    uint32_t x[16];
+
+    for (int i = 0; i < 16; ++i)
+    {
+        x[i] = (uint32_t)block[i * 4] |
+               ((uint32_t)block[i * 4 + 1] << 8) |
+               ((uint32_t)block[i * 4 + 2] << 16) |
+               ((uint32_t)block[i * 4 + 3] << 24);
+    }
+
+    /* Round 1 */
+    STEP(F, a, b, c, d, x[ 0], 0xd76aa478,  7)
+    STEP(F, d, a, b, c, x[ 1], 0xe8c7b756, 12)
+    STEP(F, c, d, a, b, x[ 2], 0x242070db, 17)
+    STEP(F, b, c, d, a, x[ 3], 0xc1bdceee, 22)
+    STEP(F, a, b, c, d, x[ 4], 0xf57c0faf,  7)
+    STEP(F, d, a, b, c, x[ 5], 0x4787c62a, 12)
+    STEP(F, c, d, a, b, x[ 6], 0xa8304613, 17)
+    STEP(F, b, c, d, a, x[ 7], 0xfd469501, 22)
+    STEP(F, a, b, c, d, x[ 8], 0x698098d8,  7)
+    STEP(F, d, a, b, c, x[ 9], 0x8b44f7af, 12)
+    STEP(F, c, d, a, b, x[10], 0xffff5bb1, 17)
+    STEP(F, b, c, d, a, x[11], 0x895cd7be, 22)
+    STEP(F, a, b, c, d, x[12], 0x6b901122,  7)
+    STEP(F, d, a, b, c, x[13], 0xfd987193, 12)
+    STEP(F, c, d, a, b, x[14], 0xa679438e, 17)
+    STEP(F, b, c, d, a, x[15], 0x49b40821, 22)
+
+    /* Round 2 */
+    STEP(G, a, b, c, d, x[ 1], 0xf61e2562,  5)
+    STEP(G, d, a, b, c, x[ 6], 0xc040b340,  9)
+    STEP(G, c, d, a, b, x[11], 0x265e5a51, 14)
+    STEP(G, b, c, d, a, x[ 0], 0xe9b6c7aa, 20)
+    STEP(G, a, b, c, d, x[ 5], 0xd62f105d,  5)
+    STEP(G, d, a, b, c, x[10], 0x02441453,  9)
+    STEP(G, c, d, a, b, x[15], 0xd8a1e681, 14)
+    STEP(G, b, c, d, a, x[ 4], 0xe7d3fbc8, 20)
+    STEP(G, a, b, c, d, x[ 9], 0x21e1cde6,  5)
+    STEP(G, d, a, b, c, x[14], 0xc33707d6,  9)
+    STEP(G, c, d, a, b, x[ 3], 0xf4d50d87, 14)
+    STEP(G, b, c, d, a, x[ 8], 0x455a14ed, 20)
+    STEP(G, a, b, c, d, x[13], 0xa9e3e905,  5)
+    STEP(G, d, a, b, c, x[ 2], 0xfcefa3f8,  9)
+    STEP(G, c, d, a, b, x[ 7], 0x676f02d9, 14)
+    STEP(G, b, c, d, a, x[12], 0x8d2a4c8a, 20)
+
+    /* Round 3 */
+    STEP(H, a, b, c, d, x[ 5], 0xfffa3942,  4)
+    STEP(H, d, a, b, c, x[ 8], 0x8771f681, 11)
+    STEP(H, c, d, a, b, x[11], 0x6d9d6122, 16)
+    STEP(H, b, c, d, a, x[14], 0xfde5380c, 23)
+    STEP(H, a, b, c, d, x[ 1], 0xa4beea44,  4)
+    STEP(H, d, a, b, c, x[ 4], 0x4bdecfa9, 11)
+    STEP(H, c, d, a, b, x[ 7], 0xf6bb4b60, 16)
+    STEP(H, b, c, d, a, x[10], 0xbebfbc70, 23)
+    STEP(H, a, b, c, d, x[13], 0x289b7ec6,  4)
+    STEP(H, d, a, b, c, x[ 0], 0xeaa127fa, 11)
+    STEP(H, c, d, a, b, x[ 3], 0xd4ef3085, 16)
+    STEP(H, b, c, d, a, x[ 6], 0x04881d05, 23)
+    STEP(H, a, b, c, d, x[ 9], 0xd9d4d039,  4)
+    STEP(H, d, a, b, c, x[12], 0xe6db99e5, 11)
+    STEP(H, c, d, a, b, x[15], 0x1fa27cf8, 16)
+    STEP(H, b, c, d, a, x[ 2], 0xc4ac5665, 23)
+
+    /* Round 4 */
+    STEP(I, a, b, c, d, x[ 0], 0xf4292244,  6)
+    STEP(I, d, a, b, c, x[ 7], 0x432aff97, 10)
+    STEP(I, c, d, a, b, x[14], 0xab9423a7, 15)
+    STEP(I, b, c, d, a, x[ 5], 0xfc93a039, 21)
+    STEP(I, a, b, c, d, x[12], 0x655b59c3,  6)
+    STEP(I, d, a, b, c, x[ 3], 0x8f0ccc92, 10)
+    STEP(I, c, d, a, b, x[10], 0xffeff47d, 15)
+    STEP(I, b, c, d, a, x[ 1], 0x85845dd1, 21)
+    STEP(I, a, b, c, d, x[ 8], 0x6fa87e4f,  6)
+    STEP(I, d, a, b, c, x[15], 0xfe2ce6e0, 10)
+    STEP(I, c, d, a, b, x[ 6], 0xa3014314, 15)
+    STEP(I, b, c, d, a, x[13], 0x4e0811a1, 21)
+    STEP(I, a, b, c, d, x[ 4], 0xf7537e82,  6)
+    STEP(I, d, a, b, c, x[11], 0xbd3af235, 10)
+    STEP(I, c, d, a, b, x[ 2], 0x2ad7d2bb, 15)
+    STEP(I, b, c, d, a, x[ 9], 0xeb86d391, 21)
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+#undef F
+#undef G
+#undef H
+#undef I
+#undef ROTATE_LEFT
+#undef STEP
+
+void md5_init(md5_ctx *ctx)
+{
+    ctx->state[0] = 0x67452301;
+    ctx->state[1] = 0xefcdab89;
+    ctx->state[2] = 0x98badcfe;
+    ctx->state[3] = 0x10325476;
+    ctx->length = 0;
+}
+
+void md5_update(md5_ctx *ctx, const void *data, size_t len)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    size_t used = ctx->length % sizeof(ctx->buffer);
+    ctx->length += len;
+
+    /* Fill the partially filled block first */
+    if (used)
+    {
+        size_t space = sizeof(ctx->buffer) - used;
+        if (len < space)
+        {
+            memcpy(&ctx->buffer[used], bytes, len);
+            return;
+        }
+        memcpy(&ctx->buffer[used], bytes, space);
+        md5_transform(ctx->state, ctx->buffer);
+        bytes += space;
+        len -= space;
+    }
+
+    /* Process whole blocks in place */
+    while (len >= sizeof(ctx->buffer))
+    {
+        md5_transform(ctx->state, bytes);
+        bytes += sizeof(ctx->buffer);
+        len -= sizeof(ctx->buffer);
+    }
+
+    memcpy(ctx->buffer, bytes, len);
+}
+
+void md5_final_hex(md5_ctx *ctx, char *hex)
+{
+    static const char digits[] = "0123456789abcdef";
+    static const unsigned char padding[64] = { 0x80 };
+
+    /* Pad to 56 bytes mod 64 then append the length in bits */
+    const uint64_t bits = ctx->length * 8;
+    size_t used = ctx->length % sizeof(ctx->buffer);
+    md5_update(ctx, padding, used < 56 ? 56 - used : 120 - used);
+
+    unsigned char length[8];
+    for (int i = 0; i < 8; ++i)
+    {
+        length[i] = (unsigned char)(bits >> (i * 8));
+    }
+    md5_update(ctx, length, sizeof(length));
+
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            unsigned char byte = (unsigned char)(ctx->state[i] >> (j * 8));
+            hex[(i * 4 + j) * 2]     = digits[byte >> 4];
+            hex[(i * 4 + j) * 2 + 1] = digits[byte & 0xf];
+        }
+    }
+    hex[MD5_HEX_SIZE - 1] = '\0';
+}
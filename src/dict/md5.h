@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MD5_H
+#define MD5_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MD5_DIGEST_SIZE     16
+#define MD5_HEX_SIZE        (MD5_DIGEST_SIZE * 2 + 1)
+
+typedef struct md5_ctx
+{
+    uint32_t state[4];
+    uint64_t length;
+    unsigned char buffer[64];
+} md5_ctx;
+
+/**
+ * Initializes an MD5 context.
+ * @param ctx The context to initialize.
+ */
+void md5_init(md5_ctx *ctx);
+
+/**
+ * Adds data to the digest.
+ * @param ctx  The context to add data to.
+ * @param data The data to add.
+ * @param len  The length of data in bytes.
+ */
+void md5_update(md5_ctx *ctx, const void *data, size_t len);
+
+/**
+ * Finishes the digest and writes it as a lowercase hex string.
+ * @param      ctx The context to finish. Must be initialized again to reuse.
+ * @param[out] hex A buffer of at least MD5_HEX_SIZE bytes. Null terminated.
+ */
+void md5_final_hex(md5_ctx *ctx, char *hex);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MD5_H
@@ -0,0 +1,232 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "subtitleannotator.h"
+
+#include <algorithm>
+
+#include <QThread>
+
+#include "dictionary.h"
+
+#include "util/globalmediator.h"
+#include "util/trace.h"
+
+/* The maximum length of a query used to find a token. */
+#define MAX_TOKEN_QUERY_LENGTH 20
+
+/* The number of lines annotated by a single task. */
+#define LINES_PER_TASK 16
+
+/* Begin Constructor/Destructor */
+
+SubtitleAnnotator::SubtitleAnnotator(QObject *parent) : QObject(parent)
+{
+    m_pool.setMaxThreadCount(QThread::idealThreadCount());
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+    m_pool.setThreadPriority(QThread::LowPriority);
+#endif
+}
+
+SubtitleAnnotator::~SubtitleAnnotator()
+{
+    m_generation.ref();
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+/* End Constructor/Destructor */
+/* Begin Annotation Methods */
+
+void SubtitleAnnotator::annotate(const QStringList &lines)
+{
+    Dictionary *dictionary =
+        GlobalMediator::getGlobalMediator()->getDictionary();
+    if (dictionary == nullptr)
+    {
+        return;
+    }
+
+    QStringList queued;
+    m_lock.lockForWrite();
+    for (const QString &line : lines)
+    {
+        if (line.isEmpty() ||
+            m_annotations.contains(line) ||
+            m_queued.contains(line))
+        {
+            continue;
+        }
+        m_queued.insert(line);
+        queued.append(line);
+    }
+    m_lock.unlock();
+
+    if (queued.isEmpty())
+    {
+        return;
+    }
+
+    const int generation = m_generation.loadRelaxed();
+    const int taskCount = (queued.size() + LINES_PER_TASK - 1) / LINES_PER_TASK;
+    std::shared_ptr<QAtomicInt> remaining =
+        std::make_shared<QAtomicInt>(taskCount);
+    for (int i = 0; i < queued.size(); i += LINES_PER_TASK)
+    {
+        QStringList batch = queued.mid(i, LINES_PER_TASK);
+        m_pool.start(
+            [=] {
+                TraceSpan span("SubtitleAnnotator::annotate");
+                for (const QString &line : batch)
+                {
+                    SharedLineAnnotation annotation =
+                        annotateLine(dictionary, line, generation);
+                    if (annotation == nullptr)
+                    {
+                        return;
+                    }
+
+                    QWriteLocker locker(&m_lock);
+                    if (generation != m_generation.loadRelaxed())
+                    {
+                        return;
+                    }
+                    m_queued.remove(line);
+                    m_annotations.insert(line, annotation);
+                }
+
+                if (!remaining->deref() &&
+                    generation == m_generation.loadRelaxed())
+                {
+                    Q_EMIT annotationsFinished();
+                }
+            }
+        );
+    }
+}
+
+SharedLineAnnotation SubtitleAnnotator::annotateLine(
+    Dictionary *dictionary,
+    const QString &line,
+    const int generation) const
+{
+    std::shared_ptr<LineAnnotation> annotation =
+        std::make_shared<LineAnnotation>();
+
+    int covered = 0;
+    int characters = 0;
+    for (int i = 0; i < line.size(); )
+    {
+        if (generation != m_generation.loadRelaxed())
+        {
+            return nullptr;
+        }
+
+        if (line[i].isSpace())
+        {
+            ++i;
+            continue;
+        }
+        ++characters;
+
+        QList<Frequency> frequencies;
+        const int length = dictionary->matchTerm(
+            line.mid(i, MAX_TOKEN_QUERY_LENGTH), &frequencies
+        );
+        if (length <= 0)
+        {
+            ++i;
+            continue;
+        }
+
+        TokenSpan token;
+        token.start = i;
+        token.length = length;
+        token.frequency = frequencyRank(frequencies);
+        annotation->tokens.append(token);
+        annotation->difficulty = std::max(
+            annotation->difficulty, token.frequency
+        );
+
+        for (int j = i + 1; j < i + token.length && j < line.size(); ++j)
+        {
+            if (!line[j].isSpace())
+            {
+                ++characters;
+            }
+        }
+        covered += token.length;
+        i += token.length;
+    }
+    annotation->coverage =
+        characters == 0 ? 1.0 : std::min(1.0, (double)covered / characters);
+
+    return annotation;
+}
+
+int SubtitleAnnotator::frequencyRank(const QList<Frequency> &frequencies)
+{
+    int best = -1;
+    for (const Frequency &freq : frequencies)
+    {
+        /* Frequencies can have display text after the number, so only look at
+         * the leading digits. */
+        int end = 0;
+        while (end < freq.freq.size() && freq.freq[end].isDigit())
+        {
+            ++end;
+        }
+        bool ok = false;
+        const int rank = freq.freq.left(end).toInt(&ok);
+        if (ok && rank > 0 && (best == -1 || rank < best))
+        {
+            best = rank;
+        }
+    }
+    return best;
+}
+
+#undef MAX_TOKEN_QUERY_LENGTH
+#undef LINES_PER_TASK
+
+/* End Annotation Methods */
+/* Begin Getters */
+
+SharedLineAnnotation SubtitleAnnotator::getAnnotation(
+    const QString &line) const
+{
+    QReadLocker locker(&m_lock);
+    return m_annotations.value(line, nullptr);
+}
+
+/* End Getters */
+/* Begin Clear Methods */
+
+void SubtitleAnnotator::clear()
+{
+    m_generation.ref();
+    m_pool.clear();
+
+    QWriteLocker locker(&m_lock);
+    m_annotations.clear();
+    m_queued.clear();
+}
+
+/* End Clear Methods */
@@ -0,0 +1,154 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SUBTITLEANNOTATOR_H
+#define SUBTITLEANNOTATOR_H
+
+#include <QObject>
+
+#include <memory>
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QList>
+#include <QReadWriteLock>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+#include "expression.h"
+
+class Dictionary;
+
+/**
+ * A span of a subtitle line matched by a dictionary term.
+ */
+struct TokenSpan
+{
+    /* The index of the first character of the token in the line. */
+    int start = 0;
+
+    /* The number of characters in the token. */
+    int length = 0;
+
+    /* The best frequency rank of the token. -1 if there is no rank. */
+    int frequency = -1;
+};
+
+/**
+ * Dictionary information about a single subtitle line.
+ */
+struct LineAnnotation
+{
+    /* The tokens of the line in order of appearance. */
+    QList<TokenSpan> tokens;
+
+    /* The fraction of non-space characters covered by tokens. */
+    double coverage = 0.0;
+
+    /* The worst frequency rank of any token in the line. -1 if none. */
+    int difficulty = -1;
+};
+
+typedef std::shared_ptr<const LineAnnotation> SharedLineAnnotation;
+
+/**
+ * Annotates subtitle lines with dictionary tokens and frequency ranks in the
+ * background. Work is done on a dedicated low priority thread pool so that it
+ * never competes with interactive lookups.
+ */
+class SubtitleAnnotator : public QObject
+{
+    Q_OBJECT
+
+public:
+    /* Tokens with a frequency rank above this are considered uncommon. */
+    static constexpr int RARE_RANK = 10000;
+
+    SubtitleAnnotator(QObject *parent = nullptr);
+    ~SubtitleAnnotator();
+
+    /**
+     * Queues all lines that haven't been annotated to be annotated.
+     * annotationsFinished() is emitted once every queued line is annotated.
+     * @param lines The lines to annotate.
+     */
+    void annotate(const QStringList &lines);
+
+    /**
+     * Gets the annotation of a line.
+     * @param line The line to get the annotation of.
+     * @return The annotation of the line, nullptr if the line hasn't been
+     *         annotated yet.
+     */
+    SharedLineAnnotation getAnnotation(const QString &line) const;
+
+    /**
+     * Removes all annotations and cancels any outstanding work.
+     */
+    void clear();
+
+Q_SIGNALS:
+    /**
+     * Emitted when a batch of lines passed to annotate() finishes. Emitted
+     * from a worker thread.
+     */
+    void annotationsFinished() const;
+
+private:
+    /**
+     * Annotates a single line by greedily matching the longest term at each
+     * position.
+     * @param dictionary The dictionary to search with.
+     * @param line       The line to annotate.
+     * @param generation The generation the work was queued in. Work stops early
+     *                   if the generation changes.
+     * @return The annotation of the line, nullptr if the work was cancelled.
+     */
+    SharedLineAnnotation annotateLine(
+        Dictionary *dictionary,
+        const QString &line,
+        int generation) const;
+
+    /**
+     * Gets the best numeric rank from a list of frequencies.
+     * @param frequencies The frequencies of a term.
+     * @return The lowest rank in the list, -1 if there is no numeric rank.
+     */
+    static int frequencyRank(const QList<Frequency> &frequencies);
+
+    /* The pool annotations are computed on. */
+    QThreadPool m_pool;
+
+    /* Maps lines to their annotations. */
+    QHash<QString, SharedLineAnnotation> m_annotations;
+
+    /* Lines currently queued for annotation. */
+    QSet<QString> m_queued;
+
+    /* Protects m_annotations and m_queued. */
+    mutable QReadWriteLock m_lock;
+
+    /* Incremented every time the annotations are cleared. */
+    QAtomicInt m_generation;
+};
+
+#endif // SUBTITLEANNOTATOR_H
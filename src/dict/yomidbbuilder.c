@@ -20,6 +20,8 @@
 
 #include "yomidbbuilder.h"
 
+#include "md5.h"
+
 #include <errno.h>
 #include <json-c/json.h>
 #include <regex.h>
@@ -1822,7 +1824,39 @@ static char *concat_paths(const char *start, const char *end)
 #endif
 
 /**
- * Extracts resources also in the archive if they exist.
+ * Writes the MD5 hashes of extracted resources to YOMI_RESOURCE_HASHES_FILE.
+ * Failing to write the file is not an error since hashes can be recomputed.
+ * @param base_path The directory resources were extracted to.
+ * @param hashes    An object mapping resource paths to their hashes.
+ */
+static void write_resource_hashes(const char *base_path, json_object *hashes)
+{
+    char *hashes_path = concat_paths(base_path, YOMI_RESOURCE_HASHES_FILE);
+#ifdef _WIN32
+    LPWSTR wHashesPath = utf8_to_lpwstr(hashes_path);
+    FILE *file = _wfopen(wHashesPath, L"wb+");
+    free(wHashesPath);
+    wHashesPath = NULL;
+#else
+    FILE *file = fopen(hashes_path, "wb+");
+#endif
+    if (file == NULL)
+    {
+        fprintf(stderr, "Could not open file for writing\n%s\n", hashes_path);
+        free(hashes_path);
+        return;
+    }
+    free(hashes_path);
+
+    const char *json = json_object_to_json_string_ext(hashes, JSON_C_TO_STRING_PLAIN);
+    fwrite(json, sizeof(char), strlen(json), file);
+    fclose(file);
+}
+
+/**
+ * Extracts resources also in the archive if they exist. The MD5 hash of every
+ * resource is computed while extracting so it doesn't have to be read again
+ * when it is added to Anki.
  * @param dict_archive The dictionary archive to extract resources from.
  * @param res_dir      Path to the resource directory.
  * @return Error code.
@@ -1834,6 +1868,7 @@ static int extract_resources(zip_t *dict_archive, const char *res_dir)
     regex_t     *file_regex = NULL;
     json_object *obj        = NULL;
     json_object *ret_obj    = NULL;
+    json_object *hashes     = NULL;
     const char  *dict_name  = NULL;
     char        *base_path  = NULL;
     const char *file_name   = NULL;
@@ -1891,6 +1926,8 @@ static int extract_resources(zip_t *dict_archive, const char *res_dir)
     }
     file_regex = &rt; // if regcomp fails, regfree is UB if passed non-NULL
 
+    hashes = json_object_new_object();
+
     /* Iterate over files */
     for (zip_int64_t i = 0; i < zip_get_num_entries(dict_archive, 0); ++i)
     {
@@ -1948,11 +1985,14 @@ static int extract_resources(zip_t *dict_archive, const char *res_dir)
         free(file_path);
         file_path = NULL;
 
-        /* Buffer and write the file */
+        /* Buffer, hash and write the file */
         char buf[BUFSIZ];
         zip_int64_t bytes_read = 0;
-        while ((bytes_read = zip_fread(zip_file, buf, sizeof(buf))))
+        md5_ctx md5;
+        md5_init(&md5);
+        while ((bytes_read = zip_fread(zip_file, buf, sizeof(buf))) > 0)
         {
+            md5_update(&md5, buf, bytes_read);
             fwrite(buf, sizeof(char), bytes_read, file);
         }
         fclose(file);
@@ -1960,13 +2000,20 @@ static int extract_resources(zip_t *dict_archive, const char *res_dir)
         {
             zip_fclose(zip_file);
         }
+
+        char hash[MD5_HEX_SIZE];
+        md5_final_hex(&md5, hash);
+        json_object_object_add(hashes, file_name, json_object_new_string(hash));
     }
 
+    write_resource_hashes(base_path, hashes);
+
 cleanup:
     if (file_regex)
     {
         regfree(file_regex);
     }
+    json_object_put(hashes);
     json_object_put(obj);
     free(base_path);
 
@@ -31,6 +31,10 @@ extern "C" {
 #define YOMI_DB_VERSION                 4
 #define YOMI_DB_FORMAT_VERSION          3
 
+/* The file in each dictionary's resource directory mapping resource paths
+ * relative to the directory to their MD5 hashes. */
+#define YOMI_RESOURCE_HASHES_FILE       ".memento_md5.json"
+
 #define YOMI_ERR_OPENING_DIC            1
 #define YOMI_ERR_DB                     2
 #define YOMI_ERR_NEWER_VERSION          3
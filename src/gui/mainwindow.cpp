@@ -82,6 +82,10 @@ MainWindow::MainWindow(QWidget *parent)
     m_aboutWindow = new AboutWindow;
     m_aboutWindow->hide();
 
+    /* Thread Pool Statistics Window */
+    m_executorStatsWindow = new ExecutorStatsWindow;
+    m_executorStatsWindow->hide();
+
     /* Splitter */
     m_ui->splitterPlayerSubtitles->setStretchFactor(0, 1);
     m_ui->splitterPlayerSubtitles->setStretchFactor(1, 0);
@@ -103,6 +107,7 @@ MainWindow::~MainWindow()
     delete m_ui;
     m_optionsWindow->deleteLater();
     m_aboutWindow->deleteLater();
+    m_executorStatsWindow->deleteLater();
     m_overlay->deleteLater();
 
     /* Wrappers and Clients */
@@ -156,6 +161,10 @@ void MainWindow::initWindow()
         m_ui->searchWidget, &SearchWidget::setSearch,
         Qt::QueuedConnection
     );
+    connect(
+        m_ui->searchWidget, &SearchWidget::metricsUpdated,
+        m_executorStatsWindow, &ExecutorStatsWindow::setSearchMetrics
+    );
 
     /* Subtitle List Signals */
     connect(
@@ -235,6 +244,11 @@ void MainWindow::initWindow()
         this, &MainWindow::showAbout,
         Qt::QueuedConnection
     );
+    connect(
+        m_mediator, &GlobalMediator::menuShowExecutorStats,
+        this, &MainWindow::showExecutorStats,
+        Qt::QueuedConnection
+    );
 }
 
 void MainWindow::initTheme()
@@ -795,6 +809,13 @@ void MainWindow::showAbout() const
     m_aboutWindow->raise();
 }
 
+void MainWindow::showExecutorStats() const
+{
+    m_executorStatsWindow->show();
+    m_executorStatsWindow->activateWindow();
+    m_executorStatsWindow->raise();
+}
+
 /* End Show Methods */
 #if defined(Q_OS_MACOS)
 /* Begin Cocoa Handlers */
@@ -26,6 +26,7 @@
 #include "anki/ankiclient.h"
 #include "gui/widgets/aboutwindow.h"
 #include "gui/widgets/definition/definitionwidget.h"
+#include "gui/widgets/executorstatswindow.h"
 #include "gui/widgets/overlay/playeroverlay.h"
 #include "gui/widgets/settings/optionswindow.h"
 #include "player/playeradapter.h"
@@ -166,6 +167,11 @@ private Q_SLOTS:
      */
     void showAbout() const;
 
+    /**
+     * Shows the thread pool statistics window.
+     */
+    void showExecutorStats() const;
+
     /**
      * Automatically resizes the screen to the supplied width and height.
      * Will not exceed the dimensions of the screen and only happens if in
@@ -234,6 +240,9 @@ private:
     /* A saved pointer to the AboutWindow. Has ownership. */
     AboutWindow *m_aboutWindow;
 
+    /* A saved pointer to the thread pool statistics window. Has ownership. */
+    ExecutorStatsWindow *m_executorStatsWindow;
+
     /* Saved value for determining if the MainWindow is maximized. Used for
      * restoring window state when leaving fullscreen.
      */
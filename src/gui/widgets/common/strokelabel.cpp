@@ -20,8 +20,14 @@
 
 #include "strokelabel.h"
 
+#include <algorithm>
+#include <memory>
+
 #include <QAbstractTextDocumentLayout>
-#include <QTextEdit>
+#include <QPainter>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QTextLayout>
 
 /* Begin Constructor/Destructor */
 
@@ -29,18 +35,22 @@
 
 StrokeLabel::StrokeLabel(QWidget *parent)
     : QWidget(parent),
-      m_backgroundText(new QTextEdit(this)),
       m_foregroundText(new QTextEdit(this)),
       m_textColor(palette().text().color()),
       m_strokeColor(palette().window().color()),
       m_strokeSize(4.0),
       m_backgroundColor(TRANSPARENT_COLOR),
-      m_currentFont(m_backgroundText->font())
+      m_currentFont(m_foregroundText->font())
 {
-    initTextEdit(m_backgroundText);
-
+    /* The text is drawn from the cache, so the QTextEdit only has to draw the
+     * selection and underlines over it */
     initTextEdit(m_foregroundText);
-    m_foregroundText->raise();
+    m_foregroundText->setStyleSheet(
+        "QTextEdit {"
+            "color: rgba(0, 0, 0, 0);"
+            "background: rgba(0, 0, 0, 0);"
+        "}"
+    );
 
     setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
     setFocusPolicy(Qt::FocusPolicy::NoFocus);
@@ -65,56 +75,29 @@ void StrokeLabel::initTextEdit(QTextEdit *te)
 
 void StrokeLabel::updateColors()
 {
-    /* Set the text and background color */
-    QString stylesheetFormat =
-        "QTextEdit {"
-            "color: rgba(%1, %2, %3, %4);"
-            "background: rgba(0, 0, 0, 0);"
-        "}";
-    m_foregroundText->setStyleSheet(
-        stylesheetFormat.arg(QString::number(m_textColor.red()))
-                        .arg(QString::number(m_textColor.green()))
-                        .arg(QString::number(m_textColor.blue()))
-                        .arg(QString::number(m_textColor.alpha()))
-    );
-
-    stylesheetFormat =
-        "QTextEdit {"
-            "color: rgba(%1, %2, %3, %4);"
-            "background: rgba(%5, %6, %7, %8);"
-        "}";
-    m_backgroundText->setStyleSheet(
-        stylesheetFormat.arg(QString::number(m_textColor.red()))
-                        .arg(QString::number(m_textColor.green()))
-                        .arg(QString::number(m_textColor.blue()))
-                        .arg(QString::number(m_textColor.alpha()))
-                        .arg(QString::number(m_backgroundColor.red()))
-                        .arg(QString::number(m_backgroundColor.green()))
-                        .arg(QString::number(m_backgroundColor.blue()))
-                        .arg(QString::number(m_backgroundColor.alpha()))
-    );
-
-    setText(m_foregroundText->toPlainText());
+    invalidateTextCache();
+    update();
 }
 
 void StrokeLabel::fitToContents()
 {
-    m_backgroundText->updateGeometry();
+    m_foregroundText->updateGeometry();
     QWidget *pw = parentWidget();
-    int width = m_backgroundText->document()->idealWidth() + 4;
+    int width = m_foregroundText->document()->idealWidth() + 4;
     if (pw && width > pw->width())
     {
         QFont f = textFont();
         int fontSizePx = f.pixelSize() * pw->width() / width;
         f.setPixelSize(fontSizePx);
-        m_backgroundText->setFont(f);
         m_foregroundText->setFont(f);
         m_fontChanged = true;
-        m_backgroundText->updateGeometry();
+        invalidateGlyphTable();
+        invalidateTextCache();
+        m_foregroundText->updateGeometry();
 
         width = pw->width();
     }
-    int height = m_backgroundText->document()->size().toSize().height();
+    int height = m_foregroundText->document()->size().toSize().height();
     setSize(width, height);
 }
 
@@ -125,24 +108,40 @@ void StrokeLabel::fitToContents()
 
 void StrokeLabel::setTextColor(const QColor &color)
 {
+    if (m_textColor == color)
+    {
+        return;
+    }
     m_textColor = color;
     updateColors();
 }
 
 void StrokeLabel::setStrokeColor(const QColor &color)
 {
+    if (m_strokeColor == color)
+    {
+        return;
+    }
     m_strokeColor = color;
     updateColors();
 }
 
 void StrokeLabel::setStrokeSize(double size)
 {
+    if (m_strokeSize == size)
+    {
+        return;
+    }
     m_strokeSize = size;
     updateColors();
 }
 
 void StrokeLabel::setBackgroundColor(const QColor &color)
 {
+    if (m_backgroundColor == color)
+    {
+        return;
+    }
     m_backgroundColor = color;
     updateColors();
 }
@@ -157,10 +156,14 @@ QFont StrokeLabel::textFont() const
 
 void StrokeLabel::setTextFont(const QFont &f)
 {
+    invalidateGlyphTable();
+    if (f != m_foregroundText->font())
+    {
+        invalidateTextCache();
+    }
     m_currentFont = f;
     m_fontChanged = false;
     m_foregroundText->setFont(f);
-    m_backgroundText->setFont(f);
     fitToContents();
 }
 
@@ -181,34 +184,11 @@ void StrokeLabel::setText(const QString &text)
         if (text.isEmpty())
             continue;
 
-        m_backgroundText->append(text);
-        m_backgroundText->setAlignment(Qt::AlignHCenter);
-
         m_foregroundText->append(text);
         m_foregroundText->setAlignment(Qt::AlignHCenter);
     }
 
-    /* Add the stroke */
-    QTextCharFormat format;
-    format.setTextOutline(
-        QPen(
-            m_strokeColor,
-            m_strokeSize,
-            Qt::SolidLine,
-            Qt::RoundCap,
-            Qt::RoundJoin
-        )
-    );
-    QTextCursor cursor(m_backgroundText->document());
-    cursor.select(QTextCursor::Document);
-    cursor.mergeCharFormat(format);
-
-    format = QTextCharFormat();
-    format.setTextOutline(QPen(Qt::transparent));
-    cursor = QTextCursor(m_foregroundText->document());
-    cursor.select(QTextCursor::Document);
-    cursor.mergeCharFormat(format);
-
+    invalidateTextCache();
     fitToContents();
 }
 
@@ -220,8 +200,10 @@ QString StrokeLabel::getText() const
 
 void StrokeLabel::clearText()
 {
-    m_backgroundText->clear();
+    m_underlines.clear();
+    m_foregroundText->setExtraSelections(m_underlines);
     m_foregroundText->clear();
+    invalidateTextCache();
     setSize(0, 0);
 }
 
@@ -240,21 +222,175 @@ void StrokeLabel::deselectText()
     m_foregroundText->setTextCursor(q);
 }
 
+void StrokeLabel::underlineText(int start, int length)
+{
+    QTextEdit::ExtraSelection underline;
+    underline.format.setUnderlineStyle(QTextCharFormat::DotLine);
+    underline.format.setUnderlineColor(m_textColor);
+    underline.cursor = QTextCursor(m_foregroundText->document());
+    underline.cursor.setPosition(start);
+    underline.cursor.setPosition(start + length, QTextCursor::KeepAnchor);
+    m_underlines.append(underline);
+
+    /* Only the underlined runs are repainted */
+    m_foregroundText->setExtraSelections(m_underlines);
+}
+
 /* End Text Methods */
+/* Begin Painting */
+
+void StrokeLabel::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+
+    const qreal ratio = devicePixelRatioF();
+    if (!m_textCacheValid || m_textCache.devicePixelRatio() != ratio)
+    {
+        buildTextCache(ratio);
+    }
+
+    if (!m_textCache.isNull())
+    {
+        QPainter painter(this);
+        painter.drawPixmap(0, 0, m_textCache);
+    }
+}
+
+void StrokeLabel::buildTextCache(const qreal ratio)
+{
+    m_textCacheValid = true;
+    if (width() <= 0 || height() <= 0)
+    {
+        m_textCache = QPixmap();
+        return;
+    }
+
+    m_textCache = QPixmap(size() * ratio);
+    m_textCache.setDevicePixelRatio(ratio);
+    m_textCache.fill(m_backgroundColor);
+
+    /* Lay out a copy of the text the same way the QTextEdit does */
+    std::unique_ptr<QTextDocument> doc(
+        m_foregroundText->document()->clone()
+    );
+    QTextOption option = doc->defaultTextOption();
+    option.setWrapMode(QTextOption::NoWrap);
+    doc->setDefaultTextOption(option);
+    doc->setTextWidth(width());
+
+    QAbstractTextDocumentLayout::PaintContext context;
+    context.palette.setColor(QPalette::Text, m_textColor);
+
+    QPainter painter(&m_textCache);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setRenderHint(QPainter::TextAntialiasing);
+
+    /* Draw the stroke, then the fill over the inner half of the stroke */
+    QTextCursor cursor(doc.get());
+    cursor.select(QTextCursor::Document);
+    QTextCharFormat format;
+    format.setTextOutline(
+        QPen(
+            m_strokeColor,
+            m_strokeSize,
+            Qt::SolidLine,
+            Qt::RoundCap,
+            Qt::RoundJoin
+        )
+    );
+    cursor.mergeCharFormat(format);
+    doc->documentLayout()->draw(&painter, context);
+
+    format.setTextOutline(QPen(Qt::transparent));
+    cursor.mergeCharFormat(format);
+    doc->documentLayout()->draw(&painter, context);
+}
+
+/* End Painting */
 /* Begin Helper Methods */
 
 void StrokeLabel::setSize(int w, int h)
 {
-    m_backgroundText->setFixedSize(w, h);
+    invalidateGlyphTable();
+    if (size() != QSize(w, h))
+    {
+        invalidateTextCache();
+    }
     m_foregroundText->setFixedSize(w, h);
     setFixedSize(w, h);
 }
 
+void StrokeLabel::buildGlyphTable() const
+{
+    m_glyphLines.clear();
+
+    QTextDocument *doc = m_foregroundText->document();
+
+    /* Make sure every block has been laid out */
+    doc->size();
+
+    for (QTextBlock block = doc->begin(); block.isValid(); block = block.next())
+    {
+        const QTextLayout *layout = block.layout();
+        if (layout == nullptr)
+        {
+            continue;
+        }
+
+        const QPointF offset = layout->position();
+        for (int i = 0; i < layout->lineCount(); ++i)
+        {
+            const QTextLine line = layout->lineAt(i);
+
+            GlyphLine glyphs;
+            glyphs.top = offset.y() + line.y();
+            glyphs.bottom = glyphs.top + line.height();
+            glyphs.start = block.position() + line.textStart();
+
+            const int end = line.textStart() + line.textLength();
+            glyphs.edges.reserve(line.textLength() + 1);
+            for (int pos = line.textStart(); pos <= end; ++pos)
+            {
+                glyphs.edges.append(offset.x() + line.cursorToX(pos));
+            }
+            m_glyphLines.append(glyphs);
+        }
+    }
+
+    m_glyphsValid = true;
+}
+
 int StrokeLabel::getPosition(const QPoint &pos) const
 {
-    return m_foregroundText->document()->documentLayout()->hitTest(
-        pos, Qt::ExactHit
+    if (!m_glyphsValid)
+    {
+        buildGlyphTable();
+    }
+
+    /* Find the line */
+    auto lineIt = std::upper_bound(
+        m_glyphLines.cbegin(), m_glyphLines.cend(), qreal(pos.y()),
+        [] (const qreal y, const GlyphLine &line) { return y < line.top; }
     );
+    if (lineIt == m_glyphLines.cbegin())
+    {
+        return -1;
+    }
+    --lineIt;
+    if (pos.y() >= lineIt->bottom || lineIt->edges.size() < 2)
+    {
+        return -1;
+    }
+
+    /* Find the character */
+    const QVector<qreal> &edges = lineIt->edges;
+    const qreal x = pos.x();
+    if (x < edges.first() || x >= edges.last())
+    {
+        return -1;
+    }
+    auto edgeIt = std::upper_bound(edges.cbegin(), edges.cend(), x);
+    return lineIt->start + (edgeIt - edges.cbegin()) - 1;
 }
 
 /* End Helper Methods */
@@ -23,10 +23,15 @@
 
 #include <QWidget>
 
-class QTextEdit;
+#include <QList>
+#include <QPixmap>
+#include <QTextEdit>
+#include <QVector>
 
 /**
  * A label that displays text with a stroke.
+ * The stroked text is rendered once into a pixmap that is reused on every
+ * repaint until the text, font, size, colors, or device pixel ratio change.
  */
 class StrokeLabel : public QWidget
 {
@@ -89,7 +94,11 @@ public:
 
     /**
      * Gets the index of the character at the current position.
+     * Uses a table of glyph positions that is built once per layout, so this
+     * is cheap enough to call on every mouse move.
      * @param pos The point (on this widget) to get the text index of.
+     * @return The index of the character, -1 if there is no character at the
+     *         position.
      */
     int getPosition(const QPoint &pos) const;
 
@@ -106,6 +115,14 @@ public Q_SLOTS:
      */
     void deselectText();
 
+    /**
+     * Underlines the text starting at some index for some number of
+     * characters. Underlines are removed when the text changes.
+     * @param start  The starting index of the underline.
+     * @param length The length of the underline.
+     */
+    void underlineText(int start, int length);
+
     /**
      * Resizes the label to fit the context of the current text.
      */
@@ -118,7 +135,52 @@ public Q_SLOTS:
      */
     void setSize(int h, int w);
 
+protected:
+    /**
+     * Draws the cached text, rebuilding the cache if it is out of date.
+     * @param event The paint event, not used.
+     */
+    void paintEvent(QPaintEvent *event) override;
+
 private:
+    /* The positions of the characters on a single line of text. */
+    struct GlyphLine
+    {
+        /* The y coordinate of the top of the line. */
+        qreal top;
+
+        /* The y coordinate of the bottom of the line. */
+        qreal bottom;
+
+        /* The index of the first character on the line. */
+        int start;
+
+        /* The x coordinate of the left edge of every character on the line
+         * followed by the right edge of the last character. */
+        QVector<qreal> edges;
+    };
+
+    /**
+     * Builds the glyph position table from the current layout of the text.
+     */
+    void buildGlyphTable() const;
+
+    /**
+     * Marks the glyph position table as out of date.
+     */
+    inline void invalidateGlyphTable() { m_glyphsValid = false; }
+
+    /**
+     * Renders the stroke and fill of the current text into m_textCache.
+     * @param ratio The device pixel ratio to render at.
+     */
+    void buildTextCache(qreal ratio);
+
+    /**
+     * Marks the cached text as out of date.
+     */
+    inline void invalidateTextCache() { m_textCacheValid = false; }
+
     /**
      * Initializes a QTextEdit with all the expected common configuration.
      * @param te The QTextEdit to initialize.
@@ -126,14 +188,12 @@ private:
     void initTextEdit(QTextEdit *te);
 
     /**
-     * Updates the colors of the QTextEdit.
+     * Redraws the text with the current colors.
      */
     void updateColors();
 
-    /* The background QTextEdit that creates the stroke effect. */
-    QTextEdit *m_backgroundText;
-
-    /* The foreground QTextEdit that creates the text */
+    /* The QTextEdit that holds the text and draws the selection and
+     * underlines over the cached text. */
     QTextEdit *m_foregroundText;
 
     /* The current color of the text */
@@ -153,6 +213,23 @@ private:
 
     /* The current saved font */
     QFont m_currentFont;
+
+    /* The underlines of the text. Drawn as extra selections so adding them
+     * doesn't change the document and force it to be laid out again. */
+    QList<QTextEdit::ExtraSelection> m_underlines;
+
+    /* Every line of text sorted from top to bottom. */
+    mutable QVector<GlyphLine> m_glyphLines;
+
+    /* true if m_glyphLines matches the current layout, false otherwise. */
+    mutable bool m_glyphsValid = false;
+
+    /* The stroke and fill of the text rendered at the device pixel ratio. */
+    QPixmap m_textCache;
+
+    /* true if m_textCache matches the current text and style, false
+     * otherwise. */
+    bool m_textCacheValid = false;
 };
 
 #endif // STROKELABEL_H
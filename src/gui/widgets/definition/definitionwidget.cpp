@@ -21,6 +21,9 @@
 #include "definitionwidget.h"
 #include "ui_definitionwidget.h"
 
+#include <algorithm>
+#include <cstdlib>
+
 #include <QFrame>
 #include <QGraphicsDropShadowEffect>
 #include <QPushButton>
@@ -31,6 +34,10 @@
 #include "util/constants.h"
 #include "util/globalmediator.h"
 #include "util/iconfactory.h"
+#include "util/trace.h"
+
+/* The maximum number of hidden term widgets kept for reuse */
+#define TERM_POOL_SIZE 16
 
 /* Begin Constructor/Destructor */
 
@@ -69,10 +76,14 @@ void DefinitionWidget::clearTerms()
 {
     ++m_searchId;
     m_savedScroll = 0;
-    m_addable.clear();
     m_termWidgets.clear();
     m_terms.clear();
     m_kanji = nullptr;
+    m_built = 0;
+    m_pageEnd = 0;
+    m_addableEnd = 0;
+    m_showingKanji = false;
+    m_buttonShowMore = nullptr;
     if (m_child)
     {
         m_child->deleteLater();
@@ -82,7 +93,14 @@ void DefinitionWidget::clearTerms()
     while ((item = m_ui->layoutScroll->takeAt(0)) != nullptr)
     {
         TermWidget *term = qobject_cast<TermWidget *>(item->widget());
-        if (term)
+        if (term &&
+            m_termPool.size() < TERM_POOL_SIZE &&
+            term->isRecyclable())
+        {
+            term->hide();
+            m_termPool.append(term);
+        }
+        else if (term)
         {
             term->deleteWhenReady();
         }
@@ -92,9 +110,10 @@ void DefinitionWidget::clearTerms()
         }
         delete item;
     }
-    GlobalMediator::getGlobalMediator()->getAudioPlayer()->clearFiles();
 }
 
+#undef TERM_POOL_SIZE
+
 /* Begin Constructor/Destructor */
 /* Begin Initializers */
 
@@ -234,10 +253,16 @@ void DefinitionWidget::initSignals()
         this, &DefinitionWidget::hide,
         Qt::QueuedConnection
     );
+    connect(
+        m_ui->scrollArea->verticalScrollBar(), &QScrollBar::valueChanged,
+        this, &DefinitionWidget::fillViewport
+    );
 }
 
 void DefinitionWidget::setTerms(SharedTermList terms, SharedKanji kanji)
 {
+    TraceSpan span("DefinitionWidget::setTerms");
+
     clearTerms();
 
     /* Save the terms in shared pointers */
@@ -261,67 +286,47 @@ void DefinitionWidget::setTerms(SharedTermList terms, SharedKanji kanji)
         return;
     }
 
-    /* Add the terms */
-    showTerms(0, m_state.resultLimit);
+    /* Build the first entry now so the widget isn't shown empty. The rest are
+     * built as they come into view. */
+    m_ui->layoutScroll->addStretch();
+    m_pageEnd = m_state.resultLimit;
+    buildEntries(1);
     m_ui->scrollArea->verticalScrollBar()->setValue(0);
     if (m_state.autoPlayAudio && !m_termWidgets.empty())
     {
         m_termWidgets.front()->playAudio();
     }
+    prefetchAudio();
+    QMetaObject::invokeMethod(
+        this, &DefinitionWidget::fillViewport, Qt::QueuedConnection
+    );
 
-    QPushButton *buttonShowMore = nullptr;
-    /* Add the show more button */
-    if (m_state.resultLimit < m_terms.size() + (m_kanji ? 1 : 0))
-    {
-        buttonShowMore = new QPushButton;
-        buttonShowMore->setSizePolicy(
-            QSizePolicy::Preferred, QSizePolicy::Fixed
-        );
-        buttonShowMore->setText("Show More");
-        buttonShowMore->setEnabled(!m_client->isEnabled());
-        m_ui->scrollAreaContents->layout()->addWidget(buttonShowMore);
-        connect(
-            buttonShowMore, &QPushButton::clicked,
-            this, &DefinitionWidget::showMoreTerms
-        );
-    }
-    else
+    Q_EMIT widgetShown();
+}
+
+#define PREFETCH_COUNT 3
+
+void DefinitionWidget::prefetchAudio()
+{
+    /* Audio from JSON sources can't be known without resolving the source, so
+     * only prefetch if the first source is a plain file */
+    if (m_state.sources.empty() ||
+        m_state.sources.front().type != Constants::AudioSourceType::File)
     {
-        /* Delete the extra line at the end */
-        QLayoutItem *item = m_ui->scrollAreaContents->layout()->takeAt(
-            m_ui->scrollAreaContents->layout()->count() - 1
-        );
-        delete item->widget();
-        delete item;
+        return;
     }
-    m_ui->layoutScroll->addStretch();
 
-    /* Check if entries are addable to Anki */
-    if (m_client->isEnabled())
-    {
-        AnkiReply *reply = m_client->notesAddable(m_terms);
-        int searchId = m_searchId;
-        connect(reply, &AnkiReply::finishedBoolList, this,
-            [=] (const QList<bool> &addable, const QString &error) {
-                if (error.isEmpty() && searchId == m_searchId)
-                {
-                    m_addable = addable;
-                    setAddable(0, m_state.resultLimit);
-                }
-            }
-        );
-        if (buttonShowMore)
-        {
-            connect(
-                reply, &AnkiReply::finishedBoolList,
-                buttonShowMore, [=] { buttonShowMore->setEnabled(true); }
-            );
-        }
+    AudioPlayer *player = GlobalMediator::getGlobalMediator()->getAudioPlayer();
+    const DefinitionState::AudioSource &src = m_state.sources.front();
+    const int count = std::min<int>(PREFETCH_COUNT, m_terms.size());
+    for (int i = 0; i < count; ++i)
+    {
+        player->prefetchAudio(TermWidget::getAudioUrl(src, *m_terms[i]));
     }
-
-    Q_EMIT widgetShown();
 }
 
+#undef PREFETCH_COUNT
+
 /* End Initializers */
 /* Begin Event Handlers */
 
@@ -345,6 +350,9 @@ void DefinitionWidget::showEvent(QShowEvent *event)
 void DefinitionWidget::resizeEvent(QResizeEvent *event)
 {
     QWidget::resizeEvent(event);
+    QMetaObject::invokeMethod(
+        this, &DefinitionWidget::fillViewport, Qt::QueuedConnection
+    );
     if (m_child)
     {
         m_child->deleteLater();
@@ -365,86 +373,183 @@ void DefinitionWidget::mousePressEvent(QMouseEvent *event)
 
 void DefinitionWidget::showMoreTerms()
 {
-    QLayoutItem *spacer = m_ui->scrollAreaContents->layout()->takeAt(
-        m_ui->scrollAreaContents->layout()->count() - 1
-    );
-    QLayoutItem *showMoreItem = m_ui->scrollAreaContents->layout()->takeAt(
-        m_ui->scrollAreaContents->layout()->count() - 1
-    );
+    if (m_buttonShowMore)
+    {
+        m_ui->layoutScroll->removeWidget(m_buttonShowMore);
+        m_buttonShowMore->deleteLater();
+        m_buttonShowMore = nullptr;
+    }
+    m_pageEnd += m_state.resultLimit;
+    fillViewport();
+}
+
+/* End Event Handlers */
+/* Begin Term Helpers */
+
+/* The number of entries built each time more content is needed */
+#define BUILD_BATCH 2
 
-    /* Add the terms */
-    int start = m_termWidgets.size();
-    int end   = start + m_state.resultLimit;
-    showTerms(start, end);
-    setAddable(start, end);
+int DefinitionWidget::entryCount() const
+{
+    return m_terms.size() + (m_kanji ? 1 : 0);
+}
 
-    if (end < m_terms.size() + (m_kanji ? 1 : 0))
+void DefinitionWidget::fillViewport()
+{
+    if (m_showingKanji)
     {
-        m_ui->scrollAreaContents->layout()->addItem(showMoreItem);
+        return;
     }
-    else
+
+    const int end = m_state.resultLimit > 0 ?
+        std::min(m_pageEnd, entryCount()) : entryCount();
+    if (m_built < end)
     {
-        QLayoutItem *lineItem =
-            m_ui->scrollAreaContents->layout()->takeAt(
-                m_ui->scrollAreaContents->layout()->count() - 1
+        /* Build more once less than half a viewport of content is left below
+         * the visible area */
+        const QScrollBar *bar = m_ui->scrollArea->verticalScrollBar();
+        const int overscan = m_ui->scrollArea->viewport()->height() / 2;
+        if (bar->maximum() - bar->value() <= overscan)
+        {
+            buildEntries(std::min(BUILD_BATCH, end - m_built));
+
+            /* Queued so the layout updates the scroll bar before the next
+             * check */
+            QMetaObject::invokeMethod(
+                this, &DefinitionWidget::fillViewport, Qt::QueuedConnection
             );
-        delete lineItem->widget();
-        delete lineItem;
-        delete showMoreItem->widget();
-        delete showMoreItem;
+            return;
+        }
+    }
+    else if (end < entryCount() && m_buttonShowMore == nullptr)
+    {
+        m_buttonShowMore = new QPushButton;
+        m_buttonShowMore->setSizePolicy(
+            QSizePolicy::Preferred, QSizePolicy::Fixed
+        );
+        m_buttonShowMore->setText("Show More");
+        m_ui->layoutScroll->insertWidget(
+            m_ui->layoutScroll->count() - 1, m_buttonShowMore
+        );
+        connect(
+            m_buttonShowMore, &QPushButton::clicked,
+            this, &DefinitionWidget::showMoreTerms
+        );
     }
-    m_ui->layoutScroll->addItem(spacer);
+
+    /* The viewport is full, check everything built so far in one request */
+    checkAddable();
 }
 
-/* End Event Handlers */
-/* Begin Term Helpers */
+#undef BUILD_BATCH
 
-void DefinitionWidget::showTerms(const int start, const int end)
+void DefinitionWidget::buildEntries(const int count)
 {
+    QVBoxLayout *layout = m_ui->layoutScroll;
+    const int end = std::min(m_built + count, entryCount());
+
     setUpdatesEnabled(false);
-    int i;
-    for (i = start; i < m_terms.size() && i < end; ++i)
+    for (; m_built < end; ++m_built)
     {
-        TermWidget *termWidget = new TermWidget(m_terms[i], m_state);
-        connect(
-            termWidget, &TermWidget::kanjiSearched,
-            this, &DefinitionWidget::showKanji
-        );
-        connect(
-            termWidget, &TermWidget::contentSearched,
-            this, &DefinitionWidget::showChild
-        );
-        m_termWidgets.append(termWidget);
-        m_ui->scrollAreaContents->layout()->addWidget(termWidget);
-
-        QFrame *line = new QFrame;
-        line->setFrameShape(QFrame::HLine);
-        line->setFrameShadow(QFrame::Sunken);
-        line->setLineWidth(1);
-        m_ui->scrollAreaContents->layout()->addWidget(line);
-    }
-    if (i < end && m_kanji != nullptr)
-    {
-        KanjiWidget *kanjiWidget = new KanjiWidget(m_kanji);
-        m_ui->scrollAreaContents->layout()->addWidget(kanjiWidget);
-        /* An extra line is expected here */
-        QFrame *line = new QFrame;
-        line->setFrameShape(QFrame::HLine);
-        line->setFrameShadow(QFrame::Sunken);
-        line->setLineWidth(1);
-        m_ui->scrollAreaContents->layout()->addWidget(line);
+        /* Everything is inserted before the trailing stretch */
+        if (m_built > 0)
+        {
+            QFrame *line = new QFrame;
+            line->setFrameShape(QFrame::HLine);
+            line->setFrameShadow(QFrame::Sunken);
+            line->setLineWidth(1);
+            layout->insertWidget(layout->count() - 1, line);
+        }
+
+        if (m_built < m_terms.size())
+        {
+            const QSharedPointer<const Term> &term = m_terms[m_built];
+            TermWidget *termWidget = takeRecycledTerm(term);
+            if (termWidget == nullptr)
+            {
+                TraceSpan span("TermWidget", term->expression);
+                termWidget = new TermWidget(term, m_state);
+                connect(
+                    termWidget, &TermWidget::kanjiSearched,
+                    this, &DefinitionWidget::showKanji
+                );
+                connect(
+                    termWidget, &TermWidget::contentSearched,
+                    this, &DefinitionWidget::showChild
+                );
+            }
+            m_termWidgets.append(termWidget);
+            layout->insertWidget(layout->count() - 1, termWidget);
+        }
+        else
+        {
+            KanjiWidget *kanjiWidget = new KanjiWidget(m_kanji);
+            layout->insertWidget(layout->count() - 1, kanjiWidget);
+        }
     }
     setUpdatesEnabled(true);
 }
 
-void DefinitionWidget::setAddable(const int start, const int end)
+TermWidget *DefinitionWidget::takeRecycledTerm(QSharedPointer<const Term> term)
+{
+    if (m_termPool.isEmpty())
+    {
+        return nullptr;
+    }
+
+    /* Prefer the widget with the closest number of definitions so the most
+     * glossaries are rebound rather than constructed or deleted */
+    int best = 0;
+    int bestDiff = std::abs(
+        m_termPool[0]->definitionCount() - term->definitions.size()
+    );
+    for (int i = 1; i < m_termPool.size() && bestDiff != 0; ++i)
+    {
+        const int diff = std::abs(
+            m_termPool[i]->definitionCount() - term->definitions.size()
+        );
+        if (diff < bestDiff)
+        {
+            best = i;
+            bestDiff = diff;
+        }
+    }
+
+    TraceSpan span("TermWidget::setTerm", term->expression);
+    TermWidget *termWidget = m_termPool.takeAt(best);
+    termWidget->setTerm(term);
+    termWidget->show();
+    return termWidget;
+}
+
+void DefinitionWidget::checkAddable()
 {
-    for (int i = start;
-         i * 2 + 1 < m_addable.size() && i < m_terms.size() && i < end;
-         ++i)
+    const int start = m_addableEnd;
+    const int end = std::min(m_built, (int)m_terms.size());
+    if (start >= end || !m_client->isEnabled())
     {
-        m_termWidgets[i]->setAddable(m_addable[i * 2], m_addable[i * 2 + 1]);
+        return;
     }
+    m_addableEnd = end;
+
+    AnkiReply *reply = m_client->notesAddable(m_terms.mid(start, end - start));
+    const int searchId = m_searchId;
+    connect(reply, &AnkiReply::finishedBoolList, this,
+        [=] (const QList<bool> &addable, const QString &error) {
+            if (!error.isEmpty() || searchId != m_searchId)
+            {
+                return;
+            }
+            for (int i = start;
+                 i < end && (i - start) * 2 + 1 < addable.size();
+                 ++i)
+            {
+                m_termWidgets[i]->setAddable(
+                    addable[(i - start) * 2], addable[(i - start) * 2 + 1]
+                );
+            }
+        }
+    );
 }
 
 /* End Term Helpers */
@@ -452,6 +557,7 @@ void DefinitionWidget::setAddable(const int start, const int end)
 
 void DefinitionWidget::showKanji(QSharedPointer<const Kanji> kanji)
 {
+    m_showingKanji = true;
     m_savedScroll = m_ui->scrollArea->verticalScrollBar()->value();
     for (int i = 0; i < m_ui->scrollAreaContents->layout()->count(); ++i)
     {
@@ -488,6 +594,8 @@ void DefinitionWidget::hideKanji()
     }
     QApplication::processEvents();
     m_ui->scrollArea->verticalScrollBar()->setValue(m_savedScroll);
+    m_showingKanji = false;
+    fillViewport();
 }
 
 /* End Kanji Helpers */
@@ -33,6 +33,8 @@
 #include "anki/ankiclient.h"
 #include "dict/expression.h"
 
+class QPushButton;
+
 enum class AudioSourceType;
 
 namespace Ui
@@ -106,25 +108,49 @@ private Q_SLOTS:
     void initSignals();
 
     /**
-     * Shows more terms up to the limit.
+     * Allows another result limit worth of entries to be built.
      */
     void showMoreTerms();
 
     /**
-     * Sets all terms in m_terms from start to end as addable to Anki based on
-     * the values in m_addable.
-     * @param start The starting index in m_terms to set addable (inclusive).
-     * @param end   The ending index in m_terms to set addable (exclusive).
+     * Builds entries until there is at least half a viewport of content below
+     * the visible area or every allowed entry is built. Builds a small batch
+     * at a time and queues itself so the event loop isn't blocked.
+     */
+    void fillViewport();
+
+    /**
+     * Builds the next entries and adds them to the end of the Definition
+     * Widget. Entries are the terms in m_terms followed by m_kanji.
+     * @param count The number of entries to build.
+     */
+    void buildEntries(const int count);
+
+    /**
+     * Checks if the terms built since the last check are addable to Anki and
+     * updates their widgets once the reply arrives.
+     */
+    void checkAddable();
+
+    /**
+     * Returns the number of entries in the current search.
+     * @return The number of terms plus one if there is a kanji.
      */
-    void setAddable(const int start, const int end);
+    int entryCount() const;
 
     /**
-     * Adds the terms in m_terms from start to end to the end of the Definition
-     * Widget.
-     * @param start The starting index in m_terms of terms to add (inclusive).
-     * @param end   The ending index in m_terms of terms to add (exclusive).
+     * Downloads the audio of the first few terms in the background so it can
+     * be played without waiting on the network.
      */
-    void showTerms(const int start, const int end);
+    void prefetchAudio();
+
+    /**
+     * Takes a widget from the pool of recycled term widgets and rebinds it to
+     * the term.
+     * @param term The term the widget should display.
+     * @return A rebound widget, nullptr if the pool is empty.
+     */
+    TermWidget *takeRecycledTerm(QSharedPointer<const Term> term);
 
     /**
      * Hides terms and shows a kanji entry.
@@ -206,12 +232,29 @@ private:
     /* Pointer to the current kanji */
     QSharedPointer<const Kanji> m_kanji;
 
-    /* List of booleans describing if a term can be added to Anki. */
-    QList<bool> m_addable;
-
     /* List of shown term widgets. */
     QList<TermWidget *> m_termWidgets;
 
+    /* Hidden term widgets that can be rebound to new terms instead of
+     * constructing new ones. */
+    QList<TermWidget *> m_termPool;
+
+    /* The number of entries that have been built. */
+    int m_built = 0;
+
+    /* The number of entries the user has allowed to be built. Increased by the
+     * result limit each time Show More is pressed. */
+    int m_pageEnd = 0;
+
+    /* The number of terms that have been checked for addability. */
+    int m_addableEnd = 0;
+
+    /* true while a kanji opened from a term is covering the results. */
+    bool m_showingKanji = false;
+
+    /* The Show More button. nullptr if it isn't shown. */
+    QPushButton *m_buttonShowMore = nullptr;
+
     /* The saved scroll location of the term widget. Used for restoring position
      * when looking at a kanji entry.
      */
@@ -0,0 +1,137 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef GLOSSARYHTMLBUILDER_H
+#define GLOSSARYHTMLBUILDER_H
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+
+#include "dict/expression.h"
+#include "util/constants.h"
+
+/**
+ * Builds the HTML displayed by GlossaryLabels. Building the HTML of large
+ * structured content dictionaries is expensive, so lookups prepare it on the
+ * thread they run on and the results are cached by definition and style. The
+ * GUI thread then only has to hand finished HTML to the label.
+ * All methods are thread-safe.
+ */
+class GlossaryHtmlBuilder
+{
+public:
+    /**
+     * Builds the HTML of every definition of every term in the list. Meant to
+     * be called by lookups before the results are sent to the GUI thread.
+     * @param terms The terms to prepare. Can be nullptr.
+     * @param style The configured style of glossaries.
+     */
+    static void prepare(SharedTermList terms, Constants::GlossaryStyle style);
+
+    /**
+     * Returns the HTML of a term definition, building it if it isn't cached.
+     * @param def   The term definition.
+     * @param style The style to display the different glossary entries in.
+     * @return The HTML of the term definition's glossary.
+     */
+    static QString build(
+        const TermDefinition &def,
+        Constants::GlossaryStyle style);
+
+private:
+    /**
+     * Builds the HTML of a glossary without consulting the cache.
+     * @param definitions The glossary entries.
+     * @param basepath    The path where all external resources begin.
+     * @param style       The style to display the different entries in.
+     * @return The HTML of the glossary.
+     */
+    static QString buildHtml(
+        const QJsonArray &definitions,
+        QString basepath,
+        Constants::GlossaryStyle style);
+
+    /**
+     * @brief Adds structured style objects.
+     * @param      obj The structured style object.
+     * @param[out] out The string this style will be appended to.
+     */
+    static void addStructuredStyle(const QJsonObject &obj, QString &out);
+
+    /**
+     * Adds string structured content.
+     * @param      str The string to add.
+     * @param[out] out The string this string will be appended to.
+     */
+    static void addStructuredContentHelper(const QString &str, QString &out);
+
+    /**
+     * Adds an array of structured content.
+     * @param      arr      The array of structured content.
+     * @param      basepath The base of the image path.
+     * @param[out] out      The string this content will be appended to.
+     */
+    static void addStructuredContentHelper(
+        const QJsonArray &arr, const QString &basepath, QString &out);
+
+    /**
+     * Adds an object of structured content.
+     * @param      obj      The object of structured content.
+     * @param      basepath The base of the image path.
+     * @param[out] out      The string this content will be appended to.
+     */
+    static void addStructuredContentHelper(
+        const QJsonObject &obj, const QString &basepath, QString &out);
+
+    /**
+     * Parses and outputs structured content to HTML.
+     * The root of the structured content add parser.
+     * @param      val      The JSON value of the structured content.
+     * @param      basepath The base of the image path.
+     * @param[out] out      The string this content will be appended to.
+     */
+    static void addStructuredContent(
+        const QJsonValue &val, const QString &basepath, QString &out);
+
+    /**
+     * Displays an image type object.
+     * @param      obj      The image object.
+     * @param      basepath The base of the image path.
+     * @param[out] out      The string this image will be appended to.
+     */
+    static void addImage(
+        const QJsonObject &obj,
+        const QString &basepath,
+        QString &out);
+
+    /**
+     * Adds a text object to the HTML document.
+     * @param      obj   The text object.
+     * @param      style The style the glossary is displayed in.
+     * @param[out] out   The string the formatted text will be appended to.
+     */
+    static void addText(
+        const QJsonObject &obj,
+        Constants::GlossaryStyle style,
+        QString &out);
+};
+
+#endif // GLOSSARYHTMLBUILDER_H
@@ -22,22 +22,18 @@
 
 #include <QAbstractTextDocumentLayout>
 #include <QGuiApplication>
-#include <QJsonArray>
-#include <QJsonObject>
 #include <QScrollBar>
 #include <QSettings>
 #include <QTextBlock>
-#include <QThreadPool>
+
+#include "glossaryhtmlbuilder.h"
 
 #include "dict/dictionary.h"
 #include "util/constants.h"
+#include "util/executor.h"
 #include "util/globalmediator.h"
 #include "util/utils.h"
 
-/* The maximum allowed width of images. This is chosen with consideration of
- * DefinitionWidget's default 500px width. */
-#define MAX_WIDTH 350
-
 /* Begin Constructor/Destructor */
 
 GlossaryLabel::GlossaryLabel(
@@ -101,451 +97,21 @@ void GlossaryLabel::deselectText()
     setTextCursor(q);
 }
 
-#define KEY_TYPE                        "type"
-#define KEY_CONTENT                     "content"
-#define VALUE_TYPE_IMAGE                "image"
-#define VALUE_TYPE_STRUCTURED_CONTENT   "structured-content"
-#define VALUE_TYPE_TEXT                 "text"
-
-void GlossaryLabel::setContents(const QJsonArray &definitions, QString basepath)
+void GlossaryLabel::setSearchStyle(
+    const Qt::KeyboardModifier modifier,
+    const Constants::GlossaryStyle style)
 {
-#if defined(Q_OS_WIN)
-    basepath.prepend('/');
-    basepath.replace('\\', '/');
-#endif
-    basepath.prepend("file://");
-    basepath += '/';
-
-    QString content = "<html><head/><body>";
-    if (m_style == Constants::GlossaryStyle::Bullet)
-    {
-        content += "<ul>";
-    }
-    for (int i = 0; i < definitions.size(); ++i)
-    {
-        const QJsonValue &val = definitions[i];
-
-        if (m_style == Constants::GlossaryStyle::Bullet)
-        {
-            content += "<li>";
-        }
-
-        switch (val.type())
-        {
-        case QJsonValue::Type::String:
-            content += val
-                .toString()
-                .replace(
-                    '\n',
-                    m_style == Constants::GlossaryStyle::Bullet ?
-                        "</li><li>" : "<br>"
-                );
-            break;
-        case QJsonValue::Type::Object:
-        {
-            QJsonObject obj = val.toObject();
-            if (obj[KEY_TYPE] == VALUE_TYPE_STRUCTURED_CONTENT)
-            {
-                addStructuredContent(obj[KEY_CONTENT], basepath, content);
-            }
-            else if (obj[KEY_TYPE] == VALUE_TYPE_IMAGE)
-            {
-                addImage(obj, basepath, content);
-            }
-            else if (obj[KEY_TYPE] == VALUE_TYPE_TEXT)
-            {
-                addText(obj, content);
-            }
-            break;
-        }
-        default:
-            break;
-        }
-
-        if (m_style == Constants::GlossaryStyle::Bullet)
-        {
-            content += "</li>";
-        }
-        else if (i < definitions.size() - 1)
-        {
-            content +=
-                m_style == Constants::GlossaryStyle::LineBreak ? "<br>" : " | ";
-        }
-    }
-    if (m_style == Constants::GlossaryStyle::Bullet)
-    {
-        content += "</ul>";
-    }
-
-    content += "</body></html>";
-    setHtml(content);
+    m_searchModifier = modifier;
+    m_style = style;
+    m_currentIndex = -1;
 }
 
-#undef KEY_TYPE
-#undef KEY_CONTENT
-#undef VALUE_TYPE_IMAGE
-#undef VALUE_TYPE_STRUCTURED_CONTENT
-#undef VALUE_TYPE_TEXT
-
-/* End Public Methods */
-/* Begin Structured Content Parsing */
-
-#define KEY_FONT_STYLE      "fontStyle"
-#define KEY_FONT_WEIGHT     "fontWeight"
-#define KEY_FONT_SIZE       "fontSize"
-#define KEY_TEXT_DECORATION "textDecorationLine"
-#define KEY_VERTICAL_ALIGN  "verticalAlign"
-#define KEY_MARGIN_TOP      "marginTop"
-#define KEY_MARGIN_LEFT     "marginLeft"
-#define KEY_MARGIN_RIGHT    "marginRight"
-#define KEY_MARGIN_BOTTOM   "marginBottom"
-
-void GlossaryLabel::addStructuredStyle(
-    const QJsonObject &obj, QString &out) const
+void GlossaryLabel::setContents(const TermDefinition &def)
 {
-    if (obj[KEY_FONT_STYLE].isString())
-    {
-        out += "font-style: ";
-        out += obj[KEY_FONT_STYLE].toString("normal");
-        out += ';';
-    }
-
-    if (obj[KEY_FONT_WEIGHT].isString())
-    {
-        out += "font-weight: ";
-        out += obj[KEY_FONT_WEIGHT].toString("normal");
-        out += ';';
-    }
-
-    if (obj[KEY_FONT_SIZE].isString())
-    {
-        out += "font-size: ";
-        out += obj[KEY_FONT_SIZE].toString("medium");
-        out += ';';
-    }
-
-    if (obj[KEY_TEXT_DECORATION].isArray())
-    {
-        out += "text-decoration: ";
-        for (const QJsonValue &val : obj[KEY_TEXT_DECORATION].toArray())
-        {
-            out += val.toString("none");
-            out += ' ';
-        }
-        out += ';';
-    }
-    else if (obj[KEY_TEXT_DECORATION].isString())
-    {
-        out += "text-decoration: ";
-        out += obj[KEY_TEXT_DECORATION].toString("none");
-        out += ';';
-    }
-
-    if (obj[KEY_VERTICAL_ALIGN].isString())
-    {
-        out += "vertical-align: ";
-        out += obj[KEY_VERTICAL_ALIGN].toString("baseline");
-        out += ';';
-    }
-
-    if (obj[KEY_MARGIN_TOP].isDouble())
-    {
-        out += "margin-top: ";
-        out += QString::number((int)obj[KEY_MARGIN_TOP].toDouble(0.0));
-        out += "px;";
-    }
-
-    if (obj[KEY_MARGIN_LEFT].isDouble())
-    {
-        out += "margin-left: ";
-        out += QString::number((int)obj[KEY_MARGIN_LEFT].toDouble(0.0));
-        out += "px;";
-    }
-
-    if (obj[KEY_MARGIN_RIGHT].isDouble())
-    {
-        out += "margin-right: ";
-        out += QString::number((int)obj[KEY_MARGIN_RIGHT].toDouble(0.0));
-        out += "px;";
-    }
-
-    if (obj[KEY_MARGIN_BOTTOM].isDouble())
-    {
-        out += "margin-bottom: ";
-        out += QString::number((int)obj[KEY_MARGIN_BOTTOM].toDouble(0.0));
-        out += "px;";
-    }
-}
-
-#undef KEY_FONT_STYLE
-#undef KEY_FONT_WEIGHT
-#undef KEY_FONT_SIZE
-#undef KEY_TEXT_DECORATION
-#undef KEY_VERTICAL_ALIGN
-#undef KEY_MARGIN_TOP
-#undef KEY_MARGIN_LEFT
-#undef KEY_MARGIN_RIGHT
-#undef KEY_MARGIN_BOTTOM
-
-void GlossaryLabel::addStructuredContentHelper(
-    const QString &str, QString &out) const
-{
-    out += QString(str).replace('\n', "<br>");
-}
-
-void GlossaryLabel::addStructuredContentHelper(
-    const QJsonArray &arr, const QString &basepath, QString &out) const
-{
-    for (const QJsonValue &val : arr)
-    {
-        addStructuredContent(val, basepath, out);
-    }
+    setHtml(GlossaryHtmlBuilder::build(def, m_style));
 }
 
-#define KEY_TAG         "tag"
-#define KEY_CONTENT     "content"
-#define KEY_PATH        "path"
-#define KEY_WIDTH       "width"
-#define KEY_HEIGHT      "height"
-#define KEY_UNITS       "sizeUnits"
-#define KEY_VERT_ALIGN  "verticalAlign"
-#define KEY_COLSPAN     "colSpan"
-#define KEY_ROWSPAN     "rowSpan"
-#define KEY_STYLE       "style"
-
-void GlossaryLabel::addStructuredContentHelper(
-    const QJsonObject &obj, const QString &basepath, QString &out) const
-{
-    QString tag = obj[KEY_TAG].toString();
-    if (tag.isEmpty())
-    {
-        return;
-    }
-    else if (tag == "br")
-    {
-        out += "<br>";
-    }
-    else if (tag == "img")
-    {
-        out += "<img src=\"";
-        out += basepath;
-        out += '/';
-        out += obj[KEY_PATH].toString();
-        out += '"';
-
-        if (obj[KEY_UNITS].isNull() || obj[KEY_UNITS].toString() == "px")
-        {
-            double width = -1;
-            double height = -1;
-            if (obj[KEY_WIDTH].isDouble())
-            {
-                width = obj[KEY_WIDTH].toDouble();
-            }
-            if (obj[KEY_HEIGHT].isDouble())
-            {
-                height = obj[KEY_HEIGHT].toDouble();
-            }
-            /*
-             * As of right now, this code creates mustard gas because while
-             * QTextEdit does inherit its font from stylesheets set in a parent
-             * widget, there is no good way to get the font size. That means
-             * there is no good way to scale the text according to ems.
-             */
-            /*
-            if (obj[KEY_UNITS].toString() == "em")
-            {
-                int size = font().pixelSize();
-                if (size < 0)
-                {
-                    size = (int)(font().pointSize() / 0.75);
-                }
-                width *= size;
-                height *= size;
-            }
-            */
-            if (width > MAX_WIDTH)
-            {
-                height = MAX_WIDTH * height / width;
-                width = MAX_WIDTH;
-            }
-            if (width > 0)
-            {
-                out += " width=\"";
-                out += QString::number((int)width);
-                out += '"';
-            }
-            if (height > 0)
-            {
-                out += " height=\"";
-                out += QString::number((int)height);
-                out += '"';
-            }
-        }
-        if (obj[KEY_VERT_ALIGN].isString())
-        {
-            out += " style=\"vertical-align: ";
-            out += obj[KEY_VERT_ALIGN].toString();
-            out += ";\"";
-        }
-
-        out += '>';
-    }
-    else if (tag == "span" || tag == "div")
-    {
-        out += '<';
-        out += tag;
-        if (obj[KEY_STYLE].isObject())
-        {
-            out += " style=\"";
-            addStructuredStyle(obj[KEY_STYLE].toObject(), out);
-            out += '"';
-        }
-        out += '>';
-
-        addStructuredContent(obj[KEY_CONTENT], basepath, out);
-
-        out += "</" + tag + '>';
-    }
-    else if (tag == "td" || tag == "th")
-    {
-        out += '<';
-        out += tag;
-        if (obj[KEY_COLSPAN].isDouble())
-        {
-            out += " colspan=\"";
-            out += QString::number((int)obj[KEY_COLSPAN].toDouble());
-            out += '"';
-        }
-        if (obj[KEY_ROWSPAN].isDouble())
-        {
-            out += " rowspan=\"";
-            out += QString::number((int)obj[KEY_ROWSPAN].toDouble());
-            out += '"';
-        }
-        if (obj[KEY_STYLE].isObject())
-        {
-            out += " style=\"";
-            addStructuredStyle(obj[KEY_STYLE].toObject(), out);
-            out += '"';
-        }
-        out += '>';
-
-        addStructuredContent(obj[KEY_CONTENT], basepath, out);
-
-        out += "</" + tag + '>';
-    }
-    else
-    {
-        out += '<' + tag + '>';
-        addStructuredContent(obj[KEY_CONTENT], basepath, out);
-        out += "</" + tag + '>';
-    }
-}
-
-#undef KEY_TAG
-#undef KEY_CONTENT
-#undef KEY_PATH
-#undef KEY_WIDTH
-#undef KEY_HEIGHT
-#undef KEY_UNITS
-#undef KEY_COLSPAN
-#undef KEY_ROWSPAN
-#undef KEY_STYLE
-
-void GlossaryLabel::addStructuredContent(
-    const QJsonValue &val, const QString &basepath, QString &out) const
-{
-    switch (val.type())
-    {
-    case QJsonValue::Type::String:
-        addStructuredContentHelper(val.toString(), out);
-        break;
-    case QJsonValue::Type::Array:
-        addStructuredContentHelper(val.toArray(), basepath, out);
-        break;
-    case QJsonValue::Type::Object:
-        addStructuredContentHelper(val.toObject(), basepath, out);
-        break;
-    default:
-        break;
-    }
-}
-
-/* End Structured Content Parsing */
-/* Begin Other Object Parsers */
-
-#define KEY_IMAGE       "image"
-#define KEY_PATH        "path"
-#define KEY_WIDTH       "width"
-#define KEY_HEIGHT      "height"
-#define KEY_DESCRIPTION "description"
-
-void GlossaryLabel::addImage(
-    const QJsonObject &obj, const QString &basepath, QString &out) const
-{
-    out += "<img src=\"";
-    out += basepath;
-    out += '/';
-    out += obj[KEY_PATH].toString();
-    out += '"';
-
-    int width = MAX_WIDTH;
-    int height = -1;
-    if (obj[KEY_WIDTH].isDouble())
-    {
-        width = (int)obj[KEY_WIDTH].toDouble();
-    }
-    if (obj[KEY_HEIGHT].isDouble())
-    {
-        height = (int)obj[KEY_HEIGHT].toDouble();
-    }
-
-    if (width < 0 || width > MAX_WIDTH)
-    {
-        height = (int)((height * MAX_WIDTH) / ((double)width));
-        width = MAX_WIDTH;
-    }
-
-    out += " width=\"";
-    out += QString::number(width);
-    out += '"';
-    if (height > 0)
-    {
-        out += " height=\"";
-        out += QString::number(height);
-        out += '"';
-    }
-
-    out += '>';
-
-    if (obj[KEY_DESCRIPTION].isString())
-    {
-        out += "<br>";
-        out += obj[KEY_DESCRIPTION].toString().replace('\n', "<br>");
-    }
-}
-
-#undef KEY_IMAGE
-#undef KEY_PATH
-#undef KEY_WIDTH
-#undef KEY_HEIGHT
-#undef KEY_DESCRIPTION
-
-#define KEY_TEXT "text"
-
-void GlossaryLabel::addText(const QJsonObject &obj, QString &out) const
-{
-    out += obj[KEY_TEXT]
-        .toString()
-        .replace(
-            '\n',
-            m_style == Constants::GlossaryStyle::Bullet ? "</li><li>" : "<br>"
-        );
-}
-
-#undef KEY_TEXT
-
-/* End Other Object Parsers */
+/* End Public Methods */
 /* Begin Event Handlers */
 
 void GlossaryLabel::adjustSize()
@@ -636,13 +202,15 @@ void GlossaryLabel::mouseMoveEvent(QMouseEvent *event)
 
     int index = position - start;
     DictionaryWorker *worker = new DictionaryWorker(
-        query, text, index, position
+        query, text, index, position, m_style
     );
     connect(
         worker, &DictionaryWorker::searchDone,
         this, &GlossaryLabel::handleSearch
     );
-    QThreadPool::globalInstance()->start(worker);
+    Executor::get(Executor::Queue::Lookup)->start(
+        worker, Executor::Priority::Interactive
+    );
 }
 
 #undef MAX_SEARCH_SIZE
@@ -683,6 +251,8 @@ void DictionaryWorker::run()
         }
     }
 
+    GlossaryHtmlBuilder::prepare(terms, style);
+
     int length = 0;
     if (terms)
     {
@@ -45,11 +45,21 @@ public:
     virtual ~GlossaryLabel();
 
     /**
-     * Sets the contents of this label.
-     * @param definitions The definitions to add to this label.
-     * @param basepath    The path where all external resources begin.
+     * Sets the contents of this label to the glossary of a term definition.
+     * Uses the HTML prepared by the lookup if there is any.
+     * @param def The term definition to display.
      */
-    void setContents(const QJsonArray &definitions, QString basepath);
+    void setContents(const TermDefinition &def);
+
+    /**
+     * Sets how this label displays and searches its contents. Only affects
+     * contents set after this call.
+     * @param modifier The modifier that triggers recursive searches.
+     * @param style    The style to display different definitions in.
+     */
+    void setSearchStyle(
+        Qt::KeyboardModifier modifier,
+        Constants::GlossaryStyle style);
 
 public Q_SLOTS:
     /**
@@ -116,67 +126,6 @@ private Q_SLOTS:
         int length);
 
 private:
-    /**
-     * @brief Adds structured style objects.
-     * @param      obj The structured style object.
-     * @param[out] out The string this style will be appended to.
-     */
-    void addStructuredStyle(const QJsonObject &obj, QString &out) const;
-
-    /**
-     * Adds string structured content.
-     * @param      str The string to add.
-     * @param[out] out The string this string will be appended to.
-     */
-    void addStructuredContentHelper(
-        const QString &str, QString &out) const;
-
-    /**
-     * Adds an array of structured content.
-     * @param      arr      The array of structured content.
-     * @param      basepath The base of the image path.
-     * @param[out] out      The string this content will be appended to.
-     */
-    void addStructuredContentHelper(
-        const QJsonArray &arr, const QString &basepath, QString &out) const;
-
-    /**
-     * Adds an object of structured content.
-     * @param      obj      The object of structured content.
-     * @param      basepath The base of the image path.
-     * @param[out] out      The string this content will be appended to.
-     */
-    void addStructuredContentHelper(
-        const QJsonObject &obj, const QString &basepath, QString &out) const;
-
-    /**
-     * Parses and outputs structured content to HTML.
-     * The root of the structured content add parser.
-     * @param      val      The JSON value of the structured content.
-     * @param      basepath The base of the image path.
-     * @param[out] out      The string this content will be appended to.
-     */
-    void addStructuredContent(
-        const QJsonValue &val, const QString &basepath, QString &out) const;
-
-    /**
-     * Displays an image type object.
-     * @param      obj      The image object.
-     * @param      basepath The base of the image path.
-     * @param[out] out      The string this image will be appended to.
-     */
-    void addImage(
-        const QJsonObject &obj,
-        const QString &basepath,
-        QString &out) const;
-
-    /**
-     * Adds a text object to the HTML document.
-     * @param      obj The text object.
-     * @param[out] out The string the formatted text will be appended to.
-     */
-    void addText(const QJsonObject &obj, QString &out) const;
-
     /* The modifier that triggers searches */
     Qt::KeyboardModifier m_searchModifier = Qt::KeyboardModifier::ShiftModifier;
 
@@ -201,17 +150,20 @@ public:
      * @param sentence The sentence containing the query.
      * @param index    The position of the query in the sentence.
      * @param position The position of the query in the entire text.
+     * @param style    The style glossaries of the results are displayed in.
      */
     DictionaryWorker(
         const QString &query,
         const QString &sentence,
         int index,
-        int position
+        int position,
+        Constants::GlossaryStyle style
     ) : QObject(nullptr),
         query(query),
         sentence(sentence),
         index(index),
-        position(position) {}
+        position(position),
+        style(style) {}
 
     /**
      * Searches the dictionary and emits are signal when finished.
@@ -245,6 +197,9 @@ private:
 
     /* The position of the query in the entire text */
     int position;
+
+    /* The style glossaries of the results are displayed in */
+    const Constants::GlossaryStyle style;
 };
 
 #endif // GLOSSARYLABEL_H
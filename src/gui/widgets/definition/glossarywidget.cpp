@@ -22,7 +22,8 @@
 
 #include "tagwidget.h"
 
-#include "util/utils.h"
+/* The index of the first tag in the header layout */
+#define HEADER_TAG_START 2
 
 GlossaryWidget::GlossaryWidget(
     const size_t number,
@@ -30,8 +31,7 @@ GlossaryWidget::GlossaryWidget(
     const Qt::KeyboardModifier modifier,
     const Constants::GlossaryStyle style,
     QWidget *parent)
-    : QWidget(parent),
-      m_def(def)
+    : QWidget(parent)
 {
     m_parentLayout  = new QVBoxLayout(this);
     m_layoutHeader  = new FlowLayout(-1, 6);
@@ -45,41 +45,66 @@ GlossaryWidget::GlossaryWidget(
 
     m_layoutHeader->addWidget(m_checkBoxAdd);
     m_layoutHeader->addWidget(m_labelNumber);
-    for (const Tag &tag : m_def.tags)
+
+#if defined(Q_OS_MACOS)
+    m_checkBoxAdd->setText(" ");
+#else
+    m_checkBoxAdd->setText("");
+#endif
+    m_checkBoxAdd->setToolTip("Add this entry to an Anki note");
+
+    connect(
+        m_glossaryLabel, &GlossaryLabel::contentSearched,
+        this, &GlossaryWidget::contentSearched
+    );
+
+    setDefinition(number, def, modifier, style);
+}
+
+void GlossaryWidget::setDefinition(
+    const size_t number,
+    const TermDefinition &def,
+    const Qt::KeyboardModifier modifier,
+    const Constants::GlossaryStyle style)
+{
+    m_def = &def;
+
+    int tagIndex = HEADER_TAG_START;
+    for (const Tag &tag : m_def->tags)
     {
-        m_layoutHeader->addWidget(new TagWidget(tag));
+        TagWidget::reuse(m_layoutHeader, tagIndex++)->setTag(tag);
     }
-    for (const Tag &rule : m_def.rules)
+    for (const Tag &rule : m_def->rules)
     {
-        if (m_def.tags.contains(rule))
+        if (m_def->tags.contains(rule))
         {
             continue;
         }
-        m_layoutHeader->addWidget(new TagWidget(rule));
+        TagWidget::reuse(m_layoutHeader, tagIndex++)->setTag(rule);
+    }
+    TagWidget::reuse(m_layoutHeader, tagIndex++)->setDictionary(
+        m_def->dictionary
+    );
+
+    /* Remove tags left over from the previous definition */
+    QLayoutItem *item;
+    while ((item = m_layoutHeader->takeAt(tagIndex)) != nullptr)
+    {
+        delete item->widget();
+        delete item;
     }
-    m_layoutHeader->addWidget(new TagWidget(m_def.dictionary));
 
     m_checkBoxAdd->setChecked(true);
-#if defined(Q_OS_MACOS)
-    m_checkBoxAdd->setText(" ");
-#else
-    m_checkBoxAdd->setText("");
-#endif
-    m_checkBoxAdd->setToolTip("Add this entry to an Anki note");
     m_checkBoxAdd->hide();
 
     m_labelNumber->setText(QString::number(number) + ".");
 
-    m_glossaryLabel->setContents(
-        m_def.glossary,
-        DirectoryUtils::getDictionaryResourceDir() + SLASH + m_def.dictionary
-    );
-    connect(
-        m_glossaryLabel, &GlossaryLabel::contentSearched,
-        this, &GlossaryWidget::contentSearched
-    );
+    m_glossaryLabel->setSearchStyle(modifier, style);
+    m_glossaryLabel->setContents(*m_def);
 }
 
+#undef HEADER_TAG_START
+
 void GlossaryWidget::setCheckable(const bool value)
 {
     m_checkBoxAdd->setVisible(value);
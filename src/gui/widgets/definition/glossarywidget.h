@@ -54,6 +54,20 @@ public:
         Constants::GlossaryStyle style,
         QWidget *parent = nullptr);
 
+    /**
+     * Rebinds this widget to a different term definition. Tags are reused
+     * where possible instead of being reconstructed.
+     * @param number   The number to label the term.
+     * @param def      The term definition to display.
+     * @param modifier The modifier key for triggering searches.
+     * @param style    The style of the GlossaryLabel.
+     */
+    void setDefinition(
+        size_t number,
+        const TermDefinition &def,
+        Qt::KeyboardModifier modifier,
+        Constants::GlossaryStyle style);
+
     /**
      * Shows the checkbox next to the term.
      * @param value If true shows the checkbox, otherwise it hides it.
@@ -83,7 +97,7 @@ Q_SIGNALS:
 
 private:
     /* The term definition this widget displays. */
-    const TermDefinition &m_def;
+    const TermDefinition *m_def = nullptr;
 
     /* The parent layout of this widget. */
     QVBoxLayout *m_parentLayout;
@@ -26,6 +26,8 @@
 
 #include "tagwidget.h"
 
+#include "util/utils.h"
+
 #define LH_STYLE    (QString(\
                         "QLabel {"\
 	                        "border-style: solid;"\
@@ -88,7 +90,11 @@ PitchWidget::PitchWidget(const Pitch &pitch, QWidget *parent) : QWidget(parent)
 
     layoutParent->addWidget(new TagWidget(pitch), 0, Qt::AlignLeft);
 
-    QString color = palette().color(foregroundRole()).name();
+    const QString color = palette().color(foregroundRole()).name();
+    const QString lhStyle = LH_STYLE.arg(color);
+    const QString hlStyle = HL_STYLE.arg(color);
+    const QString hStyle = H_STYLE.arg(color);
+    const QString lStyle = L_STYLE.arg(color);
     for (const uint8_t pos : pitch.position)
     {
         QHBoxLayout *layoutLine = new QHBoxLayout;
@@ -96,66 +102,14 @@ PitchWidget::PitchWidget(const Pitch &pitch, QWidget *parent) : QWidget(parent)
         layoutLine->setSpacing(0);
         layoutParent->addLayout(layoutLine);
 
-        switch (pos)
-        {
-        case 0:
-        {
-            QString text  = pitch.mora.first();
-            QString style = LH_STYLE.arg(color);
-            layoutLine->addWidget(createLabel(text, style));
-
-            if (pitch.mora.size() > 1)
-            {
-                text = pitch.mora.join("");
-                text.remove(0, pitch.mora.first().size());
-                style = H_STYLE.arg(color);
-                layoutLine->addWidget(createLabel(text, style));
-            }
-            break;
-        }
-        case 1:
+        const QList<GraphicUtils::PitchSegment> segments =
+            GraphicUtils::splitPitch(pitch.mora, pos);
+        for (const GraphicUtils::PitchSegment &segment : segments)
         {
-            QString text  = pitch.mora.first();
-            QString style = HL_STYLE.arg(color);
-            layoutLine->addWidget(createLabel(text, style));
-
-            if (pitch.mora.size() > 1)
-            {
-                text = pitch.mora.join("");
-                text.remove(0, pitch.mora.first().size());
-                style = L_STYLE.arg(color);
-                layoutLine->addWidget(createLabel(text, style));
-            }
-            break;
-        }
-        default:
-        {
-            QString text  = pitch.mora.first();
-            QString style = LH_STYLE.arg(color);
-            layoutLine->addWidget(createLabel(text, style));
-
-            text.clear();
-            for (size_t i = 1; i < pos; ++i)
-            {
-                text += pitch.mora[i];
-            }
-            if (!text.isEmpty())
-            {
-                style = HL_STYLE.arg(color);
-                layoutLine->addWidget(createLabel(text, style));
-            }
-
-            text.clear();
-            for (int i = (int)pos; i < pitch.mora.size(); ++i)
-            {
-                text += pitch.mora[i];
-            }
-            if (!text.isEmpty())
-            {
-                style = L_STYLE.arg(color);
-                layoutLine->addWidget(createLabel(text, style));
-            }
-        }
+            const QString &style = segment.high ?
+                (segment.change ? hlStyle : hStyle) :
+                (segment.change ? lhStyle : lStyle);
+            layoutLine->addWidget(createLabel(segment.text, style));
         }
 
         QLabel *labelNumber = new QLabel;
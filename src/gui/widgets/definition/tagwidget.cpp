@@ -21,6 +21,7 @@
 #include "tagwidget.h"
 
 #include <QDebug>
+#include <QLayout>
 
 /**
  * Stylesheet format string.
@@ -45,6 +46,35 @@
 #define FREQ_FORMAT     (QString("%1 <span style=\"color: black;\">%2</span>"))
 
 TagWidget::TagWidget(const Tag &tag, QWidget *parent) : TagWidget(parent)
+{
+    setTag(tag);
+}
+
+TagWidget::TagWidget(const Frequency &freq, QWidget *parent) : TagWidget(parent)
+{
+    setFrequency(freq);
+}
+
+TagWidget::TagWidget(const Pitch &pitch, QWidget *parent) : TagWidget(parent)
+{
+    setStyleSheet(STYLE_FORMAT.arg(colors[pitch_accent]));
+    setText(pitch.dictionary);
+    setToolTip(pitch.dictionary);
+}
+
+TagWidget::TagWidget(const QString &dicName, QWidget *parent) : TagWidget(parent)
+{
+    setDictionary(dicName);
+}
+
+TagWidget::TagWidget(QWidget *parent) : QLabel(parent)
+{
+    setTextInteractionFlags(Qt::TextSelectableByMouse);
+    setAlignment(Qt::AlignCenter);
+    setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+}
+
+void TagWidget::setTag(const Tag &tag)
 {
     TagColor color = def;
     if (tag.category == "name")
@@ -93,30 +123,28 @@ TagWidget::TagWidget(const Tag &tag, QWidget *parent) : TagWidget(parent)
     setText(tag.name);
 }
 
-TagWidget::TagWidget(const Frequency &freq, QWidget *parent) : TagWidget(parent)
+void TagWidget::setFrequency(const Frequency &freq)
 {
     setStyleSheet(STYLE_FORMAT.arg(colors[frequency]));
     setText(FREQ_FORMAT.arg(freq.dictionary).arg(freq.freq));
     setToolTip(freq.dictionary);
 }
 
-TagWidget::TagWidget(const Pitch &pitch, QWidget *parent) : TagWidget(parent)
-{
-    setStyleSheet(STYLE_FORMAT.arg(colors[pitch_accent]));
-    setText(pitch.dictionary);
-    setToolTip(pitch.dictionary);
-}
-
-TagWidget::TagWidget(const QString &dicName, QWidget *parent) : TagWidget(parent)
+void TagWidget::setDictionary(const QString &dicName)
 {
     setStyleSheet(STYLE_FORMAT.arg(colors[dictionary]));
     setToolTip(dicName);
     setText(dicName);
 }
 
-TagWidget::TagWidget(QWidget *parent) : QLabel(parent)
+TagWidget *TagWidget::reuse(QLayout *layout, const int index)
 {
-    setTextInteractionFlags(Qt::TextSelectableByMouse);
-    setAlignment(Qt::AlignCenter);
-    setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+    QLayoutItem *item = layout->itemAt(index);
+    TagWidget *tag = item ? qobject_cast<TagWidget *>(item->widget()) : nullptr;
+    if (tag == nullptr)
+    {
+        tag = new TagWidget;
+        layout->addWidget(tag);
+    }
+    return tag;
 }
@@ -61,6 +61,34 @@ public:
      */
     TagWidget(const QString &dicName, QWidget *parent = nullptr);
 
+    /**
+     * Makes this a normal tag for the Tag.
+     * @param tag The tag to display.
+     */
+    void setTag(const Tag &tag);
+
+    /**
+     * Makes this a frequency tag for the Frequency.
+     * @param freq The frequency to display.
+     */
+    void setFrequency(const Frequency &freq);
+
+    /**
+     * Makes this a dictionary tag for the dictionary name.
+     * @param dicName The name of the dictionary.
+     */
+    void setDictionary(const QString &dicName);
+
+    /**
+     * Returns the TagWidget at an index of a layout so it can be rebound
+     * instead of being reconstructed. Appends a new TagWidget to the layout if
+     * the item at the index doesn't exist.
+     * @param layout The layout containing the tags.
+     * @param index  The index of the tag in the layout.
+     * @return The TagWidget at the index. Belongs to the layout.
+     */
+    static TagWidget *reuse(QLayout *layout, int index);
+
 private:
     /**
      * General constructor that sets options common between all the
@@ -23,9 +23,6 @@
 
 #include <QClipboard>
 #include <QMenu>
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
-#include <QNetworkRequest>
 
 #include "definitionwidget.h"
 #include "glossarywidget.h"
@@ -33,6 +30,8 @@
 #include "tagwidget.h"
 
 #include "audio/audioplayer.h"
+#include "audio/audiosourceresolver.h"
+#include "audio/localaudiolibrary.h"
 #include "dict/dictionary.h"
 #include "gui/widgets/subtitlelistwidget.h"
 #include "util/constants.h"
@@ -81,9 +80,7 @@ TermWidget::TermWidget(
       m_ui(new Ui::TermWidget),
       m_term(term),
       m_state(state),
-      m_client(GlobalMediator::getGlobalMediator()->getAnkiClient()),
-      m_sources(state.sources),
-      m_jsonSources(state.jsonSourceCount)
+      m_client(GlobalMediator::getGlobalMediator()->getAnkiClient())
 {
     m_ui->setupUi(this);
 
@@ -106,24 +103,12 @@ TermWidget::TermWidget(
     m_ui->layoutGlossaryContainer->addStretch();
 
     IconFactory *factory = IconFactory::create();
-
-    m_ui->buttonCollapse->setIcon(factory->getIcon(IconFactory::Icon::down));
-
     m_ui->buttonAddCard->setIcon(factory->getIcon(IconFactory::Icon::plus));
-    m_ui->buttonAddCard->setVisible(false);
-
-    m_ui->buttonKanaKanji->setIcon(factory->getIcon(IconFactory::Icon::kanji));
-    m_ui->buttonKanaKanji->setVisible(false);
-
     m_ui->buttonAnkiOpen->setIcon(
         factory->getIcon(IconFactory::Icon::hamburger)
     );
-    m_ui->buttonAnkiOpen->setVisible(false);
-
-    m_ui->buttonAudio->setIcon(factory->getIcon(IconFactory::Icon::audio));
-    m_ui->buttonAudio->setVisible(!m_sources.empty());
 
-    initUi(*term, m_state.searchModifier, m_state.glossaryStyle);
+    setTerm(term);
 
     connect(
         m_ui->buttonCollapse, &QToolButton::clicked,
@@ -180,6 +165,79 @@ void TermWidget::deleteWhenReady()
 }
 
 /* End Constructor/Destructor */
+/* Begin Recycling */
+
+void TermWidget::setTerm(QSharedPointer<const Term> term)
+{
+    /* Drop handlers queued for the previous term's audio sources */
+    disconnect(this, &TermWidget::audioSourcesLoaded, this, nullptr);
+
+    m_term = term;
+    m_sources = m_state.sources;
+    m_jsonSources = m_state.jsonSourceCount;
+    loadLocalAudioSources();
+    m_readingAsExp = false;
+    m_menuAdd->clear();
+    m_menuAudio->clear();
+
+    IconFactory *factory = IconFactory::create();
+
+    m_ui->buttonCollapse->setIcon(factory->getIcon(IconFactory::Icon::down));
+    m_ui->glossaryContainer->show();
+
+    m_ui->buttonAddCard->setVisible(false);
+    m_ui->buttonAddCard->setEnabled(true);
+
+    m_ui->buttonKanaKanji->setIcon(factory->getIcon(IconFactory::Icon::kanji));
+    m_ui->buttonKanaKanji->setVisible(false);
+    m_ui->buttonKanaKanji->setEnabled(true);
+
+    m_ui->buttonAnkiOpen->setVisible(false);
+
+    m_ui->buttonAudio->setIcon(factory->getIcon(IconFactory::Icon::audio));
+    m_ui->buttonAudio->setVisible(!m_sources.empty());
+    m_ui->buttonAudio->setEnabled(true);
+
+    initUi(*m_term, m_state.searchModifier, m_state.glossaryStyle);
+}
+
+bool TermWidget::isRecyclable()
+{
+    if (m_ankiTerm)
+    {
+        return false;
+    }
+
+    /* Held while JSON audio sources are loading */
+    if (!m_lockSources.tryLock())
+    {
+        return false;
+    }
+    m_lockSources.unlock();
+    return true;
+}
+
+int TermWidget::definitionCount() const
+{
+    return m_layoutGlossary->count();
+}
+
+/**
+ * Deletes every item in a layout starting at an index along with its widget.
+ * @param layout The layout to remove items from.
+ * @param start  The index of the first item to remove.
+ */
+static void removeItems(QLayout *layout, const int start)
+{
+    QLayoutItem *item;
+    while ((item = layout->takeAt(start)) != nullptr)
+    {
+        delete item->widget();
+        delete item;
+    }
+}
+
+/* End Recycling */
 /* Begin Initializers */
 
 void TermWidget::initUi(
@@ -208,39 +266,54 @@ void TermWidget::initUi(
     }
     m_ui->labelKanji->setText(kanjiLabelText);
 
-    for (const Frequency &freq : term.frequencies)
+    for (int i = 0; i < term.frequencies.size(); ++i)
     {
-        TagWidget *tag = new TagWidget(freq);
-        m_layoutFreqTags->addWidget(tag);
+        TagWidget::reuse(m_layoutFreqTags, i)->setFrequency(
+            term.frequencies[i]
+        );
     }
+    removeItems(m_layoutFreqTags, term.frequencies.size());
 
+    /* Pitches are rare and their layout depends on the pitch, so they are
+     * always rebuilt */
+    removeItems(m_layoutPitches, 0);
     for (const Pitch &pitch : term.pitches)
     {
         m_layoutPitches->addWidget(new PitchWidget(pitch));
     }
 
-    for (const Tag &termTag : term.tags)
+    for (int i = 0; i < term.tags.size(); ++i)
     {
-        TagWidget *tag = new TagWidget(termTag);
-        m_layoutTermTags->addWidget(tag);
+        TagWidget::reuse(m_layoutTermTags, i)->setTag(term.tags[i]);
     }
+    removeItems(m_layoutTermTags, term.tags.size());
 
     QSharedPointer<const AnkiConfig> config = m_client->getConfig();
     for (int i = 0; i < term.definitions.size(); ++i)
     {
-        GlossaryWidget *g = new GlossaryWidget(
+        GlossaryWidget *g = nullptr;
+        if (i < m_layoutGlossary->count())
+        {
+            g = (GlossaryWidget *)m_layoutGlossary->itemAt(i)->widget();
+            g->setDefinition(i + 1, term.definitions[i], modifier, style);
+        }
+        else
+        {
+            g = new GlossaryWidget(
                 i + 1, term.definitions[i], modifier, style
             );
+            m_layoutGlossary->addWidget(g);
+
+            connect(
+                g, &GlossaryWidget::contentSearched,
+                this, &TermWidget::contentSearched
+            );
+        }
         g->setChecked(
             !config->excludeGloss.contains(term.definitions[i].dictionary)
         );
-        m_layoutGlossary->addWidget(g);
-
-        connect(
-            g, &GlossaryWidget::contentSearched,
-            this, &TermWidget::contentSearched
-        );
     }
+    removeItems(m_layoutGlossary, term.definitions.size());
 }
 
 Term *TermWidget::initAnkiTerm() const
@@ -348,6 +421,7 @@ void TermWidget::addNote(const AudioSource &src)
     AnkiReply *reply = m_client->addNote(m_ankiTerm);
     m_ankiTerm = nullptr;
     Q_EMIT safeToDelete();
+    QSharedPointer<const Term> term = m_term;
     connect(reply, &AnkiReply::finishedInt, this,
         [=] (const int, const QString &error) {
             if (!error.isEmpty())
@@ -355,7 +429,7 @@ void TermWidget::addNote(const AudioSource &src)
                 Q_EMIT GlobalMediator::getGlobalMediator()
                     ->showCritical("Error Adding Note", error);
             }
-            else
+            else if (term == m_term)
             {
                 m_ui->buttonAnkiOpen->show();
                 m_ui->buttonAddCard->hide();
@@ -421,21 +495,19 @@ void TermWidget::playAudio(const AudioSource &src)
     m_ui->buttonAudio->setEnabled(false);
     AudioPlayerReply *reply =
         GlobalMediator::getGlobalMediator()->getAudioPlayer()->playAudio(
-            QString(src.url)
-                .replace(REPLACE_EXPRESSION, m_term->expression)
-                .replace(
-                    REPLACE_READING,
-                    m_term->reading.isEmpty() ?
-                        m_term->expression : m_term->reading
-                ),
-            src.md5
+            getAudioUrl(src, *m_term), src.md5
         );
     m_ui->buttonAudio->setEnabled(reply == nullptr);
 
     if (reply)
     {
+        QSharedPointer<const Term> term = m_term;
         connect(reply, &AudioPlayerReply::result, this,
             [=] (const bool success) {
+                if (term != m_term)
+                {
+                    return;
+                }
                 if (!success)
                 {
                     IconFactory *factory = IconFactory::create();
@@ -534,122 +606,96 @@ void TermWidget::setAddable(bool expression, bool reading)
 /* End Setters */
 /* Begin Helpers */
 
-#define JSON_KEY_TYPE               "type"
-#define JSON_VALUE_TYPE             "audioSourceList"
-#define JSON_KEY_AUDIO_SOURCES      "audioSources"
-#define JSON_KEY_AUDIO_SOURCES_NAME "name"
-#define JSON_KEY_AUDIO_SOURCES_URL  "url"
-
-/**
- * Processes raw JSON audio sources into a list of audio sources.
- * @param      data The raw json.
- * @param[out] src  The audio source these audio sources belong to.
- */
-static inline void processAudioSourceJson(
-    const QByteArray &data, AudioSource &src)
+void TermWidget::loadAudioSources()
 {
-    QJsonDocument doc = QJsonDocument::fromJson(data);
-    if (!doc.isObject())
-    {
-        return;
-    }
-    QJsonObject obj = doc.object();
-    if (obj[JSON_KEY_TYPE].toString() != JSON_VALUE_TYPE)
-    {
-        return;
-    }
-    if (!obj[JSON_KEY_AUDIO_SOURCES].isArray())
+    if (!m_lockSources.tryLock())
     {
         return;
     }
-    for (const QJsonValue &val : obj[JSON_KEY_AUDIO_SOURCES].toArray())
+
+    AudioSourceResolver *resolver =
+        GlobalMediator::getGlobalMediator()->getAudioSourceResolver();
+    for (size_t i = 0; i < m_sources.size(); ++i)
     {
-        if (!val.isObject())
-        {
-            continue;
-        }
-        QJsonObject srcObj = val.toObject();
-        if (!srcObj[JSON_KEY_AUDIO_SOURCES_NAME].isString() ||
-            !srcObj[JSON_KEY_AUDIO_SOURCES_URL].isString())
+        const AudioSource &src = m_sources[i];
+        if (src.type != Constants::AudioSourceType::JSON)
         {
             continue;
         }
 
-        AudioSource childSrc;
-        childSrc.type = Constants::AudioSourceType::File;
-        childSrc.name = srcObj[JSON_KEY_AUDIO_SOURCES_NAME].toString();
-        childSrc.url = srcObj[JSON_KEY_AUDIO_SOURCES_URL].toString();
-        childSrc.md5 = src.md5;
-        src.audioSources.emplace_back(childSrc);
-    }
-}
+        AudioSourceResolverReply *reply =
+            resolver->resolve(getAudioUrl(src, *m_term));
+        connect(reply, &AudioSourceResolverReply::finished, this,
+            [=] (const QList<ResolvedAudioSource> &sources) {
+                AudioSource &parent = m_sources[i];
+                for (const ResolvedAudioSource &resolved : sources)
+                {
+                    AudioSource childSrc;
+                    childSrc.type = Constants::AudioSourceType::File;
+                    childSrc.name = resolved.name;
+                    childSrc.url = resolved.url;
+                    childSrc.md5 = parent.md5;
+                    parent.audioSources.emplace_back(childSrc);
+                }
 
-#undef JSON_KEY_TYPE
-#undef JSON_VALUE_TYPE
-#undef JSON_KEY_AUDIO_SOURCES
-#undef JSON_KEY_AUDIO_SOURCES_NAME
-#undef JSON_KEY_AUDIO_SOURCES_URL
+                m_lockJsonSources.lock();
+                if (--m_jsonSources == 0)
+                {
+                    m_lockJsonSources.unlock();
+                    populateAudioSourceMenu(
+                        m_menuAdd,
+                        [=] (const AudioSource &src) { addNote(src); }
+                    );
+                    populateAudioSourceMenu(
+                        m_menuAudio,
+                        [=] (const AudioSource &src) { playAudio(src); }
+                    );
+                    m_lockSources.unlock();
 
-#define TRANSFER_TIMEOUT 5000
+                    Q_EMIT audioSourcesLoaded();
+                }
+                else
+                {
+                    m_lockJsonSources.unlock();
+                }
+            }
+        );
+    }
+}
 
-void TermWidget::loadAudioSources()
+void TermWidget::loadLocalAudioSources()
 {
-    if (!m_lockSources.tryLock())
+    LocalAudioLibrary *library =
+        GlobalMediator::getGlobalMediator()->getLocalAudioLibrary();
+    if (library == nullptr)
     {
         return;
     }
 
-    QNetworkAccessManager *manager = new QNetworkAccessManager(this);
-    manager->setTransferTimeout(TRANSFER_TIMEOUT);
-    for (size_t i = 0; i < m_sources.size(); ++i)
+    for (AudioSource &src : m_sources)
     {
-        const AudioSource &src = m_sources[i];
-        if (src.type != Constants::AudioSourceType::JSON)
+        if (src.type != Constants::AudioSourceType::Local)
         {
             continue;
         }
 
-        QString url = src.url;
-        url.replace(REPLACE_EXPRESSION, m_term->expression)
-           .replace(
-               REPLACE_READING,
-               m_term->reading.isEmpty() ? m_term->expression : m_term->reading
-            );
-        QNetworkReply *reply = manager->get(QNetworkRequest(QUrl(url)));
-        connect(reply, &QNetworkReply::finished, this, [=] {
-            if (reply->error() == QNetworkReply::NoError)
-            {
-                processAudioSourceJson(reply->readAll(), m_sources[i]);
-            }
-
-            m_lockJsonSources.lock();
-            if (--m_jsonSources == 0)
-            {
-                m_lockJsonSources.unlock();
-                populateAudioSourceMenu(
-                    m_menuAdd,
-                    [=] (const AudioSource &src) { addNote(src); }
-                );
-                populateAudioSourceMenu(
-                    m_menuAudio,
-                    [=] (const AudioSource &src) { playAudio(src); }
-                );
-                m_lockSources.unlock();
-                manager->deleteLater();
-
-                Q_EMIT audioSourcesLoaded();
-            }
-            else
-            {
-                m_lockJsonSources.unlock();
-            }
-        });
-        connect(reply, &QNetworkReply::finished, reply, &QObject::deleteLater);
+        const QList<ResolvedAudioSource> files = library->find(
+            LocalAudioLibrary::splitRoots(src.url),
+            m_term->expression,
+            m_term->reading
+        );
+        for (const ResolvedAudioSource &file : files)
+        {
+            AudioSource childSrc;
+            childSrc.type = Constants::AudioSourceType::File;
+            childSrc.name = src.name + " " + file.name;
+            childSrc.url = file.url;
+            childSrc.md5 = src.md5;
+            src.audioSources.emplace_back(childSrc);
+        }
     }
 }
 
-#undef TRANSFER_TIMEOUT
-
 void TermWidget::populateAudioSourceMenu(
     QMenu *menu,
     std::function<void(const AudioSource &)> handler)
@@ -661,7 +707,8 @@ void TermWidget::populateAudioSourceMenu(
         {
             menu->addAction(src.name, this, [=] { handler(src); });
         }
-        else if (src.type == Constants::AudioSourceType::JSON)
+        else if (src.type == Constants::AudioSourceType::JSON ||
+                 src.type == Constants::AudioSourceType::Local)
         {
             for (const AudioSource &childSrc : src.audioSources)
             {
@@ -673,6 +720,16 @@ void TermWidget::populateAudioSourceMenu(
     }
 }
 
+QString TermWidget::getAudioUrl(const AudioSource &src, const Term &term)
+{
+    return QString(src.url)
+        .replace(REPLACE_EXPRESSION, term.expression)
+        .replace(
+            REPLACE_READING,
+            term.reading.isEmpty() ? term.expression : term.reading
+        );
+}
+
 AudioSource *TermWidget::getFirstAudioSource()
 {
     AudioSource *ret = nullptr;
@@ -684,7 +741,8 @@ AudioSource *TermWidget::getFirstAudioSource()
             break;
         }
         else if (
-            src.type == Constants::AudioSourceType::JSON &&
+            (src.type == Constants::AudioSourceType::JSON ||
+             src.type == Constants::AudioSourceType::Local) &&
             !src.audioSources.empty()
         )
         {
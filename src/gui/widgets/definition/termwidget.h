@@ -59,6 +59,27 @@ public:
         QWidget *parent = nullptr);
     ~TermWidget();
 
+    /**
+     * Rebinds this widget to a different term. Child widgets are reused where
+     * the new term has the same shape as the old one.
+     * Should only be called if isRecyclable() is true.
+     * @param term The term to display. Does not take ownership.
+     */
+    void setTerm(QSharedPointer<const Term> term);
+
+    /**
+     * Returns if this widget can be rebound to a different term without
+     * interrupting outstanding network requests.
+     * @return true if the widget can be recycled, false otherwise.
+     */
+    bool isRecyclable();
+
+    /**
+     * Returns the number of definitions this widget is displaying.
+     * @return The number of GlossaryWidgets this widget contains.
+     */
+    int definitionCount() const;
+
     /**
      * Sets this widget to be addable.
      * @param expression true if the expression is addable, false otherwise
@@ -71,6 +92,16 @@ public:
      */
     void deleteWhenReady();
 
+    /**
+     * Fills in the expression and reading of an audio source URL.
+     * @param src  The audio source.
+     * @param term The term to get the URL for.
+     * @return The URL of the term's audio from the source.
+     */
+    static QString getAudioUrl(
+        const DefinitionState::AudioSource &src,
+        const Term &term);
+
 public Q_SLOTS:
     /**
      * Plays the audio from the first available source.
@@ -180,6 +211,12 @@ private:
      */
     void loadAudioSources();
 
+    /**
+     * Fills in the audio files of every local audio source from the local
+     * audio library.
+     */
+    void loadLocalAudioSources();
+
     /**
      * Populates an audio source menu that calls the handler with the specific
      * audio source.
@@ -0,0 +1,171 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "executorstatswindow.h"
+
+#include <QHeaderView>
+#include <QLabel>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+#include "util/executor.h"
+
+/* The number of milliseconds between refreshes */
+#define REFRESH_INTERVAL 1000
+
+/* Column indices */
+#define COLUMN_NAME 0
+#define COLUMN_WAIT 1
+#define COLUMN_RUN  2
+
+/* Begin Constructor/Destructor */
+
+ExecutorStatsWindow::ExecutorStatsWindow(QWidget *parent) : QDialog(parent)
+{
+    setWindowTitle("Memento - Thread Pool Statistics");
+    resize(520, 480);
+
+    QVBoxLayout *parentLayout = new QVBoxLayout(this);
+
+    m_tree = new QTreeWidget;
+    m_tree->setColumnCount(3);
+    m_tree->setHeaderLabels({"Queue", "Wait Time", "Run Time"});
+    m_tree->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_tree->setSelectionMode(QAbstractItemView::NoSelection);
+    parentLayout->addWidget(m_tree);
+
+    m_searchLabel = new QLabel;
+    m_searchLabel->setWordWrap(true);
+    parentLayout->addWidget(m_searchLabel);
+    setSearchMetrics(SearchWidget::Metrics());
+
+    for (const Executor::Statistics &stats : Executor::statistics())
+    {
+        QTreeWidgetItem *queueItem = new QTreeWidgetItem(m_tree);
+        queueItem->setText(COLUMN_NAME, stats.name);
+        for (int i = 0; i < Executor::HISTOGRAM_BUCKETS; ++i)
+        {
+            QTreeWidgetItem *bucketItem = new QTreeWidgetItem(queueItem);
+            bucketItem->setText(
+                COLUMN_NAME, Executor::Histogram::bucketLabel(i)
+            );
+        }
+    }
+
+    m_timer.setInterval(REFRESH_INTERVAL);
+    connect(&m_timer, &QTimer::timeout, this, &ExecutorStatsWindow::refresh);
+}
+
+#undef REFRESH_INTERVAL
+
+/* End Constructor/Destructor */
+/* Begin Event Handlers */
+
+void ExecutorStatsWindow::showEvent(QShowEvent *event)
+{
+    QDialog::showEvent(event);
+    refresh();
+    m_timer.start();
+}
+
+void ExecutorStatsWindow::hideEvent(QHideEvent *event)
+{
+    QDialog::hideEvent(event);
+    m_timer.stop();
+}
+
+/* End Event Handlers */
+/* Begin Refresh */
+
+/**
+ * Creates a summary of a histogram.
+ * @param histogram The histogram to summarize.
+ * @return A string containing the number of samples, mean and max.
+ */
+static QString summarize(const Executor::Histogram &histogram)
+{
+    if (histogram.count == 0)
+    {
+        return "No samples";
+    }
+    return QString("n=%1, avg %2 ms, max %3 ms")
+        .arg(histogram.count)
+        .arg(histogram.total / 1000.0 / histogram.count, 0, 'f', 1)
+        .arg(histogram.max / 1000.0, 0, 'f', 1);
+}
+
+void ExecutorStatsWindow::refresh()
+{
+    const QList<Executor::Statistics> statistics = Executor::statistics();
+    for (int i = 0;
+         i < statistics.size() && i < m_tree->topLevelItemCount();
+         ++i)
+    {
+        const Executor::Statistics &stats = statistics[i];
+        QTreeWidgetItem *queueItem = m_tree->topLevelItem(i);
+        queueItem->setText(
+            COLUMN_NAME,
+            QString("%1 (%2/%3 active, %4 queued)")
+                .arg(stats.name)
+                .arg(stats.active)
+                .arg(stats.maxThreads)
+                .arg(stats.queued)
+        );
+        queueItem->setText(COLUMN_WAIT, summarize(stats.wait));
+        queueItem->setText(COLUMN_RUN, summarize(stats.run));
+
+        for (int j = 0; j < queueItem->childCount(); ++j)
+        {
+            QTreeWidgetItem *bucketItem = queueItem->child(j);
+            bucketItem->setText(
+                COLUMN_WAIT, QString::number(stats.wait.buckets[j])
+            );
+            bucketItem->setText(
+                COLUMN_RUN, QString::number(stats.run.buckets[j])
+            );
+        }
+    }
+}
+
+void ExecutorStatsWindow::setSearchMetrics(
+    const SearchWidget::Metrics &metrics)
+{
+    const double average = metrics.completed == 0 ?
+        0 : (double)metrics.totalLatency / metrics.completed;
+    m_searchLabel->setText(
+        QString(
+            "Search: %1 in flight or waiting, %2 started, %3 coalesced, "
+            "%4 cancelled, %5 shown, last %6 ms, avg %7 ms"
+        )
+            .arg(metrics.queueDepth)
+            .arg(metrics.started)
+            .arg(metrics.coalesced)
+            .arg(metrics.cancelled)
+            .arg(metrics.completed)
+            .arg(metrics.lastLatency)
+            .arg(average, 0, 'f', 1)
+    );
+}
+
+#undef COLUMN_NAME
+#undef COLUMN_WAIT
+#undef COLUMN_RUN
+
+/* End Refresh */
@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef EXECUTORSTATSWINDOW_H
+#define EXECUTORSTATSWINDOW_H
+
+#include <QDialog>
+
+#include <QTimer>
+
+#include "searchwidget.h"
+
+class QLabel;
+class QTreeWidget;
+
+/**
+ * Debug window showing the load and wait/run time histograms of every
+ * background work queue, and the statistics of the search widget.
+ */
+class ExecutorStatsWindow : public QDialog
+{
+    Q_OBJECT
+
+public:
+    ExecutorStatsWindow(QWidget *parent = nullptr);
+    virtual ~ExecutorStatsWindow() {}
+
+public Q_SLOTS:
+    /**
+     * Shows the latest search statistics.
+     * @param metrics The statistics of the search widget.
+     */
+    void setSearchMetrics(const SearchWidget::Metrics &metrics);
+
+protected:
+    /**
+     * Starts refreshing the statistics.
+     * @param event The show event.
+     */
+    void showEvent(QShowEvent *event) override;
+
+    /**
+     * Stops refreshing the statistics.
+     * @param event The hide event.
+     */
+    void hideEvent(QHideEvent *event) override;
+
+private Q_SLOTS:
+    /**
+     * Updates the tree with the latest statistics.
+     */
+    void refresh();
+
+private:
+    /* The tree containing a top level item per queue and a child per bucket. */
+    QTreeWidget *m_tree;
+
+    /* Shows the statistics of the search widget. */
+    QLabel *m_searchLabel;
+
+    /* Periodically refreshes the statistics while the window is visible. */
+    QTimer m_timer;
+};
+
+#endif // EXECUTORSTATSWINDOW_H
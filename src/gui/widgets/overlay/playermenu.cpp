@@ -24,6 +24,7 @@
 #include <QActionGroup>
 #include <QClipboard>
 #include <QDesktopServices>
+#include <QDir>
 #include <QFileDialog>
 #include <QGuiApplication>
 #include <QInputDialog>
@@ -33,6 +34,7 @@
 #include "anki/ankiclient.h"
 #include "util/constants.h"
 #include "util/globalmediator.h"
+#include "util/trace.h"
 #include "util/utils.h"
 
 /* Begin Constructor/Destructor */
@@ -54,6 +56,8 @@ PlayerMenu::PlayerMenu(QWidget *parent)
     m_actionGroups.subtitle    = new QActionGroup(this);
     m_actionGroups.subtitleTwo = new QActionGroup(this);
 
+    m_ui->actionRecordTrace->setChecked(Trace::isEnabled());
+
     m_ui->actionAudioNone->setActionGroup(m_actionGroups.audio);
     m_ui->actionSubtitleNone->setActionGroup(m_actionGroups.subtitle);
     m_ui->actionSubtitleTwoNone->setActionGroup(m_actionGroups.subtitleTwo);
@@ -176,6 +180,20 @@ PlayerMenu::PlayerMenu(QWidget *parent)
         mediator, &GlobalMediator::menuShowAbout,
         Qt::QueuedConnection
     );
+    connect(
+        m_ui->actionExecutorStats, &QAction::triggered,
+        mediator, &GlobalMediator::menuShowExecutorStats,
+        Qt::QueuedConnection
+    );
+    connect(
+        m_ui->actionRecordTrace, &QAction::toggled,
+        this, &Trace::setEnabled
+    );
+    connect(
+        m_ui->actionExportTrace, &QAction::triggered,
+        this, &PlayerMenu::exportTrace,
+        Qt::QueuedConnection
+    );
     connect(
         m_ui->actionOpenConfig, &QAction::triggered,
         this, &PlayerMenu::openConfigFolder,
@@ -652,6 +670,29 @@ void PlayerMenu::openConfigFolder() const
 }
 
 /* End Config Actions */
+/* Begin Debug Actions */
+
+void PlayerMenu::exportTrace()
+{
+    QString path = QFileDialog::getSaveFileName(
+        window(), "Export Trace",
+        QDir(DirectoryUtils::getConfigDir()).filePath("memento-trace.json"),
+        "Chrome Trace Files (*.json)"
+    );
+    if (path.isEmpty())
+    {
+        return;
+    }
+
+    if (!Trace::exportChromeTrace(path))
+    {
+        Q_EMIT GlobalMediator::getGlobalMediator()->showCritical(
+            "Error", "Could not write trace to " + path
+        );
+    }
+}
+
+/* End Debug Actions */
 /* Begin Playback Actions */
 
 void PlayerMenu::updateSubtitlePauseAction()
@@ -145,6 +145,11 @@ private Q_SLOTS:
      */
     void openConfigFolder() const;
 
+    /**
+     * Opens a file dialog and exports the recorded trace to the selected file.
+     */
+    void exportTrace();
+
     /**
      * Toggles the visibility of the search widget.
      */
@@ -37,6 +37,7 @@
 #include "player/playeradapter.h"
 #include "util/constants.h"
 #include "util/globalmediator.h"
+#include "util/trace.h"
 
 /* Begin Constructor/Destructor */
 
@@ -442,6 +443,9 @@ void PlayerOverlay::handleTickTimeout()
 
 void PlayerOverlay::setTerms(SharedTermList terms, SharedKanji kanji)
 {
+    Trace::endHop("termsChanged");
+    TraceSpan span("PlayerOverlay::setTerms");
+
     m_definition->setTerms(terms, kanji);
     setDefinitionWidgetLocation();
     m_definition->setVisible(terms || kanji);
@@ -27,11 +27,14 @@
 #include <QScrollBar>
 #include <QSettings>
 #include <QTextEdit>
-#include <QThreadPool>
 
+#include "dict/subtitleannotator.h"
+#include "gui/widgets/definition/glossaryhtmlbuilder.h"
 #include "player/playeradapter.h"
 #include "util/constants.h"
+#include "util/executor.h"
 #include "util/globalmediator.h"
+#include "util/trace.h"
 #include "util/utils.h"
 
 /* The maximum length of text that can be searched. */
@@ -54,6 +57,7 @@ SubtitleWidget::SubtitleWidget(QWidget *parent)
         m_dictionary = new Dictionary;
     }
     m_settings.showSubtitles = true;
+    m_settings.annotate = false;
 
     initTheme();
 
@@ -236,6 +240,11 @@ void SubtitleWidget::initTheme()
     ).toDouble();
     setStrokeSize(strokeSize);
 
+    m_settings.annotate = settings.value(
+        Constants::Settings::Interface::Subtitle::ANNOTATE,
+        Constants::Settings::Interface::Subtitle::ANNOTATE_DEFAULT
+    ).toBool();
+
     settings.endGroup();
 
     setSubtitle(
@@ -320,6 +329,14 @@ void SubtitleWidget::initSettings()
             Constants::Settings::Search::REPLACE_WITH,
             Constants::Settings::Search::REPLACE_WITH_DEFAULT
         ).toString();
+    m_settings.glossaryStyle = static_cast<Constants::GlossaryStyle>(
+            settings.value(
+                Constants::Settings::Search::LIST_GLOSSARY,
+                static_cast<int>(
+                    Constants::Settings::Search::LIST_GLOSSARY_DEFAULT
+                )
+            ).toInt()
+        );
     setSubtitle(
         m_subtitle.rawText, m_subtitle.startTime, m_subtitle.endTime, 0
     );
@@ -373,11 +390,13 @@ void SubtitleWidget::mouseMoveEvent(QMouseEvent *event)
     {
         return;
     }
+    Trace::addInstant("mouseMoveEvent");
 
     switch (m_settings.method)
     {
     case Settings::SearchMethod::Hover:
         m_currentIndex = position;
+        Trace::beginHop("hoverDelay");
         m_findDelay->start(m_settings.delay);
         break;
 
@@ -420,6 +439,7 @@ void SubtitleWidget::resizeEvent(QResizeEvent *event)
 
 void SubtitleWidget::findTerms()
 {
+    Trace::endHop("hoverDelay");
     if (!m_paused)
     {
         return;
@@ -435,8 +455,12 @@ void SubtitleWidget::findTerms()
     }
 
     QString subtitleText = getText();
-    QThreadPool::globalInstance()->start(
+    const Constants::GlossaryStyle glossaryStyle = m_settings.glossaryStyle;
+    Executor::run(
+        Executor::Queue::Lookup,
         [=] {
+            TraceSpan span("findTerms", queryStr);
+
             /* Look for Terms */
             SharedTermList terms = m_dictionary->searchTerms(
                 queryStr, subtitleText, index, &m_currentIndex
@@ -480,9 +504,14 @@ void SubtitleWidget::findTerms()
                 }
             }
 
+            /* Build glossaries here so the GUI thread doesn't have to */
+            GlossaryHtmlBuilder::prepare(terms, glossaryStyle);
+
+            Trace::beginHop("termsChanged");
             Q_EMIT GlobalMediator::getGlobalMediator()
                 ->termsChanged(terms, kanji);
-        }
+        },
+        Executor::Priority::Interactive
     );
 }
 
@@ -559,6 +588,8 @@ void SubtitleWidget::setSubtitle(QString subtitle,
 
     /* Add it to the text edit */
     setText(subtitle);
+    m_annotated = false;
+    applyAnnotation();
 
     /* Keep track of when to delete the subtitle */
     m_subtitle.startTime = start + delay;
@@ -576,4 +607,41 @@ void SubtitleWidget::selectText()
     StrokeLabel::selectText(m_lastEmittedIndex, m_lastEmittedSize);
 }
 
+void SubtitleWidget::applyAnnotation()
+{
+    SubtitleAnnotator *annotator =
+        GlobalMediator::getGlobalMediator()->getSubtitleAnnotator();
+    if (!m_settings.annotate || m_annotated || annotator == nullptr)
+    {
+        return;
+    }
+
+    const QString text = getText();
+    if (text.isEmpty())
+    {
+        return;
+    }
+
+    SharedLineAnnotation annotation = annotator->getAnnotation(text);
+    if (annotation == nullptr)
+    {
+        connect(
+            annotator, &SubtitleAnnotator::annotationsFinished,
+            this,      &SubtitleWidget::applyAnnotation,
+            Qt::ConnectionType(Qt::QueuedConnection | Qt::UniqueConnection)
+        );
+        annotator->annotate({text});
+        return;
+    }
+
+    for (const TokenSpan &token : annotation->tokens)
+    {
+        if (token.frequency > SubtitleAnnotator::RARE_RANK)
+        {
+            underlineText(token.start, token.length);
+        }
+    }
+    m_annotated = true;
+}
+
 /* End General Slots */
@@ -27,6 +27,7 @@
 #include <QTimer>
 
 #include "dict/dictionary.h"
+#include "util/constants.h"
 
 /**
  * Widget used to display subtitle text and initiate searches.
@@ -127,6 +128,12 @@ private Q_SLOTS:
      */
     void selectText();
 
+    /**
+     * Underlines the uncommon words in the current subtitle if it has been
+     * annotated. Queues the subtitle for annotation otherwise.
+     */
+    void applyAnnotation();
+
 private:
     /* The dictionary object, used for query for terms. */
     Dictionary *m_dictionary;
@@ -153,6 +160,10 @@ private:
      * otherwise. */
     bool m_pausedForCurrentSubtitle{false};
 
+    /* True if the annotation of the current subtitle has been applied, false
+     * otherwise. */
+    bool m_annotated{false};
+
     /* Contains information about the current subtitle. */
     struct Subtitle
     {
@@ -220,6 +231,12 @@ private:
         /* True if playback should be paused for the current subtitle, false
          * otherwise. */
         bool pauseOnSubtitleEnd;
+
+        /* True if uncommon words should be underlined, false otherwise. */
+        bool annotate;
+
+        /* The style glossaries of search results are displayed in. */
+        Constants::GlossaryStyle glossaryStyle;
     } m_settings;
 };
 
@@ -22,12 +22,13 @@
 
 #include <QGuiApplication>
 #include <QSettings>
-#include <QThreadPool>
 #include <QVBoxLayout>
 
 #include "dict/dictionary.h"
 #include "gui/widgets/definition/definitionwidget.h"
+#include "gui/widgets/definition/glossaryhtmlbuilder.h"
 #include "util/constants.h"
+#include "util/executor.h"
 #include "util/globalmediator.h"
 #include "util/utils.h"
 
@@ -107,6 +108,11 @@ SearchWidget::SearchWidget(QWidget *parent)
         m_definition, &DefinitionWidget::setTerms,
         Qt::QueuedConnection
     );
+    connect(
+        this, &SearchWidget::searchFinished,
+        this, &SearchWidget::handleSearchFinished,
+        Qt::QueuedConnection
+    );
     connect(
         this, &SearchWidget::widgetShown,
         m_searchEdit, qOverload<>(&QLineEdit::setFocus),
@@ -158,6 +164,15 @@ void SearchWidget::initSettings()
         m_searchEdit->setModifier(Qt::KeyboardModifier::ShiftModifier);
     }
 
+    m_glossaryStyle = static_cast<Constants::GlossaryStyle>(
+            settings.value(
+                Constants::Settings::Search::LIST_GLOSSARY,
+                static_cast<int>(
+                    Constants::Settings::Search::LIST_GLOSSARY_DEFAULT
+                )
+            ).toInt()
+        );
+
     settings.endGroup();
 }
 
@@ -174,21 +189,99 @@ void SearchWidget::updateSearch(const QString &text)
 
 void SearchWidget::updateSearch(const QString &text, const int index)
 {
-    QThreadPool::globalInstance()->start(
+    PendingSearch search;
+    search.text = text;
+    search.index = index;
+    search.seq = m_latestSeq.loadRelaxed() + 1;
+    search.requested.start();
+    m_latestSeq.storeRelaxed(search.seq);
+
+    if (!m_inFlight)
+    {
+        startSearch(search);
+        return;
+    }
+
+    /* Only keep the newest search waiting behind the in-flight search */
+    if (m_hasPending)
+    {
+        ++m_metrics.coalesced;
+    }
+    m_pending = search;
+    m_hasPending = true;
+    m_metrics.queueDepth = 2;
+    Q_EMIT metricsUpdated(m_metrics);
+}
+
+void SearchWidget::startSearch(const PendingSearch &search)
+{
+    m_inFlight = true;
+    m_inFlightRequested = search.requested;
+    ++m_metrics.started;
+    m_metrics.queueDepth = 1;
+    Q_EMIT metricsUpdated(m_metrics);
+
+    const QString text = search.text;
+    const int index = search.index;
+    const int seq = search.seq;
+    const Constants::GlossaryStyle glossaryStyle = m_glossaryStyle;
+    Executor::run(
+        Executor::Queue::Lookup,
         [=] {
+            auto cancelled = [=] { return seq != m_latestSeq.loadRelaxed(); };
+
             const QString query = text.mid(index, MAX_SEARCH_SIZE);
             SharedTermList terms =
-                m_dictionary->searchTerms(query, text, index, &index);
+                m_dictionary->searchTerms(query, text, index, cancelled);
 
             SharedKanji kanji = nullptr;
-            if (!query.isEmpty() && CharacterUtils::isKanji(query[0]))
+            if (!cancelled() &&
+                !query.isEmpty() &&
+                CharacterUtils::isKanji(query[0]))
             {
                 kanji = SharedKanji(m_dictionary->searchKanji(query[0]));
             }
 
-            Q_EMIT searchUpdated(terms, kanji);
-        }
+            if (!cancelled())
+            {
+                GlossaryHtmlBuilder::prepare(terms, glossaryStyle);
+            }
+
+            Q_EMIT searchFinished(seq, terms, kanji);
+        },
+        Executor::Priority::Interactive
     );
 }
 
+void SearchWidget::handleSearchFinished(
+    const int seq,
+    SharedTermList terms,
+    SharedKanji kanji)
+{
+    m_inFlight = false;
+
+    if (seq == m_latestSeq.loadRelaxed())
+    {
+        m_metrics.lastLatency = m_inFlightRequested.elapsed();
+        m_metrics.totalLatency += m_metrics.lastLatency;
+        ++m_metrics.completed;
+        Q_EMIT searchUpdated(terms, kanji);
+    }
+    else
+    {
+        ++m_metrics.cancelled;
+    }
+
+    if (m_hasPending)
+    {
+        m_hasPending = false;
+        startSearch(m_pending);
+    }
+    else
+    {
+        m_metrics.queueDepth = 0;
+        Q_EMIT metricsUpdated(m_metrics);
+    }
+}
+
 /* End SearchWidget */
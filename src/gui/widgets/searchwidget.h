@@ -24,9 +24,13 @@
 #include <QLineEdit>
 #include <QWidget>
 
+#include <QAtomicInt>
+#include <QElapsedTimer>
 #include <QSharedPointer>
 #include <QWheelEvent>
 
+#include "util/constants.h"
+
 class DefinitionWidget;
 class Dictionary;
 class QVBoxLayout;
@@ -94,6 +98,33 @@ class SearchWidget : public QWidget
 public:
     SearchWidget(QWidget *parent = nullptr);
 
+    /**
+     * Statistics about the searches performed by this widget.
+     */
+    struct Metrics
+    {
+        /* The number of searches in flight or waiting to run. At most 2. */
+        int queueDepth = 0;
+
+        /* The number of searches started. */
+        int started = 0;
+
+        /* The number of searches replaced before they could start. */
+        int coalesced = 0;
+
+        /* The number of searches aborted or discarded for being outdated. */
+        int cancelled = 0;
+
+        /* The number of searches whose results were shown. */
+        int completed = 0;
+
+        /* Time from request to result of the last shown search in ms. */
+        qint64 lastLatency = 0;
+
+        /* Sum of the latencies of all shown searches in ms. */
+        qint64 totalLatency = 0;
+    };
+
 Q_SIGNALS:
     /**
      * Emitted when the widget is hidden.
@@ -112,6 +143,21 @@ Q_SIGNALS:
      */
     void searchUpdated(SharedTermList terms, SharedKanji kanji) const;
 
+    /**
+     * An internal signal for moving the results of a search onto the UI
+     * thread.
+     * @param seq   The sequence number of the search.
+     * @param terms The list of found terms. nullptr if aborted.
+     * @param kanji The kanji if found.
+     */
+    void searchFinished(int seq, SharedTermList terms, SharedKanji kanji) const;
+
+    /**
+     * Emitted when the search statistics change.
+     * @param metrics The current statistics.
+     */
+    void metricsUpdated(const SearchWidget::Metrics &metrics) const;
+
 public Q_SLOTS:
     /**
      * Sets the current search.
@@ -138,6 +184,15 @@ private Q_SLOTS:
      */
     void initSettings();
 
+    /**
+     * Handles a finished search. Shows the result if it is the newest search
+     * and starts the pending search if there is one.
+     * @param seq   The sequence number of the search.
+     * @param terms The list of found terms. nullptr if aborted.
+     * @param kanji The kanji if found.
+     */
+    void handleSearchFinished(int seq, SharedTermList terms, SharedKanji kanji);
+
 protected:
     /**
      * Scrolls to the last item in the subtitle list on hide.
@@ -168,6 +223,28 @@ protected:
         { QWidget::wheelEvent(event); event->accept(); }
 
 private:
+    /* A search waiting for the in-flight search to finish */
+    struct PendingSearch
+    {
+        /* The text of the search */
+        QString text;
+
+        /* The index into the text where the search begins */
+        int index = 0;
+
+        /* The sequence number of the search */
+        int seq = 0;
+
+        /* Started when the search was requested */
+        QElapsedTimer requested;
+    };
+
+    /**
+     * Starts a search on the thread pool.
+     * @param search The search to start.
+     */
+    void startSearch(const PendingSearch &search);
+
     /* The parent layout */
     QVBoxLayout *m_layoutParent;
 
@@ -179,6 +256,28 @@ private:
 
     /* Pointer to the global dictionary */
     Dictionary *m_dictionary;
+
+    /* The style glossaries of search results are displayed in */
+    Constants::GlossaryStyle m_glossaryStyle;
+
+    /* The sequence number of the newest search. Read by worker threads to
+     * abort outdated searches. */
+    QAtomicInt m_latestSeq = 0;
+
+    /* true if a search is currently running, false otherwise */
+    bool m_inFlight = false;
+
+    /* Started when the in-flight search was requested */
+    QElapsedTimer m_inFlightRequested;
+
+    /* true if m_pending holds a search, false otherwise */
+    bool m_hasPending = false;
+
+    /* The search to run once the in-flight search finishes */
+    PendingSearch m_pending;
+
+    /* Search statistics */
+    Metrics m_metrics;
 };
 
 #endif // SEARCHWIDGET_H
@@ -269,6 +269,7 @@ void AnkiSettings::restoreDefaults()
     defaultConfig.duplicatePolicy = DEFAULT_DUPLICATE_POLICY;
     defaultConfig.newlineReplacer = DEFAULT_NEWLINE_REPLACER;
     defaultConfig.screenshotType  = DEFAULT_SCREENSHOT;
+    defaultConfig.screenshotHeight = DEFAULT_SCREENSHOT_HEIGHT;
     defaultConfig.audioPadStart   = DEFAULT_AUDIO_PAD_START;
     defaultConfig.audioPadStart   = DEFAULT_AUDIO_PAD_END;
     defaultConfig.audioNormalize  = DEFAULT_AUDIO_NORMALIZE;
@@ -457,6 +458,7 @@ void AnkiSettings::populateFields(
     m_ui->comboBoxScreenshot->setCurrentText(
         fileTypeToString(config.screenshotType)
     );
+    m_ui->spinScreenshotHeight->setValue(config.screenshotHeight);
 
     m_ui->spinAudioPadStart->setValue(config.audioPadStart);
     m_ui->spinAudioPadEnd->setValue(config.audioPadEnd);
@@ -621,6 +623,7 @@ void AnkiSettings::applyToConfig(const QString &profile)
     config->screenshotType =
         stringToFileType(m_ui->comboBoxScreenshot->currentText()
     );
+    config->screenshotHeight = (int)m_ui->spinScreenshotHeight->value();
 
     config->audioPadStart = m_ui->spinAudioPadStart->value();
     config->audioPadEnd   = m_ui->spinAudioPadEnd->value();
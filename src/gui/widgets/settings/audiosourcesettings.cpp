@@ -39,6 +39,7 @@
 /* Combo Box Type Names */
 #define TYPE_COMBO_BOX_FILE "File"
 #define TYPE_COMBO_BOX_JSON "JSON"
+#define TYPE_COMBO_BOX_LOCAL "Local"
 
 /* Begin Constructor/Destructors */
 
@@ -290,6 +291,12 @@ void AudioSourceSettings::showHelp()
             "Supports inserting {expression} and {reading} markers into the URL. "
             "See Anki Integration Help for more information."
         "<br><br>"
+        "<b>Type</b>: File sources point at a single audio file. "
+            "JSON sources return a list of audio files. "
+            "Local sources are one or more directories separated by "
+            "semicolons. Audio files in them are found by name, either "
+            "\"expression\" or \"reading - expression\"."
+        "<br><br>"
         "<b>MD5 Skip Hash</b>: Audio that matches this MD5 hash will be ignored."
     );
 }
@@ -431,6 +438,8 @@ inline QComboBox *AudioSourceSettings::createTypeComboBox(
         return createTypeComboBox(TYPE_COMBO_BOX_FILE);
     case Constants::AudioSourceType::JSON:
         return createTypeComboBox(TYPE_COMBO_BOX_JSON);
+    case Constants::AudioSourceType::Local:
+        return createTypeComboBox(TYPE_COMBO_BOX_LOCAL);
     }
     return createTypeComboBox(TYPE_COMBO_BOX_FILE);
 }
@@ -447,6 +456,10 @@ inline QComboBox *AudioSourceSettings::createTypeComboBox(
         TYPE_COMBO_BOX_JSON,
         QVariant(QVariant(static_cast<int>(Constants::AudioSourceType::JSON)))
     );
+    box->addItem(
+        TYPE_COMBO_BOX_LOCAL,
+        QVariant(static_cast<int>(Constants::AudioSourceType::Local))
+    );
     box->setCurrentText(setting);
     return box;
 }
@@ -24,10 +24,10 @@
 #include <QFileDialog>
 #include <QPushButton>
 #include <QSettings>
-#include <QThreadPool>
 
 #include "dict/dictionary.h"
 #include "util/constants.h"
+#include "util/executor.h"
 #include "util/globalmediator.h"
 #include "util/iconfactory.h"
 
@@ -137,7 +137,8 @@ void DictionarySettings::restoreSaved()
 
     setEnabled(false);
 
-    QThreadPool::globalInstance()->start(
+    Executor::run(
+        Executor::Queue::Dictionary,
         [this] {
             Dictionary *dict =
                 GlobalMediator::getGlobalMediator()->getDictionary();
@@ -145,7 +146,8 @@ void DictionarySettings::restoreSaved()
             QStringList disabledNames = dict->getDisabledDictionaries();
 
             Q_EMIT restoreSavedReady(dicts, disabledNames);
-        }
+        },
+        Executor::Priority::Normal
     );
 }
 
@@ -232,7 +234,8 @@ void DictionarySettings::addDictionary()
         return;
     }
 
-    QThreadPool::globalInstance()->start(
+    Executor::run(
+        Executor::Queue::Dictionary,
         [this, files] {
             setEnabled(false);
             Dictionary *dic =
@@ -245,7 +248,8 @@ void DictionarySettings::addDictionary()
                 );
             }
             setEnabled(true);
-        }
+        },
+        Executor::Priority::Background
     );
 }
 
@@ -263,7 +267,8 @@ void DictionarySettings::deleteDictionary()
     settings.beginGroup(Constants::Settings::Dictionaries::GROUP);
     settings.remove(item->text());
     settings.endGroup();
-    QThreadPool::globalInstance()->start(
+    Executor::run(
+        Executor::Queue::Dictionary,
         [=] {
             setEnabled(false);
             Dictionary *dic =
@@ -277,7 +282,8 @@ void DictionarySettings::deleteDictionary()
             }
             delete item;
             setEnabled(true);
-        }
+        },
+        Executor::Priority::Background
     );
 }
 
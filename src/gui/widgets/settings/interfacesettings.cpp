@@ -163,6 +163,9 @@ void InterfaceSettings::restoreDefaults()
     m_ui->checkSubListTimestamps->setChecked(
         Constants::Settings::Interface::Subtitle::LIST_TIMESTAMPS_DEFAULT
     );
+    m_ui->checkSubAnnotate->setChecked(
+        Constants::Settings::Interface::Subtitle::ANNOTATE_DEFAULT
+    );
 
     /* Aux Search */
     m_ui->checkAuxSearchWindow->setChecked(
@@ -277,6 +280,12 @@ void InterfaceSettings::restoreSaved()
             Constants::Settings::Interface::Subtitle::LIST_TIMESTAMPS_DEFAULT
         ).toBool()
     );
+    m_ui->checkSubAnnotate->setChecked(
+        settings.value(
+            Constants::Settings::Interface::Subtitle::ANNOTATE,
+            Constants::Settings::Interface::Subtitle::ANNOTATE_DEFAULT
+        ).toBool()
+    );
 
     /* Aux Search */
     m_ui->checkAuxSearchWindow->setChecked(
@@ -389,6 +398,10 @@ void InterfaceSettings::applyChanges()
         Constants::Settings::Interface::Subtitle::LIST_TIMESTAMPS,
         m_ui->checkSubListTimestamps->isChecked()
     );
+    settings.setValue(
+        Constants::Settings::Interface::Subtitle::ANNOTATE,
+        m_ui->checkSubAnnotate->isChecked()
+    );
 
     /* Aux Search */
     settings.setValue(
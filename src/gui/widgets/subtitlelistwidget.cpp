@@ -30,9 +30,10 @@
 #include <QMutexLocker>
 #include <QSettings>
 #include <QShortcut>
-#include <QThreadPool>
 
+#include "dict/subtitleannotator.h"
 #include "util/constants.h"
+#include "util/executor.h"
 #include "util/globalmediator.h"
 #include "util/iconfactory.h"
 #include "util/subtitleparser.h"
@@ -72,6 +73,7 @@ private:
 SubtitleListWidget::SubtitleListWidget(QWidget *parent)
     : QWidget(parent),
       m_ui(new Ui::SubtitleListWidget),
+      m_annotator(new SubtitleAnnotator(this)),
       m_client(GlobalMediator::getGlobalMediator()->getAnkiClient())
 {
     m_ui->setupUi(this);
@@ -92,6 +94,7 @@ SubtitleListWidget::SubtitleListWidget(QWidget *parent)
     hideSecondarySubs();
 
     GlobalMediator *mediator = GlobalMediator::getGlobalMediator();
+    mediator->setSubtitleAnnotator(m_annotator);
 
     /* Signals */
     connect(
@@ -113,6 +116,16 @@ SubtitleListWidget::SubtitleListWidget(QWidget *parent)
         this,     &SubtitleListWidget::initTheme,
         Qt::QueuedConnection
     );
+    connect(
+        mediator, &GlobalMediator::interfaceSettingsChanged,
+        this,     &SubtitleListWidget::initTheme,
+        Qt::QueuedConnection
+    );
+    connect(
+        m_annotator, &SubtitleAnnotator::annotationsFinished,
+        this,        &SubtitleListWidget::applyAnnotations,
+        Qt::QueuedConnection
+    );
     connect(
         mediator, &GlobalMediator::searchSettingsChanged,
         this,     &SubtitleListWidget::initRegex,
@@ -216,6 +229,21 @@ SubtitleListWidget::SubtitleListWidget(QWidget *parent)
         this, &SubtitleListWidget::findText,
         Qt::QueuedConnection
     );
+    connect(
+        m_ui->buttonSearchRegex, &QToolButton::toggled,
+        this, &SubtitleListWidget::refreshFind,
+        Qt::QueuedConnection
+    );
+    connect(
+        m_ui->buttonSearchKana, &QToolButton::toggled,
+        this, &SubtitleListWidget::refreshFind,
+        Qt::QueuedConnection
+    );
+    connect(
+        m_ui->tabWidget, &QTabWidget::currentChanged,
+        this, &SubtitleListWidget::refreshFind,
+        Qt::QueuedConnection
+    );
     connect(
         m_ui->buttonSearchPrev, &QToolButton::clicked,
         this, &SubtitleListWidget::findPrev,
@@ -271,8 +299,20 @@ void SubtitleListWidget::initTheme()
     ).toBool();
     m_ui->tablePrim->setColumnHidden(0, showTimestamps);
     m_ui->tableSec->setColumnHidden (0, showTimestamps);
+
+    const bool annotate = settings.value(
+        Constants::Settings::Interface::Subtitle::ANNOTATE,
+        Constants::Settings::Interface::Subtitle::ANNOTATE_DEFAULT
+    ).toBool();
     settings.endGroup();
 
+    if (annotate != m_annotate)
+    {
+        m_annotate = annotate;
+        applyAnnotations();
+        annotateSubtitles();
+    }
+
     /* Update the FindWidget icons */
     IconFactory *icons = IconFactory::create();
     m_ui->buttonSearchPrev->setIcon(icons->getIcon(IconFactory::Icon::up));
@@ -382,12 +422,25 @@ void SubtitleListWidget::handleTracklistChange(
         }
     }
 
-    QThreadPool::globalInstance()->start([=] {
+    Executor::run(Executor::Queue::Subtitle, [=] {
         SubtitleParser parser;
 
+        m_subRegexLock.lock();
+        const QRegularExpression filter = m_subRegex;
+        m_subRegexLock.unlock();
+
+        QList<QList<SubtitleInfo>> parsed;
+        for (const QString &track : extTracks)
+        {
+            parsed << parser.parseSubtitles(track);
+        }
+
+        /* Index copies of the tracks so the GUI thread isn't blocked while
+         * whole tracks are indexed */
+        QList<std::vector<std::shared_ptr<SubtitleInfo>>> snapshots;
         m_primary.lock.lock();
         m_secondary.lock.lock();
-
+        const int64_t primarySid = m_primary.sid;
         for (int i = 0; i < extTracks.size(); ++i)
         {
             if (!m_subtitleMap.contains(extSids[i]))
@@ -396,9 +449,8 @@ void SubtitleListWidget::handleTracklistChange(
                     std::vector<std::shared_ptr<SubtitleInfo>>>();
                 m_subtitleParsed[extSids[i]] = std::make_shared<bool>(false);
             }
-            QList<SubtitleInfo> subtitles = parser.parseSubtitles(extTracks[i]);
             std::transform(
-                std::begin(subtitles), std::end(subtitles),
+                std::begin(parsed[i]), std::end(parsed[i]),
                 std::back_inserter(*m_subtitleMap[extSids[i]]),
                 [] (SubtitleInfo &info)
                 {
@@ -407,13 +459,27 @@ void SubtitleListWidget::handleTracklistChange(
             );
             *m_subtitleParsed[extSids[i]] =
                 !m_subtitleMap[extSids[i]]->empty();
+            snapshots << *m_subtitleMap[extSids[i]];
         }
-
         m_secondary.lock.unlock();
         m_primary.lock.unlock();
 
+        for (int i = 0; i < extSids.size(); ++i)
+        {
+            m_index.update(
+                extSids[i],
+                snapshots[i],
+                extSids[i] == primarySid ? filter : QRegularExpression()
+            );
+        }
+
         Q_EMIT requestRefresh();
-    });
+
+        /* The annotator and m_annotate belong to the GUI thread */
+        QMetaObject::invokeMethod(
+            this, &SubtitleListWidget::annotateSubtitles, Qt::QueuedConnection
+        );
+    }, Executor::Priority::Normal);
 
     if (primarySid != -1)
     {
@@ -478,6 +544,11 @@ QTableWidgetItem *SubtitleListWidget::addTableItem(
         subtitleItem = new QTableWidgetItem(info->text);
     }
     list.itemToSub.insert(subtitleItem, info);
+    list.subToItem.insert(info.get(), subtitleItem);
+    if (m_annotate)
+    {
+        applyAnnotation(subtitleItem, info->text);
+    }
     QStringList lines = info->text.split('\n');
     for (const QString &line : lines)
     {
@@ -553,6 +624,10 @@ void SubtitleListWidget::addSubtitle(
         {
             m_subRegexLock.unlock();
         }
+        if (m_annotate)
+        {
+            m_annotator->annotate({subtitle});
+        }
     }
     else
     {
@@ -577,6 +652,7 @@ void SubtitleListWidget::handlePrimaryTrackChange(int64_t sid)
             std::make_shared<std::vector<std::shared_ptr<SubtitleInfo>>>();
         m_subtitleParsed[sid] = std::make_shared<bool>(false);
     }
+    m_primary.sid = sid;
     m_primary.subList = m_subtitleMap[sid];
     m_primary.subsParsed = m_subtitleParsed[sid];
 
@@ -604,6 +680,7 @@ void SubtitleListWidget::handleSecondaryTrackChange(int64_t sid)
             std::make_shared<std::vector<std::shared_ptr<SubtitleInfo>>>();
         m_subtitleParsed[sid] = std::make_shared<bool>(false);
     }
+    m_secondary.sid = sid;
     m_secondary.subList = m_subtitleMap[sid];
     m_secondary.subsParsed = m_subtitleParsed[sid];
 
@@ -862,7 +939,8 @@ void SubtitleListWidget::copyAudioContext() const
         dbLevel = config->audioDb;
     }
 
-    QThreadPool::globalInstance()->start(
+    Executor::run(
+        Executor::Queue::Media,
         [=] {
             QString path = player->tempAudioClip(start, end, normalize, dbLevel);
             if (!QFile(path).exists())
@@ -871,7 +949,8 @@ void SubtitleListWidget::copyAudioContext() const
             }
             QClipboard *clipboard = QGuiApplication::clipboard();
             clipboard->setMimeData(new TempMimeData(path));
-        }
+        },
+        Executor::Priority::Normal
     );
 }
 
@@ -884,12 +963,15 @@ void SubtitleListWidget::clearSubtitles(SubtitleList &list)
     list.table->setRowCount(0);
     list.subList = nullptr;
     list.subsParsed = nullptr;
+    list.sid = -1;
     list.startToItem.clear();
+    list.subToItem.clear();
     list.itemToSub.clear();
     list.lineToItem.clear();
     list.modified = true;
     list.foundRows.clear();
     list.currentFind = 0;
+    list.otherMatches = 0;
 }
 
 void SubtitleListWidget::clearPrimarySubtitles()
@@ -910,8 +992,16 @@ void SubtitleListWidget::clearCachedSubtitles()
 {
     clearPrimarySubtitles();
     clearSecondarySubtitles();
+
+    /* Workers iterate the map while holding both locks */
+    m_primary.lock.lock();
+    m_secondary.lock.lock();
     m_subtitleMap.clear();
     m_subtitleParsed.clear();
+    m_index.clear();
+    m_secondary.lock.unlock();
+    m_primary.lock.unlock();
+    m_annotator->clear();
 }
 
 /* End Clear Methods */
@@ -946,55 +1036,247 @@ void SubtitleListWidget::fixTableDimensions(const int index)
     }
 }
 
+void SubtitleListWidget::annotateSubtitles()
+{
+    if (!m_annotate)
+    {
+        return;
+    }
+
+    QStringList lines;
+    m_primary.lock.lock();
+    m_secondary.lock.lock();
+    for (const auto &subList : m_subtitleMap)
+    {
+        for (const std::shared_ptr<SubtitleInfo> &info : *subList)
+        {
+            lines << info->text;
+        }
+    }
+    m_secondary.lock.unlock();
+    m_primary.lock.unlock();
+
+    m_annotator->annotate(lines);
+}
+
+void SubtitleListWidget::applyAnnotations()
+{
+    for (SubtitleList *list : {&m_primary, &m_secondary})
+    {
+        QMutexLocker locker(&list->lock);
+        for (auto it = list->itemToSub.constBegin();
+             it != list->itemToSub.constEnd();
+             ++it)
+        {
+            applyAnnotation(it.key(), it.value()->text);
+        }
+    }
+}
+
+#define TOOLTIP_FORMAT      QString("%1% Coverage\nRarest Word: %2")
+#define TOOLTIP_NO_RANK     "Unranked"
+#define HIGHLIGHT_ALPHA     64
+
+void SubtitleListWidget::applyAnnotation(
+    QTableWidgetItem *item,
+    const QString &text)
+{
+    if (!m_annotate)
+    {
+        item->setToolTip(QString());
+        item->setData(Qt::BackgroundRole, QVariant());
+        return;
+    }
+
+    SharedLineAnnotation annotation = m_annotator->getAnnotation(text);
+    if (annotation == nullptr)
+    {
+        return;
+    }
+
+    item->setToolTip(
+        TOOLTIP_FORMAT
+            .arg(qRound(annotation->coverage * 100))
+            .arg(
+                annotation->difficulty == -1 ?
+                    QString(TOOLTIP_NO_RANK) :
+                    QString::number(annotation->difficulty)
+            )
+    );
+    if (annotation->difficulty > SubtitleAnnotator::RARE_RANK)
+    {
+        QColor color = palette().highlight().color();
+        color.setAlpha(HIGHLIGHT_ALPHA);
+        item->setBackground(color);
+    }
+    else
+    {
+        item->setData(Qt::BackgroundRole, QVariant());
+    }
+}
+
+#undef TOOLTIP_FORMAT
+#undef TOOLTIP_NO_RANK
+#undef HIGHLIGHT_ALPHA
+
 /* End Helper Slots */
 /* Begin Find Widget Slots */
 
-#define MATCH_NONE      "No Matches"
-#define MATCH_FORMAT    QString("%1 of %2 Rows")
+#define MATCH_NONE          "No Matches"
+#define MATCH_INVALID       "Invalid Expression"
+#define MATCH_FORMAT        QString("%1 of %2 Rows")
+#define MATCH_OTHER_FORMAT  QString(" (%1 in Other Tracks)")
 
-void SubtitleListWidget::findTextHelper(SubtitleList &list, const QString &text)
+void SubtitleListWidget::findText(const QString &text)
 {
+    SubtitleList &list =
+        m_ui->tabWidget->currentWidget() == m_ui->tabPrimary ?
+            m_primary : m_secondary;
+
+    SubtitleIndex::FindOptions options;
+    options.regex = m_ui->buttonSearchRegex->isChecked();
+    options.kanaInsensitive = m_ui->buttonSearchKana->isChecked();
+
+    list.lock.lock();
     list.modified = false;
-    list.foundRows.clear();
-    list.currentFind = 0;
+    const int64_t sid = list.sid;
+    list.lock.unlock();
 
-    if (text.isEmpty())
+    const int findId = m_findId.fetchAndAddRelaxed(1) + 1;
+    Executor::run(
+        Executor::Queue::Subtitle,
+        [=] {
+            /* Skip searches that were superseded before they started */
+            if (findId != m_findId.loadRelaxed())
+            {
+                return;
+            }
+
+            /* Catch the index up with lines added since the last search.
+             * The primary track is indexed the way it is displayed. */
+            m_subRegexLock.lock();
+            const QRegularExpression filter = m_subRegex;
+            m_subRegexLock.unlock();
+
+            /* Index copies of the tracks so the GUI thread isn't blocked */
+            QList<QPair<int64_t, std::vector<std::shared_ptr<SubtitleInfo>>>>
+                snapshots;
+            m_primary.lock.lock();
+            m_secondary.lock.lock();
+            const int64_t primarySid = m_primary.sid;
+            for (auto it = m_subtitleMap.constKeyValueBegin();
+                 it != m_subtitleMap.constKeyValueEnd();
+                 ++it)
+            {
+                snapshots << qMakePair(it->first, *it->second);
+            }
+            m_secondary.lock.unlock();
+            m_primary.lock.unlock();
+
+            for (const auto &snapshot : snapshots)
+            {
+                m_index.update(
+                    snapshot.first,
+                    snapshot.second,
+                    snapshot.first == primarySid ?
+                        filter : QRegularExpression()
+                );
+            }
+
+            bool valid = true;
+            QVector<int> lines = m_index.find(sid, text, options, &valid);
+            int otherMatches = 0;
+            for (int64_t other : m_index.tracks())
+            {
+                if (findId != m_findId.loadRelaxed())
+                {
+                    return;
+                }
+                if (other != sid)
+                {
+                    otherMatches += m_index.find(other, text, options).size();
+                }
+            }
+
+            QMetaObject::invokeMethod(
+                this,
+                [=] {
+                    handleFindResults(findId, sid, lines, otherMatches, valid);
+                },
+                Qt::QueuedConnection
+            );
+        },
+        Executor::Priority::Interactive
+    );
+}
+
+void SubtitleListWidget::handleFindResults(const int findId,
+                                           const int64_t sid,
+                                           const QVector<int> &lines,
+                                           const int otherMatches,
+                                           const bool valid)
+{
+    if (findId != m_findId.loadRelaxed())
     {
-        m_ui->labelSearchMatch->setText(MATCH_NONE);
         return;
     }
 
-    for (int i = 0; i < list.table->rowCount(); ++i)
+    SubtitleList &list =
+        m_ui->tabWidget->currentWidget() == m_ui->tabPrimary ?
+            m_primary : m_secondary;
+    QMutexLocker locker(&list.lock);
+    if (list.sid != sid)
     {
-        QTableWidgetItem *item = list.table->item(i, 1);
-        if (item->text().contains(text, Qt::CaseInsensitive))
+        return;
+    }
+
+    list.foundRows.clear();
+    list.currentFind = 0;
+    list.otherMatches = otherMatches;
+    for (int i : lines)
+    {
+        if ((size_t)i >= list.subList->size())
+        {
+            break;
+        }
+        QTableWidgetItem *item =
+            list.subToItem.value((*list.subList)[i].get(), nullptr);
+        if (item)
         {
-            list.foundRows << i;
+            list.foundRows << list.table->row(item);
         }
     }
+    std::sort(list.foundRows.begin(), list.foundRows.end());
 
-    if (list.foundRows.isEmpty())
+    QString other;
+    if (otherMatches > 0)
+    {
+        other = MATCH_OTHER_FORMAT.arg(otherMatches);
+    }
+
+    if (!valid)
+    {
+        m_ui->labelSearchMatch->setText(MATCH_INVALID);
+    }
+    else if (list.foundRows.isEmpty())
     {
-        m_ui->labelSearchMatch->setText(MATCH_NONE);
+        m_ui->labelSearchMatch->setText(MATCH_NONE + other);
     }
     else
     {
-        list.currentFind = 0;
         list.table->setCurrentCell(list.foundRows[0], 1);
         m_ui->labelSearchMatch->setText(
-            MATCH_FORMAT.arg(1).arg(list.foundRows.size())
+            MATCH_FORMAT.arg(1).arg(list.foundRows.size()) + other
         );
     }
 }
 
-void SubtitleListWidget::findText(const QString &text)
+void SubtitleListWidget::refreshFind()
 {
-    SubtitleList &list =
-        m_ui->tabWidget->currentWidget() == m_ui->tabPrimary ?
-            m_primary : m_secondary;
-    list.lock.lock();
-    findTextHelper(list, text);
-    list.lock.unlock();
+    if (m_ui->widgetFind->isVisible())
+    {
+        findText(m_ui->lineEditSearch->text());
+    }
 }
 
 /**
@@ -1018,7 +1300,9 @@ void SubtitleListWidget::findRowHelper(int offset)
 
     if (list.modified)
     {
-        findTextHelper(list, m_ui->lineEditSearch->text());
+        locker.unlock();
+        findText(m_ui->lineEditSearch->text());
+        return;
     }
 
     if (list.foundRows.isEmpty())
@@ -1028,13 +1312,21 @@ void SubtitleListWidget::findRowHelper(int offset)
 
     list.currentFind = mod(list.currentFind + offset, list.foundRows.size());
     list.table->setCurrentCell(list.foundRows[list.currentFind], 1);
+    QString other;
+    if (list.otherMatches > 0)
+    {
+        other = MATCH_OTHER_FORMAT.arg(list.otherMatches);
+    }
     m_ui->labelSearchMatch->setText(
-        MATCH_FORMAT.arg(list.currentFind + 1).arg(list.foundRows.size())
+        MATCH_FORMAT.arg(list.currentFind + 1).arg(list.foundRows.size()) +
+        other
     );
 }
 
 #undef MATCH_NONE
+#undef MATCH_INVALID
 #undef MATCH_FORMAT
+#undef MATCH_OTHER_FORMAT
 
 void SubtitleListWidget::findPrev()
 {
@@ -26,6 +26,7 @@
 #include <memory>
 #include <vector>
 
+#include <QAtomicInt>
 #include <QHash>
 #include <QMultiHash>
 #include <QMultiMap>
@@ -34,10 +35,12 @@
 
 #include "anki/ankiclient.h"
 #include "player/playeradapter.h"
+#include "util/subtitleindex.h"
 
 class QShortcut;
 class QTableWidget;
 class QTableWidgetItem;
+class SubtitleAnnotator;
 
 struct SubtitleInfo;
 
@@ -134,6 +137,17 @@ private Q_SLOTS:
      */
     void initRegex();
 
+    /**
+     * Queues every cached subtitle line for annotation if annotations are
+     * enabled.
+     */
+    void annotateSubtitles();
+
+    /**
+     * Applies the annotations of every line in both subtitle lists.
+     */
+    void applyAnnotations();
+
     /**
      * Handles the track list changing.
      */
@@ -250,6 +264,11 @@ private Q_SLOTS:
      */
     void findText(const QString &text);
 
+    /**
+     * Find the text currently in the search bar in the current subtitle list.
+     */
+    void refreshFind();
+
     /**
      * Seeks the the previous row of the current search.
      */
@@ -279,6 +298,12 @@ private:
         /* Maps timecodes to table widget items for the subtitles. */
         QMultiMap<double, QTableWidgetItem *> startToItem;
 
+        /* The sid of the track in the table. -1 if there is no track. */
+        int64_t sid = -1;
+
+        /* Maps subtitle infos to their table widget items. */
+        QHash<const SubtitleInfo *, QTableWidgetItem *> subToItem;
+
         /* Maps table widget items to subtitle infos. */
         QHash<
             QTableWidgetItem *,
@@ -298,6 +323,9 @@ private:
 
         /* the currently found row */
         int currentFind;
+
+        /* the number of matches in tracks other than this one */
+        int otherMatches = 0;
     };
 
     /**
@@ -387,6 +415,14 @@ private:
                                    double delay,
                                    bool regex = false);
 
+    /**
+     * Decorates a table item with the annotation of its subtitle. Removes the
+     * decoration if annotations are disabled.
+     * @param item The item to decorate.
+     * @param text The raw text of the subtitle belonging to the item.
+     */
+    void applyAnnotation(QTableWidgetItem *item, const QString &text);
+
     /**
      * Helper method that converts a time in seconds to a timecode string of the
      * form HH:MM:SS.
@@ -417,11 +453,20 @@ private:
     void seekToSubtitle(QTableWidgetItem *item, const SubtitleList &list) const;
 
     /**
-     * Finds the text in the list without locking the list.
-     * @param list The list to find the text in.
-     * @param text The text to search for.
+     * Selects the rows found by a search. Results from outdated searches are
+     * ignored.
+     * @param findId       The id of the search these results belong to.
+     * @param sid          The sid of the track that was searched.
+     * @param lines        The indices of the matching subtitles in the track.
+     * @param otherMatches The number of matches in all other tracks.
+     * @param valid        false if the query was an invalid regular
+     *                     expression, true otherwise.
      */
-    void findTextHelper(SubtitleList &list, const QString &text);
+    void handleFindResults(int findId,
+                           int64_t sid,
+                           const QVector<int> &lines,
+                           int otherMatches,
+                           bool valid);
 
     /**
      * Selects the row of the current table with the offset from the currently
@@ -457,6 +502,18 @@ private:
     /* Maps sid to whether or not the subtitle was parsed. */
     QHash<int64_t, std::shared_ptr<bool>> m_subtitleParsed;
 
+    /* N-gram index over every track in m_subtitleMap */
+    SubtitleIndex m_index;
+
+    /* The id of the most recent search. Used to drop outdated searches. */
+    QAtomicInt m_findId = 0;
+
+    /* Computes difficulty annotations for subtitle lines. */
+    SubtitleAnnotator *m_annotator;
+
+    /* true if subtitle lines should be annotated, false otherwise */
+    bool m_annotate = false;
+
     /* The primary subtitle list */
     SubtitleList m_primary;
 
@@ -38,12 +38,15 @@
 #endif
 
 #include "audio/audioplayer.h"
+#include "audio/audiosourceresolver.h"
+#include "audio/localaudiolibrary.h"
 #include "dict/dictionary.h"
 #include "dict/expression.h"
 #include "gui/mainwindow.h"
 #include "util/constants.h"
 #include "util/globalmediator.h"
 #include "util/iconfactory.h"
+#include "util/trace.h"
 #include "util/utils.h"
 
 /**
@@ -184,12 +187,44 @@ static inline bool showHelpMessage(int argc, char **argv)
     return false;
 }
 
+/* The command line flag used to record a trace from startup */
+#define TRACE_ARG "--memento-trace="
+
+/**
+ * Finds and removes the trace command line argument so it isn't passed to mpv.
+ * @param[in,out] argc The number of command line arguments.
+ * @param[in,out] argv The values of the command line arguments.
+ * @return The path to write the trace to, empty if the argument isn't present.
+ */
+static QString takeTraceArg(int &argc, char **argv)
+{
+    const size_t prefixLen = std::strlen(TRACE_ARG);
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strncmp(argv[i], TRACE_ARG, prefixLen) == 0)
+        {
+            QString path = QString::fromLocal8Bit(argv[i] + prefixLen);
+            for (int j = i; j < argc - 1; ++j)
+            {
+                argv[j] = argv[j + 1];
+            }
+            --argc;
+            argv[argc] = nullptr;
+            return path;
+        }
+    }
+    return QString();
+}
+
 int main(int argc, char **argv)
 {
     if (showHelpMessage(argc, argv))
     {
         std::cout << "Usage:\t memento [options] [url|path/]filename\n"
             << "\n"
+            << "  " TRACE_ARG "<file>  Record a trace and write it to <file> "
+               "on exit\n"
+            << "\n"
             << "For more information about command line arguments, see "
                "https://mpv.io/manual/\n";
         return 0;
@@ -205,6 +240,13 @@ int main(int argc, char **argv)
     QCoreApplication::setOrganizationDomain("ripose.projects");
     QCoreApplication::setApplicationName("memento");
 
+    /* Tracing */
+    const QString tracePath = takeTraceArg(argc, argv);
+    if (!tracePath.isEmpty())
+    {
+        Trace::setEnabled(true);
+    }
+
     /* Construct the application */
     QApplication memento(argc, argv);
 
@@ -256,17 +298,32 @@ int main(int argc, char **argv)
 
     GlobalMediator::createGlobalMediator();
     GlobalMediator::getGlobalMediator()->setAudioPlayer(new AudioPlayer);
+    GlobalMediator::getGlobalMediator()->setAudioSourceResolver(
+        new AudioSourceResolver
+    );
+    GlobalMediator::getGlobalMediator()->setLocalAudioLibrary(
+        new LocalAudioLibrary(DirectoryUtils::getLocalAudioDB())
+    );
 
     MainWindow *main_window = new MainWindow;
     main_window->show();
     int ret = memento.exec();
 
+    if (!tracePath.isEmpty())
+    {
+        Trace::exportChromeTrace(tracePath);
+    }
+
     /* Deallocate shared resources */
     delete main_window;
     delete GlobalMediator::getGlobalMediator()->getAudioPlayer();
+    delete GlobalMediator::getGlobalMediator()->getAudioSourceResolver();
+    delete GlobalMediator::getGlobalMediator()->getLocalAudioLibrary();
     delete GlobalMediator::getGlobalMediator()->getDictionary();
     delete GlobalMediator::getGlobalMediator();
     IconFactory::destroy();
 
     return ret;
 }
+
+#undef TRACE_ARG
@@ -21,18 +21,23 @@
 #include "mpvadapter.h"
 
 #include <QApplication>
+#include <QBuffer>
 #include <QDebug>
+#include <QFileInfo>
+#include <QImageWriter>
 #include <QSettings>
 #include <QTemporaryFile>
 
 #include "gui/widgets/mpv/mpvwidget.h"
 #include "util/constants.h"
 #include "util/globalmediator.h"
+#include "util/trace.h"
 
 MpvAdapter::MpvAdapter(MpvWidget *mpv, QObject *parent)
     : PlayerAdapter(parent),
       m_mpv(mpv),
-      m_handle(mpv->getHandle())
+      m_handle(mpv->getHandle()),
+      m_encoder(std::make_unique<MpvEncoder>(m_handle))
 {
     GlobalMediator *mediator = GlobalMediator::getGlobalMediator();
     GlobalMediator::getGlobalMediator()->setPlayerAdapter(this);
@@ -867,12 +872,163 @@ void MpvAdapter::showText(const QString &text)
     }
 }
 
-QString MpvAdapter::tempScreenshot(const bool subtitles, const QString &ext)
+/* mpv's default screenshot qualities */
+#define DEFAULT_JPEG_QUALITY 90
+#define DEFAULT_WEBP_QUALITY 75
+
+QByteArray MpvAdapter::screenshot(
+    const bool subtitles,
+    const QString &ext,
+    const int maxHeight)
+{
+    TraceSpan span("MpvAdapter::screenshot", ext);
+
+    const QByteArray format = ext.mid(1).toLower().toUtf8();
+    if (!QImageWriter::supportedImageFormats().contains(format))
+    {
+        return fileScreenshot(subtitles, ext);
+    }
+
+    QImage image = rawScreenshot(subtitles);
+    if (image.isNull())
+    {
+        return {};
+    }
+    if (maxHeight > 0 && image.height() > maxHeight)
+    {
+        image = image.scaledToHeight(maxHeight, Qt::SmoothTransformation);
+    }
+
+    /* Respect the user's mpv screenshot quality */
+    int64_t quality = -1;
+    if (format == "jpg" || format == "jpeg")
+    {
+        if (mpv_get_property(
+                m_handle,
+                "screenshot-jpeg-quality",
+                MPV_FORMAT_INT64,
+                &quality) < 0)
+        {
+            quality = DEFAULT_JPEG_QUALITY;
+        }
+    }
+    else if (format == "webp")
+    {
+        if (mpv_get_property(
+                m_handle,
+                "screenshot-webp-quality",
+                MPV_FORMAT_INT64,
+                &quality) < 0)
+        {
+            quality = DEFAULT_WEBP_QUALITY;
+        }
+    }
+
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, format);
+    writer.setQuality(quality);
+    if (!writer.write(image))
+    {
+        qDebug() << "Could not encode screenshot" << writer.errorString();
+        return {};
+    }
+
+    return data;
+}
+
+#undef DEFAULT_JPEG_QUALITY
+#undef DEFAULT_WEBP_QUALITY
+
+QImage MpvAdapter::rawScreenshot(const bool subtitles)
+{
+    const char *args[] = {
+        "screenshot-raw",
+        subtitles ? "subtitles" : "video",
+        NULL
+    };
+    mpv_node node;
+    if (mpv_command_ret(m_handle, args, &node) < 0)
+    {
+        qDebug() << "Could not take raw screenshot";
+        return QImage();
+    }
+
+    int64_t width = 0;
+    int64_t height = 0;
+    int64_t stride = 0;
+    QString format;
+    const mpv_byte_array *pixels = nullptr;
+    if (node.format == MPV_FORMAT_NODE_MAP)
+    {
+        for (int i = 0; i < node.u.list->num; ++i)
+        {
+            const QString key = node.u.list->keys[i];
+            const mpv_node &value = node.u.list->values[i];
+            if (key == "w" && value.format == MPV_FORMAT_INT64)
+            {
+                width = value.u.int64;
+            }
+            else if (key == "h" && value.format == MPV_FORMAT_INT64)
+            {
+                height = value.u.int64;
+            }
+            else if (key == "stride" && value.format == MPV_FORMAT_INT64)
+            {
+                stride = value.u.int64;
+            }
+            else if (key == "format" && value.format == MPV_FORMAT_STRING)
+            {
+                format = value.u.string;
+            }
+            else if (key == "data" && value.format == MPV_FORMAT_BYTE_ARRAY)
+            {
+                pixels = value.u.ba;
+            }
+        }
+    }
+
+    QImage image;
+    if (format != "bgr0")
+    {
+        qDebug() << "Unsupported raw screenshot format" << format;
+    }
+    else if (pixels == nullptr || width <= 0 || height <= 0 ||
+             stride < width * 4 ||
+             (int64_t)pixels->size < stride * height)
+    {
+        qDebug() << "Raw screenshot is malformed";
+    }
+    else
+    {
+        /* bgr0 is byte for byte the same as RGB32 on little endian machines.
+         * Copy since the pixels are freed with the node. */
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        image = QImage(
+            (const uchar *)pixels->data,
+            width, height, stride,
+            QImage::Format_RGB32
+        ).copy();
+#else
+        image = QImage(
+            (const uchar *)pixels->data,
+            width, height, stride,
+            QImage::Format_RGBX8888
+        ).rgbSwapped();
+#endif
+    }
+    mpv_free_node_contents(&node);
+
+    return image;
+}
+
+QByteArray MpvAdapter::fileScreenshot(const bool subtitles, const QString &ext)
 {
     // Get a temporary file name
     QTemporaryFile file;
     if (!file.open())
-        return "";
+        return {};
     QByteArray filename = (file.fileName() + ext).toUtf8();
     file.close();
 
@@ -885,10 +1041,19 @@ QString MpvAdapter::tempScreenshot(const bool subtitles, const QString &ext)
     if (mpv_command(m_handle, args) < 0)
     {
         qDebug() << "Could not take temporary screenshot";
-        return "";
+        return {};
     }
 
-    return filename;
+    QFile screenshotFile(filename);
+    QByteArray data;
+    if (screenshotFile.open(QIODevice::ReadOnly))
+    {
+        data = screenshotFile.readAll();
+        screenshotFile.close();
+    }
+    screenshotFile.remove();
+
+    return data;
 }
 
 QString MpvAdapter::tempAudioClip(
@@ -903,113 +1068,39 @@ QString MpvAdapter::tempAudioClip(
     {
         return "";
     }
+    QString path = getPath();
 
-    // Get a temporary file name
-    QTemporaryFile file;
-    if (!file.open())
-    {
-        return "";
-    }
-    QByteArray filename = (file.fileName() + ext).toUtf8();
-    file.close();
-
-    QByteArray input = getPath().toUtf8();
-    QByteArray optionCmd;
-    optionCmd += QString("start=%1").arg(start, 0, 'f', 3).toUtf8();
-    optionCmd += QString(",end=%1").arg(end, 0, 'f', 3).toUtf8();
-    optionCmd += QString(",aid=%1").arg(aid).toUtf8();
-    const char *args[] = {
-        "loadfile",
-        input,
-        "replace",
-        optionCmd.isEmpty() ? NULL : optionCmd.data(),
-        NULL
-    };
-
-    char *script_opts = NULL;
-    mpv_event *event = NULL;
-    mpv_handle *enc_h = mpv_create();
-    if (enc_h == NULL)
+    /* Copy the audio without re-encoding it if possible */
+    if (!normalize && QFileInfo::exists(path))
     {
-        qDebug() << "Error creating encoder handle";
-        filename = "";
-        goto cleanup;
-    }
-
-    mpv_set_option_string(enc_h, "cover-art-auto", "no");
-    mpv_set_option_string(enc_h, "keep-open", "no");
-    mpv_set_option_string(enc_h, "vid", "no");
-    mpv_set_option_string(enc_h, "sid", "no");
-    mpv_set_option_string(enc_h, "secondary-sid", "no");
-    mpv_set_option_string(enc_h, "ytdl", "yes");
-    mpv_set_option_string(enc_h, "config", "no");
-    mpv_set_option_string(enc_h, "o", filename);
-    if (normalize)
-    {
-        QByteArray audioFilter;
-        audioFilter = "loudnorm=I=";
-        audioFilter += QByteArray::number(db, 'f', 1);
-        mpv_set_option_string(enc_h, "af", audioFilter);
-    }
-
-    /* This guarantees the correct version of youtube-dl is used. */
-    script_opts = mpv_get_property_string(m_handle, "script-opts");
-    if (script_opts && QByteArray(script_opts).contains("ytdl_hook-ytdl_path="))
-    {
-        mpv_set_option_string(enc_h, "script-opts", script_opts);
-    }
-#if APPBUNDLE
-    else
-    {
-        QByteArray ytdlPath = "ytdl_hook-ytdl_path=";
-        char *config_dir = mpv_get_property_string(m_handle, "config-dir");
-        if (config_dir)
-        {
-            ytdlPath += config_dir;
-            ytdlPath += SLASH;
-        }
-        else
+        QString codec;
+        bool external = true;
+        QList<const Track *> tracks = getTracks();
+        for (const Track *track : tracks)
         {
-            ytdlPath += DirectoryUtils::getConfigDir().toUtf8();
+            if (track->type == Track::Type::audio && track->id == aid)
+            {
+                codec = track->codec;
+                external = track->external;
+            }
+            delete track;
         }
-        mpv_free(config_dir);
-        ytdlPath += "youtube-dl";
-        mpv_set_option_string(enc_h, "script-opts", ytdlPath);
-    }
-#endif
-    mpv_free(script_opts);
 
-    if (mpv_initialize(enc_h) < 0)
-    {
-        qDebug() << "Could not initialize encoder";
-        filename = "";
-        goto cleanup;
-    }
-
-    if (mpv_command(enc_h, args) < 0)
-    {
-        qDebug() << "Could not encode file";
-        filename = "";
-        goto cleanup;
-    }
-
-    do
-    {
-        event = mpv_wait_event(enc_h, 100);
-        if (event->event_id == MPV_EVENT_NONE ||
-            event->event_id == MPV_EVENT_QUEUE_OVERFLOW)
+        /* Only copy when it produces the format the user asked for */
+        const QString copyExt = MpvEncoder::copyExtension(codec);
+        if (!external &&
+            !copyExt.isEmpty() &&
+            copyExt.compare(ext, Qt::CaseInsensitive) == 0)
         {
-            qDebug() << "mpv returned a bad event" << event->event_id;
-            filename = "";
-            goto cleanup;
+            QString clip = m_encoder->copyAudio(path, aid, start, end, codec);
+            if (!clip.isEmpty())
+            {
+                return clip;
+            }
         }
     }
-    while (event->event_id != MPV_EVENT_END_FILE);
-
-cleanup:
-    mpv_destroy(enc_h);
 
-    return filename;
+    return m_encoder->encodeAudio(path, aid, start, end, normalize, db, ext);
 }
 
 void MpvAdapter::keyPressed(QKeyEvent *event)
@@ -23,11 +23,16 @@
 
 #include "playeradapter.h"
 
+#include <memory>
+
+#include <QImage>
 #include <QRegularExpression>
 #include <QSet>
 
 #include <mpv/client.h>
 
+#include "mpvencoder.h"
+
 class MpvWidget;
 
 /**
@@ -115,8 +120,9 @@ public Q_SLOTS:
 
     void showText(const QString &text) override;
 
-    QString tempScreenshot(const bool subtitles,
-                           const QString &ext = ".jpg") override;
+    QByteArray screenshot(const bool subtitles,
+                          const QString &ext = ".jpg",
+                          const int maxHeight = 0) override;
     QString tempAudioClip(double start,
                           double end,
                           bool normalize = false,
@@ -188,12 +194,33 @@ private:
     void loadFilesFromTree(const struct LoadFileNode &parent,
                                         QStringList  &options);
 
+    /**
+     * Takes a screenshot of the player contents as an uncompressed image.
+     * @param subtitles true to include the subtitles in the image, false
+     *                  otherwise.
+     * @return The screenshot, null image on error.
+     */
+    QImage rawScreenshot(const bool subtitles);
+
+    /**
+     * Takes a screenshot by having mpv write it to the temp directory and
+     * reads it back. Used for formats Qt can't encode.
+     * @param subtitles true to include the subtitles in the image, false
+     *                  otherwise.
+     * @param ext       The image format to use.
+     * @return The encoded image, empty on error.
+     */
+    QByteArray fileScreenshot(const bool subtitles, const QString &ext);
+
     /* The MpvWidget */
     MpvWidget *m_mpv;
 
     /* The mpv context. Used for interacting with the mpv api. */
     mpv_handle *m_handle;
 
+    /* Creates audio clips with warm encoder handles. */
+    std::unique_ptr<MpvEncoder> m_encoder;
+
     /* A set containing all subtitle filetype extensions. */
     QSet<QString> m_subExts;
 
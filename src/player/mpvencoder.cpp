@@ -0,0 +1,440 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "mpvencoder.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QTemporaryFile>
+
+#include "util/executor.h"
+#include "util/trace.h"
+#include "util/utils.h"
+
+/* The number of seconds to wait for an event before giving up */
+#define EVENT_TIMEOUT 100
+
+/* Begin Constructor/Destructor */
+
+MpvEncoder::MpvEncoder(mpv_handle *player) : m_player(player) {}
+
+MpvEncoder::~MpvEncoder()
+{
+    QMutexLocker locker(&m_lock);
+    m_shutdown = true;
+    while (!m_preparing.isEmpty())
+    {
+        m_prepared.wait(&m_lock);
+    }
+    for (const Encoder &encoder : m_warm)
+    {
+        mpv_destroy(encoder.handle);
+        QFile::remove(encoder.filename);
+    }
+    m_warm.clear();
+
+    QMutexLocker copyLocker(&m_copyLock);
+    if (m_copyHandle)
+    {
+        mpv_destroy(m_copyHandle);
+        m_copyHandle = nullptr;
+    }
+}
+
+/* End Constructor/Destructor */
+/* Begin Encoder Management */
+
+MpvEncoder::Encoder MpvEncoder::createEncoder(const QString &ext) const
+{
+    TraceSpan span("MpvEncoder::createEncoder");
+
+    Encoder encoder;
+
+    /* Get a temporary file name */
+    QTemporaryFile file;
+    if (!file.open())
+    {
+        return encoder;
+    }
+    encoder.filename = (file.fileName() + ext).toUtf8();
+    file.close();
+
+    mpv_handle *handle = mpv_create();
+    if (handle == NULL)
+    {
+        qDebug() << "Error creating encoder handle";
+        return encoder;
+    }
+
+    mpv_set_option_string(handle, "cover-art-auto", "no");
+    mpv_set_option_string(handle, "keep-open", "no");
+    mpv_set_option_string(handle, "vid", "no");
+    mpv_set_option_string(handle, "sid", "no");
+    mpv_set_option_string(handle, "secondary-sid", "no");
+    mpv_set_option_string(handle, "ytdl", "yes");
+    mpv_set_option_string(handle, "config", "no");
+    mpv_set_option_string(handle, "o", encoder.filename);
+
+    /* This guarantees the correct version of youtube-dl is used. */
+    char *script_opts = mpv_get_property_string(m_player, "script-opts");
+    if (script_opts && QByteArray(script_opts).contains("ytdl_hook-ytdl_path="))
+    {
+        mpv_set_option_string(handle, "script-opts", script_opts);
+    }
+#if APPBUNDLE
+    else
+    {
+        QByteArray ytdlPath = "ytdl_hook-ytdl_path=";
+        char *config_dir = mpv_get_property_string(m_player, "config-dir");
+        if (config_dir)
+        {
+            ytdlPath += config_dir;
+            ytdlPath += SLASH;
+        }
+        else
+        {
+            ytdlPath += DirectoryUtils::getConfigDir().toUtf8();
+        }
+        mpv_free(config_dir);
+        ytdlPath += "youtube-dl";
+        mpv_set_option_string(handle, "script-opts", ytdlPath);
+    }
+#endif
+    mpv_free(script_opts);
+
+    if (mpv_initialize(handle) < 0)
+    {
+        qDebug() << "Could not initialize encoder";
+        mpv_destroy(handle);
+        return encoder;
+    }
+
+    encoder.handle = handle;
+    return encoder;
+}
+
+MpvEncoder::Encoder MpvEncoder::takeEncoder(const QString &ext)
+{
+    Encoder encoder;
+    m_lock.lock();
+    auto it = m_warm.find(ext);
+    if (it != m_warm.end())
+    {
+        encoder = it.value();
+        m_warm.erase(it);
+    }
+    m_lock.unlock();
+
+    if (encoder.handle == nullptr)
+    {
+        encoder = createEncoder(ext);
+    }
+    prepareEncoder(ext);
+
+    return encoder;
+}
+
+void MpvEncoder::prepareEncoder(const QString &ext)
+{
+    {
+        QMutexLocker locker(&m_lock);
+        if (m_shutdown || m_warm.contains(ext) || m_preparing.contains(ext))
+        {
+            return;
+        }
+        m_preparing.insert(ext, true);
+    }
+
+    Executor::run(
+        Executor::Queue::Media,
+        [this, ext] {
+            Encoder encoder = createEncoder(ext);
+
+            QMutexLocker locker(&m_lock);
+            m_preparing.remove(ext);
+            if (encoder.handle == nullptr)
+            {
+                /* noop */
+            }
+            else if (m_shutdown || m_warm.contains(ext))
+            {
+                mpv_destroy(encoder.handle);
+                QFile::remove(encoder.filename);
+            }
+            else
+            {
+                m_warm.insert(ext, encoder);
+            }
+            m_prepared.wakeAll();
+        },
+        Executor::Priority::Background
+    );
+}
+
+std::shared_ptr<QMutex> MpvEncoder::lockSource(const QString &input)
+{
+    std::shared_ptr<QMutex> lock;
+    {
+        QMutexLocker locker(&m_lock);
+        std::shared_ptr<QMutex> &entry = m_sources[input];
+        if (entry == nullptr)
+        {
+            entry = std::make_shared<QMutex>();
+        }
+        lock = entry;
+    }
+    lock->lock();
+    return lock;
+}
+
+void MpvEncoder::unlockSource(
+    const QString &input,
+    std::shared_ptr<QMutex> &lock)
+{
+    lock->unlock();
+
+    QMutexLocker locker(&m_lock);
+    lock.reset();
+    auto it = m_sources.find(input);
+    if (it != m_sources.end() && it.value().use_count() == 1)
+    {
+        m_sources.erase(it);
+    }
+}
+
+/* End Encoder Management */
+/* Begin Encoding */
+
+QString MpvEncoder::encodeAudio(
+    const QString &input,
+    const int64_t aid,
+    const double start,
+    const double end,
+    const bool normalize,
+    const double db,
+    const QString &ext)
+{
+    TraceSpan span("MpvEncoder::encodeAudio", input);
+
+    /* Requests for the same remote source are queued so they don't compete
+     * for the connection. Local files are safe to read concurrently. */
+    std::shared_ptr<QMutex> lock;
+    if (!QFileInfo::exists(input))
+    {
+        lock = lockSource(input);
+    }
+
+    Encoder encoder = takeEncoder(ext);
+    if (encoder.handle == nullptr)
+    {
+        if (lock)
+        {
+            unlockSource(input, lock);
+        }
+        return "";
+    }
+
+    if (normalize)
+    {
+        QByteArray audioFilter;
+        audioFilter = "loudnorm=I=";
+        audioFilter += QByteArray::number(db, 'f', 1);
+        mpv_set_option_string(encoder.handle, "af", audioFilter);
+    }
+
+    QByteArray inputUtf8 = input.toUtf8();
+    QByteArray optionCmd;
+    optionCmd += QString("start=%1").arg(start, 0, 'f', 3).toUtf8();
+    optionCmd += QString(",end=%1").arg(end, 0, 'f', 3).toUtf8();
+    optionCmd += QString(",aid=%1").arg(aid).toUtf8();
+    const char *args[] = {
+        "loadfile",
+        inputUtf8,
+        "replace",
+        optionCmd.data(),
+        NULL
+    };
+
+    QString filename = encoder.filename;
+    mpv_event *event = NULL;
+    if (mpv_command(encoder.handle, args) < 0)
+    {
+        qDebug() << "Could not encode file";
+        filename = "";
+        goto cleanup;
+    }
+
+    do
+    {
+        event = mpv_wait_event(encoder.handle, EVENT_TIMEOUT);
+        if (event->event_id == MPV_EVENT_NONE ||
+            event->event_id == MPV_EVENT_QUEUE_OVERFLOW)
+        {
+            qDebug() << "mpv returned a bad event" << event->event_id;
+            filename = "";
+            goto cleanup;
+        }
+    }
+    while (event->event_id != MPV_EVENT_END_FILE);
+
+cleanup:
+    mpv_destroy(encoder.handle);
+    if (filename.isEmpty())
+    {
+        QFile::remove(encoder.filename);
+    }
+
+    if (lock)
+    {
+        unlockSource(input, lock);
+    }
+
+    return filename;
+}
+
+QString MpvEncoder::copyExtension(const QString &codec)
+{
+    if (codec == "aac")
+    {
+        return ".aac";
+    }
+    else if (codec == "mp3")
+    {
+        return ".mp3";
+    }
+    else if (codec == "opus")
+    {
+        return ".opus";
+    }
+    return "";
+}
+
+QString MpvEncoder::copyAudio(
+    const QString &input,
+    const int64_t aid,
+    const double start,
+    const double end,
+    const QString &codec)
+{
+    const QString ext = copyExtension(codec);
+    if (ext.isEmpty())
+    {
+        return "";
+    }
+
+    TraceSpan span("MpvEncoder::copyAudio", input);
+
+    QMutexLocker copyLocker(&m_copyLock);
+
+    if (m_copyHandle == nullptr)
+    {
+        m_copyHandle = mpv_create();
+        if (m_copyHandle == NULL)
+        {
+            qDebug() << "Error creating copy handle";
+            return "";
+        }
+
+        /* Play as fast as possible without outputting anything. Only the
+         * packets the demuxer reads are written, so disable readahead to keep
+         * the clip close to the end time. */
+        mpv_set_option_string(m_copyHandle, "cover-art-auto", "no");
+        mpv_set_option_string(m_copyHandle, "keep-open", "no");
+        mpv_set_option_string(m_copyHandle, "idle", "yes");
+        mpv_set_option_string(m_copyHandle, "vid", "no");
+        mpv_set_option_string(m_copyHandle, "sid", "no");
+        mpv_set_option_string(m_copyHandle, "secondary-sid", "no");
+        mpv_set_option_string(m_copyHandle, "ao", "null");
+        mpv_set_option_string(m_copyHandle, "untimed", "yes");
+        mpv_set_option_string(m_copyHandle, "cache", "no");
+        mpv_set_option_string(m_copyHandle, "demuxer-readahead-secs", "0");
+        mpv_set_option_string(m_copyHandle, "ytdl", "no");
+        mpv_set_option_string(m_copyHandle, "config", "no");
+        if (mpv_initialize(m_copyHandle) < 0)
+        {
+            qDebug() << "Could not initialize copy handle";
+            mpv_destroy(m_copyHandle);
+            m_copyHandle = nullptr;
+            return "";
+        }
+    }
+
+    /* Get a temporary file name */
+    QTemporaryFile file;
+    if (!file.open())
+    {
+        return "";
+    }
+    QString filename = file.fileName() + ext;
+    file.close();
+
+    QByteArray inputUtf8 = input.toUtf8();
+    QByteArray optionCmd;
+    optionCmd += QString("start=%1").arg(start, 0, 'f', 3).toUtf8();
+    optionCmd += QString(",end=%1").arg(end, 0, 'f', 3).toUtf8();
+    optionCmd += QString(",aid=%1").arg(aid).toUtf8();
+    optionCmd += ",stream-record=\"" + filename.toUtf8() + "\"";
+    const char *args[] = {
+        "loadfile",
+        inputUtf8,
+        "replace",
+        optionCmd.data(),
+        NULL
+    };
+
+    if (mpv_command(m_copyHandle, args) < 0)
+    {
+        qDebug() << "Could not copy audio";
+        return "";
+    }
+
+    mpv_event *event = NULL;
+    do
+    {
+        event = mpv_wait_event(m_copyHandle, EVENT_TIMEOUT);
+        if (event->event_id == MPV_EVENT_NONE ||
+            event->event_id == MPV_EVENT_QUEUE_OVERFLOW)
+        {
+            qDebug() << "mpv returned a bad event" << event->event_id;
+            mpv_destroy(m_copyHandle);
+            m_copyHandle = nullptr;
+            QFile::remove(filename);
+            return "";
+        }
+    }
+    while (event->event_id != MPV_EVENT_END_FILE);
+
+    const mpv_event_end_file *endFile = (mpv_event_end_file *)event->data;
+    if (endFile->reason == MPV_END_FILE_REASON_ERROR ||
+        QFile(filename).size() == 0)
+    {
+        qDebug() << "Could not copy audio, falling back to encoding";
+        QFile::remove(filename);
+        return "";
+    }
+
+    return filename;
+}
+
+#undef EVENT_TIMEOUT
+
+/* End Encoding */
@@ -0,0 +1,182 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MPVENCODER_H
+#define MPVENCODER_H
+
+#include <memory>
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+
+#include <mpv/client.h>
+
+/**
+ * Creates audio clips with dedicated mpv encoder handles.
+ * mpv can only write a single output file per handle and the output file must
+ * be set before the handle is initialized, so handles can't be reused across
+ * clips. Instead, an initialized handle is kept warm for each output format so
+ * that creating and initializing a handle is moved off the critical path of a
+ * request. Requests for the same remote source are serialized so they don't
+ * compete for the same network connection, while clips of local files are
+ * encoded concurrently. Clips that don't need to be re-encoded can instead be
+ * remuxed with a single reusable handle.
+ * All methods are thread-safe.
+ */
+class MpvEncoder
+{
+public:
+    /**
+     * Creates a new encoder.
+     * @param player The handle of the main player. Used to copy script options
+     *               so the same youtube-dl is used. Must outlive the encoder.
+     */
+    MpvEncoder(mpv_handle *player);
+    ~MpvEncoder();
+
+    /**
+     * Encodes an audio clip into the temporary directory.
+     * @param input     The path or URL of the source.
+     * @param aid       The id of the audio track to encode.
+     * @param start     The start time of the clip in seconds.
+     * @param end       The end time of the clip in seconds.
+     * @param normalize true if audio should be normalized to db, false
+     *                  otherwise.
+     * @param db        The decibel level to normalize to.
+     * @param ext       The extension of the clip. Determines the codec used.
+     * @return Path to the clip, empty string on error.
+     */
+    QString encodeAudio(
+        const QString &input,
+        int64_t aid,
+        double start,
+        double end,
+        bool normalize,
+        double db,
+        const QString &ext);
+
+    /**
+     * Copies the packets of an audio track between two times into the
+     * temporary directory without re-encoding them. The clip is snapped
+     * outwards to the nearest packet boundaries.
+     * @param input The path of the local source file.
+     * @param aid   The id of the audio track to copy.
+     * @param start The start time of the clip in seconds.
+     * @param end   The end time of the clip in seconds.
+     * @param codec The codec of the audio track as reported by mpv.
+     * @return Path to the clip, empty string if the codec can't be copied or
+     *         on error.
+     */
+    QString copyAudio(
+        const QString &input,
+        int64_t aid,
+        double start,
+        double end,
+        const QString &codec);
+
+    /**
+     * Returns the extension of the file a codec can be copied into.
+     * @param codec The codec as reported by mpv.
+     * @return The extension including the leading period, empty string if the
+     *         codec can't be copied into a file Anki supports.
+     */
+    static QString copyExtension(const QString &codec);
+
+private:
+    /* An initialized encoder handle that hasn't been used yet. */
+    struct Encoder
+    {
+        /* The initialized handle. */
+        mpv_handle *handle = nullptr;
+
+        /* The file the handle will write to. */
+        QByteArray filename;
+    };
+
+    /**
+     * Creates and initializes a new encoder handle.
+     * @param ext The extension of the output file.
+     * @return The encoder, handle is nullptr on error.
+     */
+    Encoder createEncoder(const QString &ext) const;
+
+    /**
+     * Takes the warm encoder for the extension or creates one if none exists.
+     * Schedules a replacement to be created in the background.
+     * @param ext The extension of the output file.
+     * @return The encoder, handle is nullptr on error.
+     */
+    Encoder takeEncoder(const QString &ext);
+
+    /**
+     * Creates a warm encoder for the extension in the background if there
+     * isn't one already.
+     * @param ext The extension of the output file.
+     */
+    void prepareEncoder(const QString &ext);
+
+    /**
+     * Locks the mutex used to serialize requests for a source.
+     * @param input The path or URL of the source.
+     * @return The locked mutex belonging to the source.
+     */
+    std::shared_ptr<QMutex> lockSource(const QString &input);
+
+    /**
+     * Unlocks a mutex returned by lockSource(). The mutex is forgotten once no
+     * other request holds it.
+     * @param input The path or URL of the source.
+     * @param lock  The mutex to unlock. Reset by this method.
+     */
+    void unlockSource(const QString &input, std::shared_ptr<QMutex> &lock);
+
+    /* The handle of the main player. */
+    mpv_handle *m_player;
+
+    /* Maps extensions to warm encoders. */
+    QHash<QString, Encoder> m_warm;
+
+    /* Extensions with an encoder currently being prepared. */
+    QHash<QString, bool> m_preparing;
+
+    /* The handle used to copy clips. Reused across requests. */
+    mpv_handle *m_copyHandle = nullptr;
+
+    /* Protects m_copyHandle. Held for the duration of a copy. */
+    QMutex m_copyLock;
+
+    /* Maps sources to the mutex serializing requests for them. Only sources
+     * with a request in progress are present. */
+    QHash<QString, std::shared_ptr<QMutex>> m_sources;
+
+    /* true when the encoder is being destroyed. */
+    bool m_shutdown = false;
+
+    /* Protects all members. */
+    QMutex m_lock;
+
+    /* Signaled when an encoder finishes being prepared. */
+    QWaitCondition m_prepared;
+};
+
+#endif // MPVENCODER_H
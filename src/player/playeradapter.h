@@ -21,6 +21,7 @@
 #ifndef PLAYERADAPTER_H
 #define PLAYERADAPTER_H
 
+#include <QByteArray>
 #include <QKeyEvent>
 #include <QObject>
 #include <QWheelEvent>
@@ -303,15 +304,19 @@ public Q_SLOTS:
     virtual void showText(const QString &text) = 0;
 
     /**
-     * Takes a screenshot of the player contents and stores the files in the
-     * temp directory.
+     * Takes a screenshot of the player contents and encodes it in memory.
+     * Safe to call from any thread. Encoding happens on the calling thread.
      * @param subtitles true to include the subtitles in the images, false
      *                  otherwise.
      * @param ext       The image format to use. '.jpg' by default.
-     * @return Path to the file.
+     * @param maxHeight The maximum height of the image in pixels. Larger
+     *                  screenshots are scaled down. 0 to keep the source
+     *                  resolution.
+     * @return The encoded image, empty on error.
      */
-    virtual QString tempScreenshot(const bool subtitles,
-                                   const QString &ext = ".jpg") = 0;
+    virtual QByteArray screenshot(const bool subtitles,
+                                  const QString &ext = ".jpg",
+                                  const int maxHeight = 0) = 0;
 
     /**
      * Creates an audio clip given a start and end time in the temporary
@@ -322,7 +327,9 @@ public Q_SLOTS:
      *                  otherwise.
      * @param db        The decibel level to normalize to.
      * @param ext       The extension of the audio file. Determines what codec
-     *                  is used. AAC is default.
+     *                  is used. AAC is default. If the source codec already
+     *                  matches the extension, the audio is copied without
+     *                  re-encoding.
      * @return Path to the file.
      */
     virtual QString tempAudioClip(double start,
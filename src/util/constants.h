@@ -37,6 +37,7 @@ namespace Constants
     {
         File = 0,
         JSON = 1,
+        Local = 2,
     };
 
     enum class FileOpenDirectory
@@ -244,6 +245,9 @@ namespace Constants
                 constexpr const char *LIST_TIMESTAMPS = "sub-list-timestamps";
                 constexpr bool LIST_TIMESTAMPS_DEFAULT = false;
 
+                constexpr const char *ANNOTATE = "sub-annotate";
+                constexpr bool ANNOTATE_DEFAULT = false;
+
                 constexpr const char *SEARCH_WINDOW = "search-window";
                 constexpr bool SEARCH_WINDOW_DEFAULT = false;
 
@@ -0,0 +1,224 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "executor.h"
+
+#include <algorithm>
+#include <memory>
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSemaphore>
+
+/* Begin Histogram */
+
+void Executor::Histogram::add(const quint64 usecs)
+{
+    int bucket = 0;
+    for (quint64 ms = usecs / 1000; ms > 0 && bucket < HISTOGRAM_BUCKETS - 1;
+         ms >>= 1)
+    {
+        ++bucket;
+    }
+    ++buckets[bucket];
+    ++count;
+    total += usecs;
+    max = std::max(max, usecs);
+}
+
+QString Executor::Histogram::bucketLabel(const int bucket)
+{
+    if (bucket <= 0)
+    {
+        return "< 1 ms";
+    }
+    else if (bucket >= HISTOGRAM_BUCKETS - 1)
+    {
+        return QString(">= %1 ms").arg(1ull << (HISTOGRAM_BUCKETS - 2));
+    }
+    return QString("%1-%2 ms").arg(1ull << (bucket - 1)).arg(1ull << bucket);
+}
+
+/* End Histogram */
+/* Begin Constructor/Destructor */
+
+Executor::Executor(
+    const QString &name,
+    const int maxThreads,
+    const QThread::Priority threadPriority) :
+    m_name(name)
+{
+    m_pool.setMaxThreadCount(std::max(1, maxThreads));
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+    m_pool.setThreadPriority(threadPriority);
+#else
+    Q_UNUSED(threadPriority);
+#endif
+}
+
+Executor::~Executor()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+/* End Constructor/Destructor */
+/* Begin Static Methods */
+
+Executor *Executor::get(const Queue queue)
+{
+    static const std::array<std::unique_ptr<Executor>, (size_t)Queue::Count>
+        executors = [] {
+            const int ideal = QThread::idealThreadCount();
+            std::array<std::unique_ptr<Executor>, (size_t)Queue::Count> result;
+            result[(size_t)Queue::Lookup].reset(
+                new Executor("Lookup", ideal, QThread::HighPriority)
+            );
+            result[(size_t)Queue::Anki].reset(
+                new Executor("Anki", 2, QThread::NormalPriority)
+            );
+            result[(size_t)Queue::Media].reset(
+                new Executor("Media", 4, QThread::NormalPriority)
+            );
+            result[(size_t)Queue::Subtitle].reset(
+                new Executor("Subtitle", 2, QThread::LowPriority)
+            );
+            result[(size_t)Queue::Dictionary].reset(
+                new Executor("Dictionary", 1, QThread::LowestPriority)
+            );
+            result[(size_t)Queue::Library].reset(
+                new Executor("Library", 1, QThread::LowestPriority)
+            );
+            result[(size_t)Queue::Audio].reset(
+                new Executor("Audio", 1, QThread::NormalPriority)
+            );
+            return result;
+        }();
+
+    return executors[std::clamp(
+        (size_t)queue, (size_t)0, (size_t)Queue::Count - 1
+    )].get();
+}
+
+void Executor::run(
+    const Queue queue,
+    std::function<void()> task,
+    const Priority priority)
+{
+    get(queue)->start(std::move(task), priority);
+}
+
+void Executor::runAll(
+    const Queue queue,
+    const QList<std::function<void()>> &tasks,
+    const Priority priority)
+{
+    if (tasks.isEmpty())
+    {
+        return;
+    }
+
+    QSemaphore finished;
+    Executor *executor = get(queue);
+    for (const std::function<void()> &task : tasks)
+    {
+        executor->start(
+            [&task, &finished] {
+                task();
+                finished.release();
+            },
+            priority
+        );
+    }
+    finished.acquire(tasks.size());
+}
+
+QList<Executor::Statistics> Executor::statistics()
+{
+    QList<Statistics> result;
+    for (size_t i = 0; i < (size_t)Queue::Count; ++i)
+    {
+        result.append(get((Queue)i)->getStatistics());
+    }
+    return result;
+}
+
+/* End Static Methods */
+/* Begin Task Methods */
+
+void Executor::start(std::function<void()> task, const Priority priority)
+{
+    QElapsedTimer submitted;
+    submitted.start();
+    m_queued.ref();
+
+    m_pool.start(
+        [this, submitted, task = std::move(task)] {
+            const quint64 wait = submitted.nsecsElapsed() / 1000;
+            m_queued.deref();
+            m_active.ref();
+
+            QElapsedTimer timer;
+            timer.start();
+            task();
+            const quint64 run = timer.nsecsElapsed() / 1000;
+
+            m_active.deref();
+            QMutexLocker locker(&m_lock);
+            m_wait.add(wait);
+            m_run.add(run);
+        },
+        (int)priority
+    );
+}
+
+void Executor::start(QRunnable *runnable, const Priority priority)
+{
+    start(
+        [runnable] {
+            runnable->run();
+            if (runnable->autoDelete())
+            {
+                delete runnable;
+            }
+        },
+        priority
+    );
+}
+
+/* End Task Methods */
+/* Begin Getters */
+
+Executor::Statistics Executor::getStatistics() const
+{
+    Statistics stats;
+    stats.name = m_name;
+    stats.maxThreads = m_pool.maxThreadCount();
+    stats.active = m_active.loadRelaxed();
+    stats.queued = m_queued.loadRelaxed();
+
+    QMutexLocker locker(&m_lock);
+    stats.wait = m_wait;
+    stats.run = m_run;
+    return stats;
+}
+
+/* End Getters */
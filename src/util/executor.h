@@ -0,0 +1,241 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <array>
+#include <functional>
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QThreadPool>
+
+class QRunnable;
+
+/**
+ * A named queue of background work backed by its own thread pool.
+ * Every kind of work gets its own queue with its own concurrency limit so that
+ * long running jobs such as dictionary imports can never starve interactive
+ * work such as hover lookups.
+ */
+class Executor
+{
+public:
+    /**
+     * The named queues work can be submitted to.
+     */
+    enum class Queue
+    {
+        /* Term and kanji lookups triggered by the user. */
+        Lookup = 0,
+
+        /* Building and sending notes to Anki. */
+        Anki,
+
+        /* Encoding audio clips and screenshots. */
+        Media,
+
+        /* Parsing and searching subtitle tracks. */
+        Subtitle,
+
+        /* Importing and deleting dictionaries. */
+        Dictionary,
+
+        /* Indexing local audio libraries. */
+        Library,
+
+        /* Decoding audio clips for playback. */
+        Audio,
+
+        /* The number of queues. Not a valid queue. */
+        Count
+    };
+
+    /**
+     * The priority of a task relative to other tasks in the same queue.
+     * Higher priority tasks are always started first.
+     */
+    enum class Priority
+    {
+        Background  = 0,
+        Normal      = 1,
+        Interactive = 2,
+    };
+
+    /* The number of buckets in each histogram. */
+    static constexpr int HISTOGRAM_BUCKETS = 16;
+
+    /**
+     * A histogram of durations with power of two millisecond buckets.
+     * Bucket 0 holds durations under 1 ms, bucket i holds durations in
+     * [2^(i - 1), 2^i) ms and the last bucket holds everything longer.
+     */
+    struct Histogram
+    {
+        /* The number of samples in each bucket. */
+        std::array<quint64, HISTOGRAM_BUCKETS> buckets{};
+
+        /* The total number of samples. */
+        quint64 count = 0;
+
+        /* The sum of all samples in microseconds. */
+        quint64 total = 0;
+
+        /* The largest sample in microseconds. */
+        quint64 max = 0;
+
+        /**
+         * Adds a sample to the histogram.
+         * @param usecs The duration in microseconds.
+         */
+        void add(quint64 usecs);
+
+        /**
+         * Returns a human readable label for a bucket.
+         * @param bucket The index of the bucket.
+         * @return A label such as "4-8 ms".
+         */
+        static QString bucketLabel(int bucket);
+    };
+
+    /**
+     * A snapshot of the state of a queue.
+     */
+    struct Statistics
+    {
+        /* The name of the queue. */
+        QString name;
+
+        /* The maximum number of tasks that can run concurrently. */
+        int maxThreads = 0;
+
+        /* The number of tasks currently running. */
+        int active = 0;
+
+        /* The number of tasks waiting to run. */
+        int queued = 0;
+
+        /* Time between a task being submitted and it starting. */
+        Histogram wait;
+
+        /* Time a task took to run. */
+        Histogram run;
+    };
+
+    /**
+     * Gets the executor for a queue.
+     * @param queue The queue to get.
+     * @return The executor for the queue. Never nullptr.
+     */
+    static Executor *get(Queue queue);
+
+    /**
+     * Convenience function for submitting a task to a queue.
+     * @param queue    The queue to run the task on.
+     * @param task     The task to run.
+     * @param priority The priority of the task.
+     */
+    static void run(
+        Queue queue,
+        std::function<void()> task,
+        Priority priority = Priority::Normal);
+
+    /**
+     * Runs tasks concurrently on a queue and blocks until all of them finish.
+     * Must not be called from a thread belonging to the same queue.
+     * @param queue    The queue to run the tasks on.
+     * @param tasks    The tasks to run.
+     * @param priority The priority of the tasks.
+     */
+    static void runAll(
+        Queue queue,
+        const QList<std::function<void()>> &tasks,
+        Priority priority = Priority::Normal);
+
+    /**
+     * Returns the statistics of every queue.
+     * @return The statistics of every queue in Queue order.
+     */
+    static QList<Statistics> statistics();
+
+    /**
+     * Submits a task to the queue.
+     * @param task     The task to run.
+     * @param priority The priority of the task.
+     */
+    void start(
+        std::function<void()> task,
+        Priority priority = Priority::Normal);
+
+    /**
+     * Submits a runnable to the queue. The runnable is deleted after running if
+     * autoDelete() is true.
+     * @param runnable The runnable to run.
+     * @param priority The priority of the runnable.
+     */
+    void start(QRunnable *runnable, Priority priority = Priority::Normal);
+
+    /**
+     * Returns a snapshot of the state of the queue.
+     * @return The statistics of this queue.
+     */
+    Statistics getStatistics() const;
+
+    ~Executor();
+
+private:
+    /**
+     * Creates a new executor.
+     * @param name           The name of the queue.
+     * @param maxThreads     The maximum number of concurrently running tasks.
+     * @param threadPriority The priority of the threads running tasks.
+     */
+    Executor(
+        const QString &name,
+        int maxThreads,
+        QThread::Priority threadPriority);
+
+    /* The name of the queue. */
+    const QString m_name;
+
+    /* The pool tasks are run on. */
+    QThreadPool m_pool;
+
+    /* The number of tasks submitted but not started. */
+    QAtomicInt m_queued;
+
+    /* The number of tasks currently running. */
+    QAtomicInt m_active;
+
+    /* Time tasks spent waiting to run. */
+    Histogram m_wait;
+
+    /* Time tasks spent running. */
+    Histogram m_run;
+
+    /* Protects m_wait and m_run. */
+    mutable QMutex m_lock;
+};
+
+#endif // EXECUTOR_H
@@ -30,6 +30,9 @@ GlobalMediator::GlobalMediator(QObject *parent) : QObject(parent)
     m_playerWidget = nullptr;
     m_subList      = nullptr;
     m_audioPlayer  = nullptr;
+    m_audioSourceResolver = nullptr;
+    m_localAudioLibrary = nullptr;
+    m_annotator    = nullptr;
 }
 
 GlobalMediator *GlobalMediator::createGlobalMediator()
@@ -56,6 +59,16 @@ AudioPlayer *GlobalMediator::getAudioPlayer() const
     return m_audioPlayer;
 }
 
+AudioSourceResolver *GlobalMediator::getAudioSourceResolver() const
+{
+    return m_audioSourceResolver;
+}
+
+LocalAudioLibrary *GlobalMediator::getLocalAudioLibrary() const
+{
+    return m_localAudioLibrary;
+}
+
 Dictionary *GlobalMediator::getDictionary() const
 {
     return m_dictionary;
@@ -76,6 +89,11 @@ SubtitleListWidget *GlobalMediator::getSubtitleListWidget() const
     return m_subList;
 }
 
+SubtitleAnnotator *GlobalMediator::getSubtitleAnnotator() const
+{
+    return m_annotator;
+}
+
 /* End Getters */
 /* Begin Setters */
 
@@ -91,6 +109,20 @@ GlobalMediator *GlobalMediator::setAudioPlayer(AudioPlayer *audioPlayer)
     return m_mediator;
 }
 
+GlobalMediator *GlobalMediator::setAudioSourceResolver(
+    AudioSourceResolver *resolver)
+{
+    m_audioSourceResolver = resolver;
+    return m_mediator;
+}
+
+GlobalMediator *GlobalMediator::setLocalAudioLibrary(
+    LocalAudioLibrary *library)
+{
+    m_localAudioLibrary = library;
+    return m_mediator;
+}
+
 GlobalMediator *GlobalMediator::setDictionary(Dictionary *dictionary)
 {
     m_dictionary = dictionary;
@@ -115,4 +147,11 @@ GlobalMediator *GlobalMediator::setSubtitleList(SubtitleListWidget *subList)
     return m_mediator;
 }
 
+GlobalMediator *GlobalMediator::setSubtitleAnnotator(
+    SubtitleAnnotator *annotator)
+{
+    m_annotator = annotator;
+    return m_mediator;
+}
+
 /* End Setters */
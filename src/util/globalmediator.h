@@ -29,9 +29,12 @@
 
 class AnkiClient;
 class AudioPlayer;
+class AudioSourceResolver;
+class LocalAudioLibrary;
 class Dictionary;
 class PlayerAdapter;
 class QWidget;
+class SubtitleAnnotator;
 class SubtitleListWidget;
 
 class QKeyEvent;
@@ -82,6 +85,20 @@ public:
      */
     AudioPlayer *getAudioPlayer() const;
 
+    /**
+     * Gets the AudioSourceResolver object used for resolving JSON audio
+     * sources.
+     * @return The AudioSourceResolver object, nullptr if it doesn't exist.
+     */
+    AudioSourceResolver *getAudioSourceResolver() const;
+
+    /**
+     * Gets the LocalAudioLibrary object used for finding audio in local audio
+     * sources.
+     * @return The LocalAudioLibrary object, nullptr if it doesn't exist.
+     */
+    LocalAudioLibrary *getLocalAudioLibrary() const;
+
     /**
      * Gets the shared Dictionary object for accessing the dictionary database.
      * @return The Dictionary object, nullptr if it doesn't exist.
@@ -107,6 +124,12 @@ public:
      */
     SubtitleListWidget *getSubtitleListWidget() const;
 
+    /**
+     * Gets the SubtitleAnnotator for looking up subtitle line annotations.
+     * @return The SubtitleAnnotator object, nullptr if it doesn't exist.
+     */
+    SubtitleAnnotator *getSubtitleAnnotator() const;
+
     /**
      * Sets the shared AnkiClient. Does not take ownership.
      * @param client The shared AnkiClient.
@@ -121,6 +144,20 @@ public:
      */
     GlobalMediator *setAudioPlayer(AudioPlayer *audioPlayer);
 
+    /**
+     * Sets the shared AudioSourceResolver. Does not take ownership.
+     * @param resolver The shared AudioSourceResolver.
+     * @return The shared GlobalMediator, nullptr if it doesn't exist.
+     */
+    GlobalMediator *setAudioSourceResolver(AudioSourceResolver *resolver);
+
+    /**
+     * Sets the shared LocalAudioLibrary. Does not take ownership.
+     * @param library The shared LocalAudioLibrary.
+     * @return The shared GlobalMediator, nullptr if it doesn't exist.
+     */
+    GlobalMediator *setLocalAudioLibrary(LocalAudioLibrary *library);
+
     /**
      * Sets the shared Dictionary. Does not take ownership.
      * @param dictionary The shared Dictionary.
@@ -149,6 +186,13 @@ public:
      */
     GlobalMediator *setSubtitleList(SubtitleListWidget *subList);
 
+    /**
+     * Sets the shared subtitle annotator. Does not take ownership.
+     * @param annotator The shared subtitle annotator.
+     * @return The shared GlobalMediator, nullptr if it doesn't exist.
+     */
+    GlobalMediator *setSubtitleAnnotator(SubtitleAnnotator *annotator);
+
 Q_SIGNALS:
     /* Begin Dialog Boxes */
 
@@ -446,6 +490,12 @@ Q_SIGNALS:
      */
     void menuShowAbout() const;
 
+    /**
+     * Emitted when the menu action for showing thread pool statistics is
+     * triggered.
+     */
+    void menuShowExecutorStats() const;
+
     /* End Menu Signals */
     /* Begin Player Control Signals */
 
@@ -653,6 +703,9 @@ private:
     QWidget            *m_playerWidget;
     SubtitleListWidget *m_subList;
     AudioPlayer        *m_audioPlayer;
+    AudioSourceResolver *m_audioSourceResolver;
+    LocalAudioLibrary  *m_localAudioLibrary;
+    SubtitleAnnotator  *m_annotator;
 
     GlobalMediator(QObject *parent = nullptr);
 };
@@ -0,0 +1,298 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "subtitleindex.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include <QMutexLocker>
+#include <QRegularExpression>
+
+#include "subtitleparser.h"
+
+/* Begin Static Helpers */
+
+#define KATAKANA_BEGIN      0x30A1
+#define KATAKANA_END        0x30F6
+#define KATAKANA_ITER_BEGIN 0x30FD
+#define KATAKANA_ITER_END   0x30FE
+#define KANA_OFFSET         0x60
+
+QString SubtitleIndex::foldKana(const QString &text)
+{
+    QString folded(text);
+    for (QChar &ch : folded)
+    {
+        const char16_t c = ch.unicode();
+        if ((c >= KATAKANA_BEGIN && c <= KATAKANA_END) ||
+            (c >= KATAKANA_ITER_BEGIN && c <= KATAKANA_ITER_END))
+        {
+            ch = QChar(c - KANA_OFFSET);
+        }
+    }
+    return folded;
+}
+
+#undef KATAKANA_BEGIN
+#undef KATAKANA_END
+#undef KATAKANA_ITER_BEGIN
+#undef KATAKANA_ITER_END
+#undef KANA_OFFSET
+
+/**
+ * Packs two UTF-16 code units into a single bigram key.
+ * @param first  The first code unit.
+ * @param second The second code unit.
+ * @return The key of the bigram.
+ */
+static inline uint32_t bigramKey(char16_t first, char16_t second)
+{
+    return (uint32_t)first << 16 | second;
+}
+
+/**
+ * Appends a line to a posting list if it isn't already the last entry.
+ * Lines are always indexed in increasing order, so this keeps the list sorted
+ * and free of duplicates.
+ * @param postings The posting list.
+ * @param line     The line to add.
+ */
+static inline void addPosting(QVector<int> &postings, int line)
+{
+    if (postings.isEmpty() || postings.last() != line)
+    {
+        postings.append(line);
+    }
+}
+
+/* End Static Helpers */
+/* Begin Indexing */
+
+void SubtitleIndex::update(
+    int64_t sid,
+    const std::vector<std::shared_ptr<SubtitleInfo>> &subs,
+    const QRegularExpression &filter)
+{
+    QMutexLocker locker(&m_lock);
+    updateHelper(m_tracks[sid], subs, filter);
+}
+
+void SubtitleIndex::updateHelper(
+    TrackIndex &index,
+    const std::vector<std::shared_ptr<SubtitleInfo>> &subs,
+    const QRegularExpression &filter)
+{
+    const SubtitleInfo *source = subs.empty() ? nullptr : subs.front().get();
+    if (index.source != source ||
+        index.filter != filter.pattern() ||
+        (size_t)index.lines.size() > subs.size())
+    {
+        index = TrackIndex();
+        index.source = source;
+        index.filter = filter.pattern();
+    }
+
+    const bool filtered = !filter.pattern().isEmpty();
+    for (size_t i = index.lines.size(); i < subs.size(); ++i)
+    {
+        const int line = i;
+        QString raw = subs[i]->text;
+        if (filtered)
+        {
+            raw.remove(filter);
+        }
+        QString text = raw.toCaseFolded();
+        QString folded = foldKana(text);
+
+        for (int j = 0; j < folded.size(); ++j)
+        {
+            const char16_t c = folded[j].unicode();
+            addPosting(index.unigrams[c], line);
+            if (j + 1 < folded.size())
+            {
+                addPosting(
+                    index.bigrams[bigramKey(c, folded[j + 1].unicode())], line
+                );
+            }
+        }
+
+        index.rawLines.append(std::move(raw));
+        index.lines.append(std::move(text));
+        index.foldedLines.append(std::move(folded));
+    }
+}
+
+QList<int64_t> SubtitleIndex::tracks()
+{
+    QMutexLocker locker(&m_lock);
+    return m_tracks.keys();
+}
+
+void SubtitleIndex::clear()
+{
+    QMutexLocker locker(&m_lock);
+    m_tracks.clear();
+}
+
+/* End Indexing */
+/* Begin Searching */
+
+QVector<int> SubtitleIndex::candidates(
+    const TrackIndex &index,
+    const QString &folded)
+{
+    if (folded.size() == 1)
+    {
+        return index.unigrams.value(folded[0].unicode());
+    }
+
+    QList<const QVector<int> *> postings;
+    for (int i = 0; i + 1 < folded.size(); ++i)
+    {
+        auto it = index.bigrams.constFind(
+            bigramKey(folded[i].unicode(), folded[i + 1].unicode())
+        );
+        if (it == index.bigrams.constEnd())
+        {
+            return {};
+        }
+        postings.append(&it.value());
+    }
+    std::sort(postings.begin(), postings.end(),
+        [] (const QVector<int> *lhs, const QVector<int> *rhs)
+        {
+            return lhs->size() < rhs->size();
+        }
+    );
+
+    QVector<int> result = *postings.first();
+    for (int i = 1; i < postings.size() && !result.isEmpty(); ++i)
+    {
+        QVector<int> intersection;
+        std::set_intersection(
+            result.constBegin(), result.constEnd(),
+            postings[i]->constBegin(), postings[i]->constEnd(),
+            std::back_inserter(intersection)
+        );
+        result = std::move(intersection);
+    }
+    return result;
+}
+
+QVector<int> SubtitleIndex::find(
+    int64_t sid,
+    const QString &query,
+    const FindOptions &options,
+    bool *valid)
+{
+    if (valid)
+    {
+        *valid = true;
+    }
+
+    QVector<int> matches;
+    QMutexLocker locker(&m_lock);
+    auto it = m_tracks.find(sid);
+    if (it == m_tracks.end())
+    {
+        return matches;
+    }
+    TrackIndex &index = it.value();
+
+    if (query.isEmpty())
+    {
+        index.lastQuery.clear();
+        index.lastMatches.clear();
+        return matches;
+    }
+
+    if (options.regex)
+    {
+        QRegularExpression regex(
+            options.kanaInsensitive ? foldKana(query) : query,
+            QRegularExpression::CaseInsensitiveOption |
+                QRegularExpression::UseUnicodePropertiesOption
+        );
+        if (!regex.isValid())
+        {
+            if (valid)
+            {
+                *valid = false;
+            }
+            return matches;
+        }
+        for (int i = 0; i < index.lines.size(); ++i)
+        {
+            const QString &text = options.kanaInsensitive ?
+                index.foldedLines[i] : index.rawLines[i];
+            if (regex.match(text).hasMatch())
+            {
+                matches.append(i);
+            }
+        }
+        index.lastQuery.clear();
+        index.lastMatches.clear();
+        return matches;
+    }
+
+    const QString needle = options.kanaInsensitive ?
+        foldKana(query.toCaseFolded()) : query.toCaseFolded();
+
+    /* A query that contains the previous query can only match lines the
+     * previous query matched, plus any lines added since. */
+    QVector<int> lines;
+    if (!index.lastQuery.isEmpty() &&
+        index.lastOptions == options &&
+        needle.contains(index.lastQuery))
+    {
+        lines = index.lastMatches;
+        for (int i = index.lastSize; i < index.lines.size(); ++i)
+        {
+            lines.append(i);
+        }
+    }
+    else
+    {
+        lines = candidates(
+            index,
+            options.kanaInsensitive ? needle : foldKana(needle)
+        );
+    }
+
+    const QVector<QString> &haystack =
+        options.kanaInsensitive ? index.foldedLines : index.lines;
+    for (int i : lines)
+    {
+        if (haystack[i].contains(needle))
+        {
+            matches.append(i);
+        }
+    }
+
+    index.lastQuery = needle;
+    index.lastOptions = options;
+    index.lastSize = index.lines.size();
+    index.lastMatches = matches;
+
+    return matches;
+}
+
+/* End Searching */
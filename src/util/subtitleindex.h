@@ -0,0 +1,180 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SUBTITLEINDEX_H
+#define SUBTITLEINDEX_H
+
+#include <memory>
+#include <vector>
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QRegularExpression>
+#include <QString>
+#include <QVector>
+
+struct SubtitleInfo;
+
+/**
+ * A character n-gram index over the subtitle tracks of the current file.
+ * Subtitle lists are assumed to be append-only, so the index for a track is
+ * extended incrementally as new lines are seen. All methods are thread-safe.
+ */
+class SubtitleIndex
+{
+public:
+    /**
+     * Options that change how a query is matched.
+     */
+    struct FindOptions
+    {
+        /* true if the query is a regular expression, false otherwise */
+        bool regex = false;
+
+        /* true if hiragana and katakana should be treated as equal */
+        bool kanaInsensitive = false;
+
+        bool operator==(const FindOptions &rhs) const
+        {
+            return regex == rhs.regex && kanaInsensitive == rhs.kanaInsensitive;
+        }
+    };
+
+    SubtitleIndex() = default;
+
+    /**
+     * Indexes every line in the subtitle list not already indexed.
+     * The track is reindexed if the filter differs from the one it was indexed
+     * with.
+     * @param sid    The id of the track the subtitles belong to.
+     * @param subs   The subtitles belonging to the track.
+     * @param filter Matches of this expression are removed from each line
+     *               before it is indexed so only the displayed text is
+     *               searched. Ignored if the pattern is empty.
+     */
+    void update(
+        int64_t sid,
+        const std::vector<std::shared_ptr<SubtitleInfo>> &subs,
+        const QRegularExpression &filter = QRegularExpression());
+
+    /**
+     * Finds all the indexed lines in a track that match the query.
+     * @param      sid     The id of the track to search.
+     * @param      query   The text to search for.
+     * @param      options The options to search with.
+     * @param[out] valid   Set to false if the query is an invalid regular
+     *                     expression, true otherwise. Can be nullptr.
+     * @return The sorted indices into the subtitle list of every matching line.
+     */
+    QVector<int> find(
+        int64_t sid,
+        const QString &query,
+        const FindOptions &options,
+        bool *valid = nullptr);
+
+    /**
+     * Returns the ids of every indexed track.
+     * @return The list of indexed sids.
+     */
+    QList<int64_t> tracks();
+
+    /**
+     * Removes every track from the index.
+     */
+    void clear();
+
+    /**
+     * Converts all the katakana in a string to hiragana.
+     * @param text The text to fold.
+     * @return The text with all katakana replaced with hiragana.
+     */
+    static QString foldKana(const QString &text);
+
+private:
+    /* The index of a single subtitle track. */
+    struct TrackIndex
+    {
+        /* The first line of the indexed list. Used to detect replaced lists. */
+        const SubtitleInfo *source = nullptr;
+
+        /* The pattern of the filter the lines were indexed with. */
+        QString filter;
+
+        /* Filtered text of every indexed line. */
+        QVector<QString> rawLines;
+
+        /* Case folded text of every indexed line. */
+        QVector<QString> lines;
+
+        /* Case and kana folded text of every indexed line. */
+        QVector<QString> foldedLines;
+
+        /* Maps a single folded character to the lines containing it. */
+        QHash<char16_t, QVector<int>> unigrams;
+
+        /* Maps a pair of folded characters to the lines containing them. */
+        QHash<uint32_t, QVector<int>> bigrams;
+
+        /* Begin Incremental Search Values */
+
+        /* The last query searched for in this track. */
+        QString lastQuery;
+
+        /* The options of the last search. */
+        FindOptions lastOptions;
+
+        /* The number of lines indexed when the last search was run. */
+        int lastSize = 0;
+
+        /* The results of the last search. */
+        QVector<int> lastMatches;
+
+        /* End Incremental Search Values */
+    };
+
+    /**
+     * Indexes all the unindexed lines in subs. Assumes m_lock is held.
+     * @param index  The index to update.
+     * @param subs   The subtitles belonging to the index.
+     * @param filter The expression removed from every line.
+     */
+    void updateHelper(
+        TrackIndex &index,
+        const std::vector<std::shared_ptr<SubtitleInfo>> &subs,
+        const QRegularExpression &filter);
+
+    /**
+     * Returns the lines that could contain the folded query according to the
+     * n-gram postings. Assumes m_lock is held.
+     * @param index  The index to look in.
+     * @param folded The case and kana folded query.
+     * @return The sorted list of candidate lines.
+     */
+    QVector<int> candidates(const TrackIndex &index, const QString &folded);
+
+    /* Maps sids to the index of the track. */
+    QHash<int64_t, TrackIndex> m_tracks;
+
+    /* Protects m_tracks. */
+    QMutex m_lock;
+};
+
+#endif // SUBTITLEINDEX_H
@@ -0,0 +1,343 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "trace.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+/* Begin Trace State */
+
+/**
+ * A single recorded event.
+ */
+struct TraceEvent
+{
+    /* The name of the event. */
+    const char *name = nullptr;
+
+    /* Detail attached to the event. */
+    QString detail;
+
+    /* The start of the event in microseconds. */
+    qint64 start = 0;
+
+    /* The duration of the event in microseconds. -1 for instant events. */
+    qint64 duration = 0;
+
+    /* The id of the thread the event was recorded on. */
+    int tid = 0;
+};
+
+/**
+ * Everything shared between threads.
+ */
+struct TraceState
+{
+    /* The clock all timestamps are relative to. */
+    QElapsedTimer clock;
+
+    /* The ring buffer of events. Allocated when tracing is first enabled. */
+    std::vector<TraceEvent> events;
+
+    /* The index the next event will be written to. */
+    size_t next = 0;
+
+    /* The total number of events written since the last clear. */
+    size_t written = 0;
+
+    /* Maps thread ids to their names. */
+    QHash<int, QString> threadNames;
+
+    /* Maps hop names to the time they started. */
+    QHash<QByteArray, qint64> hops;
+
+    /* Protects everything except clock. */
+    QMutex lock;
+
+    TraceState()
+    {
+        clock.start();
+    }
+};
+
+/**
+ * Returns the trace state, creating it if it doesn't exist.
+ * @return The trace state.
+ */
+static TraceState &state()
+{
+    static TraceState s;
+    return s;
+}
+
+/**
+ * Returns a small id for the current thread, registering its name on first use.
+ * Assumes the state lock is held.
+ * @param s The trace state.
+ * @return The id of the current thread.
+ */
+static int currentThreadId(TraceState &s)
+{
+    static int nextId = 1;
+    static thread_local int tid = 0;
+    if (tid == 0)
+    {
+        tid = nextId++;
+        QThread *thread = QThread::currentThread();
+        QString name = thread->objectName();
+        if (QCoreApplication::instance() &&
+            QCoreApplication::instance()->thread() == thread)
+        {
+            name = "GUI";
+        }
+        else if (name.isEmpty())
+        {
+            name = QString("Worker %1").arg(tid);
+        }
+        s.threadNames.insert(tid, name);
+    }
+    return tid;
+}
+
+/**
+ * Appends an event to the ring buffer.
+ * @param name     The name of the event.
+ * @param start    The start of the event.
+ * @param duration The duration of the event. -1 for instant events.
+ * @param detail   The detail of the event.
+ */
+static void addEvent(
+    const char *name,
+    const qint64 start,
+    const qint64 duration,
+    const QString &detail)
+{
+    TraceState &s = state();
+    QMutexLocker locker(&s.lock);
+    if (s.events.empty())
+    {
+        return;
+    }
+
+    TraceEvent &event = s.events[s.next];
+    event.name = name;
+    event.detail = detail;
+    event.start = start;
+    event.duration = duration;
+    event.tid = currentThreadId(s);
+
+    s.next = (s.next + 1) % s.events.size();
+    ++s.written;
+}
+
+/* End Trace State */
+/* Begin Trace */
+
+void Trace::setEnabled(const bool enabled)
+{
+    TraceState &s = state();
+    {
+        QMutexLocker locker(&s.lock);
+        if (enabled && s.events.empty())
+        {
+            s.events.resize(BUFFER_SIZE);
+        }
+    }
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+qint64 Trace::now()
+{
+    return state().clock.nsecsElapsed() / 1000;
+}
+
+void Trace::addSpan(
+    const char *name,
+    const qint64 start,
+    const qint64 end,
+    const QString &detail)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+    addEvent(name, start, end - start, detail);
+}
+
+void Trace::addInstant(const char *name)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+    addEvent(name, now(), -1, QString());
+}
+
+void Trace::beginHop(const char *name)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+    TraceState &s = state();
+    const qint64 start = now();
+    QMutexLocker locker(&s.lock);
+    s.hops.insert(QByteArray(name), start);
+}
+
+void Trace::endHop(const char *name)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+    TraceState &s = state();
+    qint64 start = -1;
+    {
+        QMutexLocker locker(&s.lock);
+        auto it = s.hops.find(QByteArray(name));
+        if (it == s.hops.end())
+        {
+            return;
+        }
+        start = it.value();
+        s.hops.erase(it);
+    }
+    addEvent(name, start, now() - start, QString());
+}
+
+void Trace::clear()
+{
+    TraceState &s = state();
+    QMutexLocker locker(&s.lock);
+    for (TraceEvent &event : s.events)
+    {
+        event = TraceEvent();
+    }
+    s.next = 0;
+    s.written = 0;
+    s.hops.clear();
+}
+
+bool Trace::exportChromeTrace(const QString &path)
+{
+    TraceState &s = state();
+    QJsonArray traceEvents;
+    const qint64 pid = QCoreApplication::applicationPid();
+    {
+        QMutexLocker locker(&s.lock);
+
+        for (auto it = s.threadNames.constBegin();
+             it != s.threadNames.constEnd();
+             ++it)
+        {
+            QJsonObject meta;
+            meta["name"] = "thread_name";
+            meta["ph"] = "M";
+            meta["pid"] = pid;
+            meta["tid"] = it.key();
+            meta["args"] = QJsonObject{{"name", it.value()}};
+            traceEvents.append(meta);
+        }
+
+        const size_t size = s.events.size();
+        const size_t count = std::min(s.written, size);
+        const size_t first = s.written > size ? s.next : 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const TraceEvent &event = s.events[(first + i) % size];
+            QJsonObject obj;
+            obj["name"] = event.name;
+            obj["cat"] = "memento";
+            obj["pid"] = pid;
+            obj["tid"] = event.tid;
+            obj["ts"] = event.start;
+            if (event.duration < 0)
+            {
+                obj["ph"] = "i";
+                obj["s"] = "t";
+            }
+            else
+            {
+                obj["ph"] = "X";
+                obj["dur"] = event.duration;
+            }
+            if (!event.detail.isEmpty())
+            {
+                obj["args"] = QJsonObject{{"detail", event.detail}};
+            }
+            traceEvents.append(obj);
+        }
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = traceEvents;
+    root["displayTimeUnit"] = "ms";
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qDebug() << "Could not open trace file" << path;
+        return false;
+    }
+    if (file.write(QJsonDocument(root).toJson(QJsonDocument::Compact)) == -1)
+    {
+        qDebug() << "Could not write trace file" << path;
+        return false;
+    }
+    return true;
+}
+
+/* End Trace */
+/* Begin TraceSpan */
+
+TraceSpan::TraceSpan(const char *name, const QString &detail) :
+    m_name(name),
+    m_start(Trace::isEnabled() ? Trace::now() : -1)
+{
+    if (m_start != -1)
+    {
+        m_detail = detail;
+    }
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (m_start != -1)
+    {
+        Trace::addSpan(m_name, m_start, Trace::now(), m_detail);
+    }
+}
+
+/* End TraceSpan */
@@ -0,0 +1,140 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+
+#include <QString>
+
+/**
+ * A process wide ring buffer of timed trace events that can be exported in the
+ * Chrome trace_event JSON format. Tracing is always compiled in but disabled
+ * by default. When disabled, recording an event costs a single atomic load.
+ * All methods are thread-safe.
+ */
+class Trace
+{
+public:
+    /* The maximum number of events kept. Older events are overwritten. */
+    static constexpr int BUFFER_SIZE = 1 << 16;
+
+    /**
+     * Enables or disables recording of events.
+     * @param enabled true to start recording, false to stop.
+     */
+    static void setEnabled(bool enabled);
+
+    /**
+     * Returns if events are currently being recorded.
+     * @return true if tracing is enabled, false otherwise.
+     */
+    static inline bool isEnabled()
+    {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns the current trace timestamp.
+     * @return The number of microseconds since tracing was first used.
+     */
+    static qint64 now();
+
+    /**
+     * Records a complete span on the current thread.
+     * @param name   The name of the span. Must be a string literal.
+     * @param start  The start timestamp returned by now().
+     * @param end    The end timestamp returned by now().
+     * @param detail Optional detail shown with the span.
+     */
+    static void addSpan(
+        const char *name,
+        qint64 start,
+        qint64 end,
+        const QString &detail = QString());
+
+    /**
+     * Records an instantaneous event on the current thread.
+     * @param name The name of the event. Must be a string literal.
+     */
+    static void addInstant(const char *name);
+
+    /**
+     * Marks the start of a hop between threads such as a queued signal.
+     * Only the most recent hop of each name is remembered.
+     * @param name The name of the hop. Must be a string literal.
+     */
+    static void beginHop(const char *name);
+
+    /**
+     * Records a span from the matching beginHop() call to now on the current
+     * thread. Does nothing if there is no matching beginHop() call.
+     * @param name The name of the hop. Must be a string literal.
+     */
+    static void endHop(const char *name);
+
+    /**
+     * Removes every recorded event.
+     */
+    static void clear();
+
+    /**
+     * Writes every recorded event to a file as Chrome trace_event JSON. The
+     * file can be opened in chrome://tracing or https://ui.perfetto.dev.
+     * @param path The path of the file to write.
+     * @return true on success, false otherwise.
+     */
+    static bool exportChromeTrace(const QString &path);
+
+private:
+    /* true if events are being recorded, false otherwise */
+    static inline std::atomic<bool> s_enabled{false};
+};
+
+/**
+ * Records a span from construction to destruction when tracing is enabled.
+ */
+class TraceSpan
+{
+public:
+    /**
+     * Starts a span.
+     * @param name   The name of the span. Must be a string literal.
+     * @param detail Optional detail shown with the span.
+     */
+    explicit TraceSpan(const char *name, const QString &detail = QString());
+    ~TraceSpan();
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    /* The name of the span. */
+    const char *m_name;
+
+    /* Detail to attach to the span. */
+    QString m_detail;
+
+    /* The start timestamp. -1 if tracing was disabled at construction. */
+    qint64 m_start;
+};
+
+#endif // TRACE_H
@@ -20,12 +20,17 @@
 
 #include "utils.h"
 
+#include <algorithm>
+
 #include <QCoreApplication>
 #include <QCryptographicHash>
 #include <QDir>
+#include <QHash>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
@@ -94,6 +99,24 @@ QString DirectoryUtils::getDictionaryResourceDir()
 
 #undef RES
 
+#define AUDIO_CACHE_DIR "audio"
+
+QString DirectoryUtils::getAudioCacheDir()
+{
+    return getConfigDir() + AUDIO_CACHE_DIR + SLASH;
+}
+
+#undef AUDIO_CACHE_DIR
+
+#define LOCAL_AUDIO_DB_FILE "local_audio.sqlite"
+
+QString DirectoryUtils::getLocalAudioDB()
+{
+    return getConfigDir() + LOCAL_AUDIO_DB_FILE;
+}
+
+#undef LOCAL_AUDIO_DB_FILE
+
 QString DirectoryUtils::getFileOpenDirectory(Constants::FileOpenDirectory type)
 {
     QString path;
@@ -293,6 +316,34 @@ QString GraphicUtils::generatePitchGraph(
     const uint8_t pos,
     const QString &fill,
     const QString &stroke)
+{
+    /* Only a handful of colors are ever used, so the number of distinct graphs
+     * is bounded by the mora counts and positions seen */
+    static QHash<QString, QString> cache;
+    static QMutex lock;
+
+    const QString key = QString::number(moraSize) + ':' +
+        QString::number(pos) + ':' + fill + ':' + stroke;
+    {
+        QMutexLocker locker(&lock);
+        auto it = cache.constFind(key);
+        if (it != cache.constEnd())
+        {
+            return it.value();
+        }
+    }
+
+    const QString graph = buildPitchGraph(moraSize, pos, fill, stroke);
+    QMutexLocker locker(&lock);
+    cache.insert(key, graph);
+    return graph;
+}
+
+QString GraphicUtils::buildPitchGraph(
+    const int moraSize,
+    const uint8_t pos,
+    const QString &fill,
+    const QString &stroke)
 {
     QString pitchGraph = PITCH_GRAPH_HEADER
         .arg(GRAPH_STEP * (moraSize + 1))
@@ -449,6 +500,54 @@ QString GraphicUtils::generatePitchGraph(
 #undef GRAPH_STEP
 #undef GRAPH_OFFSET
 
+QList<GraphicUtils::PitchSegment> GraphicUtils::splitPitch(
+    const QStringList &mora,
+    const uint8_t pos)
+{
+    QList<PitchSegment> segments;
+    if (mora.isEmpty())
+    {
+        return segments;
+    }
+
+    switch (pos)
+    {
+    case 0:
+        segments.append({mora.first(), false, true});
+        if (mora.size() > 1)
+        {
+            segments.append({mora.mid(1).join(""), true, false});
+        }
+        break;
+    case 1:
+        segments.append({mora.first(), true, true});
+        if (mora.size() > 1)
+        {
+            segments.append({mora.mid(1).join(""), false, false});
+        }
+        break;
+    default:
+    {
+        segments.append({mora.first(), false, true});
+
+        const int drop = std::min<int>(pos, mora.size());
+        const QString high = mora.mid(1, drop - 1).join("");
+        if (!high.isEmpty())
+        {
+            segments.append({high, true, true});
+        }
+
+        const QString low = mora.mid(drop).join("");
+        if (!low.isEmpty())
+        {
+            segments.append({low, false, false});
+        }
+    }
+    }
+
+    return segments;
+}
+
 /* End GraphicUtils */
 /* Begin CharacterUtils */
 
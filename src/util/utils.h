@@ -22,7 +22,9 @@
 #define UTILS_H
 
 #include <QFile>
+#include <QList>
 #include <QString>
+#include <QStringList>
 
 namespace Constants
 {
@@ -89,6 +91,18 @@ public:
      */
     static QString getDictionaryResourceDir();
 
+    /**
+     * Gets the directory downloaded audio is cached in.
+     * @return The audio cache directory path.
+     */
+    static QString getAudioCacheDir();
+
+    /**
+     * Gets the path to the index of local audio sources.
+     * @return Path to the local audio index database.
+     */
+    static QString getLocalAudioDB();
+
     /**
      * Gets a directory file a FileOpenDirectory enum.
      * @param type The type of directory to fetch.
@@ -144,7 +158,23 @@ class GraphicUtils
 {
 public:
     /**
-     * Generates a pitch graph SVG.
+     * A run of consecutive mora spoken at the same pitch.
+     */
+    struct PitchSegment
+    {
+        /* The mora in the run. */
+        QString text;
+
+        /* true if the run is high, false if it is low. */
+        bool high;
+
+        /* true if the pitch changes after the run, false otherwise. */
+        bool change;
+    };
+
+    /**
+     * Generates a pitch graph SVG. Graphs are cached, so generating the same
+     * graph again is cheap. Thread-safe.
      * @param moraSize The number of mora.
      * @param pos      The pitch position number.
      * @param fill     The fill color of the graph.
@@ -156,8 +186,31 @@ public:
                                       const QString &fill,
                                       const QString &stroke);
 
+    /**
+     * Splits the mora of a reading into runs of the same pitch.
+     * @param mora The mora of the reading.
+     * @param pos  The pitch position number.
+     * @return The runs in order. Empty if there are no mora.
+     */
+    static QList<PitchSegment> splitPitch(
+        const QStringList &mora,
+        uint8_t pos);
+
 private:
     GraphicUtils() {}
+
+    /**
+     * Builds a pitch graph SVG without consulting the cache.
+     * @param moraSize The number of mora.
+     * @param pos      The pitch position number.
+     * @param fill     The fill color of the graph.
+     * @param stroke   The stroke color of the graph.
+     * @return The string representation of the SVG.
+     */
+    static QString buildPitchGraph(const int      moraSize,
+                                   const uint8_t  pos,
+                                   const QString &fill,
+                                   const QString &stroke);
 };
 
 class CharacterUtils
@@ -0,0 +1,223 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QSharedPointer>
+#include <QStandardPaths>
+
+#include "anki/ankiclient.h"
+#include "mockankiconnect.h"
+#include "util/globalmediator.h"
+
+/* The number of terms checked by each notesAddable() call */
+#define SEARCH_SIZE 10
+
+/**
+ * Prints the mean and tail latency of a set of calls.
+ * @param name    The name of the call.
+ * @param samples The time each call took in nanoseconds.
+ */
+static void printLatency(const char *name, std::vector<qint64> samples)
+{
+    if (samples.empty())
+    {
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    qint64 total = 0;
+    for (qint64 sample : samples)
+    {
+        total += sample;
+    }
+    const size_t size = samples.size();
+    std::cout
+        << "  " << name << " latency: "
+        << "mean " << total / (qint64)size / 1000000.0 << " ms, "
+        << "p50 " << samples[size / 2] / 1000000.0 << " ms, "
+        << "p95 " << samples[size * 95 / 100] / 1000000.0 << " ms, "
+        << "p99 " << samples[size * 99 / 100] / 1000000.0 << " ms, "
+        << "max " << samples.back() / 1000000.0 << " ms\n";
+}
+
+/**
+ * Creates a term shaped like a typical search result.
+ * @param i The index of the term. Makes the first field unique.
+ * @return The term.
+ */
+static Term createTerm(const int i)
+{
+    Term term;
+    term.expression = QString("単語%1").arg(i);
+    term.reading = QString("たんご%1").arg(i);
+    term.title = "Episode 01.mkv";
+    term.clozePrefix = "この";
+    term.clozeBody = term.expression;
+    term.clozeSuffix = "はよく使われています。";
+    term.sentence = term.clozePrefix + term.clozeBody + term.clozeSuffix;
+    term.frequencies = {{"JPDB", QString::number(i + 1)}};
+
+    TermDefinition def;
+    def.dictionary = "JMdict";
+    def.tags = {{"JMdict", "n", "partOfSpeech", "noun", 0, 0}};
+    def.glossary = QJsonArray{
+        QString("word %1").arg(i), "vocabulary", "term; expression"
+    };
+    def.score = 0;
+    term.definitions = {def, def};
+    return term;
+}
+
+/**
+ * Drives AnkiClient against a mock AnkiConnect. Checks whether search results
+ * are addable like the definition popup does, then adds every term as a note,
+ * and reports throughput, bytes sent and tail latency.
+ * Usage: bench_ankiclient [notes] [latency in ms] [failure rate]
+ */
+int main(int argc, char **argv)
+{
+    /* Keep the benchmark's Anki settings out of Memento's */
+    QStandardPaths::setTestModeEnabled(true);
+    QCoreApplication::setApplicationName("memento");
+    QApplication app(argc, argv);
+
+    const int notes = argc > 1 ? std::max(1, std::atoi(argv[1])) : 500;
+    const int latency = argc > 2 ? std::atoi(argv[2]) : 0;
+    const double failureRate = argc > 3 ? std::atof(argv[3]) : 0.0;
+
+    MockAnkiConnect mock;
+    mock.setLatency(latency);
+    mock.setFailureRate(failureRate);
+    mock.addDeck("Mining");
+    mock.addModel("Mining", {"Expression", "Reading", "Meaning", "Sentence"});
+    if (!mock.listen())
+    {
+        std::cerr << "Could not start the mock AnkiConnect server\n";
+        return EXIT_FAILURE;
+    }
+
+    GlobalMediator::createGlobalMediator();
+    AnkiClient client;
+    AnkiConfig config(*client.getConfig());
+    config.address = "127.0.0.1";
+    config.port = QString::number(mock.port());
+    config.duplicatePolicy = AnkiConfig::DifferentDeck;
+    config.termDeck = "Mining";
+    config.termModel = "Mining";
+    config.termFields = QJsonObject{
+        {"Expression", REPLACE_EXPRESSION},
+        {"Reading", REPLACE_FURIGANA_PLAIN},
+        {"Meaning", REPLACE_GLOSSARY},
+        {"Sentence",
+            REPLACE_CLOZE_PREFIX "<b>" REPLACE_CLOZE_BODY "</b>"
+            REPLACE_CLOZE_SUFFIX},
+    };
+    client.addProfile("Benchmark", config);
+    client.setProfile("Benchmark");
+    client.setEnabled(true);
+
+    std::vector<Term> terms;
+    for (int i = 0; i < notes; ++i)
+    {
+        terms.push_back(createTerm(i));
+    }
+    std::cout << notes << " notes, " << latency << " ms latency, "
+              << failureRate * 100 << "% failure rate\n";
+
+    /* Check search results one page at a time */
+    std::vector<qint64> addableSamples;
+    int addableFailures = 0;
+    qint64 bytes = mock.bytesReceived();
+    QElapsedTimer total;
+    total.start();
+    for (int i = 0; i < notes; i += SEARCH_SIZE)
+    {
+        QList<QSharedPointer<const Term>> page;
+        for (int j = i; j < std::min(notes, i + SEARCH_SIZE); ++j)
+        {
+            page << QSharedPointer<const Term>(new Term(terms[j]));
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        AnkiReply *reply = client.notesAddable(page);
+        QEventLoop loop;
+        QObject::connect(reply, &AnkiReply::finishedBoolList, &loop,
+            [&] (const QList<bool> &, const QString &error) {
+                addableFailures += error.isEmpty() ? 0 : 1;
+                addableSamples.push_back(timer.nsecsElapsed());
+                loop.quit();
+            }
+        );
+        loop.exec();
+    }
+    qint64 elapsed = std::max(total.elapsed(), 1LL);
+    std::cout
+        << "notesAddable: " << addableSamples.size() << " calls of "
+        << SEARCH_SIZE << " terms in " << elapsed << " ms, "
+        << notes * 1000.0 / elapsed << " notes/s, "
+        << mock.bytesReceived() - bytes << " bytes sent, "
+        << addableFailures << " failures\n";
+    printLatency("notesAddable", addableSamples);
+
+    /* Add every note at once like a burst of mining */
+    std::vector<qint64> addSamples;
+    int addFailures = 0;
+    bytes = mock.bytesReceived();
+    const int requests = mock.count("multi");
+    total.restart();
+    {
+        QEventLoop loop;
+        for (const Term &term : terms)
+        {
+            AnkiReply *reply = client.addNote(new Term(term));
+            const qint64 start = total.nsecsElapsed();
+            QObject::connect(reply, &AnkiReply::finishedInt, &loop,
+                [&, start] (const int, const QString &error) {
+                    addFailures += error.isEmpty() ? 0 : 1;
+                    addSamples.push_back(total.nsecsElapsed() - start);
+                    if ((int)addSamples.size() == notes)
+                    {
+                        loop.quit();
+                    }
+                }
+            );
+        }
+        loop.exec();
+    }
+    elapsed = std::max(total.elapsed(), 1LL);
+    std::cout
+        << "addNote: " << notes << " notes in " << elapsed << " ms, "
+        << notes * 1000.0 / elapsed << " notes/s, "
+        << mock.bytesReceived() - bytes << " bytes sent in "
+        << mock.count("multi") - requests << " requests, "
+        << addFailures << " failures\n";
+    printLatency("addNote", addSamples);
+
+    return EXIT_SUCCESS;
+}
+
+#undef SEARCH_SIZE
@@ -0,0 +1,242 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <clocale>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+
+#include <mpv/client.h>
+
+#include "player/mpvencoder.h"
+
+/* The number of seconds to wait for the file to load */
+#define LOAD_TIMEOUT 30
+
+/**
+ * Timings of one clipping method.
+ */
+struct Timings
+{
+    /* The time each clip took in milliseconds. */
+    std::vector<qint64> samples;
+
+    /* The total size of every clip in bytes. */
+    qint64 bytes = 0;
+
+    /* The number of clips that failed. */
+    int failures = 0;
+};
+
+/**
+ * Prints the mean and tail latency of a method.
+ * @param name    The name of the method.
+ * @param timings The timings of the method.
+ */
+static void printTimings(const char *name, Timings timings)
+{
+    std::vector<qint64> &samples = timings.samples;
+    if (samples.empty())
+    {
+        std::cout << name << ": every clip failed\n";
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    qint64 total = 0;
+    for (qint64 sample : samples)
+    {
+        total += sample;
+    }
+    std::cout
+        << name << ": "
+        << "mean " << total / (qint64)samples.size() << " ms, "
+        << "p50 " << samples[samples.size() / 2] << " ms, "
+        << "p95 " << samples[samples.size() * 95 / 100] << " ms, "
+        << "max " << samples.back() << " ms, "
+        << "mean size " << timings.bytes / (qint64)samples.size() << " B, "
+        << timings.failures << " failures\n";
+}
+
+/**
+ * Loads a file into a paused handle to read its duration and audio codec.
+ * @param      handle   An initialized handle.
+ * @param      path     The path of the file.
+ * @param[out] duration The duration of the file in seconds.
+ * @param[out] aid      The id of the selected audio track.
+ * @param[out] codec    The codec of the selected audio track.
+ * @return true on success, false otherwise.
+ */
+static bool probeFile(
+    mpv_handle *handle,
+    const QByteArray &path,
+    double &duration,
+    int64_t &aid,
+    QString &codec)
+{
+    const char *args[] = {"loadfile", path.constData(), NULL};
+    if (mpv_command(handle, args) < 0)
+    {
+        return false;
+    }
+
+    mpv_event *event = NULL;
+    do
+    {
+        event = mpv_wait_event(handle, LOAD_TIMEOUT);
+        if (event->event_id == MPV_EVENT_NONE ||
+            event->event_id == MPV_EVENT_END_FILE)
+        {
+            return false;
+        }
+    }
+    while (event->event_id != MPV_EVENT_FILE_LOADED);
+
+    if (mpv_get_property(
+            handle, "duration", MPV_FORMAT_DOUBLE, &duration) < 0 ||
+        mpv_get_property(
+            handle, "current-tracks/audio/id", MPV_FORMAT_INT64, &aid) < 0)
+    {
+        return false;
+    }
+    char *codecStr =
+        mpv_get_property_string(handle, "current-tracks/audio/codec");
+    codec = codecStr;
+    mpv_free(codecStr);
+    return !codec.isEmpty();
+}
+
+/**
+ * Clips the audio of a local video at evenly spaced points, once by copying
+ * packets and once by re-encoding, and reports how long each method takes.
+ * Usage: bench_audioclip <video file> [clips] [clip length in seconds]
+ */
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    setlocale(LC_NUMERIC, "C");
+
+    if (argc < 2 || !QFileInfo::exists(argv[1]))
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " <video file> [clips] [clip length in seconds]\n";
+        return EXIT_FAILURE;
+    }
+    const QString path = QFileInfo(argv[1]).absoluteFilePath();
+    const int clips = argc > 2 ? std::max(1, std::atoi(argv[2])) : 20;
+    const double length = argc > 3 ? std::atof(argv[3]) : 5.0;
+
+    /* Stands in for the player the encoder copies options from */
+    mpv_handle *player = mpv_create();
+    if (player == NULL)
+    {
+        std::cerr << "Could not create mpv handle\n";
+        return EXIT_FAILURE;
+    }
+    mpv_set_option_string(player, "vo", "null");
+    mpv_set_option_string(player, "ao", "null");
+    mpv_set_option_string(player, "pause", "yes");
+    mpv_set_option_string(player, "config", "no");
+    if (mpv_initialize(player) < 0)
+    {
+        std::cerr << "Could not initialize mpv handle\n";
+        mpv_destroy(player);
+        return EXIT_FAILURE;
+    }
+
+    double duration = 0;
+    int64_t aid = -1;
+    QString codec;
+    if (!probeFile(player, path.toUtf8(), duration, aid, codec))
+    {
+        std::cerr << "Could not read the audio track of " << argv[1] << '\n';
+        mpv_destroy(player);
+        return EXIT_FAILURE;
+    }
+    const QString ext = MpvEncoder::copyExtension(codec);
+    std::cout << "Source: " << duration << " s, codec " << qPrintable(codec)
+              << ", " << clips << " clips of " << length << " s\n";
+
+    Timings copied;
+    Timings encoded;
+    {
+        MpvEncoder encoder(player);
+        const double step = std::max(duration - length, 0.0) / clips;
+        for (int i = 0; i < clips; ++i)
+        {
+            const double start = step * i;
+            const double end = start + length;
+            QElapsedTimer timer;
+
+            if (!ext.isEmpty())
+            {
+                timer.start();
+                QString clip = encoder.copyAudio(path, aid, start, end, codec);
+                const qint64 elapsed = timer.elapsed();
+                if (clip.isEmpty())
+                {
+                    ++copied.failures;
+                }
+                else
+                {
+                    copied.samples.push_back(elapsed);
+                    copied.bytes += QFileInfo(clip).size();
+                    QFile::remove(clip);
+                }
+            }
+
+            timer.start();
+            QString clip = encoder.encodeAudio(
+                path, aid, start, end, false, 0, ext.isEmpty() ? ".aac" : ext
+            );
+            const qint64 elapsed = timer.elapsed();
+            if (clip.isEmpty())
+            {
+                ++encoded.failures;
+            }
+            else
+            {
+                encoded.samples.push_back(elapsed);
+                encoded.bytes += QFileInfo(clip).size();
+                QFile::remove(clip);
+            }
+        }
+    }
+    mpv_destroy(player);
+
+    if (ext.isEmpty())
+    {
+        std::cout << "Copy: " << qPrintable(codec) << " can't be copied\n";
+    }
+    else
+    {
+        printTimings("Copy", copied);
+    }
+    printTimings("Encode", encoded);
+
+    return EXIT_SUCCESS;
+}
+
+#undef LOAD_TIMEOUT
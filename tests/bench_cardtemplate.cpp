@@ -0,0 +1,326 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonObject>
+
+#include "anki/ankiclient.h"
+#include "anki/cardtemplate.h"
+
+/**
+ * A marker and the text it is written as in a field.
+ */
+struct MarkerText
+{
+    /* The text of the marker including the braces. */
+    const char *text;
+
+    /* The marker. */
+    CardTemplate::Marker marker;
+};
+
+/* Markers shared by term and kanji notes */
+static const std::vector<MarkerText> SHARED_MARKERS{
+    {REPLACE_AUDIO_MEDIA,      CardTemplate::Marker::AudioMedia},
+    {REPLACE_AUDIO_CONTEXT,    CardTemplate::Marker::AudioContext},
+    {REPLACE_SCREENSHOT,       CardTemplate::Marker::Screenshot},
+    {REPLACE_SCREENSHOT_VIDEO, CardTemplate::Marker::ScreenshotVideo},
+    {REPLACE_TITLE,            CardTemplate::Marker::Title},
+    {REPLACE_CLIPBOARD,        CardTemplate::Marker::Clipboard},
+    {REPLACE_CLOZE_BODY,       CardTemplate::Marker::ClozeBody},
+    {REPLACE_CLOZE_PREFIX,     CardTemplate::Marker::ClozePrefix},
+    {REPLACE_CLOZE_SUFFIX,     CardTemplate::Marker::ClozeSuffix},
+    {REPLACE_FREQUENCIES,      CardTemplate::Marker::Frequencies},
+    {REPLACE_SENTENCE,         CardTemplate::Marker::Sentence},
+    {REPLACE_SENTENCE_SEC,     CardTemplate::Marker::SentenceSecondary},
+    {REPLACE_CONTEXT,          CardTemplate::Marker::Context},
+    {REPLACE_CONTEXT_SEC,      CardTemplate::Marker::ContextSecondary},
+};
+
+/* Markers only found in term notes */
+static const std::vector<MarkerText> TERM_MARKERS{
+    {REPLACE_AUDIO,            CardTemplate::Marker::Audio},
+    {REPLACE_EXPRESSION,       CardTemplate::Marker::Expression},
+    {REPLACE_FURIGANA,         CardTemplate::Marker::Furigana},
+    {REPLACE_FURIGANA_PLAIN,   CardTemplate::Marker::FuriganaPlain},
+    {REPLACE_GLOSSARY,         CardTemplate::Marker::Glossary},
+    {REPLACE_GLOSSARY_BRIEF,   CardTemplate::Marker::GlossaryBrief},
+    {REPLACE_GLOSSARY_COMPACT, CardTemplate::Marker::GlossaryCompact},
+    {REPLACE_PITCH,            CardTemplate::Marker::Pitch},
+    {REPLACE_PITCH_GRAPHS,     CardTemplate::Marker::PitchGraphs},
+    {REPLACE_PITCH_POSITIONS,  CardTemplate::Marker::PitchPositions},
+    {REPLACE_READING,          CardTemplate::Marker::Reading},
+    {REPLACE_TAGS,             CardTemplate::Marker::Tags},
+};
+
+/* Markers only found in kanji notes */
+static const std::vector<MarkerText> KANJI_MARKERS{
+    {REPLACE_CHARACTER,    CardTemplate::Marker::Character},
+    {REPLACE_KUNYOMI,      CardTemplate::Marker::Kunyomi},
+    {REPLACE_ONYOMI,       CardTemplate::Marker::Onyomi},
+    {REPLACE_STROKE_COUNT, CardTemplate::Marker::StrokeCount},
+    {REPLACE_GLOSSARY,     CardTemplate::Marker::Glossary},
+    {REPLACE_TAGS,         CardTemplate::Marker::Tags},
+};
+
+/**
+ * Renders fields the way notes were built before templates were compiled,
+ * calling QString::replace() on every field once per marker.
+ * @param fields The raw fields object.
+ * @param type   The kind of note.
+ * @param values The values of the markers.
+ * @return The fields object mapping field names to their rendered values.
+ */
+static QJsonObject renderReplace(
+    const QJsonObject &fields,
+    CardTemplate::Type type,
+    const CardTemplate::Values &values)
+{
+    const std::vector<MarkerText> &typeMarkers =
+        type == CardTemplate::Type::Term ? TERM_MARKERS : KANJI_MARKERS;
+
+    QJsonObject result;
+    for (auto it = fields.constBegin(); it != fields.constEnd(); ++it)
+    {
+        QString value = it.value().toString();
+        for (const MarkerText &marker : typeMarkers)
+        {
+            value.replace(marker.text, values[marker.marker]);
+        }
+        for (const MarkerText &marker : SHARED_MARKERS)
+        {
+            value.replace(marker.text, values[marker.marker]);
+        }
+        result[it.key()] = value;
+    }
+    return result;
+}
+
+/**
+ * Gets the fields of a term note type modeled after popular mining decks.
+ * @return The raw fields object.
+ */
+static QJsonObject termFields()
+{
+    return QJsonObject{
+        {"Expression", REPLACE_EXPRESSION},
+        {"ExpressionFurigana", REPLACE_FURIGANA_PLAIN},
+        {"ExpressionReading", REPLACE_READING},
+        {"ExpressionAudio", REPLACE_AUDIO},
+        {"SelectionText", REPLACE_CLIPBOARD},
+        {"MainDefinition",
+            "<div class=\"glossary\">" REPLACE_GLOSSARY "</div>"},
+        {"DefinitionPicture", ""},
+        {"Sentence",
+            REPLACE_CLOZE_PREFIX "<b>" REPLACE_CLOZE_BODY "</b>"
+            REPLACE_CLOZE_SUFFIX},
+        {"SentenceFurigana", ""},
+        {"SentenceAudio", REPLACE_AUDIO_CONTEXT},
+        {"Picture", REPLACE_SCREENSHOT},
+        {"Glossary", REPLACE_GLOSSARY_COMPACT},
+        {"Hint", REPLACE_SENTENCE_SEC},
+        {"IsWordAndSentenceCard", ""},
+        {"IsClickCard", ""},
+        {"IsSentenceCard", "x"},
+        {"PitchPosition", REPLACE_PITCH_POSITIONS},
+        {"PitchCategories", REPLACE_PITCH_GRAPHS},
+        {"Frequency", REPLACE_FREQUENCIES},
+        {"FreqSort", ""},
+        {"MiscInfo", REPLACE_TITLE " " REPLACE_CONTEXT},
+    };
+}
+
+/**
+ * Gets the fields of a kanji note type.
+ * @return The raw fields object.
+ */
+static QJsonObject kanjiFields()
+{
+    return QJsonObject{
+        {"Kanji",       REPLACE_CHARACTER},
+        {"Onyomi",      REPLACE_ONYOMI},
+        {"Kunyomi",     REPLACE_KUNYOMI},
+        {"Strokes",     REPLACE_STROKE_COUNT},
+        {"Meaning",     "<div class=\"glossary\">" REPLACE_GLOSSARY "</div>"},
+        {"Example",     REPLACE_SENTENCE},
+        {"Picture",     REPLACE_SCREENSHOT},
+        {"Source",      REPLACE_TITLE},
+    };
+}
+
+/**
+ * Gets marker values about as long as those of a typical mined note.
+ * @return The values of every marker.
+ */
+static CardTemplate::Values noteValues()
+{
+    using Marker = CardTemplate::Marker;
+
+    QString glossary = "<ol>";
+    for (int i = 0; i < 12; ++i)
+    {
+        glossary += QString(
+            "<li><span class=\"tags\">n, vs</span> <i>(JMdict)</i> "
+            "to eat; to have (a meal); to live on; sense %1</li>"
+        ).arg(i);
+    }
+    glossary += "</ol>";
+
+    QString pitch;
+    for (int i = 0; i < 3; ++i)
+    {
+        pitch += "<svg xmlns=\"http://www.w3.org/2000/svg\" "
+                 "viewBox=\"0 0 200 100\"><path d=\"M25 25 L75 75 L125 75\" "
+                 "style=\"fill:none;stroke:black;stroke-width:5\"/></svg>";
+    }
+
+    CardTemplate::Values values;
+    values[Marker::Expression] = "食べる";
+    values[Marker::Reading] = "たべる";
+    values[Marker::Furigana] = "<ruby>食<rt>た</rt></ruby>べる";
+    values[Marker::FuriganaPlain] = "食[た]べる";
+    values[Marker::Glossary] = glossary;
+    values[Marker::GlossaryBrief] = glossary.left(glossary.size() / 2);
+    values[Marker::GlossaryCompact] = glossary.left(glossary.size() / 3);
+    values[Marker::Pitch] = "<span class=\"pitch\">た↓べる</span>";
+    values[Marker::PitchGraphs] = pitch;
+    values[Marker::PitchPositions] = "<span class=\"pitch\">[2]</span>";
+    values[Marker::Tags] = "memento";
+    values[Marker::Clipboard] = "食べる";
+    values[Marker::ClozeBody] = "食べた";
+    values[Marker::ClozePrefix] = "昨日は友達と一緒に寿司を";
+    values[Marker::ClozeSuffix] = "んだけど、すごく美味しかったよ。";
+    values[Marker::Sentence] =
+        "昨日は友達と一緒に寿司を食べたんだけど、すごく美味しかったよ。";
+    values[Marker::SentenceSecondary] =
+        "I ate sushi with my friend yesterday and it was really good.";
+    values[Marker::Context] = values[Marker::Sentence];
+    values[Marker::ContextSecondary] = values[Marker::SentenceSecondary];
+    values[Marker::Frequencies] =
+        "<ul><li>JPDB: 1234</li><li>Innocent Corpus: 5678</li>"
+        "<li>Netflix: 910</li></ul>";
+    values[Marker::Title] = "Episode 01 [1080p].mkv";
+    values[Marker::Character] = "食";
+    values[Marker::Onyomi] = "ショク, ジキ";
+    values[Marker::Kunyomi] = "く.う, く.らう, た.べる, は.む";
+    values[Marker::StrokeCount] = "9";
+    return values;
+}
+
+/**
+ * Prints the mean and tail latency of a rendering method.
+ * @param name    The name of the method.
+ * @param samples The time each render took in nanoseconds.
+ */
+static void printTimings(const char *name, std::vector<qint64> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    qint64 total = 0;
+    for (qint64 sample : samples)
+    {
+        total += sample;
+    }
+    const qint64 mean = total / (qint64)samples.size();
+    std::cout
+        << "  " << name << ": "
+        << "mean " << mean / 1000.0 << " us, "
+        << "p50 " << samples[samples.size() / 2] / 1000.0 << " us, "
+        << "p95 " << samples[samples.size() * 95 / 100] / 1000.0 << " us, "
+        << "max " << samples.back() / 1000.0 << " us, "
+        << (mean > 0 ? 1000000000 / mean : 0) << " notes/s\n";
+}
+
+/**
+ * Renders a note type with both methods and prints how long each takes.
+ * @param name       The name of the note type.
+ * @param fields     The raw fields object.
+ * @param type       The kind of note.
+ * @param values     The values of the markers.
+ * @param iterations The number of notes to render with each method.
+ * @return true if both methods produced the same fields, false otherwise.
+ */
+static bool benchmark(
+    const char *name,
+    const QJsonObject &fields,
+    CardTemplate::Type type,
+    const CardTemplate::Values &values,
+    int iterations)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const CardTemplate tmpl(fields, type);
+    const qint64 compile = timer.nsecsElapsed();
+
+    std::vector<qint64> replaced;
+    std::vector<qint64> compiled;
+    replaced.reserve(iterations);
+    compiled.reserve(iterations);
+    QJsonObject replaceResult;
+    QJsonObject compileResult;
+    for (int i = 0; i < iterations; ++i)
+    {
+        timer.restart();
+        replaceResult = renderReplace(fields, type, values);
+        replaced.push_back(timer.nsecsElapsed());
+
+        timer.restart();
+        compileResult = tmpl.render(values);
+        compiled.push_back(timer.nsecsElapsed());
+    }
+
+    std::cout << name << ": " << fields.size() << " fields, compiled in "
+              << compile / 1000.0 << " us\n";
+    printTimings("QString::replace", replaced);
+    printTimings("CardTemplate", compiled);
+
+    if (replaceResult != compileResult)
+    {
+        std::cerr << name << ": rendered fields differ\n";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Renders realistic term and kanji notes by replacing every marker in turn
+ * and with a compiled CardTemplate, and reports how long each method takes.
+ * Usage: bench_cardtemplate [notes]
+ */
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    const int iterations = argc > 1 ? std::max(1, std::atoi(argv[1])) : 10000;
+    const CardTemplate::Values values = noteValues();
+
+    bool same = benchmark(
+        "Term", termFields(), CardTemplate::Type::Term, values, iterations
+    );
+    same &= benchmark(
+        "Kanji", kanjiFields(), CardTemplate::Type::Kanji, values, iterations
+    );
+    return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <iostream>
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QThread>
+
+#include "dict/dictionary.h"
+#include "dict/subtitleannotator.h"
+#include "util/globalmediator.h"
+#include "util/subtitleparser.h"
+
+/**
+ * Annotates every line of a subtitle file with the installed dictionaries and
+ * reports how long it took.
+ * Usage: bench_subtitleannotator <subtitle file>
+ */
+int main(int argc, char **argv)
+{
+    /* Use the same configuration directory as Memento */
+    QCoreApplication::setOrganizationName("memento");
+    QCoreApplication::setOrganizationDomain("ripose.projects");
+    QCoreApplication::setApplicationName("memento");
+    QApplication app(argc, argv);
+
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <subtitle file>\n";
+        return EXIT_FAILURE;
+    }
+
+    QStringList lines;
+    for (const SubtitleInfo &info : SubtitleParser().parseSubtitles(argv[1]))
+    {
+        lines << info.text;
+    }
+    lines.removeDuplicates();
+    lines.removeAll(QString());
+    if (lines.isEmpty())
+    {
+        std::cerr << "No subtitles found in " << argv[1] << '\n';
+        return EXIT_FAILURE;
+    }
+
+    GlobalMediator::createGlobalMediator();
+    Dictionary dictionary;
+    SubtitleAnnotator annotator;
+
+    QElapsedTimer timer;
+    QObject::connect(
+        &annotator, &SubtitleAnnotator::annotationsFinished, &app,
+        [&] {
+            const qint64 elapsed = timer.elapsed();
+            double coverage = 0.0;
+            for (const QString &line : lines)
+            {
+                SharedLineAnnotation annotation =
+                    annotator.getAnnotation(line);
+                coverage += annotation ? annotation->coverage : 0.0;
+            }
+            std::cout
+                << "Annotated " << lines.size() << " lines in " << elapsed
+                << " ms (" << lines.size() * 1000.0 / std::max(elapsed, 1LL)
+                << " lines/s) on " << QThread::idealThreadCount()
+                << " threads\n"
+                << "Mean coverage " << coverage * 100.0 / lines.size()
+                << "%\n";
+            app.quit();
+        },
+        Qt::QueuedConnection
+    );
+
+    timer.start();
+    annotator.annotate(lines);
+
+    return app.exec();
+}
@@ -0,0 +1,412 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "mockankiconnect.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QRandomGenerator>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+/* The version of AnkiConnect the server claims to be */
+#define ANKICONNECT_VERSION 6
+
+/* Begin Constructor */
+
+MockAnkiConnect::MockAnkiConnect(QObject *parent) : QObject(parent)
+{
+    m_server = new QTcpServer(this);
+    connect(
+        m_server, &QTcpServer::newConnection,
+        this, &MockAnkiConnect::acceptConnections
+    );
+}
+
+/* End Constructor */
+/* Begin Server Methods */
+
+bool MockAnkiConnect::listen(const quint16 port)
+{
+    return m_server->listen(QHostAddress::LocalHost, port);
+}
+
+void MockAnkiConnect::close()
+{
+    m_server->close();
+    const QList<QTcpSocket *> sockets = m_buffers.keys();
+    for (QTcpSocket *socket : sockets)
+    {
+        socket->abort();
+    }
+}
+
+quint16 MockAnkiConnect::port() const
+{
+    return m_server->serverPort();
+}
+
+void MockAnkiConnect::acceptConnections()
+{
+    while (m_server->hasPendingConnections())
+    {
+        QTcpSocket *socket = m_server->nextPendingConnection();
+        m_buffers[socket] = QByteArray();
+        connect(socket, &QTcpSocket::readyRead, this,
+            [this, socket] { readRequest(socket); }
+        );
+        connect(socket, &QTcpSocket::disconnected, this,
+            [this, socket] {
+                m_buffers.remove(socket);
+                socket->deleteLater();
+            }
+        );
+    }
+}
+
+void MockAnkiConnect::readRequest(QTcpSocket *socket)
+{
+    QByteArray &buffer = m_buffers[socket];
+    const QByteArray data = socket->readAll();
+    m_bytesReceived += data.size();
+    buffer += data;
+
+    const qsizetype headerEnd = buffer.indexOf("\r\n\r\n");
+    if (headerEnd == -1)
+    {
+        return;
+    }
+
+    qsizetype length = 0;
+    const QList<QByteArray> headers = buffer.left(headerEnd).split('\n');
+    for (const QByteArray &header : headers)
+    {
+        const qsizetype colon = header.indexOf(':');
+        if (colon != -1 &&
+            header.left(colon).trimmed().toLower() == "content-length")
+        {
+            length = header.mid(colon + 1).trimmed().toLongLong();
+        }
+    }
+    if (buffer.size() - headerEnd - 4 < length)
+    {
+        return;
+    }
+
+    const QJsonObject request =
+        QJsonDocument::fromJson(buffer.mid(headerEnd + 4, length)).object();
+    buffer.clear();
+
+    const QString action = request["action"].toString();
+    QByteArray body;
+    if (action == "multi")
+    {
+        m_actions << action;
+        QJsonArray results;
+        const QJsonArray actions = request["params"]["actions"].toArray();
+        for (const QJsonValue &subrequest : actions)
+        {
+            results.append(runAction(subrequest.toObject()));
+        }
+        QJsonObject reply;
+        reply["result"] = results;
+        reply["error"] = QJsonValue::Null;
+        body = QJsonDocument(reply).toJson(QJsonDocument::Compact);
+    }
+    else
+    {
+        body = QJsonDocument(runAction(request))
+            .toJson(QJsonDocument::Compact);
+    }
+
+    if (m_latency > 0)
+    {
+        QTimer::singleShot(m_latency, socket,
+            [this, socket, action, body] { answer(socket, action, body); }
+        );
+    }
+    else
+    {
+        answer(socket, action, body);
+    }
+}
+
+void MockAnkiConnect::answer(
+    QTcpSocket *socket,
+    const QString &action,
+    const QByteArray &body)
+{
+    if (m_dropRequests)
+    {
+        socket->abort();
+    }
+    else
+    {
+        writeResponse(socket, body);
+    }
+    Q_EMIT requestFinished(action);
+}
+
+void MockAnkiConnect::writeResponse(QTcpSocket *socket, const QByteArray &body)
+{
+    socket->write(
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+        "Connection: close\r\n"
+        "\r\n"
+    );
+    socket->write(body);
+    socket->disconnectFromHost();
+}
+
+/* End Server Methods */
+/* Begin Actions */
+
+QJsonObject MockAnkiConnect::runAction(const QJsonObject &request)
+{
+    const QString action = request["action"].toString();
+    m_actions << action;
+
+    QString error;
+    QJsonValue result;
+    if (m_failureRate > 0 &&
+        QRandomGenerator::global()->generateDouble() < m_failureRate)
+    {
+        error = "injected failure";
+    }
+    else
+    {
+        result = getResult(action, request["params"].toObject(), error);
+    }
+
+    QJsonObject reply;
+    reply["result"] = error.isEmpty() ? result : QJsonValue::Null;
+    reply["error"] = error.isEmpty() ? QJsonValue::Null : QJsonValue(error);
+    return reply;
+}
+
+QJsonValue MockAnkiConnect::getResult(
+    const QString &action,
+    const QJsonObject &params,
+    QString &error)
+{
+    if (action == "version")
+    {
+        return ANKICONNECT_VERSION;
+    }
+    else if (action == "getActiveProfile")
+    {
+        return m_profile;
+    }
+    else if (action == "deckNames")
+    {
+        return QJsonArray::fromStringList(m_decks);
+    }
+    else if (action == "modelNames")
+    {
+        QStringList models = m_models.keys();
+        models.sort();
+        return QJsonArray::fromStringList(models);
+    }
+    else if (action == "modelFieldNames")
+    {
+        const QString model = params["modelName"].toString();
+        auto it = m_models.constFind(model);
+        if (it == m_models.constEnd())
+        {
+            error = "model was not found: " + model;
+            return QJsonValue();
+        }
+        return QJsonArray::fromStringList(it.value());
+    }
+    else if (action == "canAddNotes")
+    {
+        QJsonArray result;
+        const QJsonArray notes = params["notes"].toArray();
+        for (const QJsonValue &note : notes)
+        {
+            QString key;
+            QString noteError;
+            result.append(canAddNote(note.toObject(), key, noteError));
+        }
+        return result;
+    }
+    else if (action == "addNote")
+    {
+        const QJsonObject note = params["note"].toObject();
+        QString key;
+        if (!canAddNote(note, key, error))
+        {
+            return QJsonValue();
+        }
+        m_notes[m_profile][key].insert(note["deckName"].toString());
+        m_noteIds[m_profile].append(m_nextNoteId);
+        return m_nextNoteId++;
+    }
+    else if (action == "guiBrowse")
+    {
+        QJsonArray result;
+        for (const qint64 id : m_noteIds.value(m_profile))
+        {
+            result.append(id);
+        }
+        return result;
+    }
+    else if (action == "getMediaFilesNames")
+    {
+        return QJsonArray::fromStringList(mediaFiles());
+    }
+    else if (action == "storeMediaFile")
+    {
+        const QString filename = params["filename"].toString();
+        if (filename.isEmpty())
+        {
+            error = "filename is empty";
+            return QJsonValue();
+        }
+        m_media[m_profile].insert(filename);
+        return filename;
+    }
+
+    error = "unsupported action";
+    return QJsonValue();
+}
+
+#undef ANKICONNECT_VERSION
+
+bool MockAnkiConnect::canAddNote(
+    const QJsonObject &note,
+    QString &key,
+    QString &error)
+{
+    const QString deck = note["deckName"].toString();
+    const QString model = note["modelName"].toString();
+    if (!m_decks.contains(deck))
+    {
+        error = "deck was not found: " + deck;
+        return false;
+    }
+    auto it = m_models.constFind(model);
+    if (it == m_models.constEnd() || it->isEmpty())
+    {
+        error = "model was not found: " + model;
+        return false;
+    }
+
+    /* Like Anki, only the first field is checked for duplicates */
+    const QString first = note["fields"][it->first()].toString();
+    if (first.isEmpty())
+    {
+        error = "cannot create note because it is empty";
+        return false;
+    }
+    key = model + '\x1f' + first;
+
+    const QJsonObject options = note["options"].toObject();
+    if (options["allowDuplicate"].toBool())
+    {
+        return true;
+    }
+    const QHash<QString, QSet<QString>> &notes = m_notes[m_profile];
+    auto dup = notes.constFind(key);
+    if (dup != notes.constEnd() &&
+        (options["duplicateScope"].toString() != "deck" ||
+         dup->contains(deck)))
+    {
+        error = "cannot create note because it is a duplicate";
+        return false;
+    }
+    return true;
+}
+
+/* End Actions */
+/* Begin State */
+
+void MockAnkiConnect::setLatency(const int latency)
+{
+    m_latency = latency;
+}
+
+void MockAnkiConnect::setFailureRate(const double rate)
+{
+    m_failureRate = rate;
+}
+
+void MockAnkiConnect::setDropRequests(const bool drop)
+{
+    m_dropRequests = drop;
+}
+
+void MockAnkiConnect::setProfile(const QString &profile)
+{
+    m_profile = profile;
+}
+
+void MockAnkiConnect::addModel(const QString &name, const QStringList &fields)
+{
+    m_models[name] = fields;
+}
+
+void MockAnkiConnect::addDeck(const QString &name)
+{
+    if (!m_decks.contains(name))
+    {
+        m_decks << name;
+    }
+}
+
+int MockAnkiConnect::noteCount() const
+{
+    return m_noteIds.value(m_profile).size();
+}
+
+QStringList MockAnkiConnect::mediaFiles() const
+{
+    return m_media.value(m_profile).values();
+}
+
+void MockAnkiConnect::setMediaFiles(const QStringList &filenames)
+{
+    m_media[m_profile] = QSet<QString>(filenames.begin(), filenames.end());
+}
+
+QStringList MockAnkiConnect::actions() const
+{
+    return m_actions;
+}
+
+int MockAnkiConnect::count(const QString &action) const
+{
+    return m_actions.count(action);
+}
+
+void MockAnkiConnect::clearActions()
+{
+    m_actions.clear();
+}
+
+qint64 MockAnkiConnect::bytesReceived() const
+{
+    return m_bytesReceived;
+}
+
+/* End State */
@@ -0,0 +1,259 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MOCKANKICONNECT_H
+#define MOCKANKICONNECT_H
+
+#include <QHash>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+class QTcpServer;
+class QTcpSocket;
+
+/**
+ * A minimal AnkiConnect server that listens on localhost. It keeps just
+ * enough state in memory to answer the actions Memento sends, and can add
+ * latency and failures to test how Memento copes with them.
+ */
+class MockAnkiConnect : public QObject
+{
+    Q_OBJECT
+
+public:
+    MockAnkiConnect(QObject *parent = nullptr);
+
+    /**
+     * Starts listening on localhost.
+     * @param port The port to listen on. 0 picks a free port.
+     * @return true on success, false otherwise.
+     */
+    bool listen(const quint16 port = 0);
+
+    /**
+     * Stops listening and closes every open connection.
+     */
+    void close();
+
+    /**
+     * Gets the port the server is listening on.
+     * @return The port the server is listening on.
+     */
+    quint16 port() const;
+
+    /**
+     * Sets how long to wait before answering a request. Actions are run as
+     * soon as the request is received.
+     * @param latency The delay in milliseconds.
+     */
+    void setLatency(const int latency);
+
+    /**
+     * Sets the chance of an action failing. Failed actions aren't run and
+     * are answered with an error.
+     * @param rate The chance between 0 and 1.
+     */
+    void setFailureRate(const double rate);
+
+    /**
+     * Sets if requests should be dropped. Dropped requests are read in full
+     * and their actions run, but the connection is closed without a reply.
+     * @param drop true to drop requests, false to answer them.
+     */
+    void setDropRequests(const bool drop);
+
+    /**
+     * Sets the name of the Anki profile that is open.
+     * @param profile The name of the profile.
+     */
+    void setProfile(const QString &profile);
+
+    /**
+     * Adds a note type. Its first field is used for duplicate checks.
+     * @param name   The name of the note type.
+     * @param fields The names of the fields of the note type.
+     */
+    void addModel(const QString &name, const QStringList &fields);
+
+    /**
+     * Adds a deck.
+     * @param name The name of the deck.
+     */
+    void addDeck(const QString &name);
+
+    /**
+     * Gets the number of notes in the open profile.
+     * @return The number of notes.
+     */
+    int noteCount() const;
+
+    /**
+     * Gets the names of the media files stored in the open profile.
+     * @return The names of the stored media files.
+     */
+    QStringList mediaFiles() const;
+
+    /**
+     * Replaces the media files stored in the open profile.
+     * @param filenames The names of the stored media files.
+     */
+    void setMediaFiles(const QStringList &filenames);
+
+    /**
+     * Gets every action received in order, including the actions inside of
+     * multi actions.
+     * @return The names of the received actions.
+     */
+    QStringList actions() const;
+
+    /**
+     * Counts the number of times an action has been received.
+     * @param action The name of the action.
+     * @return The number of times action has been received.
+     */
+    int count(const QString &action) const;
+
+    /**
+     * Forgets every received action.
+     */
+    void clearActions();
+
+    /**
+     * Gets the number of bytes received, including HTTP headers.
+     * @return The number of bytes received.
+     */
+    qint64 bytesReceived() const;
+
+Q_SIGNALS:
+    /**
+     * Emitted after a request has been answered.
+     * @param action The name of the top level action.
+     */
+    void requestFinished(const QString &action);
+
+private Q_SLOTS:
+    /**
+     * Accepts pending connections.
+     */
+    void acceptConnections();
+
+private:
+    /**
+     * Reads from a socket and answers the request once all of it has been
+     * received.
+     * @param socket The socket to read from.
+     */
+    void readRequest(QTcpSocket *socket);
+
+    /**
+     * Answers a request after the configured latency.
+     * @param socket The socket to write to.
+     * @param action The name of the top level action.
+     * @param body   The JSON body of the response.
+     */
+    void answer(
+        QTcpSocket *socket,
+        const QString &action,
+        const QByteArray &body);
+
+    /**
+     * Writes an HTTP response containing a JSON body and closes the socket.
+     * @param socket The socket to write to.
+     * @param body   The JSON body of the response.
+     */
+    void writeResponse(QTcpSocket *socket, const QByteArray &body);
+
+    /**
+     * Runs an AnkiConnect action.
+     * @param request The action, version and params of the request.
+     * @return An object containing the result and error of the action.
+     */
+    QJsonObject runAction(const QJsonObject &request);
+
+    /**
+     * Gets the result of an action.
+     * @param action     The name of the action.
+     * @param params     The params of the action.
+     * @param[out] error The reason the action failed. Empty if it succeeded.
+     * @return The result of the action.
+     */
+    QJsonValue getResult(
+        const QString &action,
+        const QJsonObject &params,
+        QString &error);
+
+    /**
+     * Checks if a note could be added to the open profile.
+     * @param      note  The note object as sent to addNote.
+     * @param[out] key   The key of the note in m_notes.
+     * @param[out] error The reason the note can't be added. Empty if it can.
+     * @return true if the note can be added, false otherwise.
+     */
+    bool canAddNote(const QJsonObject &note, QString &key, QString &error);
+
+    /* The server being listened on. */
+    QTcpServer *m_server;
+
+    /* Partially received requests. */
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+
+    /* The delay before answering a request in milliseconds. */
+    int m_latency = 0;
+
+    /* The chance of an action failing. */
+    double m_failureRate = 0;
+
+    /* true if requests are answered by closing the connection. */
+    bool m_dropRequests = false;
+
+    /* The name of the open profile. */
+    QString m_profile = "User 1";
+
+    /* The names of every deck. */
+    QStringList m_decks{"Default"};
+
+    /* Maps note type names to the names of their fields. */
+    QHash<QString, QStringList> m_models{{"Basic", {"Front", "Back"}}};
+
+    /* Maps profiles and duplicate keys to the decks notes are in. */
+    QHash<QString, QHash<QString, QSet<QString>>> m_notes;
+
+    /* The ID of every note in each profile. */
+    QHash<QString, QList<qint64>> m_noteIds;
+
+    /* The ID of the next added note. */
+    qint64 m_nextNoteId = 1496198395707;
+
+    /* Maps profile names to the media files stored in them. */
+    QHash<QString, QSet<QString>> m_media;
+
+    /* Every action received in order. */
+    QStringList m_actions;
+
+    /* The number of bytes received. */
+    qint64 m_bytesReceived = 0;
+};
+
+#endif // MOCKANKICONNECT_H
@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+#include <iostream>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+#include "mockankiconnect.h"
+
+/* The port AnkiConnect listens on by default */
+#define DEFAULT_PORT "8765"
+
+/**
+ * Runs a mock AnkiConnect server for trying Memento's Anki integration
+ * without Anki. Every answered request is printed.
+ * Usage: mockankiconnect_server [--port] [--latency] [--failure-rate]
+ *                               [--profile] [--deck]... [--model]...
+ */
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Mock AnkiConnect server");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"port", "The port to listen on.", "port", DEFAULT_PORT},
+        {"latency", "Milliseconds to wait before answering.", "ms", "0"},
+        {"failure-rate", "Chance of an action failing.", "rate", "0"},
+        {"profile", "The name of the open profile.", "name", "User 1"},
+        {"deck", "Adds a deck.", "name"},
+        {"model", "Adds a note type, e.g. Mining:Expression,Meaning.",
+            "name:fields"},
+    });
+    parser.process(app);
+
+    MockAnkiConnect mock;
+    mock.setLatency(parser.value("latency").toInt());
+    mock.setFailureRate(parser.value("failure-rate").toDouble());
+    mock.setProfile(parser.value("profile"));
+    for (const QString &deck : parser.values("deck"))
+    {
+        mock.addDeck(deck);
+    }
+    for (const QString &model : parser.values("model"))
+    {
+        const qsizetype colon = model.indexOf(':');
+        if (colon <= 0)
+        {
+            std::cerr << "Note types must be name:field1,field2,...\n";
+            return EXIT_FAILURE;
+        }
+        mock.addModel(model.left(colon), model.mid(colon + 1).split(','));
+    }
+
+    if (!mock.listen(parser.value("port").toUShort()))
+    {
+        std::cerr << "Could not listen on port "
+                  << qPrintable(parser.value("port")) << '\n';
+        return EXIT_FAILURE;
+    }
+    std::cout << "Listening on 127.0.0.1:" << mock.port() << std::endl;
+
+    QObject::connect(&mock, &MockAnkiConnect::requestFinished, &mock,
+        [&mock] (const QString &action) {
+            std::cout << qPrintable(action) << ", "
+                      << mock.bytesReceived() << " bytes received, "
+                      << mock.noteCount() << " notes" << std::endl;
+        }
+    );
+
+    return app.exec();
+}
+
+#undef DEFAULT_PORT
@@ -0,0 +1,201 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "anki/ankiclient.h"
+#include "mockankiconnect.h"
+#include "util/globalmediator.h"
+#include "util/utils.h"
+
+/* A content addressed media filename */
+#define MEDIA_FILENAME "0123456789abcdef0123456789abcdef.mp3"
+
+/* The file the media index is saved to */
+#define MEDIA_INDEX_FILE "anki_media.json"
+
+/**
+ * Tests that AnkiClient skips media already stored in the open Anki profile
+ * and nothing else.
+ */
+class TestAnkiMediaIndex : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void skipsStoredMedia();
+    void reseedsOnProfileChange();
+    void reseedsOnTestConnection();
+
+private:
+    /**
+     * Adds the test file as media and waits for the reply.
+     * @return The filenames AnkiClient replied with.
+     */
+    QStringList addMedia();
+
+    /**
+     * Waits for the media index of a profile to be seeded.
+     * @param profile The name of the profile.
+     * @return true if the profile was seeded, false on timeout.
+     */
+    bool waitForSeed(const QString &profile);
+
+    /* A temporary directory containing the media file. */
+    QTemporaryDir m_dir;
+
+    /* The path of the media file. */
+    QString m_mediaPath;
+
+    /* The path of the media index. */
+    QString m_indexPath;
+
+    MockAnkiConnect *m_mock = nullptr;
+    AnkiClient *m_client = nullptr;
+};
+
+void TestAnkiMediaIndex::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QCoreApplication::setApplicationName("memento");
+    QDir().mkpath(DirectoryUtils::getConfigDir());
+    m_indexPath = DirectoryUtils::getConfigDir() + MEDIA_INDEX_FILE;
+
+    QVERIFY(m_dir.isValid());
+    m_mediaPath = m_dir.filePath(MEDIA_FILENAME);
+    QFile file(m_mediaPath);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("not really audio");
+    file.close();
+
+    GlobalMediator::createGlobalMediator();
+}
+
+void TestAnkiMediaIndex::init()
+{
+    QFile::remove(m_indexPath);
+
+    m_mock = new MockAnkiConnect(this);
+    QVERIFY(m_mock->listen());
+    m_mock->setProfile("User 1");
+
+    m_client = new AnkiClient(this);
+    m_client->setServer("127.0.0.1", QString::number(m_mock->port()));
+
+    AnkiReply *reply = m_client->testConnection();
+    QSignalSpy spy(reply, &AnkiReply::finishedBool);
+    QVERIFY(spy.wait());
+    QCOMPARE(spy.first().at(0).toBool(), true);
+    QVERIFY(waitForSeed("User 1"));
+}
+
+void TestAnkiMediaIndex::cleanup()
+{
+    delete m_client;
+    m_client = nullptr;
+    delete m_mock;
+    m_mock = nullptr;
+}
+
+QStringList TestAnkiMediaIndex::addMedia()
+{
+    AnkiReply *reply = m_client->addMedia({{m_mediaPath, MEDIA_FILENAME}});
+    QSignalSpy spy(reply, &AnkiReply::finishedStringList);
+    if (!spy.wait())
+    {
+        return QStringList();
+    }
+    return spy.first().at(0).toStringList();
+}
+
+bool TestAnkiMediaIndex::waitForSeed(const QString &profile)
+{
+    const QString key =
+        "127.0.0.1:" + QString::number(m_mock->port()) + '/' + profile;
+    auto seeded = [&] {
+        QFile file(m_indexPath);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            return false;
+        }
+        return QJsonDocument::fromJson(file.readAll()).object().contains(key);
+    };
+    return QTest::qWaitFor(seeded);
+}
+
+void TestAnkiMediaIndex::skipsStoredMedia()
+{
+    QCOMPARE(addMedia(), QStringList{MEDIA_FILENAME});
+    QCOMPARE(m_mock->count("storeMediaFile"), 1);
+
+    QCOMPARE(addMedia(), QStringList{MEDIA_FILENAME});
+    QCOMPARE(m_mock->count("storeMediaFile"), 1);
+}
+
+void TestAnkiMediaIndex::reseedsOnProfileChange()
+{
+    QCOMPARE(addMedia(), QStringList{MEDIA_FILENAME});
+    QCOMPARE(m_mock->count("storeMediaFile"), 1);
+
+    /* The new profile doesn't have the file, so it must be sent again */
+    m_mock->setProfile("User 2");
+    QCOMPARE(addMedia(), QStringList{MEDIA_FILENAME});
+    QCOMPARE(m_mock->count("storeMediaFile"), 2);
+    QCOMPARE(m_mock->mediaFiles(), QStringList{MEDIA_FILENAME});
+
+    QVERIFY(waitForSeed("User 2"));
+    QCOMPARE(addMedia(), QStringList{MEDIA_FILENAME});
+    QCOMPARE(m_mock->count("storeMediaFile"), 2);
+}
+
+void TestAnkiMediaIndex::reseedsOnTestConnection()
+{
+    QCOMPARE(addMedia(), QStringList{MEDIA_FILENAME});
+    QCOMPARE(m_mock->count("storeMediaFile"), 1);
+
+    /* Check Media in Anki removed the file */
+    m_mock->setMediaFiles(QStringList());
+    QFile::remove(m_indexPath);
+
+    AnkiReply *reply = m_client->testConnection();
+    QSignalSpy spy(reply, &AnkiReply::finishedBool);
+    QVERIFY(spy.wait());
+    QVERIFY(waitForSeed("User 1"));
+
+    QCOMPARE(addMedia(), QStringList{MEDIA_FILENAME});
+    QCOMPARE(m_mock->count("storeMediaFile"), 2);
+}
+
+#undef MEDIA_FILENAME
+#undef MEDIA_INDEX_FILE
+
+QTEST_MAIN(TestAnkiMediaIndex)
+#include "tst_ankimediaindex.moc"
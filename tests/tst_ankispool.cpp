@@ -0,0 +1,176 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <QDir>
+#include <QFile>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "anki/ankiclient.h"
+#include "mockankiconnect.h"
+#include "util/globalmediator.h"
+#include "util/utils.h"
+
+/* A content addressed media filename */
+#define MEDIA_FILENAME "0123456789abcdef0123456789abcdef.mp3"
+
+/* The file unsent writes are spooled to */
+#define SPOOL_FILE "anki_spool.jsonl"
+
+/* The file the media index is saved to */
+#define MEDIA_INDEX_FILE "anki_media.json"
+
+/**
+ * Tests that AnkiClient spools writes that never reached AnkiConnect, and
+ * only those, and replays them once AnkiConnect is back.
+ */
+class TestAnkiSpool : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void spoolsRefusedWrites();
+    void keepsWritesThatReachedAnki();
+
+private:
+    /**
+     * Adds the test file as media and waits for the reply.
+     * @return The error AnkiClient replied with.
+     */
+    QString addMedia();
+
+    /**
+     * Tests the connection and waits for the reply.
+     * @return true if the connection succeeded, false otherwise.
+     */
+    bool testConnection();
+
+    /* A temporary directory containing the media file. */
+    QTemporaryDir m_dir;
+
+    /* The path of the media file. */
+    QString m_mediaPath;
+
+    /* The path of the spool. */
+    QString m_spoolPath;
+
+    MockAnkiConnect *m_mock = nullptr;
+    AnkiClient *m_client = nullptr;
+};
+
+void TestAnkiSpool::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QCoreApplication::setApplicationName("memento");
+    QDir().mkpath(DirectoryUtils::getConfigDir());
+    m_spoolPath = DirectoryUtils::getConfigDir() + SPOOL_FILE;
+
+    QVERIFY(m_dir.isValid());
+    m_mediaPath = m_dir.filePath(MEDIA_FILENAME);
+    QFile file(m_mediaPath);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("not really audio");
+    file.close();
+
+    GlobalMediator::createGlobalMediator();
+}
+
+void TestAnkiSpool::init()
+{
+    QFile::remove(m_spoolPath);
+    QFile::remove(DirectoryUtils::getConfigDir() + MEDIA_INDEX_FILE);
+
+    m_mock = new MockAnkiConnect(this);
+    QVERIFY(m_mock->listen());
+
+    m_client = new AnkiClient(this);
+    m_client->setServer("127.0.0.1", QString::number(m_mock->port()));
+}
+
+void TestAnkiSpool::cleanup()
+{
+    delete m_client;
+    m_client = nullptr;
+    delete m_mock;
+    m_mock = nullptr;
+}
+
+QString TestAnkiSpool::addMedia()
+{
+    AnkiReply *reply = m_client->addMedia({{m_mediaPath, MEDIA_FILENAME}});
+    QSignalSpy spy(reply, &AnkiReply::finishedStringList);
+    if (!spy.wait())
+    {
+        return "Timed out";
+    }
+    return spy.first().at(1).toString();
+}
+
+bool TestAnkiSpool::testConnection()
+{
+    AnkiReply *reply = m_client->testConnection();
+    QSignalSpy spy(reply, &AnkiReply::finishedBool);
+    return spy.wait() && spy.first().at(0).toBool();
+}
+
+void TestAnkiSpool::spoolsRefusedWrites()
+{
+    const quint16 port = m_mock->port();
+    m_mock->close();
+
+    QVERIFY(!addMedia().isEmpty());
+    QVERIFY(QFile::exists(m_spoolPath));
+    QCOMPARE(m_mock->count("storeMediaFile"), 0);
+
+    QVERIFY(m_mock->listen(port));
+    QVERIFY(testConnection());
+    QTRY_COMPARE(m_mock->count("storeMediaFile"), 1);
+    QCOMPARE(m_mock->mediaFiles(), QStringList{MEDIA_FILENAME});
+    QVERIFY(!QFile::exists(m_spoolPath));
+}
+
+void TestAnkiSpool::keepsWritesThatReachedAnki()
+{
+    /* AnkiConnect runs the actions but the reply is lost */
+    m_mock->setDropRequests(true);
+    QVERIFY(!addMedia().isEmpty());
+    QVERIFY(m_mock->count("storeMediaFile") > 0);
+    QVERIFY(!QFile::exists(m_spoolPath));
+
+    /* Nothing is replayed */
+    m_mock->setDropRequests(false);
+    m_mock->clearActions();
+    QVERIFY(testConnection());
+    QTest::qWait(500);
+    QCOMPARE(m_mock->count("storeMediaFile"), 0);
+}
+
+#undef MEDIA_FILENAME
+#undef SPOOL_FILE
+#undef MEDIA_INDEX_FILE
+
+QTEST_MAIN(TestAnkiSpool)
+#include "tst_ankispool.moc"
@@ -0,0 +1,155 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "audio/audiocache.h"
+
+/* Big enough to never evict anything */
+#define LARGE_CACHE (1024 * 1024)
+
+/**
+ * Tests that the AudioCache survives being torn down without saving its index.
+ */
+class TestAudioCache : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void keepsSavedUrlsAfterCrash();
+    void adoptsUnindexedFiles();
+    void evictsAdoptedFilesFirst();
+    void removesStrayFiles();
+
+private:
+    /**
+     * Returns the MD5 of the data as a hex string.
+     * @param data The data to hash.
+     * @return The hex MD5 of the data.
+     */
+    static QString md5(const QByteArray &data);
+
+    /**
+     * Writes a file directly into the cache directory.
+     * @param name The name of the file.
+     * @param data The contents of the file.
+     */
+    void writeFile(const QString &name, const QByteArray &data);
+
+    /* The directory of the cache. Recreated for every test. */
+    QTemporaryDir *m_dir = nullptr;
+};
+
+void TestAudioCache::init()
+{
+    m_dir = new QTemporaryDir;
+    QVERIFY(m_dir->isValid());
+}
+
+void TestAudioCache::cleanup()
+{
+    delete m_dir;
+    m_dir = nullptr;
+}
+
+QString TestAudioCache::md5(const QByteArray &data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Md5).toHex();
+}
+
+void TestAudioCache::writeFile(const QString &name, const QByteArray &data)
+{
+    QFile file(m_dir->filePath(name));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(data), data.size());
+}
+
+void TestAudioCache::keepsSavedUrlsAfterCrash()
+{
+    /* The cache is leaked so its destructor never saves the index */
+    AudioCache *crashed = new AudioCache(m_dir->path(), LARGE_CACHE);
+    QVERIFY(!crashed->insert("http://a/1", "first").path.isEmpty());
+    QVERIFY(!crashed->insert("http://a/2", "second").path.isEmpty());
+
+    AudioCache cache(m_dir->path(), LARGE_CACHE);
+    const AudioCache::Entry first = cache.find("http://a/1");
+    QCOMPARE(first.md5, md5("first"));
+    QVERIFY(QFile::exists(first.path));
+
+    /* The second insert may not have been saved yet, but its file is kept */
+    QVERIFY(QFile::exists(m_dir->filePath(md5("second"))));
+}
+
+void TestAudioCache::adoptsUnindexedFiles()
+{
+    writeFile(md5("orphan"), "orphan");
+    {
+        AudioCache cache(m_dir->path(), LARGE_CACHE);
+    }
+    QVERIFY(QFile::exists(m_dir->filePath(md5("orphan"))));
+
+    /* Inserting the same audio reuses the adopted file */
+    AudioCache cache(m_dir->path(), LARGE_CACHE);
+    const AudioCache::Entry entry = cache.insert("http://a/1", "orphan");
+    QCOMPARE(entry.md5, md5("orphan"));
+    QCOMPARE(QFileInfo(entry.path).fileName(), md5("orphan"));
+    QCOMPARE(cache.find("http://a/1").md5, md5("orphan"));
+}
+
+void TestAudioCache::evictsAdoptedFilesFirst()
+{
+    const QByteArray indexed(100, 'i');
+    const QByteArray orphan(100, 'o');
+    const QByteArray added(100, 'a');
+    {
+        AudioCache cache(m_dir->path(), 250);
+        QVERIFY(!cache.insert("http://a/1", indexed).path.isEmpty());
+    }
+    writeFile(md5(orphan), orphan);
+
+    AudioCache cache(m_dir->path(), 250);
+    QVERIFY(!cache.insert("http://a/2", added).path.isEmpty());
+    QVERIFY(!QFile::exists(m_dir->filePath(md5(orphan))));
+    QVERIFY(!cache.find("http://a/1").path.isEmpty());
+    QVERIFY(!cache.find("http://a/2").path.isEmpty());
+}
+
+void TestAudioCache::removesStrayFiles()
+{
+    writeFile("index.json.a1B2c3", "partial index");
+    writeFile("not-an-md5", "junk");
+
+    AudioCache cache(m_dir->path(), LARGE_CACHE);
+    QVERIFY(!QFile::exists(m_dir->filePath("index.json.a1B2c3")));
+    QVERIFY(!QFile::exists(m_dir->filePath("not-an-md5")));
+}
+
+#undef LARGE_CACHE
+
+QTEST_GUILESS_MAIN(TestAudioCache)
+#include "tst_audiocache.moc"
@@ -0,0 +1,298 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstring>
+#include <QDateTime>
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <QtMath>
+#include <QtTest>
+
+#include "audio/audioengine.h"
+
+/* The sample rate of the test files */
+#define SAMPLE_RATE 44100
+
+/* The number of frames in the test files, half a second */
+#define FRAMES (SAMPLE_RATE / 2)
+
+/* The number of frames the test files have once decoded */
+#define DECODED_FRAMES 24000
+
+/**
+ * Tests that the AudioEngine decodes, caches and plays audio on the null audio
+ * output.
+ */
+class TestAudioEngine : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void decodesToPcm();
+    void detectsSilence();
+    void fingerprintsAudio();
+    void cachesDecodedAudio();
+    void forgetsChangedFiles();
+    void evictsWhenFull();
+    void failsOnInvalidFiles();
+    void playsDecodedAudio();
+    void playsFiles();
+
+private:
+    /**
+     * Writes a mono 16-bit WAV file.
+     * @param name      The name of the file in the temporary directory.
+     * @param frequency The frequency of the tone in Hz. 0 for silence.
+     * @return The path of the file.
+     */
+    QString writeWav(const QString &name, double frequency);
+
+    /**
+     * Decodes a file and waits for the result.
+     * @param path The path of the file.
+     * @return The decoded audio. nullptr on error.
+     */
+    SharedDecodedAudio load(const QString &path);
+
+    /**
+     * Waits for playback to start.
+     * @param spy The spy on AudioEngine::started.
+     * @return The startup latency in microseconds. -1 on timeout.
+     */
+    qint64 waitForStart(QSignalSpy &spy);
+
+    /* The directory the test files are written to. */
+    QTemporaryDir m_dir;
+
+    /* A half second 440 Hz tone. */
+    QString m_tone;
+
+    /* A copy of the tone. */
+    QString m_toneCopy;
+
+    /* A half second 880 Hz tone. */
+    QString m_highTone;
+
+    /* Half a second of silence. */
+    QString m_silence;
+
+    /* The engine under test. */
+    AudioEngine *m_engine = nullptr;
+};
+
+void TestAudioEngine::initTestCase()
+{
+    qRegisterMetaType<SharedDecodedAudio>();
+
+    QVERIFY(m_dir.isValid());
+    m_tone = writeWav("tone.wav", 440);
+    m_toneCopy = writeWav("tone-copy.wav", 440);
+    m_highTone = writeWav("high-tone.wav", 880);
+    m_silence = writeWav("silence.wav", 0);
+}
+
+void TestAudioEngine::init()
+{
+    m_engine = new AudioEngine("null", AudioEngine::DEFAULT_CACHE_SIZE, this);
+    QVERIFY(m_engine->isValid());
+}
+
+void TestAudioEngine::cleanup()
+{
+    delete m_engine;
+    m_engine = nullptr;
+}
+
+QString TestAudioEngine::writeWav(const QString &name, const double frequency)
+{
+    QByteArray samples(FRAMES * 2, '\0');
+    for (int i = 0; i < FRAMES; ++i)
+    {
+        const double value = qSin(2 * M_PI * frequency * i / SAMPLE_RATE);
+        qToLittleEndian<qint16>(qRound(value * 16000), samples.data() + i * 2);
+    }
+
+    QByteArray header(44, '\0');
+    char *data = header.data();
+    std::memcpy(data, "RIFF", 4);
+    qToLittleEndian<quint32>(36 + samples.size(), data + 4);
+    std::memcpy(data + 8, "WAVEfmt ", 8);
+    qToLittleEndian<quint32>(16, data + 16);
+    qToLittleEndian<quint16>(1, data + 20);
+    qToLittleEndian<quint16>(1, data + 22);
+    qToLittleEndian<quint32>(SAMPLE_RATE, data + 24);
+    qToLittleEndian<quint32>(SAMPLE_RATE * 2, data + 28);
+    qToLittleEndian<quint16>(2, data + 32);
+    qToLittleEndian<quint16>(16, data + 34);
+    std::memcpy(data + 36, "data", 4);
+    qToLittleEndian<quint32>(samples.size(), data + 40);
+
+    const QString path = m_dir.filePath(name);
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return QString();
+    }
+    file.write(header);
+    file.write(samples);
+    return path;
+}
+
+SharedDecodedAudio TestAudioEngine::load(const QString &path)
+{
+    AudioEngineReply *reply = m_engine->load(path);
+    QSignalSpy spy(reply, &AudioEngineReply::finished);
+    if (!QTest::qWaitFor([&] { return !spy.isEmpty(); }))
+    {
+        return nullptr;
+    }
+    return spy.first().at(0).value<SharedDecodedAudio>();
+}
+
+qint64 TestAudioEngine::waitForStart(QSignalSpy &spy)
+{
+    if (!QTest::qWaitFor([&] { return !spy.isEmpty(); }))
+    {
+        return -1;
+    }
+    return spy.takeFirst().at(0).toLongLong();
+}
+
+void TestAudioEngine::decodesToPcm()
+{
+    const SharedDecodedAudio audio = load(m_tone);
+    QVERIFY(audio);
+    QVERIFY(audio->wav.startsWith("RIFF"));
+    QVERIFY(!audio->silent);
+
+    /* Resampling may add or drop a few frames at the edges */
+    QVERIFY2(
+        qAbs(audio->frames - DECODED_FRAMES) < DECODED_FRAMES / 10,
+        qPrintable(QString::number(audio->frames))
+    );
+}
+
+void TestAudioEngine::detectsSilence()
+{
+    const SharedDecodedAudio audio = load(m_silence);
+    QVERIFY(audio);
+    QVERIFY(audio->silent);
+}
+
+void TestAudioEngine::fingerprintsAudio()
+{
+    const SharedDecodedAudio tone = load(m_tone);
+    const SharedDecodedAudio copy = load(m_toneCopy);
+    const SharedDecodedAudio high = load(m_highTone);
+    QVERIFY(tone && copy && high);
+    QCOMPARE(tone->fingerprint, copy->fingerprint);
+    QVERIFY(tone->fingerprint != high->fingerprint);
+}
+
+void TestAudioEngine::cachesDecodedAudio()
+{
+    QVERIFY(!m_engine->find(m_tone));
+
+    const SharedDecodedAudio audio = load(m_tone);
+    QVERIFY(audio);
+    QVERIFY(m_engine->find(m_tone) == audio);
+    QVERIFY(load(m_tone) == audio);
+}
+
+void TestAudioEngine::forgetsChangedFiles()
+{
+    const QString path = writeWav("changed.wav", 440);
+    QVERIFY(load(path));
+    QVERIFY(m_engine->find(path));
+
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.setFileTime(
+        QDateTime::currentDateTime().addSecs(60),
+        QFileDevice::FileModificationTime
+    ));
+    file.close();
+    QVERIFY(!m_engine->find(path));
+}
+
+void TestAudioEngine::evictsWhenFull()
+{
+    /* Only fits one decoded clip */
+    delete m_engine;
+    m_engine = new AudioEngine("null", DECODED_FRAMES * 4 * 3 / 2, this);
+
+    QVERIFY(load(m_tone));
+    QVERIFY(load(m_highTone));
+    QVERIFY(!m_engine->find(m_tone));
+    QVERIFY(m_engine->find(m_highTone));
+}
+
+void TestAudioEngine::failsOnInvalidFiles()
+{
+    const QString path = m_dir.filePath("not-audio.wav");
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("this is not audio");
+    file.close();
+
+    QVERIFY(!load(path));
+    QVERIFY(!load(m_dir.filePath("missing.wav")));
+
+    /* The decoder still works after a failure */
+    QVERIFY(load(m_tone));
+}
+
+void TestAudioEngine::playsDecodedAudio()
+{
+    const SharedDecodedAudio audio = load(m_tone);
+    QVERIFY(audio);
+
+    QSignalSpy spy(m_engine, &AudioEngine::started);
+    QVERIFY(m_engine->play(audio));
+    const qint64 first = waitForStart(spy);
+    QVERIFY(first >= 0);
+
+    /* The audio output is already open the second time */
+    QVERIFY(m_engine->play(audio));
+    const qint64 second = waitForStart(spy);
+    QVERIFY(second >= 0);
+
+    qInfo() << "Startup latency:" << first << "us cold," << second << "us warm";
+}
+
+void TestAudioEngine::playsFiles()
+{
+    QSignalSpy spy(m_engine, &AudioEngine::started);
+    QVERIFY(m_engine->playFile(m_tone));
+    QVERIFY(waitForStart(spy) >= 0);
+}
+
+#undef SAMPLE_RATE
+#undef FRAMES
+#undef DECODED_FRAMES
+
+QTEST_GUILESS_MAIN(TestAudioEngine)
+#include "tst_audioengine.moc"
@@ -0,0 +1,374 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024 Ripose
+//
+// This file is part of Memento.
+//
+// Memento is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2 of the License.
+//
+// Memento is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Memento.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QtTest>
+
+#include "audio/audiosourceresolver.h"
+
+/* The number of requests the resolver sends to a host at once */
+#define MAX_HOST_REQUESTS 4
+
+/**
+ * A minimal HTTP server that answers every GET with a JSON audio source list
+ * containing one file named after the request path. Requests can be held
+ * unanswered to observe how many are in flight.
+ */
+class SourceServer : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    SourceServer(QObject *parent = nullptr);
+
+    /**
+     * Returns the URL of a source on this server.
+     * @param path The path of the source.
+     * @return The URL of the source.
+     */
+    QString url(const QString &path) const;
+
+    /**
+     * Sets whether requests are held instead of being answered. Releasing
+     * answers every held request.
+     * @param hold true to hold requests, false to answer them.
+     */
+    void setHold(bool hold);
+
+    /**
+     * Returns the number of requests received for a path.
+     * @param path The path of the source.
+     * @return The number of requests for the path.
+     */
+    int count(const QString &path) const;
+
+    /**
+     * Returns the total number of requests received.
+     * @return The number of requests.
+     */
+    int total() const;
+
+    /**
+     * Returns the number of requests currently held.
+     * @return The number of held requests.
+     */
+    int active() const;
+
+    /**
+     * Returns the most requests that were ever held at once.
+     * @return The maximum number of held requests.
+     */
+    int maxActive() const;
+
+private Q_SLOTS:
+    /**
+     * Starts reading requests from new connections.
+     */
+    void acceptConnections();
+
+private:
+    /**
+     * Reads a request from a socket, answering or holding it once it is
+     * complete.
+     * @param socket The socket to read from.
+     */
+    void readRequest(QTcpSocket *socket);
+
+    /**
+     * Answers a request and closes the connection.
+     * @param socket The socket the request was received on.
+     * @param path   The path of the request.
+     */
+    void respond(QTcpSocket *socket, const QString &path);
+
+    /* true if requests are held instead of being answered. */
+    bool m_hold = false;
+
+    /* The total number of requests received. */
+    int m_total = 0;
+
+    /* The most requests that were ever held at once. */
+    int m_maxActive = 0;
+
+    /* Maps paths to the number of requests received for them. */
+    QHash<QString, int> m_counts;
+
+    /* Partially read requests. */
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+
+    /* Held requests and their paths. */
+    QList<QPair<QTcpSocket *, QString>> m_held;
+};
+
+SourceServer::SourceServer(QObject *parent) : QTcpServer(parent)
+{
+    connect(
+        this, &QTcpServer::newConnection,
+        this, &SourceServer::acceptConnections
+    );
+}
+
+QString SourceServer::url(const QString &path) const
+{
+    return QString("http://127.0.0.1:%1/%2").arg(serverPort()).arg(path);
+}
+
+void SourceServer::setHold(const bool hold)
+{
+    m_hold = hold;
+    if (m_hold)
+    {
+        return;
+    }
+    const QList<QPair<QTcpSocket *, QString>> held = m_held;
+    m_held.clear();
+    for (const auto &request : held)
+    {
+        respond(request.first, request.second);
+    }
+}
+
+int SourceServer::count(const QString &path) const
+{
+    return m_counts.value(path);
+}
+
+int SourceServer::total() const
+{
+    return m_total;
+}
+
+int SourceServer::active() const
+{
+    return m_held.size();
+}
+
+int SourceServer::maxActive() const
+{
+    return m_maxActive;
+}
+
+void SourceServer::acceptConnections()
+{
+    while (QTcpSocket *socket = nextPendingConnection())
+    {
+        connect(socket, &QTcpSocket::readyRead, this,
+            [=] { readRequest(socket); }
+        );
+        connect(
+            socket, &QTcpSocket::disconnected,
+            socket, &QObject::deleteLater
+        );
+    }
+}
+
+void SourceServer::readRequest(QTcpSocket *socket)
+{
+    QByteArray &buffer = m_buffers[socket];
+    buffer += socket->readAll();
+    if (buffer.indexOf("\r\n\r\n") == -1)
+    {
+        return;
+    }
+    const QList<QByteArray> requestLine =
+        buffer.left(buffer.indexOf("\r\n")).split(' ');
+    m_buffers.remove(socket);
+    const QString path =
+        requestLine.size() > 1 ? requestLine[1].mid(1) : QString();
+
+    ++m_counts[path];
+    ++m_total;
+    if (m_hold)
+    {
+        m_held << qMakePair(socket, path);
+        m_maxActive = qMax(m_maxActive, m_held.size());
+        return;
+    }
+    respond(socket, path);
+}
+
+void SourceServer::respond(QTcpSocket *socket, const QString &path)
+{
+    QJsonObject source;
+    source["name"] = path;
+    source["url"] = url(path + ".mp3");
+    QJsonObject root;
+    root["type"] = "audioSourceList";
+    root["audioSources"] = QJsonArray{source};
+    const QByteArray body = QJsonDocument(root).toJson();
+
+    socket->write(
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: application/json\r\n"
+        "Connection: close\r\n"
+        "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+        "\r\n" + body
+    );
+    socket->disconnectFromHost();
+}
+
+/**
+ * Tests that the AudioSourceResolver merges requests, caches results and limits
+ * the requests sent to a host.
+ */
+class TestAudioSourceResolver : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void mergesInFlightRequests();
+    void cachesResolvedLists();
+    void expiresResolvedLists();
+    void limitsRequestsPerHost();
+
+private:
+    /**
+     * Resolves a source and waits for the result.
+     * @param path The path of the source on the server.
+     * @return The resolved audio files.
+     */
+    QList<ResolvedAudioSource> resolve(const QString &path);
+
+    /* The server the sources are resolved from. */
+    SourceServer *m_server = nullptr;
+
+    /* The resolver under test. */
+    AudioSourceResolver *m_resolver = nullptr;
+};
+
+void TestAudioSourceResolver::initTestCase()
+{
+    qRegisterMetaType<QList<ResolvedAudioSource>>();
+}
+
+void TestAudioSourceResolver::init()
+{
+    m_server = new SourceServer(this);
+    QVERIFY(m_server->listen(QHostAddress::LocalHost));
+    m_resolver = new AudioSourceResolver(this);
+}
+
+void TestAudioSourceResolver::cleanup()
+{
+    delete m_resolver;
+    m_resolver = nullptr;
+    delete m_server;
+    m_server = nullptr;
+}
+
+QList<ResolvedAudioSource> TestAudioSourceResolver::resolve(
+    const QString &path)
+{
+    AudioSourceResolverReply *reply = m_resolver->resolve(m_server->url(path));
+    QSignalSpy spy(reply, &AudioSourceResolverReply::finished);
+    if (!QTest::qWaitFor([&] { return !spy.isEmpty(); }))
+    {
+        return {};
+    }
+    return spy.first().at(0).value<QList<ResolvedAudioSource>>();
+}
+
+void TestAudioSourceResolver::mergesInFlightRequests()
+{
+    m_server->setHold(true);
+    AudioSourceResolverReply *first =
+        m_resolver->resolve(m_server->url("word"));
+    AudioSourceResolverReply *second =
+        m_resolver->resolve(m_server->url("word"));
+    QCOMPARE(first, second);
+
+    QSignalSpy spy(first, &AudioSourceResolverReply::finished);
+    QTRY_COMPARE(m_server->active(), 1);
+    m_server->setHold(false);
+    QTRY_COMPARE(spy.size(), 1);
+
+    const QList<ResolvedAudioSource> sources =
+        spy.first().at(0).value<QList<ResolvedAudioSource>>();
+    QCOMPARE(sources.size(), 1);
+    QCOMPARE(sources.first().name, QString("word"));
+    QCOMPARE(m_server->count("word"), 1);
+}
+
+void TestAudioSourceResolver::cachesResolvedLists()
+{
+    QCOMPARE(resolve("word").size(), 1);
+    QCOMPARE(m_server->count("word"), 1);
+
+    QCOMPARE(resolve("word").size(), 1);
+    QCOMPARE(m_server->count("word"), 1);
+}
+
+void TestAudioSourceResolver::expiresResolvedLists()
+{
+    m_resolver->setCacheTtl(100);
+
+    QCOMPARE(resolve("word").size(), 1);
+    QCOMPARE(m_server->count("word"), 1);
+
+    QTest::qWait(200);
+    QCOMPARE(resolve("word").size(), 1);
+    QCOMPARE(m_server->count("word"), 2);
+}
+
+void TestAudioSourceResolver::limitsRequestsPerHost()
+{
+    const int requests = MAX_HOST_REQUESTS * 2 + 1;
+
+    m_server->setHold(true);
+    QList<QSignalSpy *> spies;
+    for (int i = 0; i < requests; ++i)
+    {
+        AudioSourceResolverReply *reply =
+            m_resolver->resolve(m_server->url(QString::number(i)));
+        spies << new QSignalSpy(reply, &AudioSourceResolverReply::finished);
+    }
+
+    /* Give extra requests a chance to arrive if the limit is broken */
+    QTRY_COMPARE(m_server->active(), MAX_HOST_REQUESTS);
+    QTest::qWait(200);
+    QCOMPARE(m_server->active(), MAX_HOST_REQUESTS);
+
+    /* Queued requests are sent as earlier ones finish */
+    m_server->setHold(false);
+    for (QSignalSpy *spy : spies)
+    {
+        QTRY_COMPARE(spy->size(), 1);
+    }
+    qDeleteAll(spies);
+
+    QCOMPARE(m_server->total(), requests);
+    QCOMPARE(m_server->maxActive(), MAX_HOST_REQUESTS);
+}
+
+#undef MAX_HOST_REQUESTS
+
+QTEST_GUILESS_MAIN(TestAudioSourceResolver)
+#include "tst_audiosourceresolver.moc"